@@ -6,6 +6,7 @@ dnl   SANE_SET_AM_LDFLAGS
 dnl   SANE_CHECK_DLL_LIB
 dnl   SANE_EXTRACT_LDFLAGS(LIBS, LDFLAGS)
 dnl   SANE_CHECK_JPEG
+dnl   SANE_CHECK_ZLIB
 dnl   SANE_CHECK_IEEE1284
 dnl   SANE_CHECK_PTHREAD
 dnl   SANE_CHECK_LOCKING
@@ -324,6 +325,19 @@ AC_DEFUN([SANE_CHECK_PNG],
   AC_SUBST(PNG_LIBS)
 ])
 
+AC_DEFUN([SANE_CHECK_ZLIB],
+[
+  AC_CHECK_LIB(z,compress2,
+  [
+    AC_CHECK_HEADER(zlib.h,
+    [sane_cv_use_zlib="yes"; ZLIB_LIBS="-lz"],)
+  ],)
+  if test "$sane_cv_use_zlib" = "yes" ; then
+    AC_DEFINE(HAVE_LIBZ,1,[Define to 1 if you have the zlib library.])
+  fi
+  AC_SUBST(ZLIB_LIBS)
+])
+
 #
 # Checks for pthread support
 AC_DEFUN([SANE_CHECK_LOCKING],
@@ -65,6 +65,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+# include <sys/time.h>
+# define DLL_PARALLEL_PROBE
+#endif
 
 #if defined(HAVE_DLOPEN) && defined(HAVE_DLFCN_H)
 # include <dlfcn.h>
@@ -199,6 +209,7 @@ struct backend
   u_int inited:1;		/* has the backend been initialized? */
   void *handle;			/* handle returned by dlopen() */
   void *(*op[NUM_OPS]) (void);
+  int busy;			/* being probed by a worker thread */
 };
 
 #define BE_ENTRY(be,func)       sane_##be##_##func
@@ -239,7 +250,8 @@ struct backend
     BE_ENTRY(name,cancel),                      \
     BE_ENTRY(name,set_io_mode),                 \
     BE_ENTRY(name,get_select_fd)                \
-  }                                             \
+  },                                            \
+  0 /* busy */                                  \
 }
 
 #ifndef __BEOS__
@@ -247,7 +259,7 @@ struct backend
 #include "dll-preload.h"
 #else
 static struct backend preloaded_backends[] = {
- { 0, 0, 0, 0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }}
+ { 0, 0, 0, 0, 0, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }, 0}
 };
 #endif
 #endif
@@ -276,6 +288,61 @@ static struct alias *first_alias;
 static SANE_Auth_Callback auth_callback;
 static struct backend *first_backend;
 
+#ifdef DLL_PARALLEL_PROBE
+/* SANE_DLL_THREADS > 0 makes sane_get_devices() initialize and query the
+   backends on that many threads, waiting at most SANE_DLL_TIMEOUT seconds
+   for them.  Backends that are still busy after that are left out until
+   they're done.  */
+#define DLL_THREADS_MAX		64
+#define DLL_TIMEOUT_DEFAULT	10
+
+struct probe_job
+{
+  struct backend *be;
+  int done;
+  SANE_Status status;
+  const SANE_Device **list;
+};
+
+struct probe_run
+{
+  int refs;			/* caller and worker threads */
+  int abandoned;		/* caller stopped waiting */
+  int next;			/* next job to hand out */
+  int num_done;
+  int num_jobs;
+  struct probe_job *job;
+  SANE_Bool local_only;
+};
+
+static int probe_threads;
+static int probe_timeout = DLL_TIMEOUT_DEFAULT;
+static int probes_running;	/* backends being probed */
+static pthread_mutex_t probe_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t probe_cond = PTHREAD_COND_INITIALIZER;
+
+/* Wait until no backend is probed anymore. */
+static void
+wait_for_probes (void)
+{
+  pthread_mutex_lock (&probe_lock);
+  while (probes_running > 0)
+    pthread_cond_wait (&probe_cond, &probe_lock);
+  pthread_mutex_unlock (&probe_lock);
+}
+#endif /* DLL_PARALLEL_PROBE */
+
+/* SANE_DLL_CACHE names a file in which sane_get_devices() stores the
+   merged device list.  Later calls, also from other processes, return
+   it without loading any backend for SANE_DLL_CACHE_TTL seconds, unless
+   the configured backends or the attached USB devices have changed.  */
+#define DLL_CACHE_VERSION	1
+#define DLL_CACHE_TTL_DEFAULT	300
+
+static char *cache_path;
+static int cache_ttl = DLL_CACHE_TTL_DEFAULT;
+static int devlist_incomplete;	/* some backend was skipped */
+
 #ifndef __BEOS__
 static const char *op_name[] = {
   "init", "exit", "get_devices", "open", "close", "get_option_descriptor",
@@ -908,6 +975,44 @@ sane_init (SANE_Int * version_code, SANE_Auth_Callback authorize)
   DBG (1, "sane_init: SANE dll backend version %s from %s\n", DLL_VERSION,
        PACKAGE_STRING);
 
+#ifdef DLL_PARALLEL_PROBE
+  {
+    char *env;
+
+    env = getenv ("SANE_DLL_THREADS");
+    probe_threads = env ? atoi (env) : 0;
+    if (probe_threads < 0)
+      probe_threads = 0;
+    if (probe_threads > DLL_THREADS_MAX)
+      probe_threads = DLL_THREADS_MAX;
+
+    env = getenv ("SANE_DLL_TIMEOUT");
+    probe_timeout = env ? atoi (env) : DLL_TIMEOUT_DEFAULT;
+    if (probe_timeout <= 0)
+      probe_timeout = DLL_TIMEOUT_DEFAULT;
+
+    if (probe_threads > 0)
+      DBG (2, "sane_init: probing backends on %d threads, timeout %d s\n",
+	   probe_threads, probe_timeout);
+  }
+#endif /* DLL_PARALLEL_PROBE */
+
+  {
+    char *env;
+
+    env = getenv ("SANE_DLL_CACHE");
+    if (env && env[0])
+      {
+	cache_path = strdup (env);
+	env = getenv ("SANE_DLL_CACHE_TTL");
+	cache_ttl = env ? atoi (env) : DLL_CACHE_TTL_DEFAULT;
+	if (cache_ttl < 0)
+	  cache_ttl = DLL_CACHE_TTL_DEFAULT;
+	DBG (2, "sane_init: caching device list in `%s' for %d s\n",
+	     cache_path ? cache_path : "", cache_ttl);
+      }
+  }
+
 #ifndef __BEOS__
   /* chain preloaded backends together: */
   for (i = 0; i < NELEMS (preloaded_backends); ++i)
@@ -983,6 +1088,17 @@ sane_exit (void)
 
   DBG (2, "sane_exit: exiting\n");
 
+#ifdef DLL_PARALLEL_PROBE
+  /* backends can't be shut down while they are probed */
+  wait_for_probes ();
+#endif /* DLL_PARALLEL_PROBE */
+
+  if (cache_path)
+    {
+      free (cache_path);
+      cache_path = NULL;
+    }
+
   for (be = first_backend; be; be = next)
     {
       next = be->next;
@@ -1054,20 +1170,6 @@ sane_exit (void)
   DBG (3, "sane_exit: finished\n");
 }
 
-/* Note that a call to get_devices() implies that we'll have to load
-   all backends.  To avoid this, you can call sane_open() directly
-   (assuming you know the name of the backend/device).  This is
-   appropriate for the command-line interface of SANE, for example.
- */
-SANE_Status
-sane_get_devices (const SANE_Device *** device_list, SANE_Bool local_only)
-{
-  const SANE_Device **be_list;
-  struct backend *be;
-  SANE_Status status;
-  char *full_name;
-  int i, num_devs;
-  size_t len;
 #define ASSERT_SPACE(n)                                                    \
   {                                                                        \
     if (devlist_len + (n) > devlist_size)                                  \
@@ -1082,82 +1184,534 @@ sane_get_devices (const SANE_Device *** device_list, SANE_Bool local_only)
       }                                                                    \
   }
 
-  DBG (3, "sane_get_devices\n");
+/* Append the devices BE_LIST of backend BE to devlist. */
+static SANE_Status
+add_devices (struct backend *be, const SANE_Device ** be_list)
+{
+  char *full_name;
+  int i, num_devs;
+  size_t len;
 
-  if (devlist)
-    for (i = 0; i < devlist_len; ++i)
-      free ((void *) devlist[i]);
-  devlist_len = 0;
+  /* count the number of devices for this backend: */
+  for (num_devs = 0; be_list[num_devs]; ++num_devs);
 
-  for (be = first_backend; be; be = be->next)
+  ASSERT_SPACE (num_devs);
+
+  for (i = 0; i < num_devs; ++i)
     {
-      if (!be->inited)
-	if (init (be) != SANE_STATUS_GOOD)
+      SANE_Device *dev;
+      char *mem;
+      struct alias *alias;
+
+      for (alias = first_alias; alias != NULL; alias = alias->next)
+	{
+	  len = strlen (be->name);
+	  if (strlen (alias->oldname) <= len)
+	    continue;
+	  if (strncmp (alias->oldname, be->name, len) == 0
+	      && alias->oldname[len] == ':'
+	      && strcmp (&alias->oldname[len + 1], be_list[i]->name) == 0)
+	    break;
+	}
+
+      if (alias)
+	{
+	  if (!alias->newname)	/* hidden device */
+	    continue;
+
+	  len = strlen (alias->newname);
+	  mem = malloc (sizeof (*dev) + len + 1);
+	  if (!mem)
+	    return SANE_STATUS_NO_MEM;
+
+	  full_name = mem + sizeof (*dev);
+	  strcpy (full_name, alias->newname);
+	}
+      else
+	{
+	  /* create a new device entry with a device name that is the
+	     sum of the backend name a colon and the backend's device
+	     name: */
+	  len = strlen (be->name) + 1 + strlen (be_list[i]->name);
+	  mem = malloc (sizeof (*dev) + len + 1);
+	  if (!mem)
+	    return SANE_STATUS_NO_MEM;
+
+	  full_name = mem + sizeof (*dev);
+	  strcpy (full_name, be->name);
+	  strcat (full_name, ":");
+	  strcat (full_name, be_list[i]->name);
+	}
+
+      dev = (SANE_Device *) mem;
+      dev->name = full_name;
+      dev->vendor = be_list[i]->vendor;
+      dev->model = be_list[i]->model;
+      dev->type = be_list[i]->type;
+
+      devlist[devlist_len++] = dev;
+    }
+  return SANE_STATUS_GOOD;
+}
+
+#ifdef DLL_PARALLEL_PROBE
+
+static void
+probe_backend (struct probe_job *job, SANE_Bool local_only)
+{
+  job->list = NULL;
+  job->status = SANE_STATUS_GOOD;
+  if (!job->be->inited)
+    job->status = init (job->be);
+  if (job->status == SANE_STATUS_GOOD)
+    job->status = (*(op_get_devs_t)job->be->op[OP_GET_DEVS])
+      (&job->list, local_only);
+}
+
+static void
+release_probe_run (struct probe_run *run)
+{
+  /* called with probe_lock held */
+  if (--run->refs == 0)
+    {
+      free (run->job);
+      free (run);
+    }
+}
+
+static void *
+probe_worker (void *arg)
+{
+  struct probe_run *run = arg;
+  struct probe_job *job;
+
+  pthread_mutex_lock (&probe_lock);
+  while (!run->abandoned && run->next < run->num_jobs)
+    {
+      job = &run->job[run->next++];
+      pthread_mutex_unlock (&probe_lock);
+
+      DBG (4, "probe_worker: probing backend `%s'\n", job->be->name);
+      probe_backend (job, run->local_only);
+
+      pthread_mutex_lock (&probe_lock);
+      job->done = 1;
+      job->be->busy = 0;
+      ++run->num_done;
+      --probes_running;
+      pthread_cond_broadcast (&probe_cond);
+    }
+  release_probe_run (run);
+  pthread_mutex_unlock (&probe_lock);
+  return NULL;
+}
+
+/* Probe the backends on worker threads.  Preloaded backends share the
+   sanei code and are probed one by one by the calling thread meanwhile.
+   The devices are added in the order of the backend list.  */
+static SANE_Status
+get_devices_parallel (SANE_Bool local_only)
+{
+  struct probe_run *run;
+  struct probe_job *mine, **order, *result;
+  struct backend *be;
+  struct timeval now;
+  struct timespec deadline;
+  pthread_attr_t attr;
+  pthread_t thread;
+  SANE_Status status = SANE_STATUS_GOOD;
+  int i, n, num_backends, num_mine = 0, started = 0;
+
+  for (num_backends = 0, be = first_backend; be; be = be->next)
+    ++num_backends;
+
+  run = calloc (1, sizeof (*run));
+  mine = calloc (num_backends + 1, sizeof (mine[0]));
+  order = calloc (num_backends + 1, sizeof (order[0]));
+  result = calloc (num_backends + 1, sizeof (result[0]));
+  if (run)
+    run->job = calloc (num_backends + 1, sizeof (run->job[0]));
+  if (!run || !run->job || !mine || !order || !result)
+    {
+      if (run)
+	free (run->job);
+      free (run);
+      free (mine);
+      free (order);
+      free (result);
+      return SANE_STATUS_NO_MEM;
+    }
+
+  pthread_mutex_lock (&probe_lock);
+  run->local_only = local_only;
+  for (n = 0, be = first_backend; be; be = be->next)
+    {
+      if (be->busy)
+	{
+	  DBG (2, "sane_get_devices: backend `%s' is still busy, "
+	       "skipping it\n", be->name);
+	  devlist_incomplete = 1;
 	  continue;
+	}
+      if (be->permanent)
+	{
+	  mine[num_mine].be = be;
+	  order[n++] = &mine[num_mine++];
+	}
+      else
+	{
+	  run->job[run->num_jobs].be = be;
+	  be->busy = 1;
+	  ++probes_running;
+	  order[n++] = &run->job[run->num_jobs++];
+	}
+    }
+  run->refs = 1;
 
-      status = (*(op_get_devs_t)be->op[OP_GET_DEVS]) (&be_list, local_only);
-      if (status != SANE_STATUS_GOOD || !be_list)
-	continue;
+  pthread_attr_init (&attr);
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+  for (i = 0; i < probe_threads && i < run->num_jobs; ++i)
+    {
+      ++run->refs;
+      if (pthread_create (&thread, &attr, probe_worker, run) != 0)
+	{
+	  DBG (1, "sane_get_devices: failed to start thread (%s)\n",
+	       strerror (errno));
+	  --run->refs;
+	  break;
+	}
+      ++started;
+    }
+  pthread_attr_destroy (&attr);
+  pthread_mutex_unlock (&probe_lock);
+
+  DBG (3, "sane_get_devices: probing %d backends on %d threads\n",
+       run->num_jobs, started);
+
+  if (started == 0 && run->num_jobs > 0)
+    {
+      /* no threads: do the work here */
+      pthread_mutex_lock (&probe_lock);
+      ++run->refs;
+      pthread_mutex_unlock (&probe_lock);
+      probe_worker (run);
+    }
+
+  for (i = 0; i < num_mine; ++i)
+    {
+      probe_backend (&mine[i], local_only);
+      mine[i].done = 1;
+    }
 
-      /* count the number of devices for this backend: */
-      for (num_devs = 0; be_list[num_devs]; ++num_devs);
+  gettimeofday (&now, NULL);
+  deadline.tv_sec = now.tv_sec + probe_timeout;
+  deadline.tv_nsec = now.tv_usec * 1000;
 
-      ASSERT_SPACE (num_devs);
+  pthread_mutex_lock (&probe_lock);
+  while (run->num_done < run->num_jobs)
+    if (pthread_cond_timedwait (&probe_cond, &probe_lock, &deadline)
+	== ETIMEDOUT)
+      break;
 
-      for (i = 0; i < num_devs; ++i)
+  /* give up on what isn't done yet, keep the results of the rest (the
+     job array is freed by the last worker) */
+  run->abandoned = 1;
+  for (i = run->next; i < run->num_jobs; ++i)
+    {
+      run->job[i].be->busy = 0;
+      --probes_running;
+    }
+  for (i = 0; i < n; ++i)
+    {
+      result[i] = *order[i];
+      if (!result[i].done)
 	{
-	  SANE_Device *dev;
-	  char *mem;
-	  struct alias *alias;
+	  DBG (1, "sane_get_devices: timeout waiting for backend `%s'\n",
+	       result[i].be->name);
+	  devlist_incomplete = 1;
+	  result[i].list = NULL;
+	}
+      else if (result[i].status != SANE_STATUS_GOOD)
+	result[i].list = NULL;
+    }
+  release_probe_run (run);
+  pthread_mutex_unlock (&probe_lock);
 
-	  for (alias = first_alias; alias != NULL; alias = alias->next)
-	    {
-	      len = strlen (be->name);
-	      if (strlen (alias->oldname) <= len)
-		continue;
-	      if (strncmp (alias->oldname, be->name, len) == 0
-		  && alias->oldname[len] == ':'
-		  && strcmp (&alias->oldname[len + 1], be_list[i]->name) == 0)
-		break;
-	    }
+  for (i = 0; i < n && status == SANE_STATUS_GOOD; ++i)
+    if (result[i].list)
+      status = add_devices (result[i].be, result[i].list);
 
-	  if (alias)
-	    {
-	      if (!alias->newname)	/* hidden device */
-		continue;
+  free (result);
+  free (mine);
+  free (order);
+  return status;
+}
+#endif /* DLL_PARALLEL_PROBE */
 
-	      len = strlen (alias->newname);
-	      mem = malloc (sizeof (*dev) + len + 1);
-	      if (!mem)
-		return SANE_STATUS_NO_MEM;
+/* Returns a stamp that changes when USB devices are plugged in or
+   removed: the newest modification time of the usbfs bus directories.
+   Zero where there is no /dev/bus/usb.  */
+static long
+cache_usb_stamp (void)
+{
+  DIR *dir;
+  struct dirent *dirent;
+  struct stat st;
+  char path[PATH_MAX];
+  long stamp = 0;
 
-	      full_name = mem + sizeof (*dev);
-	      strcpy (full_name, alias->newname);
-	    }
-	  else
-	    {
-	      /* create a new device entry with a device name that is the
-	         sum of the backend name a colon and the backend's device
-	         name: */
-	      len = strlen (be->name) + 1 + strlen (be_list[i]->name);
-	      mem = malloc (sizeof (*dev) + len + 1);
-	      if (!mem)
-		return SANE_STATUS_NO_MEM;
-
-	      full_name = mem + sizeof (*dev);
-	      strcpy (full_name, be->name);
-	      strcat (full_name, ":");
-	      strcat (full_name, be_list[i]->name);
-	    }
+  dir = opendir ("/dev/bus/usb");
+  if (!dir)
+    return 0;
+  while ((dirent = readdir (dir)) != NULL)
+    {
+      if (dirent->d_name[0] == '.')
+	continue;
+      snprintf (path, sizeof (path), "/dev/bus/usb/%s", dirent->d_name);
+      if (stat (path, &st) == 0 && (long) st.st_mtime > stamp)
+	stamp = (long) st.st_mtime;
+    }
+  closedir (dir);
+  return stamp;
+}
 
-	  dev = (SANE_Device *) mem;
-	  dev->name = full_name;
-	  dev->vendor = be_list[i]->vendor;
-	  dev->model = be_list[i]->model;
-	  dev->type = be_list[i]->type;
+/* Append a device read from the cache; FIELD holds name, vendor, model
+   and type.  */
+static SANE_Status
+cache_add_device (char **field)
+{
+  SANE_Device *dev;
+  char *mem, *cp;
+  size_t len = 0;
+  int i;
+
+  for (i = 0; i < 4; ++i)
+    len += strlen (field[i]) + 1;
+
+  ASSERT_SPACE (1);
+  mem = malloc (sizeof (*dev) + len);
+  if (!mem)
+    return SANE_STATUS_NO_MEM;
+
+  dev = (SANE_Device *) mem;
+  cp = mem + sizeof (*dev);
+  dev->name = strcpy (cp, field[0]);
+  cp += strlen (cp) + 1;
+  dev->vendor = strcpy (cp, field[1]);
+  cp += strlen (cp) + 1;
+  dev->model = strcpy (cp, field[2]);
+  cp += strlen (cp) + 1;
+  dev->type = strcpy (cp, field[3]);
+
+  devlist[devlist_len++] = dev;
+  return SANE_STATUS_GOOD;
+}
 
-	  devlist[devlist_len++] = dev;
+/* Fill devlist from the cache file.  Fails unless the file is younger
+   than cache_ttl and was written for the same backends (in dll.conf
+   order), the same USB devices and the same LOCAL_ONLY.  */
+static SANE_Status
+cache_load (SANE_Bool local_only)
+{
+  struct backend *be = first_backend;
+  SANE_Status status = SANE_STATUS_GOOD;
+  char line[PATH_MAX];
+  long version = -1, written = -1, usb = -1, local = -1;
+  long now;
+  FILE *fp;
+  int i;
+
+  fp = fopen (cache_path, "r");
+  if (!fp)
+    {
+      DBG (3, "cache_load: can't open `%s' (%s)\n", cache_path,
+	   strerror (errno));
+      return SANE_STATUS_INVAL;
+    }
+
+  while (status == SANE_STATUS_GOOD && fgets (line, sizeof (line), fp))
+    {
+      char *field[5], *cp = line;
+      size_t len = strlen (line);
+      int n;
+
+      if (len == 0 || line[len - 1] != '\n')
+	{
+	  status = SANE_STATUS_INVAL;	/* truncated or overlong */
+	  break;
+	}
+      line[len - 1] = '\0';
+      if (line[0] == '#')
+	continue;
+
+      for (n = 0; n < 5 && cp; ++n)
+	field[n] = strsep (&cp, "\t");
+      if (cp)
+	n = 0;			/* too many fields */
+
+      if (n == 2 && strcmp (field[0], "version") == 0)
+	version = atol (field[1]);
+      else if (n == 2 && strcmp (field[0], "time") == 0)
+	written = atol (field[1]);
+      else if (n == 2 && strcmp (field[0], "usb") == 0)
+	usb = atol (field[1]);
+      else if (n == 2 && strcmp (field[0], "local") == 0)
+	local = atol (field[1]);
+      else if (n == 2 && strcmp (field[0], "backend") == 0)
+	{
+	  if (be && strcmp (be->name, field[1]) == 0)
+	    be = be->next;
+	  else
+	    status = SANE_STATUS_INVAL;
 	}
+      else if (n == 5 && strcmp (field[0], "device") == 0)
+	status = cache_add_device (field + 1);
+      else
+	status = SANE_STATUS_INVAL;
+    }
+  fclose (fp);
+
+  now = (long) time (NULL);
+  if (status == SANE_STATUS_GOOD)
+    {
+      if (version != DLL_CACHE_VERSION || be != NULL)
+	status = SANE_STATUS_INVAL;
+      else if (local != (local_only ? 1 : 0) || usb != cache_usb_stamp ())
+	status = SANE_STATUS_INVAL;
+      else if (written > now || now - written >= cache_ttl)
+	status = SANE_STATUS_INVAL;
+    }
+
+  if (status != SANE_STATUS_GOOD)
+    {
+      DBG (3, "cache_load: `%s' is stale or invalid\n", cache_path);
+      for (i = 0; i < devlist_len; ++i)
+	free ((void *) devlist[i]);
+      devlist_len = 0;
+    }
+  return status;
+}
+
+static int
+cache_field_ok (SANE_String_Const str)
+{
+  return str && !strpbrk (str, "\t\n");
+}
+
+/* Write devlist to the cache file.  The new file is renamed over the
+   old one so that concurrent readers see either list complete.  */
+static void
+cache_save (SANE_Bool local_only)
+{
+  struct backend *be;
+  char *tmp;
+  FILE *fp;
+  int i;
+
+  for (i = 0; i < devlist_len; ++i)
+    if (!cache_field_ok (devlist[i]->name)
+	|| !cache_field_ok (devlist[i]->vendor)
+	|| !cache_field_ok (devlist[i]->model)
+	|| !cache_field_ok (devlist[i]->type))
+      {
+	DBG (2, "cache_save: can't cache device `%s'\n",
+	     devlist[i]->name ? devlist[i]->name : "");
+	return;
+      }
+
+  tmp = malloc (strlen (cache_path) + 32);
+  if (!tmp)
+    return;
+  sprintf (tmp, "%s.%ld", cache_path, (long) getpid ());
+
+  fp = fopen (tmp, "w");
+  if (!fp)
+    {
+      DBG (1, "cache_save: can't create `%s' (%s)\n", tmp, strerror (errno));
+      free (tmp);
+      return;
+    }
+
+  fprintf (fp, "# SANE dll device list cache, see sane-dll(5)\n");
+  fprintf (fp, "version\t%d\n", DLL_CACHE_VERSION);
+  fprintf (fp, "time\t%ld\n", (long) time (NULL));
+  fprintf (fp, "usb\t%ld\n", cache_usb_stamp ());
+  fprintf (fp, "local\t%d\n", local_only ? 1 : 0);
+  for (be = first_backend; be; be = be->next)
+    fprintf (fp, "backend\t%s\n", be->name);
+  for (i = 0; i < devlist_len; ++i)
+    fprintf (fp, "device\t%s\t%s\t%s\t%s\n", devlist[i]->name,
+	     devlist[i]->vendor, devlist[i]->model, devlist[i]->type);
+
+  if (fclose (fp) != 0 || rename (tmp, cache_path) != 0)
+    {
+      DBG (1, "cache_save: can't write `%s' (%s)\n", cache_path,
+	   strerror (errno));
+      remove (tmp);
+    }
+  else
+    DBG (3, "cache_save: saved %d devices\n", devlist_len);
+  free (tmp);
+}
+
+/* Initialize the backends and collect their devices in devlist.  */
+static SANE_Status
+probe_devices (SANE_Bool local_only)
+{
+  const SANE_Device **be_list;
+  struct backend *be;
+  SANE_Status status;
+
+#ifdef DLL_PARALLEL_PROBE
+  if (probe_threads > 0)
+    return get_devices_parallel (local_only);
+#endif /* DLL_PARALLEL_PROBE */
+
+  for (be = first_backend; be; be = be->next)
+    {
+      if (!be->inited)
+	if (init (be) != SANE_STATUS_GOOD)
+	  continue;
+
+      status = (*(op_get_devs_t)be->op[OP_GET_DEVS]) (&be_list, local_only);
+      if (status != SANE_STATUS_GOOD || !be_list)
+	continue;
+
+      status = add_devices (be, be_list);
+      if (status != SANE_STATUS_GOOD)
+	return status;
+    }
+  return SANE_STATUS_GOOD;
+}
+
+/* Note that a call to get_devices() implies that we'll have to load
+   all backends.  To avoid this, you can call sane_open() directly
+   (assuming you know the name of the backend/device).  This is
+   appropriate for the command-line interface of SANE, for example.
+ */
+SANE_Status
+sane_get_devices (const SANE_Device *** device_list, SANE_Bool local_only)
+{
+  SANE_Status status;
+  int i;
+
+  DBG (3, "sane_get_devices\n");
+
+  if (devlist)
+    for (i = 0; i < devlist_len; ++i)
+      free ((void *) devlist[i]);
+  devlist_len = 0;
+
+  devlist_incomplete = 0;
+  if (cache_path && cache_load (local_only) == SANE_STATUS_GOOD)
+    DBG (3, "sane_get_devices: using cached device list\n");
+  else
+    {
+      status = probe_devices (local_only);
+      if (status != SANE_STATUS_GOOD)
+	return status;
+      if (cache_path && !devlist_incomplete)
+	cache_save (local_only);
     }
 
   /* terminate device list with NULL entry: */
@@ -1284,6 +1838,11 @@ sane_open (SANE_String_Const full_name, SANE_Handle * meta_handle)
     }
   free(be_name);
 
+#ifdef DLL_PARALLEL_PROBE
+  if (be->busy)
+    wait_for_probes ();
+#endif /* DLL_PARALLEL_PROBE */
+
   if (!be->inited)
     {
       status = init (be);
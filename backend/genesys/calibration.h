@@ -44,9 +44,13 @@
 #ifndef BACKEND_GENESYS_CALIBRATION_H
 #define BACKEND_GENESYS_CALIBRATION_H
 
+#include "mapped_file.h"
 #include "sensor.h"
 #include "settings.h"
+#include <cstring>
 #include <ctime>
+#include <functional>
+#include <memory>
 
 namespace genesys {
 
@@ -68,6 +72,33 @@ struct Genesys_Calibration_Cache
     std::vector<std::uint16_t> white_average_data;
     std::vector<std::uint16_t> dark_average_data;
 
+    // When the entry has been read from a calibration file, the shading data stays in the file
+    // until load_shading_data() is called
+    std::shared_ptr<const MappedFile> shading_file;
+    std::size_t white_average_offset = 0;
+    std::size_t white_average_count = 0;
+    std::size_t dark_average_offset = 0;
+    std::size_t dark_average_count = 0;
+
+    // Tracks the least recently used entry. Stored in the index of calibration files, see
+    // Genesys_Device::calibration_cache_use_counter
+    std::uint64_t last_use = 0;
+
+    // Copies the shading data from the calibration file, if it has not been loaded yet
+    void load_shading_data()
+    {
+        if (!shading_file) {
+            return;
+        }
+        white_average_data.resize(white_average_count);
+        std::memcpy(white_average_data.data(), shading_file->data() + white_average_offset,
+                    white_average_count * sizeof(std::uint16_t));
+        dark_average_data.resize(dark_average_count);
+        std::memcpy(dark_average_data.data(), shading_file->data() + dark_average_offset,
+                    dark_average_count * sizeof(std::uint16_t));
+        shading_file.reset();
+    }
+
     bool operator==(const Genesys_Calibration_Cache& other) const
     {
         return params == other.params &&
@@ -81,8 +112,54 @@ struct Genesys_Calibration_Cache
     }
 };
 
+// The scan parameters that must match for a calibration cache entry to be usable for a scan.
+// See sanei_genesys_is_compatible_calibration().
+struct CalibrationCacheKey
+{
+    CalibrationCacheKey() = default;
+
+    explicit CalibrationCacheKey(const SetupParams& params) :
+        scan_method{params.scan_method},
+        xres{params.xres},
+        yres{params.yres},
+        channels{params.channels},
+        startx{params.startx},
+        pixels{params.pixels}
+    {}
+
+    ScanMethod scan_method = ScanMethod::FLATBED;
+    unsigned xres = 0;
+    unsigned yres = 0;
+    unsigned channels = 0;
+    unsigned startx = 0;
+    unsigned pixels = 0;
+
+    bool operator==(const CalibrationCacheKey& other) const
+    {
+        return scan_method == other.scan_method &&
+            xres == other.xres &&
+            yres == other.yres &&
+            channels == other.channels &&
+            startx == other.startx &&
+            pixels == other.pixels;
+    }
+};
+
+struct CalibrationCacheKeyHash
+{
+    std::size_t operator()(const CalibrationCacheKey& key) const
+    {
+        std::size_t hash = static_cast<std::size_t>(key.scan_method);
+        for (unsigned value : { key.xres, key.yres, key.channels, key.startx, key.pixels }) {
+            hash = hash * 31 + std::hash<unsigned>()(value);
+        }
+        return hash;
+    }
+};
+
+// Serializes everything except the shading data
 template<class Stream>
-void serialize(Stream& str, Genesys_Calibration_Cache& x)
+void serialize_metadata(Stream& str, Genesys_Calibration_Cache& x)
 {
     serialize(str, x.params);
     serialize_newline(str);
@@ -95,6 +172,12 @@ void serialize(Stream& str, Genesys_Calibration_Cache& x)
     serialize(str, x.session);
     serialize(str, x.average_size);
     serialize_newline(str);
+}
+
+template<class Stream>
+void serialize(Stream& str, Genesys_Calibration_Cache& x)
+{
+    serialize_metadata(str, x);
     serialize(str, x.white_average_data);
     serialize_newline(str);
     serialize(str, x.dark_average_data);
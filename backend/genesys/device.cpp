@@ -105,6 +105,8 @@ void Genesys_Device::clear()
     calib_file.clear();
 
     calibration_cache.clear();
+    invalidate_calibration_cache_index();
+    calibration_cache_session_valid = false;
 
     white_average_data.clear();
     dark_average_data.clear();
@@ -115,6 +117,57 @@ ImagePipelineNodeBufferedCallableSource& Genesys_Device::get_pipeline_source()
     return static_cast<ImagePipelineNodeBufferedCallableSource&>(pipeline.front());
 }
 
+void Genesys_Device::stop_pipeline_read_ahead()
+{
+    // pipeline_buffer reads from the pipeline source, thus it must be stopped first
+    pipeline_buffer.stop_read_ahead();
+    if (!pipeline.empty()) {
+        get_pipeline_source().stop_read_ahead();
+    }
+}
+
+void Genesys_Device::start_async_pipeline()
+{
+    // limit the memory used by the data that has been processed, but not yet read
+    const std::size_t MAX_PROCESSED_BYTES = 8 * 1024 * 1024;
+    const std::size_t MIN_PROCESSED_CHUNKS = 2;
+    const std::size_t MAX_PROCESSED_CHUNKS = 1024;
+
+    if (pipeline_buffer.is_read_ahead_enabled()) {
+        return;
+    }
+
+    // the scanner must not be accessed from the thread that calls sane_read() while the pipeline
+    // is being processed. This is guaranteed only if the scan data is read ahead.
+    if (pipeline.empty() || !get_pipeline_source().is_read_ahead_enabled()) {
+        throw SaneException(SANE_STATUS_UNSUPPORTED,
+                            "asynchronous processing is not supported for the current scan");
+    }
+
+    read_notifier.open();
+    read_notifier.reset();
+
+    auto chunk_size = std::max<std::size_t>(pipeline_buffer.read_size(), 1);
+    pipeline_buffer.enable_read_ahead(clamp(MAX_PROCESSED_BYTES / chunk_size,
+                                            MIN_PROCESSED_CHUNKS, MAX_PROCESSED_CHUNKS));
+    pipeline_buffer.set_read_ahead_callback([this]() { read_notifier.signal(); });
+    pipeline_buffer.start_read_ahead();
+}
+
+void Genesys_Device::update_read_notifier()
+{
+    if (!read_notifier.is_open()) {
+        return;
+    }
+
+    read_notifier.reset();
+    if (!pipeline_buffer.is_read_ahead_enabled() || pipeline_buffer.ready_size() > 0 ||
+        total_bytes_read >= total_bytes_to_read)
+    {
+        read_notifier.signal();
+    }
+}
+
 bool Genesys_Device::is_head_pos_known(ScanHeadId scan_head) const
 {
     switch (scan_head) {
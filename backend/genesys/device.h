@@ -54,7 +54,9 @@
 #include "register.h"
 #include "usb_device.h"
 #include "scanner_interface.h"
+#include "select_notifier.h"
 #include "utilities.h"
+#include <unordered_map>
 #include <vector>
 
 namespace genesys {
@@ -327,6 +329,25 @@ struct Genesys_Device
 
     Calibration calibration_cache;
 
+    // Maps the keys of the entries in calibration_cache to the indices of all entries with that
+    // key. The index must be invalidated whenever entries are added to or removed from
+    // calibration_cache.
+    std::unordered_map<CalibrationCacheKey, std::vector<std::size_t>, CalibrationCacheKeyHash>
+        calibration_cache_index;
+    bool calibration_cache_index_valid = false;
+
+    // Incremented whenever a calibration cache entry is used, see Genesys_Calibration_Cache::last_use
+    std::uint64_t calibration_cache_use_counter = 0;
+
+    // The scan session used for calibration cache lookups is recomputed only when its inputs change
+    bool calibration_cache_session_valid = false;
+    Genesys_Settings calibration_cache_session_settings;
+    Genesys_Sensor calibration_cache_session_sensor;
+    bool calibration_cache_session_ignore_offsets = false;
+    ScanSession calibration_cache_session;
+
+    void invalidate_calibration_cache_index() { calibration_cache_index_valid = false; }
+
     // number of scan lines used during scan
     int line_count = 0;
 
@@ -339,8 +360,27 @@ struct Genesys_Device
     // an buffer that allows reading from `pipeline` in chunks of any size
     ImageBuffer pipeline_buffer;
 
+    // whether sane_read() must return immediately if no data is available
+    bool read_nonblocking = false;
+
+    // readable whenever data can be read from `pipeline_buffer` without waiting. Only used when
+    // the pipeline is processed asynchronously.
+    SelectNotifier read_notifier;
+
     ImagePipelineNodeBufferedCallableSource& get_pipeline_source();
 
+    // stops reading scan data in the background. Must be called before communicating with the
+    // scanner in any other way once the scan data is no longer needed.
+    void stop_pipeline_read_ahead();
+
+    // Processes `pipeline` on a separate thread so that the processed data can be read without
+    // waiting for the scanner. Throws SANE_STATUS_UNSUPPORTED if this is not possible for the
+    // current scan.
+    void start_async_pipeline();
+
+    // makes `read_notifier` readable if data can be read without waiting, or not readable otherwise
+    void update_read_notifier();
+
     std::unique_ptr<ScannerInterface> interface;
 
     bool is_head_pos_known(ScanHeadId scan_head) const;
@@ -74,8 +74,11 @@
 #include "test_settings.h"
 #include "../include/sane/sanei_config.h"
 
+#include <algorithm>
 #include <array>
+#include <cerrno>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iterator>
@@ -105,6 +108,10 @@ namespace {
 
     // Maximum time for lamp warm-up
     constexpr unsigned WARMUP_TIME = 65;
+
+    // Maximum number of entries in the calibration cache of each device, 0 means no limit.
+    // Can be changed via the calibration-cache-size option in the configuration file
+    SANE_Word s_calibration_cache_max_entries = 64;
 } // namespace
 
 static SANE_String_Const mode_list[] = {
@@ -3598,6 +3605,109 @@ static void genesys_send_shading_coefficient(Genesys_Device* dev, const Genesys_
 }
 
 
+// Returns the scan session that is used to find calibration cache entries for the current
+// settings. The session is recomputed only when the settings or the sensor change.
+static const ScanSession& get_calibration_cache_session(Genesys_Device* dev,
+                                                        const Genesys_Sensor& sensor)
+{
+    if (!dev->calibration_cache_session_valid ||
+        !(dev->calibration_cache_session_settings == dev->settings) ||
+        !(dev->calibration_cache_session_sensor == sensor) ||
+        dev->calibration_cache_session_ignore_offsets != dev->ignore_offsets)
+    {
+        dev->calibration_cache_session = dev->cmd_set->calculate_scan_session(dev, sensor,
+                                                                              dev->settings);
+        dev->calibration_cache_session_settings = dev->settings;
+        dev->calibration_cache_session_sensor = sensor;
+        dev->calibration_cache_session_ignore_offsets = dev->ignore_offsets;
+        dev->calibration_cache_session_valid = true;
+    }
+    return dev->calibration_cache_session;
+}
+
+static void build_calibration_cache_index(Genesys_Device* dev)
+{
+    auto& cache = dev->calibration_cache;
+    auto& index = dev->calibration_cache_index;
+
+    index.clear();
+    for (std::size_t i = 0; i < cache.size(); ++i) {
+        index[CalibrationCacheKey{cache[i].params}].push_back(i);
+    }
+    dev->calibration_cache_index_valid = true;
+}
+
+// Returns the calibration cache entry that can be used for the given session, or nullptr
+static Genesys_Calibration_Cache* find_calibration_cache_entry(Genesys_Device* dev,
+                                                               const ScanSession& session,
+                                                               bool for_overwrite)
+{
+    if (!dev->calibration_cache_index_valid) {
+        build_calibration_cache_index(dev);
+    }
+
+    auto it = dev->calibration_cache_index.find(CalibrationCacheKey{session.params});
+    if (it == dev->calibration_cache_index.end()) {
+        return nullptr;
+    }
+
+    // the cache may contain several entries with the same key, e.g. when they were read from a
+    // file. Prefer the most recent compatible calibration.
+    Genesys_Calibration_Cache* found = nullptr;
+    for (auto index : it->second) {
+        auto& cache = dev->calibration_cache[index];
+        if (found && cache.last_calibration <= found->last_calibration) {
+            continue;
+        }
+        if (sanei_genesys_is_compatible_calibration(dev, session, &cache, for_overwrite)) {
+            found = &cache;
+        }
+    }
+    return found;
+}
+
+// Continues counting the uses of calibration cache entries after the last use stored in the
+// entries that have been read from the calibration file
+static void restore_calibration_cache_use_counter(Genesys_Device* dev)
+{
+    dev->calibration_cache_use_counter = 0;
+    for (const auto& entry : dev->calibration_cache) {
+        dev->calibration_cache_use_counter = std::max(dev->calibration_cache_use_counter,
+                                                      entry.last_use);
+    }
+}
+
+// Removes expired calibration cache entries and the least recently used ones so that a new
+// entry can be added without exceeding the configured cache size
+static void evict_calibration_cache_entries(Genesys_Device* dev)
+{
+    auto& cache = dev->calibration_cache;
+
+    cache.erase(std::remove_if(cache.begin(), cache.end(),
+                               [&](const Genesys_Calibration_Cache& entry)
+    {
+        return is_calibration_cache_entry_expired(*dev, entry);
+    }), cache.end());
+
+    if (s_calibration_cache_max_entries > 0) {
+        auto max_entries = static_cast<std::size_t>(s_calibration_cache_max_entries);
+        while (cache.size() >= max_entries) {
+            auto lru_it = std::min_element(cache.begin(), cache.end(),
+                                           [](const Genesys_Calibration_Cache& a,
+                                              const Genesys_Calibration_Cache& b)
+            {
+                if (a.last_use != b.last_use) {
+                    return a.last_use < b.last_use;
+                }
+                return a.last_calibration < b.last_calibration;
+            });
+            cache.erase(lru_it);
+        }
+    }
+
+    dev->invalidate_calibration_cache_index();
+}
+
 /**
  * search calibration cache list for an entry matching required scan.
  * If one is found, set device calibration with it
@@ -3615,33 +3725,33 @@ genesys_restore_calibration(Genesys_Device * dev, Genesys_Sensor& sensor)
         return false;
     }
 
-    auto session = dev->cmd_set->calculate_scan_session(dev, sensor, dev->settings);
+    const auto& session = get_calibration_cache_session(dev, sensor);
 
-  /* we walk the link list of calibration cache in search for a
-   * matching one */
-  for (auto& cache : dev->calibration_cache)
-    {
-        if (sanei_genesys_is_compatible_calibration(dev, session, &cache, false)) {
-            dev->frontend = cache.frontend;
-          /* we don't restore the gamma fields */
-          sensor.exposure = cache.sensor.exposure;
+    auto* cache = find_calibration_cache_entry(dev, session, false);
+    if (!cache) {
+        DBG(DBG_proc, "%s: completed(nothing found)\n", __func__);
+        return false;
+    }
 
-            dev->calib_session = cache.session;
-          dev->average_size = cache.average_size;
+    cache->last_use = ++dev->calibration_cache_use_counter;
 
-          dev->dark_average_data = cache.dark_average_data;
-          dev->white_average_data = cache.white_average_data;
+    dev->frontend = cache->frontend;
+    // we don't restore the gamma fields
+    sensor.exposure = cache->sensor.exposure;
 
-            if (!dev->cmd_set->has_send_shading_data()) {
-            genesys_send_shading_coefficient(dev, sensor);
-          }
+    dev->calib_session = cache->session;
+    dev->average_size = cache->average_size;
 
-          DBG(DBG_proc, "%s: restored\n", __func__);
-          return true;
-	}
+    cache->load_shading_data();
+    dev->dark_average_data = cache->dark_average_data;
+    dev->white_average_data = cache->white_average_data;
+
+    if (!dev->cmd_set->has_send_shading_data()) {
+        genesys_send_shading_coefficient(dev, sensor);
     }
-  DBG(DBG_proc, "%s: completed(nothing found)\n", __func__);
-  return false;
+
+    DBG(DBG_proc, "%s: restored\n", __func__);
+    return true;
 }
 
 
@@ -3652,40 +3762,34 @@ static void genesys_save_calibration(Genesys_Device* dev, const Genesys_Sensor&
   struct timeval time;
 #endif
 
-    auto session = dev->cmd_set->calculate_scan_session(dev, sensor, dev->settings);
+    auto session = get_calibration_cache_session(dev, sensor);
 
-  auto found_cache_it = dev->calibration_cache.end();
-  for (auto cache_it = dev->calibration_cache.begin(); cache_it != dev->calibration_cache.end();
-       cache_it++)
-    {
-        if (sanei_genesys_is_compatible_calibration(dev, session, &*cache_it, true)) {
-            found_cache_it = cache_it;
-            break;
-        }
+    // if we found on overridable cache, we reuse it
+    auto* found_cache = find_calibration_cache_entry(dev, session, true);
+    if (!found_cache) {
+        evict_calibration_cache_entries(dev);
+        dev->calibration_cache.push_back(Genesys_Calibration_Cache());
+        found_cache = &dev->calibration_cache.back();
     }
 
-  /* if we found on overridable cache, we reuse it */
-  if (found_cache_it == dev->calibration_cache.end())
-    {
-      /* create a new cache entry and insert it in the linked list */
-      dev->calibration_cache.push_back(Genesys_Calibration_Cache());
-      found_cache_it = std::prev(dev->calibration_cache.end());
-    }
+    found_cache->last_use = ++dev->calibration_cache_use_counter;
+    found_cache->average_size = dev->average_size;
 
-  found_cache_it->average_size = dev->average_size;
+    // the shading data from the calibration file is no longer needed
+    found_cache->shading_file.reset();
 
-  found_cache_it->dark_average_data = dev->dark_average_data;
-  found_cache_it->white_average_data = dev->white_average_data;
+    found_cache->dark_average_data = dev->dark_average_data;
+    found_cache->white_average_data = dev->white_average_data;
 
-    found_cache_it->params = session.params;
-  found_cache_it->frontend = dev->frontend;
-  found_cache_it->sensor = sensor;
+    found_cache->params = session.params;
+    found_cache->frontend = dev->frontend;
+    found_cache->sensor = sensor;
 
-    found_cache_it->session = dev->calib_session;
+    found_cache->session = dev->calib_session;
 
 #ifdef HAVE_SYS_TIME_H
     gettimeofday(&time, nullptr);
-  found_cache_it->last_calibration = time.tv_sec;
+    found_cache->last_calibration = time.tv_sec;
 #endif
 }
 
@@ -4241,7 +4345,8 @@ static void genesys_read_ordered_data(Genesys_Device* dev, SANE_Byte* destinatio
         throw SaneException(SANE_STATUS_EOF, "nothing more to scan: EOF");
     }
 
-    if (is_testing_mode()) {
+    // the image pipeline is skipped during testing unless the test supplies sensor data
+    if (is_testing_mode() && !get_testing_bulk_read_callback()) {
         if (dev->total_bytes_read + *len > dev->total_bytes_to_read) {
             *len = dev->total_bytes_to_read - dev->total_bytes_read;
         }
@@ -4255,6 +4360,18 @@ static void genesys_read_ordered_data(Genesys_Device* dev, SANE_Byte* destinatio
             *len = dev->total_bytes_to_read - dev->total_bytes_read;
         }
 
+        if (dev->read_nonblocking) {
+            auto ready_size = dev->pipeline_buffer.ready_size();
+            if (ready_size < *len) {
+                *len = ready_size;
+            }
+            if (*len == 0) {
+                DBG(DBG_io2, "%s: no data is available yet\n", __func__);
+                dev->update_read_notifier();
+                return;
+            }
+        }
+
         dev->pipeline_buffer.get_data(*len, destination);
         dev->total_bytes_read += *len;
     }
@@ -4262,12 +4379,15 @@ static void genesys_read_ordered_data(Genesys_Device* dev, SANE_Byte* destinatio
   /* end scan if all needed data have been read */
    if(dev->total_bytes_read >= dev->total_bytes_to_read)
     {
+        dev->stop_pipeline_read_ahead();
         dev->cmd_set->end_scan(dev, &dev->reg, true);
         if (dev->model->is_sheetfed) {
             dev->cmd_set->eject_document (dev);
         }
     }
 
+    dev->update_read_notifier();
+
     DBG(DBG_proc, "%s: completed, %zu bytes read\n", __func__, bytes);
 }
 
@@ -5223,12 +5343,30 @@ static void probe_genesys_devices()
         return;
     }
 
+    SANE_Range cache_size_range;
+    cache_size_range.min = 0;
+    cache_size_range.max = 65536;
+    cache_size_range.quant = 0;
+
+    SANE_Option_Descriptor cache_size_option;
+    std::memset(&cache_size_option, 0, sizeof(cache_size_option));
+    cache_size_option.name = "calibration-cache-size";
+    cache_size_option.type = SANE_TYPE_INT;
+    cache_size_option.unit = SANE_UNIT_NONE;
+    cache_size_option.size = sizeof(SANE_Word);
+    cache_size_option.cap = SANE_CAP_SOFT_SELECT;
+    cache_size_option.constraint_type = SANE_CONSTRAINT_RANGE;
+    cache_size_option.constraint.range = &cache_size_range;
+
+    SANE_Option_Descriptor* options[] = { &cache_size_option };
+    void* values[] = { &s_calibration_cache_max_entries };
+
   SANEI_Config config;
 
-    // set configuration options structure : no option for this backend
-    config.descriptors = nullptr;
-    config.values = nullptr;
-  config.count = 0;
+    // set configuration options structure
+    config.descriptors = options;
+    config.values = values;
+    config.count = 1;
 
     auto status = sanei_configure_attach(GENESYS_CONFIG_FILE, &config, config_attach_genesys);
     if (status == SANE_STATUS_ACCESS_DENIED) {
@@ -5246,74 +5384,232 @@ static void probe_genesys_devices()
    changes that don't change size -- at least for now, as we store most
    of Genesys_Calibration_Cache as is.
 */
-static const char* CALIBRATION_IDENT = "sane_genesys";
-static const int CALIBRATION_VERSION = 31;
+static const char CALIBRATION_IDENT[] = "sane_genesys_cal";
+static const std::uint32_t CALIBRATION_VERSION = 33;
 
-bool read_calibration(std::istream& str, Genesys_Device::Calibration& calibration,
-                      const std::string& path)
+/*  Calibration files consist of a header, an index with one record per calibration entry and the
+    data of the entries. The values are stored in the native representation of the host, so that
+    the shading data can be copied directly from the file once it has been mapped into memory.
+    Only the shading data of the entries that are actually used is loaded.
+*/
+struct CalibrationFileHeader
+{
+    char ident[16];
+    std::uint32_t version;
+    // identifies the representation of the values, see get_calibration_type_sizes()
+    std::uint32_t type_sizes;
+    std::uint64_t entry_count;
+};
+
+struct CalibrationFileIndexEntry
+{
+    std::uint64_t metadata_offset;
+    std::uint64_t metadata_size;
+    std::uint64_t white_average_offset;
+    std::uint64_t white_average_count;
+    std::uint64_t dark_average_offset;
+    std::uint64_t dark_average_count;
+    std::uint64_t last_use;
+};
+
+static std::uint32_t get_calibration_type_sizes()
+{
+    const std::uint16_t byte_order_probe = 1;
+    std::uint8_t is_little_endian = 0;
+    std::memcpy(&is_little_endian, &byte_order_probe, 1);
+
+    return sizeof(std::size_t) | (sizeof(long) << 4) | (sizeof(std::time_t) << 8) |
+            (sizeof(unsigned) << 12) | (sizeof(float) << 16) | (is_little_endian << 20);
+}
+
+static bool is_calibration_file_range_valid(std::uint64_t offset, std::uint64_t count,
+                                            std::size_t item_size, std::size_t file_size)
+{
+    return offset <= file_size && count <= (file_size - offset) / item_size;
+}
+
+static bool read_calibration(const std::shared_ptr<MappedFile>& file,
+                             Genesys_Device::Calibration& calibration, const std::string& path)
 {
     DBG_HELPER(dbg);
 
-    std::string ident;
-    serialize(str, ident);
+    const auto* data = file->data();
+    auto size = file->size();
 
-    if (ident != CALIBRATION_IDENT) {
+    CalibrationFileHeader header;
+    if (size < sizeof(header)) {
         DBG(DBG_info, "%s: Incorrect calibration file '%s' header\n", __func__, path.c_str());
         return false;
     }
+    std::memcpy(&header, data, sizeof(header));
 
-    size_t version;
-    serialize(str, version);
+    if (std::memcmp(header.ident, CALIBRATION_IDENT, sizeof(header.ident)) != 0) {
+        DBG(DBG_info, "%s: Incorrect calibration file '%s' header\n", __func__, path.c_str());
+        return false;
+    }
 
-    if (version != CALIBRATION_VERSION) {
+    if (header.version != CALIBRATION_VERSION ||
+        header.type_sizes != get_calibration_type_sizes())
+    {
         DBG(DBG_info, "%s: Incorrect calibration file '%s' version\n", __func__, path.c_str());
         return false;
     }
 
-    calibration.clear();
-    serialize(str, calibration);
+    if (!is_calibration_file_range_valid(sizeof(header), header.entry_count,
+                                         sizeof(CalibrationFileIndexEntry), size))
+    {
+        throw SaneException("Corrupted calibration file index");
+    }
+
+    Genesys_Device::Calibration new_calibration;
+    new_calibration.reserve(header.entry_count);
+
+    for (std::size_t i = 0; i < header.entry_count; ++i) {
+        CalibrationFileIndexEntry index_entry;
+        std::memcpy(&index_entry, data + sizeof(header) + i * sizeof(index_entry),
+                    sizeof(index_entry));
+
+        if (!is_calibration_file_range_valid(index_entry.metadata_offset,
+                                             index_entry.metadata_size, 1, size) ||
+            !is_calibration_file_range_valid(index_entry.white_average_offset,
+                                             index_entry.white_average_count,
+                                             sizeof(std::uint16_t), size) ||
+            !is_calibration_file_range_valid(index_entry.dark_average_offset,
+                                             index_entry.dark_average_count,
+                                             sizeof(std::uint16_t), size))
+        {
+            throw SaneException("Corrupted calibration file entry %zu", i);
+        }
+
+        Genesys_Calibration_Cache entry;
+        BinaryInputStream str{data + index_entry.metadata_offset, index_entry.metadata_size};
+        serialize_metadata(str, entry);
+
+        entry.shading_file = file;
+        entry.white_average_offset = index_entry.white_average_offset;
+        entry.white_average_count = index_entry.white_average_count;
+        entry.dark_average_offset = index_entry.dark_average_offset;
+        entry.dark_average_count = index_entry.dark_average_count;
+        entry.last_use = index_entry.last_use;
+        new_calibration.push_back(std::move(entry));
+    }
+
+    calibration = std::move(new_calibration);
     return true;
 }
 
+bool read_calibration(std::istream& str, Genesys_Device::Calibration& calibration,
+                      const std::string& path)
+{
+    DBG_HELPER(dbg);
+
+    std::vector<std::uint8_t> data{std::istreambuf_iterator<char>(str),
+                                   std::istreambuf_iterator<char>()};
+    auto file = std::make_shared<MappedFile>();
+    file->assign(std::move(data));
+    return read_calibration(file, calibration, path);
+}
+
 /**
  * reads previously cached calibration data
  * from file defined in dev->calib_file
  */
-static bool sanei_genesys_read_calibration(Genesys_Device::Calibration& calibration,
-                                           const std::string& path)
+bool sanei_genesys_read_calibration(Genesys_Device::Calibration& calibration,
+                                    const std::string& path)
 {
     DBG_HELPER(dbg);
 
-    std::ifstream str;
-    str.open(path);
-    if (!str.is_open()) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path)) {
         DBG(DBG_info, "%s: Cannot open %s\n", __func__, path.c_str());
         return false;
     }
 
-    return read_calibration(str, calibration, path);
+    return read_calibration(file, calibration, path);
 }
 
 void write_calibration(std::ostream& str, Genesys_Device::Calibration& calibration)
 {
-    std::string ident = CALIBRATION_IDENT;
-    serialize(str, ident);
-    size_t version = CALIBRATION_VERSION;
-    serialize(str, version);
-    serialize_newline(str);
-    serialize(str, calibration);
+    std::vector<std::uint8_t> data;
+    BinaryOutputStream out{data};
+
+    CalibrationFileHeader header;
+    std::memcpy(header.ident, CALIBRATION_IDENT, sizeof(header.ident));
+    header.version = CALIBRATION_VERSION;
+    header.type_sizes = get_calibration_type_sizes();
+    header.entry_count = calibration.size();
+    out.write(&header, sizeof(header));
+
+    // the index is written once the offsets of the entries are known
+    std::vector<CalibrationFileIndexEntry> index;
+    index.resize(calibration.size());
+    auto index_offset = out.offset();
+    out.write(index.data(), index.size() * sizeof(CalibrationFileIndexEntry));
+
+    for (std::size_t i = 0; i < calibration.size(); ++i) {
+        auto& entry = calibration[i];
+        auto& index_entry = index[i];
+
+        // the shading data may still be in the file that we're about to overwrite
+        entry.load_shading_data();
+
+        index_entry.last_use = entry.last_use;
+        index_entry.metadata_offset = out.offset();
+        serialize_metadata(out, entry);
+        index_entry.metadata_size = out.offset() - index_entry.metadata_offset;
+
+        out.align(sizeof(std::uint64_t));
+        index_entry.white_average_offset = out.offset();
+        index_entry.white_average_count = entry.white_average_data.size();
+        out.write(entry.white_average_data.data(),
+                  entry.white_average_data.size() * sizeof(std::uint16_t));
+
+        out.align(sizeof(std::uint64_t));
+        index_entry.dark_average_offset = out.offset();
+        index_entry.dark_average_count = entry.dark_average_data.size();
+        out.write(entry.dark_average_data.data(),
+                  entry.dark_average_data.size() * sizeof(std::uint16_t));
+    }
+
+    if (!index.empty()) {
+        std::memcpy(data.data() + index_offset, index.data(),
+                    index.size() * sizeof(CalibrationFileIndexEntry));
+    }
+
+    str.write(reinterpret_cast<const char*>(data.data()), data.size());
 }
 
 static void write_calibration(Genesys_Device::Calibration& calibration, const std::string& path)
 {
     DBG_HELPER(dbg);
 
+    // load the shading data before the file is replaced
+    for (auto& entry : calibration) {
+        entry.load_shading_data();
+    }
+
+    // the file may be mapped by other processes, so it is never modified in place. The new
+    // contents are written to a temporary file that is then renamed over the old one.
+    std::string tmp_path = path + ".tmp";
+
     std::ofstream str;
-    str.open(path);
+    str.open(tmp_path, std::ios::binary);
     if (!str.is_open()) {
         throw SaneException("Cannot open calibration for writing");
     }
     write_calibration(str, calibration);
+    str.close();
+
+    if (!str) {
+        std::remove(tmp_path.c_str());
+        throw SaneException("Cannot write calibration to %s", tmp_path.c_str());
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        auto error = errno;
+        std::remove(tmp_path.c_str());
+        throw SaneException("Cannot rename calibration to %s: %s", path.c_str(),
+                            std::strerror(error));
+    }
 }
 
 /* -------------------------- SANE API functions ------------------------- */
@@ -5504,6 +5800,7 @@ static void sane_open_impl(SANE_String_Const devicename, SANE_Handle * handle)
         auto interface = std::unique_ptr<TestScannerInterface>{
                 new TestScannerInterface{dev, vendor_id, product_id, bcd_device}};
         interface->set_checkpoint_callback(get_testing_checkpoint_callback());
+        interface->set_bulk_read_callback(get_testing_bulk_read_callback());
         dev->interface = std::move(interface);
 
         dev->interface->get_usb_device().open(dev->file_name.c_str());
@@ -5591,6 +5888,8 @@ sane_close_impl(SANE_Handle handle)
 
     auto* dev = it->dev;
 
+    dev->stop_pipeline_read_ahead();
+
     // eject document for sheetfed scanners
     if (dev->model->is_sheetfed) {
         catch_all_exceptions(__func__, [&](){ dev->cmd_set->eject_document(dev); });
@@ -5849,15 +6148,9 @@ static void get_option_value(Genesys_Scanner* s, int option, void* val)
             // scanner needs calibration for current mode unless a matching calibration cache is
             // found
 
-            bool result = true;
-
-            auto session = dev->cmd_set->calculate_scan_session(dev, *sensor, dev->settings);
+            const auto& session = get_calibration_cache_session(dev, *sensor);
+            bool result = find_calibration_cache_entry(dev, session, false) == nullptr;
 
-            for (auto& cache : dev->calibration_cache) {
-                if (sanei_genesys_is_compatible_calibration(dev, session, &cache, false)) {
-                    *reinterpret_cast<SANE_Bool*>(val) = SANE_FALSE;
-                }
-            }
             *reinterpret_cast<SANE_Bool*>(val) = result;
             break;
         }
@@ -5889,6 +6182,8 @@ static void set_calibration_value(Genesys_Scanner* s, const char* val)
     }
 
     dev->calibration_cache = std::move(new_calibration);
+    dev->invalidate_calibration_cache_index();
+    restore_calibration_cache_use_counter(dev);
     dev->calib_file = new_calib_path;
     s->calibration_file = new_calib_path;
     DBG(DBG_info, "%s: Calibration filename set to '%s':\n", __func__, new_calib_path.c_str());
@@ -6132,6 +6427,7 @@ static void set_option_value(Genesys_Scanner* s, int option, void *val, SANE_Int
         }
         case OPT_CLEAR_CALIBRATION: {
             dev->calibration_cache.clear();
+            dev->invalidate_calibration_cache_index();
 
             // remove file
             unlink(dev->calib_file.c_str());
@@ -6142,6 +6438,7 @@ static void set_option_value(Genesys_Scanner* s, int option, void *val, SANE_Int
         case OPT_FORCE_CALIBRATION: {
             dev->force_calibration = 1;
             dev->calibration_cache.clear();
+            dev->invalidate_calibration_cache_index();
             dev->calib_file.clear();
 
             // signals that sensors will have to be read again
@@ -6290,12 +6587,19 @@ void sane_start_impl(SANE_Handle handle)
         {
             sanei_genesys_read_calibration(dev->calibration_cache, dev->calib_file);
         });
+        dev->invalidate_calibration_cache_index();
+        restore_calibration_cache_use_counter(dev);
     }
 
     // First make sure we have a current parameter set.  Some of the
     // parameters will be overwritten below, but that's OK.
 
     calc_parameters(s);
+
+    // each scan starts in blocking mode, sane_set_io_mode() may be used to change it
+    dev->read_nonblocking = false;
+    dev->read_notifier.reset();
+
     genesys_start_scan(dev, s->lamp_off);
 
     s->scanning = true;
@@ -6390,6 +6694,8 @@ void sane_cancel_impl(SANE_Handle handle)
     s->scanning = false;
     dev->read_active = false;
 
+    dev->stop_pipeline_read_ahead();
+
     // no need to end scan if we are parking the head
     if (!dev->parking) {
         dev->cmd_set->end_scan(dev, &dev->reg, true);
@@ -6428,8 +6734,9 @@ void sane_set_io_mode_impl(SANE_Handle handle, SANE_Bool non_blocking)
         throw SaneException("not scanning");
     }
     if (non_blocking) {
-        throw SaneException(SANE_STATUS_UNSUPPORTED);
+        s->dev->start_async_pipeline();
     }
+    s->dev->read_nonblocking = non_blocking;
 }
 
 SANE_GENESYS_API_LINKAGE
@@ -6449,7 +6756,9 @@ void sane_get_select_fd_impl(SANE_Handle handle, SANE_Int* fd)
     if (!s->scanning) {
         throw SaneException("not scanning");
     }
-    throw SaneException(SANE_STATUS_UNSUPPORTED);
+    s->dev->start_async_pipeline();
+    s->dev->update_read_notifier();
+    *fd = s->dev->read_notifier.get_fd();
 }
 
 SANE_GENESYS_API_LINKAGE
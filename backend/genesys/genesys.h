@@ -234,6 +234,8 @@ struct Genesys_Scanner
 void write_calibration(std::ostream& str, Genesys_Device::Calibration& cache);
 bool read_calibration(std::istream& str, Genesys_Device::Calibration& cache,
                       const std::string& path);
+bool sanei_genesys_read_calibration(Genesys_Device::Calibration& calibration,
+                                    const std::string& path);
 
 } // namespace genesys
 
@@ -44,6 +44,7 @@
 #define DEBUG_DECLARE_ONLY
 
 #include "image.h"
+#include "image_simd.h"
 
 #if defined(HAVE_TIFFIO_H)
 #include <tiffio.h>
@@ -167,6 +168,19 @@ void convert_pixel_row_format(const std::uint8_t* in_data, PixelFormat in_format
         return;
     }
 
+    if ((in_format == PixelFormat::RGB888 && out_format == PixelFormat::BGR888) ||
+        (in_format == PixelFormat::BGR888 && out_format == PixelFormat::RGB888))
+    {
+        get_pixel_kernels().swap_rgb_8(in_data, out_data, count);
+        return;
+    }
+    if ((in_format == PixelFormat::RGB161616 && out_format == PixelFormat::BGR161616) ||
+        (in_format == PixelFormat::BGR161616 && out_format == PixelFormat::RGB161616))
+    {
+        get_pixel_kernels().swap_rgb_16(in_data, out_data, count);
+        return;
+    }
+
     switch (in_format) {
         case PixelFormat::I1: {
             convert_pixel_row_impl<PixelFormat::I1>(in_data, out_data, out_format, count);
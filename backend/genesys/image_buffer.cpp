@@ -56,6 +56,252 @@ ImageBuffer::ImageBuffer(std::size_t size, ProducerCallback producer) :
     buffer_.resize(size_);
 }
 
+ImageBuffer::ImageBuffer(ImageBuffer&& other)
+{
+    *this = std::move(other);
+}
+
+ImageBuffer& ImageBuffer::operator=(ImageBuffer&& other)
+{
+    // the read-ahead thread refers to the object it was started for
+    stop_read_ahead();
+    other.stop_read_ahead();
+
+    producer_ = std::move(other.producer_);
+    size_ = other.size_;
+    curr_size_ = other.curr_size_;
+    remaining_size_ = other.remaining_size_;
+    last_read_multiple_ = other.last_read_multiple_;
+    buffer_offset_ = other.buffer_offset_;
+    buffer_ = std::move(other.buffer_);
+    read_ahead_ = std::move(other.read_ahead_);
+    return *this;
+}
+
+ImageBuffer::~ImageBuffer()
+{
+    stop_read_ahead();
+}
+
+std::uint64_t ImageBuffer::remaining_size() const
+{
+    if (read_ahead_) {
+        std::lock_guard<std::mutex> lock{read_ahead_->mutex};
+        return remaining_size_;
+    }
+    return remaining_size_;
+}
+
+void ImageBuffer::set_remaining_size(std::uint64_t bytes)
+{
+    if (is_reading_ahead()) {
+        // data that has already been requested can't be returned to the producer, so the
+        // remaining size is only meaningful for synchronous reads
+        DBG(DBG_warn, "%s: stopping read-ahead to adjust remaining size\n", __func__);
+        stop_read_ahead();
+    }
+    remaining_size_ = bytes;
+}
+
+void ImageBuffer::enable_read_ahead(std::size_t max_chunks)
+{
+    if (read_ahead_) {
+        throw SaneException("Read-ahead has already been enabled");
+    }
+    if (remaining_size_ == BUFFER_SIZE_UNSET) {
+        throw SaneException("Read-ahead requires the remaining size to be set");
+    }
+    if (max_chunks == 0) {
+        throw SaneException("Read-ahead requires at least one chunk");
+    }
+    read_ahead_.reset(new ReadAheadState);
+    read_ahead_->max_chunks = max_chunks;
+}
+
+void ImageBuffer::start_read_ahead()
+{
+    if (!read_ahead_) {
+        throw SaneException("Read-ahead has not been enabled");
+    }
+    std::lock_guard<std::mutex> lock{read_ahead_->mutex};
+    if (!read_ahead_->started && !read_ahead_->stop_requested) {
+        read_ahead_->started = true;
+        read_ahead_->thread = std::thread([this]() { read_ahead_thread_main(); });
+    }
+}
+
+void ImageBuffer::set_read_ahead_callback(std::function<void()> callback)
+{
+    if (!read_ahead_) {
+        throw SaneException("Read-ahead has not been enabled");
+    }
+    if (read_ahead_->started) {
+        throw SaneException("Read-ahead thread has already been started");
+    }
+    read_ahead_->callback = callback;
+}
+
+std::uint64_t ImageBuffer::ready_size() const
+{
+    if (!read_ahead_) {
+        return BUFFER_SIZE_UNSET;
+    }
+
+    std::lock_guard<std::mutex> lock{read_ahead_->mutex};
+    if (read_ahead_->finished || read_ahead_->stop_requested) {
+        return BUFFER_SIZE_UNSET;
+    }
+
+    std::uint64_t size = available();
+    for (const auto& chunk : read_ahead_->ready_chunks) {
+        size += chunk.size;
+    }
+    return size;
+}
+
+void ImageBuffer::stop_read_ahead()
+{
+    if (!read_ahead_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock{read_ahead_->mutex};
+        read_ahead_->stop_requested = true;
+    }
+    read_ahead_->cond.notify_all();
+    if (read_ahead_->thread.joinable()) {
+        read_ahead_->thread.join();
+    }
+}
+
+void ImageBuffer::compute_next_read(std::size_t& size_to_read, std::size_t& aligned_size_to_read,
+                                    bool& is_last)
+{
+    size_to_read = size_;
+    if (remaining_size_ != BUFFER_SIZE_UNSET) {
+        size_to_read = std::min<std::uint64_t>(size_to_read, remaining_size_);
+        remaining_size_ -= size_to_read;
+    }
+
+    aligned_size_to_read = size_to_read;
+    if (remaining_size_ == 0 && last_read_multiple_ != BUFFER_SIZE_UNSET) {
+        aligned_size_to_read = align_multiple_ceil(size_to_read, last_read_multiple_);
+    }
+    is_last = remaining_size_ == 0;
+}
+
+bool ImageBuffer::read_from_producer(bool& is_last)
+{
+    std::size_t size_to_read = 0;
+    std::size_t aligned_size_to_read = 0;
+    compute_next_read(size_to_read, aligned_size_to_read, is_last);
+
+    if (buffer_.size() < aligned_size_to_read) {
+        buffer_.resize(aligned_size_to_read);
+    }
+
+    bool got_data = producer_(aligned_size_to_read, buffer_.data());
+    curr_size_ = size_to_read;
+    return got_data;
+}
+
+bool ImageBuffer::read_from_read_ahead(bool& is_last)
+{
+    auto& state = *read_ahead_;
+    std::unique_lock<std::mutex> lock{state.mutex};
+
+    if (!state.started) {
+        state.started = true;
+        state.thread = std::thread([this]() { read_ahead_thread_main(); });
+    }
+
+    state.cond.wait(lock, [&]() { return !state.ready_chunks.empty() || state.finished; });
+
+    if (state.ready_chunks.empty()) {
+        if (state.error) {
+            std::rethrow_exception(state.error);
+        }
+        // all requested data has been consumed; behave the same as a synchronous read would
+        lock.unlock();
+        return read_from_producer(is_last);
+    }
+
+    auto chunk = std::move(state.ready_chunks.front());
+    state.ready_chunks.pop_front();
+
+    state.free_buffers.push_back(std::move(buffer_));
+    buffer_ = std::move(chunk.data);
+    curr_size_ = chunk.size;
+    is_last = chunk.is_last;
+
+    lock.unlock();
+    state.cond.notify_all();
+    return chunk.got_data;
+}
+
+void ImageBuffer::read_ahead_thread_main()
+{
+    auto& state = *read_ahead_;
+    std::unique_lock<std::mutex> lock{state.mutex};
+
+    while (true) {
+        state.cond.wait(lock, [&]()
+        {
+            return state.stop_requested || state.ready_chunks.size() < state.max_chunks;
+        });
+
+        if (state.stop_requested || remaining_size_ == 0) {
+            break;
+        }
+
+        Chunk chunk;
+        std::size_t aligned_size_to_read = 0;
+        compute_next_read(chunk.size, aligned_size_to_read, chunk.is_last);
+
+        if (!state.free_buffers.empty()) {
+            chunk.data = std::move(state.free_buffers.back());
+            state.free_buffers.pop_back();
+        }
+
+        lock.unlock();
+
+        if (chunk.data.size() < aligned_size_to_read) {
+            chunk.data.resize(aligned_size_to_read);
+        }
+
+        try {
+            chunk.got_data = producer_(aligned_size_to_read, chunk.data.data());
+        } catch (...) {
+            lock.lock();
+            state.error = std::current_exception();
+            break;
+        }
+
+        lock.lock();
+        bool got_data = chunk.got_data;
+        state.ready_chunks.push_back(std::move(chunk));
+        state.cond.notify_all();
+
+        if (state.callback) {
+            lock.unlock();
+            state.callback();
+            lock.lock();
+        }
+
+        if (!got_data) {
+            break;
+        }
+    }
+
+    state.finished = true;
+    state.cond.notify_all();
+
+    if (state.callback) {
+        lock.unlock();
+        state.callback();
+    }
+}
+
 bool ImageBuffer::get_data(std::size_t size, std::uint8_t* out_data)
 {
     const std::uint8_t* out_data_end = out_data + size;
@@ -82,23 +328,16 @@ bool ImageBuffer::get_data(std::size_t size, std::uint8_t* out_data)
     do {
         buffer_offset_ = 0;
 
-        std::size_t size_to_read = size_;
-        if (remaining_size_ != BUFFER_SIZE_UNSET) {
-            size_to_read = std::min<std::uint64_t>(size_to_read, remaining_size_);
-            remaining_size_ -= size_to_read;
+        bool is_last = false;
+        if (read_ahead_ && !(read_ahead_->stop_requested && read_ahead_->ready_chunks.empty())) {
+            got_data &= read_from_read_ahead(is_last);
+        } else {
+            got_data &= read_from_producer(is_last);
         }
 
-        std::size_t aligned_size_to_read = size_to_read;
-        if (remaining_size_ == 0 && last_read_multiple_ != BUFFER_SIZE_UNSET) {
-            aligned_size_to_read = align_multiple_ceil(size_to_read, last_read_multiple_);
-        }
-
-        got_data &= producer_(aligned_size_to_read, buffer_.data());
-        curr_size_ = size_to_read;
-
         copy_buffer();
 
-        if (remaining_size_ == 0 && out_data < out_data_end) {
+        if (is_last && out_data < out_data_end) {
             got_data = false;
         }
 
@@ -47,7 +47,13 @@
 #include "enums.h"
 #include "row_buffer.h"
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 namespace genesys {
 
@@ -61,19 +67,90 @@ public:
     ImageBuffer() {}
     ImageBuffer(std::size_t size, ProducerCallback producer);
 
+    ImageBuffer(ImageBuffer&& other);
+    ImageBuffer& operator=(ImageBuffer&& other);
+
+    ~ImageBuffer();
+
     std::size_t available() const { return curr_size_ - buffer_offset_; }
 
+    // the size of a single read from the producer
+    std::size_t read_size() const { return size_; }
+
     // allows adjusting the amount of data left so that we don't do a full size read from the
     // producer on the last iteration. Set to BUFFER_SIZE_UNSET to ignore buffer size.
-    std::uint64_t remaining_size() const { return remaining_size_; }
-    void set_remaining_size(std::uint64_t bytes) { remaining_size_ = bytes; }
+    // If the data is being read ahead, then the amount of data not yet requested from the producer
+    // is returned.
+    std::uint64_t remaining_size() const;
+    void set_remaining_size(std::uint64_t bytes);
 
     // May be used to force the last read to be rounded up of a certain number of bytes
     void set_last_read_multiple(std::uint64_t bytes) { last_read_multiple_ = bytes; }
 
+    // Enables reading from the producer on a separate thread so that up to `max_chunks` chunks are
+    // read before the consumer requests them. The thread is started on the first call to
+    // get_data(), thus the producer is not touched until the data is actually needed. The
+    // remaining size must be set, because the thread can't otherwise know when to stop.
+    void enable_read_ahead(std::size_t max_chunks);
+
+    // Starts the read-ahead thread without waiting for the first call to get_data().
+    void start_read_ahead();
+
+    // Sets a callback that is called from the read-ahead thread whenever a new chunk of data
+    // becomes available or the thread finishes. Must be set before the thread is started.
+    void set_read_ahead_callback(std::function<void()> callback);
+
+    // Returns the number of bytes that get_data() can return without waiting for the read-ahead
+    // thread. If the thread has finished or has been stopped, get_data() does not wait for it and
+    // BUFFER_SIZE_UNSET is returned.
+    std::uint64_t ready_size() const;
+
+    // Stops the read-ahead thread. The producer is not called from any other thread once this
+    // function returns. The chunks that have already been read are still returned by get_data()
+    // and any further data is read synchronously.
+    void stop_read_ahead();
+
+    bool is_read_ahead_enabled() const { return read_ahead_ != nullptr; }
+    bool is_reading_ahead() const { return read_ahead_ && read_ahead_->thread.joinable(); }
+
     bool get_data(std::size_t size, std::uint8_t* out_data);
 
 private:
+    struct Chunk
+    {
+        std::vector<std::uint8_t> data;
+        std::size_t size = 0;
+        bool got_data = false;
+        bool is_last = false;
+    };
+
+    struct ReadAheadState
+    {
+        std::size_t max_chunks = 0;
+        bool started = false;
+        bool stop_requested = false;
+        bool finished = false;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::function<void()> callback;
+
+        // chunks that have been read, but not yet consumed
+        std::deque<Chunk> ready_chunks;
+        // unused buffers so that allocations are not repeated for each chunk
+        std::vector<std::vector<std::uint8_t>> free_buffers;
+        std::exception_ptr error;
+    };
+
+    // computes the size of the next read from the producer and updates the remaining size
+    void compute_next_read(std::size_t& size_to_read, std::size_t& aligned_size_to_read,
+                           bool& is_last);
+
+    bool read_from_producer(bool& is_last);
+    bool read_from_read_ahead(bool& is_last);
+    void read_ahead_thread_main();
+
     ProducerCallback producer_;
     std::size_t size_ = 0;
     std::size_t curr_size_ = 0;
@@ -83,6 +160,8 @@ private:
 
     std::size_t buffer_offset_ = 0;
     std::vector<std::uint8_t> buffer_;
+
+    std::unique_ptr<ReadAheadState> read_ahead_;
 };
 
 } // namespace genesys
@@ -45,6 +45,7 @@
 
 #include "image_pipeline.h"
 #include "image.h"
+#include "image_simd.h"
 #include "low.h"
 #include <cmath>
 #include <numeric>
@@ -53,6 +54,16 @@ namespace genesys {
 
 ImagePipelineNode::~ImagePipelineNode() {}
 
+bool ImagePipelineNode::get_next_rows(std::size_t count, std::uint8_t* out_data)
+{
+    bool got_data = true;
+    auto row_bytes = get_row_bytes();
+    for (std::size_t i = 0; i < count; ++i) {
+        got_data &= get_next_row_data(out_data + row_bytes * i);
+    }
+    return got_data;
+}
+
 bool ImagePipelineNodeCallableSource::get_next_row_data(std::uint8_t* out_data)
 {
     bool got_data = producer_(get_row_bytes(), out_data);
@@ -91,6 +102,22 @@ bool ImagePipelineNodeBufferedCallableSource::get_next_row_data(std::uint8_t* ou
     return got_data;
 }
 
+bool ImagePipelineNodeBufferedCallableSource::get_next_rows(std::size_t count,
+                                                            std::uint8_t* out_data)
+{
+    if (curr_row_ + count > get_height()) {
+        // rows out of bounds are handled one by one
+        return ImagePipelineNode::get_next_rows(count, out_data);
+    }
+
+    bool got_data = buffer_.get_data(get_row_bytes() * count, out_data);
+    curr_row_ += count;
+    if (!got_data) {
+        eof_ = true;
+    }
+    return got_data;
+}
+
 ImagePipelineNodeArraySource::ImagePipelineNodeArraySource(std::size_t width, std::size_t height,
                                                            PixelFormat format,
                                                            std::vector<std::uint8_t> data) :
@@ -121,6 +148,19 @@ bool ImagePipelineNodeArraySource::get_next_row_data(std::uint8_t* out_data)
     return true;
 }
 
+bool ImagePipelineNodeArraySource::get_next_rows(std::size_t count, std::uint8_t* out_data)
+{
+    if (next_row_ + count > height_) {
+        return ImagePipelineNode::get_next_rows(count, out_data);
+    }
+
+    auto row_bytes = get_row_bytes();
+    std::memcpy(out_data, data_.data() + row_bytes * next_row_, row_bytes * count);
+    next_row_ += count;
+
+    return true;
+}
+
 
 ImagePipelineNodeImageSource::ImagePipelineNodeImageSource(const Image& source) :
     source_{source}
@@ -137,17 +177,35 @@ bool ImagePipelineNodeImageSource::get_next_row_data(std::uint8_t* out_data)
 }
 
 bool ImagePipelineNodeFormatConvert::get_next_row_data(std::uint8_t* out_data)
+{
+    return get_next_rows(1, out_data);
+}
+
+bool ImagePipelineNodeFormatConvert::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
     auto src_format = source_.get_format();
     if (src_format == dst_format_) {
-        return source_.get_next_row_data(out_data);
+        return source_.get_next_rows(count, out_data);
     }
 
-    buffer_.clear();
-    buffer_.resize(source_.get_row_bytes());
-    bool got_data = source_.get_next_row_data(buffer_.data());
+    auto src_row_bytes = source_.get_row_bytes();
+    auto dst_row_bytes = get_row_bytes();
+    auto width = get_width();
 
-    convert_pixel_row_format(buffer_.data(), src_format, out_data, dst_format_, get_width());
+    buffer_.resize(src_row_bytes * count);
+    bool got_data = source_.get_next_rows(count, buffer_.data());
+
+    // rows can be converted as a single long row unless they are padded to whole bytes
+    if (get_pixel_format_depth(src_format) % 8 == 0 &&
+        get_pixel_format_depth(dst_format_) % 8 == 0)
+    {
+        convert_pixel_row_format(buffer_.data(), src_format, out_data, dst_format_, width * count);
+    } else {
+        for (std::size_t y = 0; y < count; ++y) {
+            convert_pixel_row_format(buffer_.data() + src_row_bytes * y, src_format,
+                                     out_data + dst_row_bytes * y, dst_format_, width);
+        }
+    }
     return got_data;
 }
 
@@ -251,13 +309,14 @@ ImagePipelineNodeSwap16BitEndian::ImagePipelineNodeSwap16BitEndian(ImagePipeline
 
 bool ImagePipelineNodeSwap16BitEndian::get_next_row_data(std::uint8_t* out_data)
 {
-    bool got_data = source_.get_next_row_data(out_data);
+    return get_next_rows(1, out_data);
+}
+
+bool ImagePipelineNodeSwap16BitEndian::get_next_rows(std::size_t count, std::uint8_t* out_data)
+{
+    bool got_data = source_.get_next_rows(count, out_data);
     if (needs_swapping_) {
-        std::size_t pixels = get_row_bytes() / 2;
-        for (std::size_t i = 0; i < pixels; ++i) {
-            std::swap(*out_data, *(out_data + 1));
-            out_data += 2;
-        }
+        get_pixel_kernels().swap_16bit_endian(out_data, get_row_bytes() * count / 2);
     }
     return got_data;
 }
@@ -269,34 +328,28 @@ ImagePipelineNodeInvert::ImagePipelineNodeInvert(ImagePipelineNode& source) :
 
 bool ImagePipelineNodeInvert::get_next_row_data(std::uint8_t* out_data)
 {
-    bool got_data = source_.get_next_row_data(out_data);
-    auto num_values = get_width() * get_pixel_channels(source_.get_format());
+    return get_next_rows(1, out_data);
+}
+
+bool ImagePipelineNodeInvert::get_next_rows(std::size_t count, std::uint8_t* out_data)
+{
+    bool got_data = source_.get_next_rows(count, out_data);
+    auto num_values = get_width() * get_pixel_channels(source_.get_format()) * count;
     auto depth = get_pixel_format_depth(source_.get_format());
 
+    // 0xff - x and 0xffff - x are equal to inverting all bits of the value
     switch (depth) {
         case 16: {
-            auto* data = reinterpret_cast<std::uint16_t*>(out_data);
-            for (std::size_t i = 0; i < num_values; ++i) {
-                *data = 0xffff - *data;
-                data++;
-            }
+            get_pixel_kernels().invert_bytes(out_data, num_values * 2);
             break;
         }
         case 8: {
-            auto* data = out_data;
-            for (std::size_t i = 0; i < num_values; ++i) {
-                *data = 0xff - *data;
-                data++;
-            }
+            get_pixel_kernels().invert_bytes(out_data, num_values);
             break;
         }
         case 1: {
-            auto* data = out_data;
-            auto num_bytes = (num_values + 7) / 8;
-            for (std::size_t i = 0; i < num_bytes; ++i) {
-                *data = ~*data;
-                data++;
-            }
+            // rows are padded to whole bytes, the padding is inverted too
+            get_pixel_kernels().invert_bytes(out_data, get_row_bytes() * count);
             break;
         }
         default:
@@ -308,8 +361,7 @@ bool ImagePipelineNodeInvert::get_next_row_data(std::uint8_t* out_data)
 
 ImagePipelineNodeMergeMonoLines::ImagePipelineNodeMergeMonoLines(ImagePipelineNode& source,
                                                                  ColorOrder color_order) :
-    source_(source),
-    buffer_(source_.get_row_bytes())
+    source_(source)
 {
     DBG_HELPER_ARGS(dbg, "color_order %d", static_cast<unsigned>(color_order));
 
@@ -318,27 +370,46 @@ ImagePipelineNodeMergeMonoLines::ImagePipelineNodeMergeMonoLines(ImagePipelineNo
 
 bool ImagePipelineNodeMergeMonoLines::get_next_row_data(std::uint8_t* out_data)
 {
-    bool got_data = true;
+    return get_next_rows(1, out_data);
+}
 
-    buffer_.clear();
-    for (unsigned i = 0; i < 3; ++i) {
-        buffer_.push_back();
-        got_data &= source_.get_next_row_data(buffer_.get_row_ptr(i));
-    }
+bool ImagePipelineNodeMergeMonoLines::get_next_rows(std::size_t count, std::uint8_t* out_data)
+{
+    auto src_row_bytes = source_.get_row_bytes();
+    auto dst_row_bytes = get_row_bytes();
 
-    const auto* row0 = buffer_.get_row_ptr(0);
-    const auto* row1 = buffer_.get_row_ptr(1);
-    const auto* row2 = buffer_.get_row_ptr(2);
+    buffer_.resize(src_row_bytes * 3 * count);
+    bool got_data = source_.get_next_rows(3 * count, buffer_.data());
 
     auto format = source_.get_format();
-
-    for (std::size_t x = 0, width = get_width(); x < width; ++x) {
-        std::uint16_t ch0 = get_raw_channel_from_row(row0, x, 0, format);
-        std::uint16_t ch1 = get_raw_channel_from_row(row1, x, 0, format);
-        std::uint16_t ch2 = get_raw_channel_from_row(row2, x, 0, format);
-        set_raw_channel_to_row(out_data, x, 0, ch0, output_format_);
-        set_raw_channel_to_row(out_data, x, 1, ch1, output_format_);
-        set_raw_channel_to_row(out_data, x, 2, ch2, output_format_);
+    auto width = get_width();
+    const auto& kernels = get_pixel_kernels();
+
+    for (std::size_t y = 0; y < count; ++y) {
+        const auto* row0 = buffer_.data() + src_row_bytes * 3 * y;
+        const auto* row1 = row0 + src_row_bytes;
+        const auto* row2 = row1 + src_row_bytes;
+        auto* out_row = out_data + dst_row_bytes * y;
+
+        switch (format) {
+            case PixelFormat::I8:
+                kernels.merge_mono_lines_8(row0, row1, row2, out_row, width);
+                break;
+            case PixelFormat::I16:
+                kernels.merge_mono_lines_16(row0, row1, row2, out_row, width);
+                break;
+            default: {
+                for (std::size_t x = 0; x < width; ++x) {
+                    std::uint16_t ch0 = get_raw_channel_from_row(row0, x, 0, format);
+                    std::uint16_t ch1 = get_raw_channel_from_row(row1, x, 0, format);
+                    std::uint16_t ch2 = get_raw_channel_from_row(row2, x, 0, format);
+                    set_raw_channel_to_row(out_row, x, 0, ch0, output_format_);
+                    set_raw_channel_to_row(out_row, x, 1, ch1, output_format_);
+                    set_raw_channel_to_row(out_row, x, 2, ch2, output_format_);
+                }
+                break;
+            }
+        }
     }
     return got_data;
 }
@@ -451,30 +522,72 @@ ImagePipelineNodeComponentShiftLines::ImagePipelineNodeComponentShiftLines(
     }
 }
 
+template<class ValueType>
+static void component_shift_lines_row(const std::uint8_t* row0, const std::uint8_t* row1,
+                                      const std::uint8_t* row2, std::uint8_t* out_data,
+                                      std::size_t width)
+{
+    const auto* in0 = reinterpret_cast<const ValueType*>(row0);
+    const auto* in1 = reinterpret_cast<const ValueType*>(row1);
+    const auto* in2 = reinterpret_cast<const ValueType*>(row2);
+    auto* out = reinterpret_cast<ValueType*>(out_data);
+
+    for (std::size_t i = 0, count = width * 3; i < count; i += 3) {
+        out[i] = in0[i];
+        out[i + 1] = in1[i + 1];
+        out[i + 2] = in2[i + 2];
+    }
+}
+
 bool ImagePipelineNodeComponentShiftLines::get_next_row_data(std::uint8_t* out_data)
 {
-    bool got_data = true;
+    return get_next_rows(1, out_data);
+}
 
-    if (!buffer_.empty()) {
-        buffer_.pop_front();
-    }
-    while (buffer_.height() < extra_height_ + 1) {
-        buffer_.push_back();
-        got_data &= source_.get_next_row_data(buffer_.get_back_row_ptr());
-    }
+bool ImagePipelineNodeComponentShiftLines::get_next_rows(std::size_t count,
+                                                         std::uint8_t* out_data)
+{
+    bool got_data = true;
 
     auto format = get_format();
-    const auto* row0 = buffer_.get_row_ptr(channel_shifts_[0]);
-    const auto* row1 = buffer_.get_row_ptr(channel_shifts_[1]);
-    const auto* row2 = buffer_.get_row_ptr(channel_shifts_[2]);
+    auto width = get_width();
+    auto row_bytes = get_row_bytes();
 
-    for (std::size_t x = 0, width = get_width(); x < width; ++x) {
-        std::uint16_t ch0 = get_raw_channel_from_row(row0, x, 0, format);
-        std::uint16_t ch1 = get_raw_channel_from_row(row1, x, 1, format);
-        std::uint16_t ch2 = get_raw_channel_from_row(row2, x, 2, format);
-        set_raw_channel_to_row(out_data, x, 0, ch0, format);
-        set_raw_channel_to_row(out_data, x, 1, ch1, format);
-        set_raw_channel_to_row(out_data, x, 2, ch2, format);
+    for (std::size_t y = 0; y < count; ++y) {
+        if (!buffer_.empty()) {
+            buffer_.pop_front();
+        }
+        while (buffer_.height() < extra_height_ + 1) {
+            buffer_.push_back();
+            got_data &= source_.get_next_row_data(buffer_.get_back_row_ptr());
+        }
+
+        const auto* row0 = buffer_.get_row_ptr(channel_shifts_[0]);
+        const auto* row1 = buffer_.get_row_ptr(channel_shifts_[1]);
+        const auto* row2 = buffer_.get_row_ptr(channel_shifts_[2]);
+        auto* out_row = out_data + row_bytes * y;
+
+        switch (format) {
+            case PixelFormat::RGB888:
+            case PixelFormat::BGR888:
+                component_shift_lines_row<std::uint8_t>(row0, row1, row2, out_row, width);
+                break;
+            case PixelFormat::RGB161616:
+            case PixelFormat::BGR161616:
+                component_shift_lines_row<std::uint16_t>(row0, row1, row2, out_row, width);
+                break;
+            default: {
+                for (std::size_t x = 0; x < width; ++x) {
+                    std::uint16_t ch0 = get_raw_channel_from_row(row0, x, 0, format);
+                    std::uint16_t ch1 = get_raw_channel_from_row(row1, x, 1, format);
+                    std::uint16_t ch2 = get_raw_channel_from_row(row2, x, 2, format);
+                    set_raw_channel_to_row(out_row, x, 0, ch0, format);
+                    set_raw_channel_to_row(out_row, x, 1, ch1, format);
+                    set_raw_channel_to_row(out_row, x, 2, ch2, format);
+                }
+                break;
+            }
+        }
     }
     return got_data;
 }
@@ -710,6 +823,9 @@ bool ImagePipelineNodeExtract::get_next_row_data(std::uint8_t* out_data)
     return got_data;
 }
 
+// The number of fractional bits of the fixed point calibration coefficients
+static const unsigned CALIBRATION_FRACTION_BITS = 24;
+
 ImagePipelineNodeCalibrate::ImagePipelineNodeCalibrate(ImagePipelineNode& source,
                                                        const std::vector<std::uint16_t>& bottom,
                                                        const std::vector<std::uint16_t>& top,
@@ -721,44 +837,99 @@ ImagePipelineNodeCalibrate::ImagePipelineNodeCalibrate(ImagePipelineNode& source
         size = std::min(bottom.size() - x_start, top.size() - x_start);
     }
 
+    std::int64_t max_value = 0;
+    switch (get_pixel_format_depth(get_format())) {
+        case 8: max_value = 255; break;
+        case 16: max_value = 65535; break;
+        default:
+            // unsupported depths are reported when reading data
+            return;
+    }
+
+    gain_.reserve(size);
     offset_.reserve(size);
-    multiplier_.reserve(size);
 
+    /*  The calibrated value is computed as follows:
+
+            out = ((in / max_value) - (bottom / 65535)) * (65535 / (top - bottom)) * max_value
+
+        which is equal to
+
+            out = in * 65535 / (top - bottom) - bottom * max_value / (top - bottom)
+
+        Both terms are stored as fixed point numbers so that calibrating a value needs only one
+        multiplication and one subtraction. The errors of the coefficients are well below a
+        single output step even for 16-bit data.
+    */
     for (std::size_t i = 0; i < size; ++i) {
-        offset_.push_back(bottom[i + x_start] / 65535.0f);
-        multiplier_.push_back(65535.0f / (top[i + x_start] - bottom[i + x_start]));
+        std::int64_t range = static_cast<std::int64_t>(top[i + x_start]) - bottom[i + x_start];
+        if (range == 0) {
+            // the output is zero just like with the previous floating-point implementation
+            gain_.push_back(0);
+            offset_.push_back(0);
+            continue;
+        }
+        double scale = static_cast<double>(1ull << CALIBRATION_FRACTION_BITS) / range;
+        gain_.push_back(static_cast<std::int64_t>(std::round(65535 * scale)));
+        offset_.push_back(static_cast<std::int64_t>(
+                std::round(bottom[i + x_start] * max_value * scale)));
+    }
+}
+
+template<unsigned Depth>
+static void calibrate_row(std::uint8_t* data, const std::int64_t* gain,
+                          const std::int64_t* offset, std::size_t count)
+{
+    const std::int64_t max_value = (1 << Depth) - 1;
+    const std::int64_t rounding = 1ll << (CALIBRATION_FRACTION_BITS - 1);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        std::int64_t value = 0;
+        if (Depth == 16) {
+            value = data[i * 2] | (data[i * 2 + 1] << 8);
+        } else {
+            value = data[i];
+        }
+
+        value = value * gain[i] - offset[i] + rounding;
+        value = std::max<std::int64_t>(value, 0) >> CALIBRATION_FRACTION_BITS;
+        value = std::min(value, max_value);
+
+        if (Depth == 16) {
+            data[i * 2] = value & 0xff;
+            data[i * 2 + 1] = (value >> 8) & 0xff;
+        } else {
+            data[i] = value;
+        }
     }
 }
 
 bool ImagePipelineNodeCalibrate::get_next_row_data(std::uint8_t* out_data)
 {
-    bool ret = source_.get_next_row_data(out_data);
+    return get_next_rows(1, out_data);
+}
+
+bool ImagePipelineNodeCalibrate::get_next_rows(std::size_t count, std::uint8_t* out_data)
+{
+    bool ret = source_.get_next_rows(count, out_data);
 
     auto format = get_format();
     auto depth = get_pixel_format_depth(format);
-    std::size_t max_value = 1;
-    switch (depth) {
-        case 8: max_value = 255; break;
-        case 16: max_value = 65535; break;
-        default:
-            throw SaneException("Unsupported depth for calibration %d", depth);
+    if (depth != 8 && depth != 16) {
+        throw SaneException("Unsupported depth for calibration %d", depth);
     }
-    unsigned channels = get_pixel_channels(format);
 
-    std::size_t max_calib_i = offset_.size();
-    std::size_t curr_calib_i = 0;
-
-    for (std::size_t x = 0, width = get_width(); x < width && curr_calib_i < max_calib_i; ++x) {
-        for (unsigned ch = 0; ch < channels && curr_calib_i < max_calib_i; ++ch) {
-            std::int32_t value = get_raw_channel_from_row(out_data, x, ch, format);
-
-            float value_f = static_cast<float>(value) / max_value;
-            value_f = (value_f - offset_[curr_calib_i]) * multiplier_[curr_calib_i];
-            value_f = std::round(value_f * max_value);
-            value = clamp<std::int32_t>(static_cast<std::int32_t>(value_f), 0, max_value);
-            set_raw_channel_to_row(out_data, x, ch, value, format);
+    // the channels of all pixels in a row are stored sequentially, thus each row can be
+    // processed as a single array of values
+    std::size_t row_values = std::min(get_width() * get_pixel_channels(format), gain_.size());
+    auto row_bytes = get_row_bytes();
 
-            curr_calib_i++;
+    for (std::size_t y = 0; y < count; ++y) {
+        auto* row_data = out_data + row_bytes * y;
+        if (depth == 16) {
+            calibrate_row<16>(row_data, gain_.data(), offset_.data(), row_values);
+        } else {
+            calibrate_row<8>(row_data, gain_.data(), offset_.data(), row_values);
         }
     }
     return ret;
@@ -73,6 +73,11 @@ public:
     // returns true if the row was filled successfully, false otherwise (e.g. if not enough data
     // was available.
     virtual bool get_next_row_data(std::uint8_t* out_data) = 0;
+
+    // Fills `count` rows that are stored one after another in `out_data`. Returns true if all rows
+    // were filled successfully, false otherwise. The default implementation calls
+    // get_next_row_data() for each row. Nodes may override it to process many rows at once.
+    virtual bool get_next_rows(std::size_t count, std::uint8_t* out_data);
 };
 
 // A pipeline node that produces data from a callable
@@ -122,11 +127,17 @@ public:
     bool eof() const override { return eof_; }
 
     bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
     std::size_t remaining_bytes() const { return buffer_.remaining_size(); }
     void set_remaining_bytes(std::size_t bytes) { buffer_.set_remaining_size(bytes); }
     void set_last_read_multiple(std::size_t bytes) { buffer_.set_last_read_multiple(bytes); }
 
+    // see ImageBuffer::enable_read_ahead() and ImageBuffer::stop_read_ahead()
+    void enable_read_ahead(std::size_t max_chunks) { buffer_.enable_read_ahead(max_chunks); }
+    void stop_read_ahead() { buffer_.stop_read_ahead(); }
+    bool is_read_ahead_enabled() const { return buffer_.is_read_ahead_enabled(); }
+
 private:
     ProducerCallback producer_;
     std::size_t width_ = 0;
@@ -153,6 +164,7 @@ public:
     bool eof() const override { return eof_; }
 
     bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     std::size_t width_ = 0;
@@ -203,6 +215,7 @@ public:
     bool eof() const override { return source_.eof(); }
 
     bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -273,6 +286,7 @@ public:
     bool eof() const override { return source_.eof(); }
 
     bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -291,6 +305,7 @@ public:
     bool eof() const override { return source_.eof(); }
 
     bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -310,6 +325,7 @@ public:
     bool eof() const override { return source_.eof(); }
 
     bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     static PixelFormat get_output_format(PixelFormat input_format, ColorOrder order);
@@ -317,7 +333,7 @@ private:
     ImagePipelineNode& source_;
     PixelFormat output_format_ = PixelFormat::UNKNOWN;
 
-    RowBuffer buffer_;
+    std::vector<std::uint8_t> buffer_;
 };
 
 // A pipeline node that splits a color channel into 3 mono lines
@@ -358,6 +374,7 @@ public:
     bool eof() const override { return source_.eof(); }
 
     bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -492,12 +509,14 @@ public:
     bool eof() const override { return source_.eof(); }
 
     bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
 
-    std::vector<float> offset_;
-    std::vector<float> multiplier_;
+    // Per-value fixed point coefficients, see the constructor for details
+    std::vector<std::int64_t> gain_;
+    std::vector<std::int64_t> offset_;
 };
 
 class ImagePipelineNodeDebug : public ImagePipelineNode
@@ -551,6 +570,8 @@ public:
 
     ImagePipelineNode& front() { return *(nodes_.front().get()); }
 
+    bool empty() const { return nodes_.empty(); }
+
     bool eof() const { return nodes_.back()->eof(); }
 
     void clear();
@@ -579,6 +600,11 @@ public:
         return nodes_.back()->get_next_row_data(out_data);
     }
 
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data)
+    {
+        return nodes_.back()->get_next_rows(count, out_data);
+    }
+
     std::vector<std::uint8_t> get_all_data();
 
     Image get_image();
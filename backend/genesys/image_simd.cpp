@@ -0,0 +1,475 @@
+/* sane - Scanner Access Now Easy.
+
+   Copyright (C) 2020 Povilas Kanapickas <povilas@radix.lt>
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+*/
+
+
+#define DEBUG_DECLARE_ONLY
+
+#include "image_simd.h"
+
+#include <initializer_list>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GENESYS_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GENESYS_HAVE_NEON_SIMD 1
+#include <arm_neon.h>
+#endif
+
+namespace genesys {
+
+namespace {
+
+void swap_rgb_8_scalar(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        std::uint8_t ch0 = in_data[0];
+        std::uint8_t ch1 = in_data[1];
+        std::uint8_t ch2 = in_data[2];
+        out_data[0] = ch2;
+        out_data[1] = ch1;
+        out_data[2] = ch0;
+        in_data += 3;
+        out_data += 3;
+    }
+}
+
+void swap_rgb_16_scalar(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        std::uint8_t ch0_lo = in_data[0];
+        std::uint8_t ch0_hi = in_data[1];
+        std::uint8_t ch1_lo = in_data[2];
+        std::uint8_t ch1_hi = in_data[3];
+        std::uint8_t ch2_lo = in_data[4];
+        std::uint8_t ch2_hi = in_data[5];
+        out_data[0] = ch2_lo;
+        out_data[1] = ch2_hi;
+        out_data[2] = ch1_lo;
+        out_data[3] = ch1_hi;
+        out_data[4] = ch0_lo;
+        out_data[5] = ch0_hi;
+        in_data += 6;
+        out_data += 6;
+    }
+}
+
+void swap_16bit_endian_scalar(std::uint8_t* data, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        std::uint8_t tmp = data[0];
+        data[0] = data[1];
+        data[1] = tmp;
+        data += 2;
+    }
+}
+
+void invert_bytes_scalar(std::uint8_t* data, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        data[i] = ~data[i];
+    }
+}
+
+void merge_mono_lines_8_scalar(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                               const std::uint8_t* in_data2, std::uint8_t* out_data,
+                               std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        out_data[i * 3] = in_data0[i];
+        out_data[i * 3 + 1] = in_data1[i];
+        out_data[i * 3 + 2] = in_data2[i];
+    }
+}
+
+void merge_mono_lines_16_scalar(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                                const std::uint8_t* in_data2, std::uint8_t* out_data,
+                                std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        out_data[i * 6] = in_data0[i * 2];
+        out_data[i * 6 + 1] = in_data0[i * 2 + 1];
+        out_data[i * 6 + 2] = in_data1[i * 2];
+        out_data[i * 6 + 3] = in_data1[i * 2 + 1];
+        out_data[i * 6 + 4] = in_data2[i * 2];
+        out_data[i * 6 + 5] = in_data2[i * 2 + 1];
+    }
+}
+
+const PixelKernels kernels_scalar = {
+    swap_rgb_8_scalar,
+    swap_rgb_16_scalar,
+    swap_16bit_endian_scalar,
+    invert_bytes_scalar,
+    merge_mono_lines_8_scalar,
+    merge_mono_lines_16_scalar,
+};
+
+#if GENESYS_HAVE_X86_SIMD
+
+// SSE2 has no byte shuffle instruction, so only the operations that don't need to move data
+// across bytes are implemented at that level. Channel shuffles are implemented using SSSE3.
+
+__attribute__((target("sse2")))
+void swap_16bit_endian_sse2(std::uint8_t* data, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto* ptr = reinterpret_cast<__m128i*>(data + i * 2);
+        __m128i v = _mm_loadu_si128(ptr);
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(ptr, v);
+    }
+    swap_16bit_endian_scalar(data + i * 2, count - i);
+}
+
+__attribute__((target("sse2")))
+void invert_bytes_sse2(std::uint8_t* data, std::size_t count)
+{
+    const __m128i ones = _mm_set1_epi8(-1);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto* ptr = reinterpret_cast<__m128i*>(data + i);
+        _mm_storeu_si128(ptr, _mm_xor_si128(_mm_loadu_si128(ptr), ones));
+    }
+    invert_bytes_scalar(data + i, count - i);
+}
+
+/*  Each step processes the whole pixels that fit into a 16-byte register and stores the full
+    register. The trailing bytes that belong to the next pixel are stored unchanged and are
+    overwritten in the next step, which allows the kernels to work in place too.
+*/
+__attribute__((target("ssse3")))
+void swap_rgb_8_ssse3(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count)
+{
+    // 5 pixels per step
+    const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    std::size_t i = 0;
+    for (; i + 6 <= count; i += 5) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_data + i * 3), _mm_shuffle_epi8(v, mask));
+    }
+    swap_rgb_8_scalar(in_data + i * 3, out_data + i * 3, count - i);
+}
+
+__attribute__((target("ssse3")))
+void swap_rgb_16_ssse3(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count)
+{
+    // 2 pixels per step
+    const __m128i mask = _mm_setr_epi8(4, 5, 2, 3, 0, 1, 10, 11, 8, 9, 6, 7, 12, 13, 14, 15);
+    std::size_t i = 0;
+    for (; i + 3 <= count; i += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data + i * 6));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_data + i * 6), _mm_shuffle_epi8(v, mask));
+    }
+    swap_rgb_16_scalar(in_data + i * 6, out_data + i * 6, count - i);
+}
+
+// Computes the shuffle mask that moves the values of the given input row into their positions
+// within the given 16-byte part of 48 bytes of interleaved output.
+void compute_merge_mask(std::uint8_t* mask, unsigned out_part, unsigned in_row,
+                        unsigned value_size)
+{
+    for (unsigned i = 0; i < 16; ++i) {
+        unsigned out_offset = out_part * 16 + i;
+        unsigned value_index = out_offset / value_size;
+        if (value_index % 3 == in_row) {
+            mask[i] = (value_index / 3) * value_size + out_offset % value_size;
+        } else {
+            mask[i] = 0x80;
+        }
+    }
+}
+
+__attribute__((target("ssse3")))
+void merge_mono_lines_ssse3(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                            const std::uint8_t* in_data2, std::uint8_t* out_data,
+                            std::size_t count_bytes, unsigned value_size)
+{
+    __m128i masks[3][3];
+    for (unsigned part = 0; part < 3; ++part) {
+        for (unsigned row = 0; row < 3; ++row) {
+            std::uint8_t mask[16];
+            compute_merge_mask(mask, part, row, value_size);
+            masks[part][row] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+        }
+    }
+
+    std::size_t i = 0;
+    for (; i + 16 <= count_bytes; i += 16) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data0 + i));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data1 + i));
+        __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data2 + i));
+        auto* out = reinterpret_cast<__m128i*>(out_data + i * 3);
+        for (unsigned part = 0; part < 3; ++part) {
+            __m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, masks[part][0]),
+                                                  _mm_shuffle_epi8(v1, masks[part][1])),
+                                     _mm_shuffle_epi8(v2, masks[part][2]));
+            _mm_storeu_si128(out + part, r);
+        }
+    }
+    if (value_size == 1) {
+        merge_mono_lines_8_scalar(in_data0 + i, in_data1 + i, in_data2 + i, out_data + i * 3,
+                                  count_bytes - i);
+    } else {
+        merge_mono_lines_16_scalar(in_data0 + i, in_data1 + i, in_data2 + i, out_data + i * 3,
+                                   (count_bytes - i) / 2);
+    }
+}
+
+void merge_mono_lines_8_ssse3(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                              const std::uint8_t* in_data2, std::uint8_t* out_data,
+                              std::size_t count)
+{
+    merge_mono_lines_ssse3(in_data0, in_data1, in_data2, out_data, count, 1);
+}
+
+void merge_mono_lines_16_ssse3(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                               const std::uint8_t* in_data2, std::uint8_t* out_data,
+                               std::size_t count)
+{
+    merge_mono_lines_ssse3(in_data0, in_data1, in_data2, out_data, count * 2, 2);
+}
+
+// The 3-byte and 6-byte pixels don't map well to the 128-bit lanes of AVX2 shuffles, thus only
+// the byte-wise operations are implemented at this level.
+
+__attribute__((target("avx2")))
+void swap_16bit_endian_avx2(std::uint8_t* data, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        auto* ptr = reinterpret_cast<__m256i*>(data + i * 2);
+        __m256i v = _mm256_loadu_si256(ptr);
+        v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        _mm256_storeu_si256(ptr, v);
+    }
+    swap_16bit_endian_sse2(data + i * 2, count - i);
+}
+
+__attribute__((target("avx2")))
+void invert_bytes_avx2(std::uint8_t* data, std::size_t count)
+{
+    const __m256i ones = _mm256_set1_epi8(-1);
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        auto* ptr = reinterpret_cast<__m256i*>(data + i);
+        _mm256_storeu_si256(ptr, _mm256_xor_si256(_mm256_loadu_si256(ptr), ones));
+    }
+    invert_bytes_sse2(data + i, count - i);
+}
+
+const PixelKernels kernels_sse2 = {
+    swap_rgb_8_scalar,
+    swap_rgb_16_scalar,
+    swap_16bit_endian_sse2,
+    invert_bytes_sse2,
+    merge_mono_lines_8_scalar,
+    merge_mono_lines_16_scalar,
+};
+
+const PixelKernels kernels_ssse3 = {
+    swap_rgb_8_ssse3,
+    swap_rgb_16_ssse3,
+    swap_16bit_endian_sse2,
+    invert_bytes_sse2,
+    merge_mono_lines_8_ssse3,
+    merge_mono_lines_16_ssse3,
+};
+
+const PixelKernels kernels_avx2 = {
+    swap_rgb_8_ssse3,
+    swap_rgb_16_ssse3,
+    swap_16bit_endian_avx2,
+    invert_bytes_avx2,
+    merge_mono_lines_8_ssse3,
+    merge_mono_lines_16_ssse3,
+};
+
+bool cpu_supports_simd_level(SimdLevel level)
+{
+    __builtin_cpu_init();
+    switch (level) {
+        case SimdLevel::SSE2: return __builtin_cpu_supports("sse2");
+        case SimdLevel::SSSE3: return __builtin_cpu_supports("ssse3");
+        case SimdLevel::AVX2: return __builtin_cpu_supports("avx2");
+        default: return false;
+    }
+}
+
+#endif // GENESYS_HAVE_X86_SIMD
+
+#if GENESYS_HAVE_NEON_SIMD
+
+void swap_rgb_8_neon(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t v = vld3q_u8(in_data + i * 3);
+        uint8x16_t tmp = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = tmp;
+        vst3q_u8(out_data + i * 3, v);
+    }
+    swap_rgb_8_scalar(in_data + i * 3, out_data + i * 3, count - i);
+}
+
+void swap_rgb_16_neon(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // deinterleaving 16-bit values keeps the bytes of each value together
+        uint16x8x3_t v16 = vld3q_u16(reinterpret_cast<const std::uint16_t*>(in_data + i * 6));
+        uint16x8_t tmp = v16.val[0];
+        v16.val[0] = v16.val[2];
+        v16.val[2] = tmp;
+        vst3q_u16(reinterpret_cast<std::uint16_t*>(out_data + i * 6), v16);
+    }
+    swap_rgb_16_scalar(in_data + i * 6, out_data + i * 6, count - i);
+}
+
+void swap_16bit_endian_neon(std::uint8_t* data, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8(data + i * 2, vrev16q_u8(vld1q_u8(data + i * 2)));
+    }
+    swap_16bit_endian_scalar(data + i * 2, count - i);
+}
+
+void invert_bytes_neon(std::uint8_t* data, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        vst1q_u8(data + i, vmvnq_u8(vld1q_u8(data + i)));
+    }
+    invert_bytes_scalar(data + i, count - i);
+}
+
+void merge_mono_lines_8_neon(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                             const std::uint8_t* in_data2, std::uint8_t* out_data,
+                             std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t v;
+        v.val[0] = vld1q_u8(in_data0 + i);
+        v.val[1] = vld1q_u8(in_data1 + i);
+        v.val[2] = vld1q_u8(in_data2 + i);
+        vst3q_u8(out_data + i * 3, v);
+    }
+    merge_mono_lines_8_scalar(in_data0 + i, in_data1 + i, in_data2 + i, out_data + i * 3,
+                              count - i);
+}
+
+void merge_mono_lines_16_neon(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                              const std::uint8_t* in_data2, std::uint8_t* out_data,
+                              std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint16x8x3_t v;
+        v.val[0] = vreinterpretq_u16_u8(vld1q_u8(in_data0 + i * 2));
+        v.val[1] = vreinterpretq_u16_u8(vld1q_u8(in_data1 + i * 2));
+        v.val[2] = vreinterpretq_u16_u8(vld1q_u8(in_data2 + i * 2));
+        vst3q_u16(reinterpret_cast<std::uint16_t*>(out_data + i * 6), v);
+    }
+    merge_mono_lines_16_scalar(in_data0 + i * 2, in_data1 + i * 2, in_data2 + i * 2,
+                               out_data + i * 6, count - i);
+}
+
+const PixelKernels kernels_neon = {
+    swap_rgb_8_neon,
+    swap_rgb_16_neon,
+    swap_16bit_endian_neon,
+    invert_bytes_neon,
+    merge_mono_lines_8_neon,
+    merge_mono_lines_16_neon,
+};
+
+#endif // GENESYS_HAVE_NEON_SIMD
+
+} // namespace
+
+const PixelKernels* get_pixel_kernels(SimdLevel level)
+{
+    switch (level) {
+        case SimdLevel::SCALAR:
+            return &kernels_scalar;
+#if GENESYS_HAVE_X86_SIMD
+        case SimdLevel::SSE2:
+            return cpu_supports_simd_level(level) ? &kernels_sse2 : nullptr;
+        case SimdLevel::SSSE3:
+            return cpu_supports_simd_level(level) ? &kernels_ssse3 : nullptr;
+        case SimdLevel::AVX2:
+            return cpu_supports_simd_level(level) ? &kernels_avx2 : nullptr;
+#endif
+#if GENESYS_HAVE_NEON_SIMD
+        case SimdLevel::NEON:
+            return &kernels_neon;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static const PixelKernels& select_pixel_kernels()
+{
+    for (auto level : { SimdLevel::NEON, SimdLevel::AVX2, SimdLevel::SSSE3, SimdLevel::SSE2 }) {
+        const auto* kernels = get_pixel_kernels(level);
+        if (kernels) {
+            return *kernels;
+        }
+    }
+    return kernels_scalar;
+}
+
+const PixelKernels& get_pixel_kernels()
+{
+    static const PixelKernels& kernels = select_pixel_kernels();
+    return kernels;
+}
+
+} // namespace genesys
@@ -0,0 +1,101 @@
+/* sane - Scanner Access Now Easy.
+
+   Copyright (C) 2020 Povilas Kanapickas <povilas@radix.lt>
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+*/
+
+
+#ifndef BACKEND_GENESYS_IMAGE_SIMD_H
+#define BACKEND_GENESYS_IMAGE_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace genesys {
+
+enum class SimdLevel : unsigned
+{
+    SCALAR,
+    SSE2,
+    SSSE3,
+    AVX2,
+    NEON,
+};
+
+/*  Kernels for the most common operations on rows of pixel data. All kernels accept unaligned
+    pointers. Kernels that take separate input and output pointers also work in place when both
+    pointers are equal, but the buffers must not overlap otherwise.
+*/
+struct PixelKernels
+{
+    // Swaps the first and the third channel of 8-bit 3-channel pixels, e.g. BGR888 -> RGB888
+    void (*swap_rgb_8)(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count);
+
+    // Swaps the first and the third channel of 16-bit 3-channel pixels,
+    // e.g. BGR161616 -> RGB161616
+    void (*swap_rgb_16)(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count);
+
+    // Swaps the two bytes of each of count 16-bit values
+    void (*swap_16bit_endian)(std::uint8_t* data, std::size_t count);
+
+    // Inverts all bits of count bytes
+    void (*invert_bytes)(std::uint8_t* data, std::size_t count);
+
+    // Interleaves count 8-bit values from each of three rows into 3-channel pixels
+    void (*merge_mono_lines_8)(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                               const std::uint8_t* in_data2, std::uint8_t* out_data,
+                               std::size_t count);
+
+    // Interleaves count 16-bit values from each of three rows into 3-channel pixels
+    void (*merge_mono_lines_16)(const std::uint8_t* in_data0, const std::uint8_t* in_data1,
+                                const std::uint8_t* in_data2, std::uint8_t* out_data,
+                                std::size_t count);
+};
+
+// Returns the kernels of the given level or nullptr if either the compiler or the CPU does not
+// support the level. Kernels that have no implementation at that level use the next best one.
+const PixelKernels* get_pixel_kernels(SimdLevel level);
+
+// Returns the fastest kernels supported by the CPU
+const PixelKernels& get_pixel_kernels();
+
+} // namespace genesys
+
+#endif // BACKEND_GENESYS_IMAGE_SIMD_H
@@ -1264,6 +1264,29 @@ ImagePipelineStack build_image_pipeline(const Genesys_Device& dev, const ScanSes
     return pipeline;
 }
 
+static std::size_t compute_read_ahead_chunk_count(std::size_t chunk_size)
+{
+    // limit the memory used by the chunks that are read ahead
+    const std::size_t MAX_READ_AHEAD_BYTES = 32 * 1024 * 1024;
+    const std::size_t MAX_READ_AHEAD_CHUNKS = 8;
+
+    if (chunk_size == 0) {
+        return MAX_READ_AHEAD_CHUNKS;
+    }
+    return clamp<std::size_t>(MAX_READ_AHEAD_BYTES / chunk_size, 2, MAX_READ_AHEAD_CHUNKS);
+}
+
+static std::size_t compute_pipeline_batch_rows(std::size_t row_bytes)
+{
+    const std::size_t MAX_BATCH_BYTES = 256 * 1024;
+    const std::size_t MAX_BATCH_ROWS = 64;
+
+    if (row_bytes == 0) {
+        return 1;
+    }
+    return clamp<std::size_t>(MAX_BATCH_BYTES / row_bytes, 1, MAX_BATCH_ROWS);
+}
+
 void setup_image_pipeline(Genesys_Device& dev, const ScanSession& session)
 {
     static unsigned s_pipeline_index = 0;
@@ -1272,13 +1295,29 @@ void setup_image_pipeline(Genesys_Device& dev, const ScanSession& session)
 
     dev.pipeline = build_image_pipeline(dev, session, s_pipeline_index, dbg_log_image_data());
 
-    auto read_from_pipeline = [&dev](std::size_t size, std::uint8_t* out_data)
+    // Reading the scanner on a separate thread allows the scanner to continue while the data is
+    // being processed, which avoids motor stalls at high resolutions. Sheetfed scanners adjust
+    // the amount of data to read during the scan, which can't be done once the data has been
+    // requested. USB captures need to be deterministic, thus they are made without read-ahead.
+    if (!dev.model->is_sheetfed && !dev.interface->is_mock() &&
+        !sanei_usb_is_record_mode_enabled() && !sanei_usb_is_replay_mode_enabled())
     {
-        (void) size; // will be always equal to dev.pipeline.get_output_row_bytes()
-        return dev.pipeline.get_next_row_data(out_data);
+        dev.get_pipeline_source().enable_read_ahead(
+                    compute_read_ahead_chunk_count(session.buffer_size_read));
+    }
+
+    auto row_bytes = dev.pipeline.get_output_row_bytes();
+
+    auto read_from_pipeline = [&dev, row_bytes](std::size_t size, std::uint8_t* out_data)
+    {
+        // size is always a multiple of row_bytes, as is the remaining size of the buffer
+        return dev.pipeline.get_next_rows(size / row_bytes, out_data);
     };
-    dev.pipeline_buffer = ImageBuffer{dev.pipeline.get_output_row_bytes(),
-                                       read_from_pipeline};
+
+    // the pipeline processes several rows at once to reduce per-row overhead
+    dev.pipeline_buffer = ImageBuffer{row_bytes * compute_pipeline_batch_rows(row_bytes),
+                                      read_from_pipeline};
+    dev.pipeline_buffer.set_remaining_size(dev.pipeline.get_output_height() * row_bytes);
 }
 
 std::uint8_t compute_frontend_gain_wolfson(float value, float target_value)
@@ -1779,9 +1818,6 @@ bool sanei_genesys_is_compatible_calibration(Genesys_Device* dev,
                                              bool for_overwrite)
 {
     DBG_HELPER(dbg);
-#ifdef HAVE_SYS_TIME_H
-  struct timeval time;
-#endif
 
     bool compatible = true;
 
@@ -1834,23 +1870,33 @@ bool sanei_genesys_is_compatible_calibration(Genesys_Device* dev,
       return false;
     }
 
-  /* a cache entry expires after afetr expiration time for non sheetfed scanners */
-  /* this is not taken into account when overwriting cache entries    */
+    // expiration is not taken into account when overwriting cache entries
+    if (!for_overwrite && is_calibration_cache_entry_expired(*dev, *cache)) {
+        DBG (DBG_proc, "%s: expired entry, non compatible cache\n", __func__);
+        return false;
+    }
+
+  return true;
+}
+
+bool is_calibration_cache_entry_expired(const Genesys_Device& dev,
+                                        const Genesys_Calibration_Cache& cache)
+{
+    // a flatbed cache entry expires after expiration time for non sheetfed scanners. The scan
+    // method of the entry itself is used, the cache holds entries of all scan methods.
 #ifdef HAVE_SYS_TIME_H
-    if (!for_overwrite && dev->settings.expiration_time >=0)
+    if (dev.settings.expiration_time >= 0 && !dev.model->is_sheetfed &&
+        cache.params.scan_method == ScanMethod::FLATBED)
     {
+        struct timeval time;
         gettimeofday(&time, nullptr);
-      if ((time.tv_sec - cache->last_calibration > dev->settings.expiration_time*60)
-          && !dev->model->is_sheetfed
-          && (dev->settings.scan_method == ScanMethod::FLATBED))
-        {
-          DBG (DBG_proc, "%s: expired entry, non compatible cache\n", __func__);
-          return false;
-        }
+        return time.tv_sec - cache.last_calibration > dev.settings.expiration_time * 60;
     }
+#else
+    (void) dev;
+    (void) cache;
 #endif
-
-  return true;
+    return false;
 }
 
 /** @brief build lookup table for digital enhancements
@@ -409,6 +409,11 @@ bool sanei_genesys_is_compatible_calibration(Genesys_Device* dev,
                                              const Genesys_Calibration_Cache* cache,
                                              bool for_overwrite);
 
+// Returns true if the calibration cache entry is too old to be used. Whether an entry can expire
+// depends on its own scan method, not on the currently selected one.
+bool is_calibration_cache_entry_expired(const Genesys_Device& dev,
+                                        const Genesys_Calibration_Cache& cache);
+
 extern void sanei_genesys_load_lut(unsigned char* lut,
                                    int in_bits, int out_bits,
                                    int out_min, int out_max,
@@ -0,0 +1,139 @@
+/* sane - Scanner Access Now Easy.
+
+   Copyright (C) 2020 Povilas Kanapickas <povilas@radix.lt>
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+*/
+
+
+#define DEBUG_DECLARE_ONLY
+
+#include "mapped_file.h"
+#include "error.h"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#define GENESYS_USE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace genesys {
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#if GENESYS_USE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    if (st.st_size > 0) {
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            mapping_ = mapping;
+            mapping_size_ = st.st_size;
+            ::close(fd);
+            return true;
+        }
+        DBG(DBG_info, "%s: could not map %s, reading it instead\n", __func__, path.c_str());
+    }
+    ::close(fd);
+#endif
+
+    std::ifstream str(path, std::ios::binary);
+    if (!str.is_open()) {
+        return false;
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(str), std::istreambuf_iterator<char>());
+    return !str.bad();
+}
+
+void MappedFile::assign(std::vector<std::uint8_t> data)
+{
+    close();
+    buffer_ = std::move(data);
+}
+
+void MappedFile::close()
+{
+#if GENESYS_USE_MMAP
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    buffer_.clear();
+}
+
+const std::uint8_t* MappedFile::data() const
+{
+    if (mapping_) {
+        return static_cast<const std::uint8_t*>(mapping_);
+    }
+    return buffer_.data();
+}
+
+std::size_t MappedFile::size() const
+{
+    if (mapping_) {
+        return mapping_size_;
+    }
+    return buffer_.size();
+}
+
+} // namespace genesys
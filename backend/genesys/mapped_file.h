@@ -0,0 +1,88 @@
+/* sane - Scanner Access Now Easy.
+
+   Copyright (C) 2020 Povilas Kanapickas <povilas@radix.lt>
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+*/
+
+
+#ifndef BACKEND_GENESYS_MAPPED_FILE_H
+#define BACKEND_GENESYS_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace genesys {
+
+// Read-only view of the contents of a file. The file is mapped into memory if the platform
+// supports it, otherwise it is read into a buffer.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    // Returns false if the file could not be opened
+    bool open(const std::string& path);
+
+    // Uses the given data instead of the contents of a file
+    void assign(std::vector<std::uint8_t> data);
+
+    void close();
+
+    const std::uint8_t* data() const;
+    std::size_t size() const;
+
+    // Returns true if the data is mapped from the file instead of being held in a buffer
+    bool is_mapped() const { return mapping_ != nullptr; }
+
+private:
+    void* mapping_ = nullptr;
+    std::size_t mapping_size_ = 0;
+    std::vector<std::uint8_t> buffer_;
+};
+
+} // namespace genesys
+
+#endif // BACKEND_GENESYS_MAPPED_FILE_H
@@ -461,6 +461,10 @@ public:
     friend void serialize(std::istream& str, RegisterSettingSet<V>& reg);
     template<class V>
     friend void serialize(std::ostream& str, RegisterSettingSet<V>& reg);
+    template<class V>
+    friend void serialize(BinaryInputStream& str, RegisterSettingSet<V>& reg);
+    template<class V>
+    friend void serialize(BinaryOutputStream& str, RegisterSettingSet<V>& reg);
 
     bool operator==(const RegisterSettingSet& other) const
     {
@@ -523,6 +527,22 @@ inline void serialize(std::ostream& str, RegisterSettingSet<Value>& reg)
     serialize(str, reg.registers_);
 }
 
+template<class Value>
+inline void serialize(BinaryInputStream& str, RegisterSettingSet<Value>& reg)
+{
+    using AddressType = typename RegisterSetting<Value>::AddressType;
+
+    reg.clear();
+    const std::size_t max_register_address = 1 << (sizeof(AddressType) * CHAR_BIT);
+    serialize(str, reg.registers_, max_register_address);
+}
+
+template<class Value>
+inline void serialize(BinaryOutputStream& str, RegisterSettingSet<Value>& reg)
+{
+    serialize(str, reg.registers_);
+}
+
 template<class F, class Value>
 void apply_registers_ordered(const RegisterSettingSet<Value>& set,
                              std::initializer_list<std::uint16_t> order, F f)
@@ -68,11 +68,21 @@ public:
         }
     }
 
+    bool has(std::uint16_t address) const
+    {
+        return regs_.has_reg(address);
+    }
+
     Value get(std::uint16_t address) const
     {
         return regs_.get(address);
     }
 
+    void clear()
+    {
+        regs_.clear();
+    }
+
 private:
     RegisterContainer<Value> regs_;
 
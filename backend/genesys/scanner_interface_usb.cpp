@@ -87,6 +87,7 @@ std::uint8_t ScannerInterfaceUsb::read_register(std::uint16_t address)
         DBG(DBG_io, "%s (0x%02x, 0x%02x) completed\n", __func__, address, value2x8[0]);
 
         value = value2x8[0];
+        cached_regs_.update(address, value);
 
     } else {
 
@@ -127,6 +128,13 @@ void ScannerInterfaceUsb::write_register(std::uint16_t address, std::uint8_t val
         usb_dev_.control_msg(REQUEST_TYPE_OUT, REQUEST_BUFFER, usb_value, INDEX,
                                   2, buffer);
 
+        if (address == 0x0e) {
+            // writes to this register reset the scanner, all register values become unknown
+            cached_regs_.clear();
+        } else {
+            cached_regs_.update(address, value);
+        }
+
     } else {
         if (address > 0xff) {
             throw SaneException("Invalid register address 0x%04x", address);
@@ -144,7 +152,92 @@ void ScannerInterfaceUsb::write_register(std::uint16_t address, std::uint8_t val
     DBG(DBG_io, "%s (0x%02x, 0x%02x) completed\n", __func__, address, value);
 }
 
+bool ScannerInterfaceUsb::should_skip_unchanged_registers() const
+{
+    // Only the ASICs that need a separate control message for each register benefit from this.
+    // The USB traffic must not depend on the cache state when recording or replaying it.
+    return (dev_->model->asic_type == AsicType::GL847 ||
+            dev_->model->asic_type == AsicType::GL845 ||
+            dev_->model->asic_type == AsicType::GL846 ||
+            dev_->model->asic_type == AsicType::GL124) &&
+            !sanei_usb_is_record_mode_enabled() &&
+            !sanei_usb_is_replay_mode_enabled();
+}
+
+bool is_volatile_register(AsicType asic_type, std::uint16_t address)
+{
+    switch (asic_type) {
+        case AsicType::GL845:
+        case AsicType::GL846:
+        case AsicType::GL847: {
+            switch (address) {
+                case 0x0d: // commands
+                case 0x0e:
+                case 0x0f:
+                case 0x3a: // frontend address and data ports
+                case 0x3b:
+                case 0x50:
+                case 0x51:
+                case 0x6c: // GPIO data, the inputs are driven by the hardware
+                case 0x6d:
+                    return true;
+                default:
+                    // status registers
+                    return address >= 0x40 && address <= 0x4f;
+            }
+        }
+        case AsicType::GL124: {
+            switch (address) {
+                case 0x0d: // commands
+                case 0x0e:
+                case 0x0f:
+                case 0x50: // frontend address and data ports
+                case 0x51:
+                case 0x5d:
+                case 0x5e:
+                    return true;
+                default:
+                    // GPIO data and status registers
+                    return (address >= 0x30 && address <= 0x38) ||
+                           (address >= 0x100 && address <= 0x10f);
+            }
+        }
+        default:
+            // the register values are not tracked on other ASICs
+            return true;
+    }
+}
+
+Genesys_Register_Set filter_unchanged_registers(AsicType asic_type,
+                                                const Genesys_Register_Set& regs,
+                                                const RegisterCache<std::uint8_t>& cached_regs)
+{
+    Genesys_Register_Set changed_regs(Genesys_Register_Set::SEQUENTIAL);
+    for (const auto& r : regs) {
+        if (is_volatile_register(asic_type, r.address) || !cached_regs.has(r.address) ||
+            cached_regs.get(r.address) != r.value)
+        {
+            changed_regs.init_reg(r.address, r.value);
+        }
+    }
+    return changed_regs;
+}
+
 void ScannerInterfaceUsb::write_registers(const Genesys_Register_Set& regs)
+{
+    if (!should_skip_unchanged_registers()) {
+        write_registers_unfiltered(regs);
+        return;
+    }
+
+    auto changed_regs = filter_unchanged_registers(dev_->model->asic_type, regs, cached_regs_);
+
+    DBG(DBG_io, "%s: skipping %zu unchanged registers\n", __func__,
+        regs.size() - changed_regs.size());
+    write_registers_unfiltered(changed_regs);
+}
+
+void ScannerInterfaceUsb::write_registers_unfiltered(const Genesys_Register_Set& regs)
 {
     DBG_HELPER(dbg);
     if (dev_->model->asic_type == AsicType::GL646 ||
@@ -446,7 +539,7 @@ std::uint16_t ScannerInterfaceUsb::read_fe_register(std::uint8_t address)
     reg.init_reg(0x50, address);
 
     // set up read address
-    write_registers(reg);
+    write_registers_unfiltered(reg);
 
     // read data
     std::uint16_t value = read_register(0x46) << 8;
@@ -470,7 +563,7 @@ void ScannerInterfaceUsb::write_fe_register(std::uint8_t address, std::uint16_t
         reg.init_reg(0x3b, value & 0xff);
     }
 
-    write_registers(reg);
+    write_registers_unfiltered(reg);
 }
 
 IUsbDevice& ScannerInterfaceUsb::get_usb_device()
@@ -44,6 +44,8 @@
 #ifndef BACKEND_GENESYS_SCANNER_INTERFACE_USB_H
 #define BACKEND_GENESYS_SCANNER_INTERFACE_USB_H
 
+#include "enums.h"
+#include "register_cache.h"
 #include "scanner_interface.h"
 #include "usb_device.h"
 
@@ -89,10 +91,26 @@ public:
     void test_checkpoint(const std::string& name) override;
 
 private:
+    // Whether write_registers() writes only registers with changed values
+    bool should_skip_unchanged_registers() const;
+
+    void write_registers_unfiltered(const Genesys_Register_Set& regs);
+
     Genesys_Device* dev_;
     UsbDevice usb_dev_;
+
+    // The last known values of the scanner registers
+    RegisterCache<std::uint8_t> cached_regs_;
 };
 
+// Whether writing the given register has side effects or the scanner itself may change its value
+bool is_volatile_register(AsicType asic_type, std::uint16_t address);
+
+// Returns the subset of regs that needs to be written given the last known register values
+Genesys_Register_Set filter_unchanged_registers(AsicType asic_type,
+                                                const Genesys_Register_Set& regs,
+                                                const RegisterCache<std::uint8_t>& cached_regs);
+
 } // namespace genesys
 
 #endif
@@ -0,0 +1,102 @@
+/* sane - Scanner Access Now Easy.
+
+   Copyright (C) 2020 Povilas Kanapickas <povilas@radix.lt>
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "select_notifier.h"
+#include "error.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace genesys {
+
+SelectNotifier::~SelectNotifier()
+{
+    close();
+}
+
+void SelectNotifier::open()
+{
+    if (is_open()) {
+        return;
+    }
+
+    int fds[2];
+    if (pipe(fds) < 0) {
+        throw SaneException(SANE_STATUS_IO_ERROR, "could not create pipe: %s",
+                            std::strerror(errno));
+    }
+
+    for (auto fd : fds) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            ::close(fds[0]);
+            ::close(fds[1]);
+            throw SaneException(SANE_STATUS_IO_ERROR, "could not make pipe non-blocking: %s",
+                                std::strerror(errno));
+        }
+    }
+
+    read_fd_ = fds[0];
+    write_fd_ = fds[1];
+}
+
+void SelectNotifier::close()
+{
+    if (!is_open()) {
+        return;
+    }
+    ::close(read_fd_);
+    ::close(write_fd_);
+    read_fd_ = -1;
+    write_fd_ = -1;
+}
+
+void SelectNotifier::signal()
+{
+    if (!is_open()) {
+        return;
+    }
+    // a full pipe is readable already, thus failure due to EAGAIN can be ignored
+    char byte = 0;
+    while (write(write_fd_, &byte, 1) < 0 && errno == EINTR) {}
+}
+
+void SelectNotifier::reset()
+{
+    if (!is_open()) {
+        return;
+    }
+    char buf[64];
+    while (true) {
+        auto ret = read(read_fd_, buf, sizeof(buf));
+        if (ret > 0 || (ret < 0 && errno == EINTR)) {
+            continue;
+        }
+        break;
+    }
+}
+
+} // namespace genesys
@@ -0,0 +1,60 @@
+/* sane - Scanner Access Now Easy.
+
+   Copyright (C) 2020 Povilas Kanapickas <povilas@radix.lt>
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+*/
+
+#ifndef BACKEND_GENESYS_SELECT_NOTIFIER_H
+#define BACKEND_GENESYS_SELECT_NOTIFIER_H
+
+namespace genesys {
+
+// Wraps a pipe whose read end is readable whenever the notifier is signalled. The read end is
+// suitable to be returned from sane_get_select_fd().
+class SelectNotifier
+{
+public:
+    SelectNotifier() = default;
+    SelectNotifier(const SelectNotifier&) = delete;
+    SelectNotifier& operator=(const SelectNotifier&) = delete;
+    ~SelectNotifier();
+
+    // creates the pipe unless it has already been created
+    void open();
+    void close();
+
+    bool is_open() const { return read_fd_ != -1; }
+
+    // returns the file descriptor that is readable whenever the notifier is signalled
+    int get_fd() const { return read_fd_; }
+
+    // Makes the file descriptor readable. May be called from any thread.
+    void signal();
+
+    // Makes the file descriptor not readable until the next call to signal().
+    void reset();
+
+private:
+    int read_fd_ = -1;
+    int write_fd_ = -1;
+};
+
+} // namespace genesys
+
+#endif // BACKEND_GENESYS_SELECT_NOTIFIER_H
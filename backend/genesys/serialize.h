@@ -46,9 +46,11 @@
 
 #include "error.h"
 #include <array>
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace genesys {
@@ -145,6 +147,145 @@ void serialize(std::istream& str, std::array<T, Size>& x)
     }
 }
 
+/*  The binary serialization format stores values in the native representation of the host. The
+    data is meant to be read back on the same machine, possibly by accessing it directly after the
+    file has been mapped into memory.
+*/
+class BinaryOutputStream
+{
+public:
+    explicit BinaryOutputStream(std::vector<std::uint8_t>& data) : data_(data) {}
+
+    void write(const void* data, std::size_t size);
+
+    // Pads the data with zeros so that its size is a multiple of alignment
+    void align(std::size_t alignment);
+
+    std::size_t offset() const { return data_.size(); }
+
+private:
+    std::vector<std::uint8_t>& data_;
+};
+
+class BinaryInputStream
+{
+public:
+    BinaryInputStream(const std::uint8_t* data, std::size_t size) : data_{data}, size_{size} {}
+
+    // Throws an exception if there's not enough data to read
+    void read(void* data, std::size_t size);
+
+    std::size_t offset() const { return offset_; }
+    std::size_t remaining() const { return size_ - offset_; }
+
+private:
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t offset_ = 0;
+};
+
+inline void serialize_newline(BinaryOutputStream& str) { (void) str; }
+inline void serialize_newline(BinaryInputStream& str) { (void) str; }
+
+template<class T>
+typename std::enable_if<std::is_arithmetic<T>::value>::type
+    serialize(BinaryOutputStream& str, T x)
+{
+    str.write(&x, sizeof(x));
+}
+
+template<class T>
+typename std::enable_if<std::is_arithmetic<T>::value>::type
+    serialize(BinaryInputStream& str, T& x)
+{
+    str.read(&x, sizeof(x));
+}
+
+template<class T>
+typename std::enable_if<std::is_enum<T>::value>::type
+    serialize(BinaryOutputStream& str, T& x)
+{
+    auto value = static_cast<std::uint32_t>(x);
+    serialize(str, value);
+}
+
+template<class T>
+typename std::enable_if<std::is_enum<T>::value>::type
+    serialize(BinaryInputStream& str, T& x)
+{
+    std::uint32_t value = 0;
+    serialize(str, value);
+    x = static_cast<T>(value);
+}
+
+inline void serialize(BinaryOutputStream& str, const std::string& x)
+{
+    serialize(str, static_cast<std::uint64_t>(x.size()));
+    str.write(x.data(), x.size());
+}
+
+inline void serialize(BinaryInputStream& str, std::string& x)
+{
+    std::uint64_t size = 0;
+    serialize(str, size);
+    if (size > str.remaining()) {
+        throw SaneException("Too large std::string to deserialize");
+    }
+    x.resize(size);
+    str.read(&x[0], size);
+}
+
+template<class T>
+void serialize(BinaryOutputStream& str, std::vector<T>& x)
+{
+    serialize(str, static_cast<std::uint64_t>(x.size()));
+    if (std::is_arithmetic<T>::value) {
+        str.write(x.data(), x.size() * sizeof(T));
+        return;
+    }
+    for (auto& item : x) {
+        serialize(str, item);
+    }
+}
+
+template<class T>
+void serialize(BinaryInputStream& str, std::vector<T>& x,
+               size_t max_size = std::numeric_limits<size_t>::max())
+{
+    std::uint64_t new_size = 0;
+    serialize(str, new_size);
+
+    // each item occupies at least one byte
+    if (new_size > max_size || new_size > str.remaining()) {
+        throw SaneException("Too large std::vector to deserialize");
+    }
+    x.clear();
+    x.resize(new_size);
+    if (std::is_arithmetic<T>::value) {
+        str.read(x.data(), x.size() * sizeof(T));
+        return;
+    }
+    for (auto& item : x) {
+        serialize(str, item);
+    }
+}
+
+template<class T, size_t Size>
+void serialize(BinaryOutputStream& str, std::array<T, Size>& x)
+{
+    for (auto& item : x) {
+        serialize(str, item);
+    }
+}
+
+template<class T, size_t Size>
+void serialize(BinaryInputStream& str, std::array<T, Size>& x)
+{
+    for (auto& item : x) {
+        serialize(str, item);
+    }
+}
+
 } // namespace genesys
 
 #endif
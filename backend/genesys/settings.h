@@ -96,6 +96,25 @@ struct Genesys_Settings
             return 3;
         return 1;
     }
+
+    bool operator==(const Genesys_Settings& other) const
+    {
+        return scan_method == other.scan_method &&
+            scan_mode == other.scan_mode &&
+            xres == other.xres &&
+            yres == other.yres &&
+            tl_x == other.tl_x &&
+            tl_y == other.tl_y &&
+            lines == other.lines &&
+            pixels == other.pixels &&
+            requested_pixels == other.requested_pixels &&
+            depth == other.depth &&
+            color_filter == other.color_filter &&
+            true_gray == other.true_gray &&
+            contrast == other.contrast &&
+            brightness == other.brightness &&
+            expiration_time == other.expiration_time;
+    }
 };
 
 std::ostream& operator<<(std::ostream& out, const Genesys_Settings& settings);
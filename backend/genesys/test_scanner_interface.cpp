@@ -130,7 +130,11 @@ void TestScannerInterface::write_0x8c(std::uint8_t index, std::uint8_t value)
 void TestScannerInterface::bulk_read_data(std::uint8_t addr, std::uint8_t* data, std::size_t size)
 {
     (void) addr;
-    std::memset(data, 0, size);
+    if (bulk_read_callback_) {
+        bulk_read_callback_(data, size);
+    } else {
+        std::memset(data, 0, size);
+    }
 }
 
 void TestScannerInterface::bulk_write_data(std::uint8_t addr, std::uint8_t* data, std::size_t size)
@@ -228,4 +232,9 @@ void TestScannerInterface::set_checkpoint_callback(TestCheckpointCallback callba
     checkpoint_callback_ = callback;
 }
 
+void TestScannerInterface::set_bulk_read_callback(TestBulkReadCallback callback)
+{
+    bulk_read_callback_ = callback;
+}
+
 } // namespace genesys
@@ -103,6 +103,8 @@ public:
 
     void set_checkpoint_callback(TestCheckpointCallback callback);
 
+    void set_bulk_read_callback(TestBulkReadCallback callback);
+
 private:
     Genesys_Device* dev_;
 
@@ -111,6 +113,7 @@ private:
     TestUsbDevice usb_dev_;
 
     TestCheckpointCallback checkpoint_callback_;
+    TestBulkReadCallback bulk_read_callback_;
 
     std::map<unsigned, std::vector<std::uint16_t>> slope_tables_;
 
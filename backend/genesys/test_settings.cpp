@@ -54,6 +54,7 @@ std::uint16_t s_vendor_id = 0;
 std::uint16_t s_product_id = 0;
 std::uint16_t s_bcd_device = 0;
 TestCheckpointCallback s_checkpoint_callback;
+TestBulkReadCallback s_bulk_read_callback;
 
 } // namespace
 
@@ -68,6 +69,7 @@ void disable_testing_mode()
     s_vendor_id = 0;
     s_product_id = 0;
     s_bcd_device = 0;
+    s_bulk_read_callback = nullptr;
 }
 
 void enable_testing_mode(std::uint16_t vendor_id, std::uint16_t product_id,
@@ -111,4 +113,14 @@ TestCheckpointCallback get_testing_checkpoint_callback()
     return s_checkpoint_callback;
 }
 
+void set_testing_bulk_read_callback(TestBulkReadCallback bulk_read_callback)
+{
+    s_bulk_read_callback = bulk_read_callback;
+}
+
+TestBulkReadCallback get_testing_bulk_read_callback()
+{
+    return s_bulk_read_callback;
+}
+
 } // namespace genesys
@@ -55,6 +55,10 @@ using TestCheckpointCallback = std::function<void(const Genesys_Device&,
                                                   TestScannerInterface&,
                                                   const std::string&)>;
 
+// Fills the data returned by bulk reads of the test scanner interface. By default the data is
+// all zeros.
+using TestBulkReadCallback = std::function<void(std::uint8_t*, std::size_t)>;
+
 bool is_testing_mode();
 void disable_testing_mode();
 void enable_testing_mode(std::uint16_t vendor_id, std::uint16_t product_id,
@@ -65,6 +69,8 @@ std::uint16_t get_testing_product_id();
 std::uint16_t get_testing_bcd_device();
 std::string get_testing_device_name();
 TestCheckpointCallback get_testing_checkpoint_callback();
+void set_testing_bulk_read_callback(TestBulkReadCallback bulk_read_callback);
+TestBulkReadCallback get_testing_bulk_read_callback();
 
 
 } // namespace genesys
@@ -0,0 +1,196 @@
+/* sane - Scanner Access Now Easy.
+
+   Copyright (C) 2020 Povilas Kanapickas <povilas@radix.lt>
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+*/
+
+
+#define DEBUG_DECLARE_ONLY
+
+#include "utilities.h"
+#include <array>
+#include <system_error>
+#include <thread>
+
+namespace genesys {
+
+namespace {
+
+// The number of columns that are transposed into the scratch buffer at once
+constexpr std::size_t PERCENTILE_TILE_COLUMNS = 64;
+
+// For smaller columns std::nth_element is faster than the histogram based selection
+constexpr std::size_t PERCENTILE_MIN_HISTOGRAM_LINES = 64;
+
+// The minimum number of elements to process in each thread
+constexpr std::size_t PERCENTILE_MIN_ELEMENTS_PER_THREAD = 256 * 1024;
+constexpr std::size_t PERCENTILE_MAX_THREADS = 8;
+
+// Returns the select_elem-th smallest value. The high byte of the result is found first and then
+// the low byte among the values that have that high byte.
+std::uint16_t select_using_histogram(const std::uint16_t* values, std::size_t count,
+                                     std::size_t select_elem)
+{
+    std::array<std::size_t, 256> histogram;
+
+    histogram.fill(0);
+    for (std::size_t i = 0; i < count; ++i) {
+        histogram[values[i] >> 8]++;
+    }
+
+    unsigned high = 0;
+    while (select_elem >= histogram[high]) {
+        select_elem -= histogram[high];
+        high++;
+    }
+
+    histogram.fill(0);
+    for (std::size_t i = 0; i < count; ++i) {
+        if ((values[i] >> 8) == high) {
+            histogram[values[i] & 0xff]++;
+        }
+    }
+
+    unsigned low = 0;
+    while (select_elem >= histogram[low]) {
+        select_elem -= histogram[low];
+        low++;
+    }
+
+    return static_cast<std::uint16_t>((high << 8) | low);
+}
+
+void compute_percentile_for_columns(std::uint16_t* result, const std::uint16_t* data,
+                                    std::size_t line_count, std::size_t elements_per_line,
+                                    std::size_t select_elem,
+                                    std::size_t begin_x, std::size_t end_x,
+                                    std::uint16_t* scratch)
+{
+    for (std::size_t tile_x = begin_x; tile_x < end_x; tile_x += PERCENTILE_TILE_COLUMNS) {
+        std::size_t tile_width = std::min(PERCENTILE_TILE_COLUMNS, end_x - tile_x);
+
+        // transpose the tile so that the elements of each column are contiguous
+        for (std::size_t iy = 0; iy < line_count; ++iy) {
+            const auto* line = data + iy * elements_per_line + tile_x;
+            for (std::size_t ix = 0; ix < tile_width; ++ix) {
+                scratch[ix * line_count + iy] = line[ix];
+            }
+        }
+
+        for (std::size_t ix = 0; ix < tile_width; ++ix) {
+            auto* column = scratch + ix * line_count;
+            if (line_count < PERCENTILE_MIN_HISTOGRAM_LINES) {
+                std::nth_element(column, column + select_elem, column + line_count);
+                result[tile_x + ix] = column[select_elem];
+            } else {
+                result[tile_x + ix] = select_using_histogram(column, line_count, select_elem);
+            }
+        }
+    }
+}
+
+std::size_t get_percentile_thread_count(std::size_t line_count, std::size_t elements_per_line)
+{
+    std::size_t thread_count = std::min<std::size_t>(std::thread::hardware_concurrency(),
+                                                     PERCENTILE_MAX_THREADS);
+    thread_count = std::min(thread_count,
+                            line_count * elements_per_line / PERCENTILE_MIN_ELEMENTS_PER_THREAD);
+    thread_count = std::min(thread_count, elements_per_line / PERCENTILE_TILE_COLUMNS);
+    return std::max<std::size_t>(thread_count, 1);
+}
+
+} // namespace
+
+void compute_array_percentile_approx(std::uint16_t* result, const std::uint16_t* data,
+                                     std::size_t line_count, std::size_t elements_per_line,
+                                     float percentile)
+{
+    if (line_count == 0) {
+        throw SaneException("invalid line count");
+    }
+
+    if (line_count == 1) {
+        std::copy(data, data + elements_per_line, result);
+        return;
+    }
+
+    std::size_t select_elem = std::min(static_cast<std::size_t>(line_count * percentile),
+                                       line_count - 1);
+
+    std::size_t thread_count = get_percentile_thread_count(line_count, elements_per_line);
+
+    // each thread processes a range of columns that is a multiple of the tile size
+    std::size_t tile_count = (elements_per_line + PERCENTILE_TILE_COLUMNS - 1) /
+            PERCENTILE_TILE_COLUMNS;
+    std::size_t columns_per_thread = ((tile_count + thread_count - 1) / thread_count) *
+            PERCENTILE_TILE_COLUMNS;
+
+    std::vector<std::uint16_t> scratch(thread_count * PERCENTILE_TILE_COLUMNS * line_count);
+
+    auto process_chunk = [&](std::size_t chunk)
+    {
+        std::size_t begin_x = std::min(chunk * columns_per_thread, elements_per_line);
+        std::size_t end_x = std::min(begin_x + columns_per_thread, elements_per_line);
+        compute_percentile_for_columns(result, data, line_count, elements_per_line, select_elem,
+                                       begin_x, end_x,
+                                       scratch.data() + chunk * PERCENTILE_TILE_COLUMNS *
+                                           line_count);
+    };
+
+    std::vector<std::thread> threads;
+    try {
+        for (std::size_t chunk = 1; chunk < thread_count; ++chunk) {
+            threads.emplace_back(process_chunk, chunk);
+        }
+    } catch (const std::system_error&) {
+        // the chunks without a thread are processed below
+    }
+
+    process_chunk(0);
+    for (std::size_t chunk = threads.size() + 1; chunk < thread_count; ++chunk) {
+        process_chunk(chunk);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace genesys
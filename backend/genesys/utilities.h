@@ -121,6 +121,15 @@ inline T clamp(const T& value, const T& lo, const T& hi)
     return value;
 }
 
+/*  Computes the given percentile of each column of an array consisting of line_count lines of
+    elements_per_line elements. The 16-bit variant is used for the shading calibration data: it
+    processes the data in tiles of columns so that the memory is accessed sequentially, uses a
+    histogram based selection and splits the columns across multiple threads.
+*/
+void compute_array_percentile_approx(std::uint16_t* result, const std::uint16_t* data,
+                                     std::size_t line_count, std::size_t elements_per_line,
+                                     float percentile);
+
 template<class T>
 void compute_array_percentile_approx(T* result, const T* data,
                                      std::size_t line_count, std::size_t elements_per_line,
@@ -64,6 +64,14 @@
 #include <sys/time.h>
 #include <sys/types.h>
 
+#ifdef HAVE_LIBZ
+# include <zlib.h>
+#endif
+
+#if defined (HAVE_SYS_POLL_H) && defined (HAVE_POLL)
+# include <sys/poll.h>
+#endif
+
 #include <netinet/in.h>
 #include <netdb.h> /* OS/2 needs this _after_ <netinet/in.h>, grrr... */
 
@@ -114,6 +122,11 @@ static AvahiServiceBrowser *avahi_browser = NULL;
 # define NET_VERSION "1.0.14"
 #endif /* HAVE_GETADDRINFO && HAVE_GETNAMEINFO */
 
+/* connect to all hosts at once when building the device list */
+#if defined (NET_USES_AF_INDEP) && defined (HAVE_SYS_POLL_H) && defined (HAVE_POLL)
+# define NET_PARALLEL_CONNECT
+#endif
+
 static SANE_Auth_Callback auth_callback;
 static Net_Device *first_device;
 static Net_Scanner *first_handle;
@@ -122,6 +135,8 @@ static int client_big_endian; /* 1 == big endian; 0 == little endian */
 static int server_big_endian; /* 1 == big endian; 0 == little endian */
 static int depth; /* bits per pixel */
 static int connect_timeout = -1; /* timeout for connection to saned */
+static int use_compression = 0; /* request compressed image data from saned */
+static int device_list_ttl = 0; /* seconds to reuse the device list of a host */
 
 #ifndef NET_USES_AF_INDEP
 static int saned_port;
@@ -314,23 +329,141 @@ add_device (const char *name, Net_Device ** ndp)
 #endif /* NET_USES_AF_INDEP */
 
 
-#ifdef NET_USES_AF_INDEP
+/* Set up a freshly connected control connection and exchange version
+   codes with the server.  Closes the connection on failure.  */
 static SANE_Status
-connect_dev (Net_Device * dev)
+init_connection (Net_Device * dev)
 {
-  struct addrinfo *addrp;
-
   SANE_Word version_code;
+  SANE_Word protocol_version;
   SANE_Init_Reply reply;
   SANE_Status status = SANE_STATUS_IO_ERROR;
   SANE_Init_Req req;
-  SANE_Bool connected = SANE_FALSE;
 #ifdef TCP_NODELAY
   int on = 1;
   int level = -1;
 #endif
   struct timeval tv;
 
+  /* We're connected now, so reset SO_SNDTIMEO to the default value of 0 */
+  if (connect_timeout > 0)
+    {
+      tv.tv_sec = 0;
+      tv.tv_usec = 0;
+
+      if (setsockopt (dev->ctl, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
+	{
+	  DBG (1, "connect_dev: failed to reset SO_SNDTIMEO (%s)\n", strerror (errno));
+	}
+    }
+
+#ifdef TCP_NODELAY
+# ifdef SOL_TCP
+  level = SOL_TCP;
+# else /* !SOL_TCP */
+  /* Look up the protocol level in the protocols database. */
+  {
+    struct protoent *p;
+    p = getprotobyname ("tcp");
+    if (p == 0)
+      DBG (1, "connect_dev: cannot look up `tcp' protocol number");
+    else
+      level = p->p_proto;
+  }
+# endif	/* SOL_TCP */
+
+  if (level == -1 ||
+      setsockopt (dev->ctl, level, TCP_NODELAY, &on, sizeof (on)))
+    DBG (1, "connect_dev: failed to put send socket in TCP_NODELAY mode (%s)",
+	 strerror (errno));
+#endif /* !TCP_NODELAY */
+
+  DBG (2, "connect_dev: sanei_w_init\n");
+  sanei_w_init (&dev->wire, sanei_codec_bin_init);
+  dev->wire.io.fd = dev->ctl;
+  dev->wire.io.read = read;
+  dev->wire.io.write = write;
+
+  /* exchange version codes with the server: */
+  req.version_code = SANE_VERSION_CODE (V_MAJOR, V_MINOR,
+					SANEI_NET_PROTOCOL_VERSION);
+#ifdef HAVE_LIBZ
+  if (use_compression)
+    req.version_code |= SANEI_NET_FEATURE_COMPRESSION;
+#endif /* HAVE_LIBZ */
+  req.version_code |= SANEI_NET_FEATURE_OPTION_BATCH;
+  req.username = getlogin ();
+  DBG (2, "connect_dev: net_init (user=%s, local version=%d.%d.%d)\n",
+       req.username, V_MAJOR, V_MINOR, SANEI_NET_PROTOCOL_VERSION);
+  sanei_w_call (&dev->wire, SANE_NET_INIT,
+		(WireCodecFunc) sanei_w_init_req, &req,
+		(WireCodecFunc) sanei_w_init_reply, &reply);
+
+  if (dev->wire.status != 0)
+    {
+      DBG (1, "connect_dev: argument marshalling error (%s)\n",
+	   strerror (dev->wire.status));
+      status = SANE_STATUS_IO_ERROR;
+      goto fail;
+    }
+
+  status = reply.status;
+  version_code = reply.version_code;
+  DBG (2, "connect_dev: freeing init reply (status=%s, remote "
+       "version=%d.%d.%d)\n", sane_strstatus (status),
+       SANE_VERSION_MAJOR (version_code),
+       SANE_VERSION_MINOR (version_code), SANE_VERSION_BUILD (version_code));
+  sanei_w_free (&dev->wire, (WireCodecFunc) sanei_w_init_reply, &reply);
+
+  if (status != 0)
+    {
+      DBG (1, "connect_dev: access to %s denied\n", dev->name);
+      goto fail;
+    }
+  if (SANE_VERSION_MAJOR (version_code) != V_MAJOR)
+    {
+      DBG (1, "connect_dev: major version mismatch: got %d, expected %d\n",
+	   SANE_VERSION_MAJOR (version_code), V_MAJOR);
+      status = SANE_STATUS_IO_ERROR;
+      goto fail;
+    }
+  protocol_version = SANE_VERSION_BUILD (version_code)
+    & SANEI_NET_PROTOCOL_VERSION_MASK;
+  if (protocol_version != SANEI_NET_PROTOCOL_VERSION && protocol_version != 2)
+    {
+      DBG (1, "connect_dev: network protocol version mismatch: "
+	   "got %d, expected %d\n",
+	   protocol_version, SANEI_NET_PROTOCOL_VERSION);
+      status = SANE_STATUS_IO_ERROR;
+      goto fail;
+    }
+  dev->wire.version = protocol_version;
+  dev->compression =
+    (SANE_VERSION_BUILD (version_code) & SANEI_NET_FEATURE_COMPRESSION) != 0;
+  if (dev->compression)
+    DBG (2, "connect_dev: server enabled compression\n");
+  dev->option_batch =
+    (SANE_VERSION_BUILD (version_code) & SANEI_NET_FEATURE_OPTION_BATCH) != 0;
+  if (dev->option_batch)
+    DBG (2, "connect_dev: server supports option batches\n");
+  DBG (4, "connect_dev: done\n");
+  return SANE_STATUS_GOOD;
+
+fail:
+  DBG (2, "connect_dev: closing connection to %s\n", dev->name);
+  close (dev->ctl);
+  dev->ctl = -1;
+  return status;
+}
+
+#ifdef NET_USES_AF_INDEP
+static SANE_Status
+connect_dev (Net_Device * dev)
+{
+  struct addrinfo *addrp;
+  SANE_Bool connected = SANE_FALSE;
+  struct timeval tv;
+
   int i;
 
   DBG (2, "connect_dev: trying to connect to %s\n", dev->name);
@@ -392,14 +525,6 @@ static SANE_Status
 connect_dev (Net_Device * dev)
 {
   struct sockaddr_in *sin;
-  SANE_Word version_code;
-  SANE_Init_Reply reply;
-  SANE_Status status = SANE_STATUS_IO_ERROR;
-  SANE_Init_Req req;
-#ifdef TCP_NODELAY
-  int on = 1;
-  int level = -1;
-#endif
   struct timeval tv;
 
   DBG (2, "connect_dev: trying to connect to %s\n", dev->name);
@@ -444,110 +569,350 @@ connect_dev (Net_Device * dev)
   DBG (3, "connect_dev: connection succeeded\n");
 #endif /* NET_USES_AF_INDEP */
 
-  /* We're connected now, so reset SO_SNDTIMEO to the default value of 0 */
-  if (connect_timeout > 0)
+  return init_connection (dev);
+}
+
+#ifdef NET_PARALLEL_CONNECT
+/* Start a non-blocking connect to the next usable address of DEV, starting
+   at *ADDRP.  Returns the socket or -1 if no address is left.  Sets
+   *DONE if the connection was established immediately.  */
+static int
+start_connect (Net_Device * dev, struct addrinfo ** addrp,
+	       struct addrinfo ** used, int *done)
+{
+  struct addrinfo *a;
+  int fd;
+
+  while ((a = *addrp) != NULL)
     {
-      tv.tv_sec = 0;
-      tv.tv_usec = 0;
+      *addrp = a->ai_next;
+# ifdef ENABLE_IPV6
+      if ((a->ai_family != AF_INET) && (a->ai_family != AF_INET6))
+# else /* !ENABLE_IPV6 */
+      if (a->ai_family != AF_INET)
+# endif /* ENABLE_IPV6 */
+	continue;
 
-      if (setsockopt (dev->ctl, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
+      fd = socket (a->ai_family, SOCK_STREAM, 0);
+      if (fd < 0)
 	{
-	  DBG (1, "connect_dev: failed to reset SO_SNDTIMEO (%s)\n", strerror (errno));
+	  DBG (1, "connect_devs: %s: failed to obtain socket (%s)\n",
+	       dev->name, strerror (errno));
+	  continue;
+	}
+      if (fcntl (fd, F_SETFL, O_NONBLOCK) < 0)
+	{
+	  DBG (1, "connect_devs: %s: failed to set non-blocking mode (%s)\n",
+	       dev->name, strerror (errno));
+	  close (fd);
+	  continue;
+	}
+
+      *used = a;
+      if (connect (fd, a->ai_addr, a->ai_addrlen) == 0)
+	{
+	  *done = 1;
+	  return fd;
 	}
+      if (errno == EINPROGRESS)
+	{
+	  *done = 0;
+	  return fd;
+	}
+      DBG (1, "connect_devs: %s: failed to connect (%s)\n",
+	   dev->name, strerror (errno));
+      close (fd);
     }
+  return -1;
+}
 
-#ifdef TCP_NODELAY
-# ifdef SOL_TCP
-  level = SOL_TCP;
-# else /* !SOL_TCP */
-  /* Look up the protocol level in the protocols database. */
-  {
-    struct protoent *p;
-    p = getprotobyname ("tcp");
-    if (p == 0)
-      DBG (1, "connect_dev: cannot look up `tcp' protocol number");
-    else
-      level = p->p_proto;
-  }
-# endif	/* SOL_TCP */
+/* Milliseconds left of the connection attempt that started at STARTED */
+static int
+attempt_left (const struct timeval *started, const struct timeval *now)
+{
+  int left;
 
-  if (level == -1 ||
-      setsockopt (dev->ctl, level, TCP_NODELAY, &on, sizeof (on)))
-    DBG (1, "connect_dev: failed to put send socket in TCP_NODELAY mode (%s)",
-	 strerror (errno));
-#endif /* !TCP_NODELAY */
+  left = (started->tv_sec + connect_timeout - now->tv_sec) * 1000
+    + (started->tv_usec - now->tv_usec) / 1000;
+  return left > 0 ? left : 0;
+}
 
-  DBG (2, "connect_dev: sanei_w_init\n");
-  sanei_w_init (&dev->wire, sanei_codec_bin_init);
-  dev->wire.io.fd = dev->ctl;
-  dev->wire.io.read = read;
-  dev->wire.io.write = write;
+/* Connect to all of the NUM_DEVS hosts in DEVS that aren't connected yet,
+   in parallel.  Like in connect_dev(), every address of a host gets
+   connect_timeout seconds before the next one is tried, but the waiting
+   for unreachable hosts doesn't add up.  */
+static void
+connect_devs (Net_Device ** devs, int num_devs)
+{
+  struct pollfd *fds;
+  struct addrinfo **next, **used;
+  struct timeval now, *started;
+  socklen_t len;
+  int i, n, err, done, pending = 0, timeout, left;
 
-  /* exchange version codes with the server: */
-  req.version_code = SANE_VERSION_CODE (V_MAJOR, V_MINOR,
-					SANEI_NET_PROTOCOL_VERSION);
-  req.username = getlogin ();
-  DBG (2, "connect_dev: net_init (user=%s, local version=%d.%d.%d)\n",
-       req.username, V_MAJOR, V_MINOR, SANEI_NET_PROTOCOL_VERSION);
-  sanei_w_call (&dev->wire, SANE_NET_INIT,
-		(WireCodecFunc) sanei_w_init_req, &req,
-		(WireCodecFunc) sanei_w_init_reply, &reply);
+  fds = calloc (num_devs + 1, sizeof (fds[0]));
+  next = calloc (num_devs + 1, sizeof (next[0]));
+  used = calloc (num_devs + 1, sizeof (used[0]));
+  started = calloc (num_devs + 1, sizeof (started[0]));
+  if (!fds || !next || !used || !started)
+    {
+      DBG (1, "connect_devs: not enough memory, connecting one by one\n");
+      for (i = 0; i < num_devs; ++i)
+	if (devs[i]->ctl < 0 && connect_dev (devs[i]) != SANE_STATUS_GOOD)
+	  DBG (1, "connect_devs: failed to connect to %s\n", devs[i]->name);
+      free (fds);
+      free (next);
+      free (used);
+      free (started);
+      return;
+    }
+
+  gettimeofday (&now, NULL);
+
+  for (i = 0; i < num_devs; ++i)
+    {
+      fds[i].fd = -1;
+      fds[i].events = POLLOUT;
+      if (devs[i]->ctl >= 0)
+	continue;
+      DBG (2, "connect_devs: trying to connect to %s\n", devs[i]->name);
+      next[i] = devs[i]->addr;
+      fds[i].fd = start_connect (devs[i], &next[i], &used[i], &done);
+      started[i] = now;
+      if (fds[i].fd >= 0 && done)
+	{
+	  devs[i]->ctl = fds[i].fd;
+	  fds[i].fd = -1;
+	}
+      else if (fds[i].fd >= 0)
+	++pending;
+    }
 
-  if (dev->wire.status != 0)
+  while (pending > 0)
     {
-      DBG (1, "connect_dev: argument marshalling error (%s)\n",
-	   strerror (dev->wire.status));
-      status = SANE_STATUS_IO_ERROR;
-      goto fail;
+      /* wait until the first of the pending attempts times out */
+      timeout = -1;
+      if (connect_timeout > 0)
+	{
+	  gettimeofday (&now, NULL);
+	  for (i = 0; i < num_devs; ++i)
+	    {
+	      if (fds[i].fd < 0)
+		continue;
+	      left = attempt_left (&started[i], &now);
+	      if (timeout < 0 || left < timeout)
+		timeout = left;
+	    }
+	}
+
+      n = poll (fds, num_devs, timeout);
+      if (n < 0 && errno == EINTR)
+	continue;
+      if (n < 0)
+	{
+	  DBG (1, "connect_devs: poll failed (%s)\n", strerror (errno));
+	  break;
+	}
+
+      gettimeofday (&now, NULL);
+      for (i = 0; i < num_devs; ++i)
+	{
+	  if (fds[i].fd < 0)
+	    continue;
+
+	  if (fds[i].revents)
+	    {
+	      err = 0;
+	      len = sizeof (err);
+	      if (getsockopt (fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+		err = errno;
+	      if (err == 0)
+		{
+		  devs[i]->ctl = fds[i].fd;
+		  fds[i].fd = -1;
+		  --pending;
+		  continue;
+		}
+	      DBG (1, "connect_devs: %s: failed to connect (%s)\n",
+		   devs[i]->name, strerror (err));
+	    }
+	  else if (connect_timeout <= 0 || attempt_left (&started[i], &now) > 0)
+	    continue;
+	  else
+	    DBG (1, "connect_devs: %s: connection timed out\n", devs[i]->name);
+
+	  /* try the next address of the host */
+	  close (fds[i].fd);
+	  fds[i].fd = start_connect (devs[i], &next[i], &used[i], &done);
+	  started[i] = now;
+	  if (fds[i].fd < 0)
+	    --pending;
+	  else if (done)
+	    {
+	      devs[i]->ctl = fds[i].fd;
+	      fds[i].fd = -1;
+	      --pending;
+	    }
+	}
     }
 
-  status = reply.status;
-  version_code = reply.version_code;
-  DBG (2, "connect_dev: freeing init reply (status=%s, remote "
-       "version=%d.%d.%d)\n", sane_strstatus (status),
-       SANE_VERSION_MAJOR (version_code),
-       SANE_VERSION_MINOR (version_code), SANE_VERSION_BUILD (version_code));
-  sanei_w_free (&dev->wire, (WireCodecFunc) sanei_w_init_reply, &reply);
+  for (i = 0; i < num_devs; ++i)
+    {
+      if (fds[i].fd >= 0)
+	close (fds[i].fd);
+      if (!used[i] || devs[i]->ctl < 0)
+	continue;
 
-  if (status != 0)
+      /* connected in this call: back to blocking mode and say hello */
+      fcntl (devs[i]->ctl, F_SETFL, 0);
+      devs[i]->addr_used = used[i];
+      DBG (3, "connect_devs: connected to %s (%s)\n", devs[i]->name,
+	   (used[i]->ai_family == AF_INET6) ? "IPv6" : "IPv4");
+      if (init_connection (devs[i]) != SANE_STATUS_GOOD)
+	DBG (1, "connect_devs: failed to initialize connection to %s\n",
+	     devs[i]->name);
+    }
+
+  free (fds);
+  free (next);
+  free (used);
+  free (started);
+}
+
+#else /* !NET_PARALLEL_CONNECT */
+
+static void
+connect_devs (Net_Device ** devs, int num_devs)
+{
+  int i;
+
+  for (i = 0; i < num_devs; ++i)
+    if (devs[i]->ctl < 0 && connect_dev (devs[i]) != SANE_STATUS_GOOD)
+      DBG (1, "connect_devs: failed to connect to %s\n", devs[i]->name);
+}
+#endif /* NET_PARALLEL_CONNECT */
+
+
+static void
+drop_option_values (Net_Scanner * s)
+{
+  int i;
+
+  if (s->value_cache)
     {
-      DBG (1, "connect_dev: access to %s denied\n", dev->name);
-      goto fail;
+      for (i = 0; i < s->num_values; ++i)
+	free (s->value_cache[i]);
+      free (s->value_cache);
     }
-  if (SANE_VERSION_MAJOR (version_code) != V_MAJOR)
+  s->value_cache = 0;
+  s->num_values = 0;
+  s->values_loaded = 0;
+}
+
+/* Values of options that can only change by setting them (or by
+   setting an option that reloads the options) can be cached.  */
+static int
+is_cacheable_option (const SANE_Option_Descriptor * d)
+{
+  return (d && SANE_OPTION_IS_ACTIVE (d->cap)
+	  && (d->cap & SANE_CAP_SOFT_DETECT)
+	  && (d->cap & SANE_CAP_SOFT_SELECT)
+	  && !(d->cap & SANE_CAP_HARD_SELECT)
+	  && d->type != SANE_TYPE_BUTTON && d->type != SANE_TYPE_GROUP
+	  && d->size > 0);
+}
+
+/* Read the values of all cacheable options in one request.  Options
+   that fail are simply not cached and read one by one.  */
+static void
+load_option_values (Net_Scanner * s)
+{
+  SANE_Control_Options_Req req;
+  SANE_Control_Options_Reply reply;
+  SANE_Option_Descriptor *d;
+  SANE_Word max_size = 0;
+  void *zero;
+  int i, option;
+
+  drop_option_values (s);
+  s->values_loaded = 1;
+
+  s->value_cache = calloc (s->opt.num_options + 1, sizeof (void *));
+  req.op = calloc (s->opt.num_options + 1, sizeof (req.op[0]));
+  if (!s->value_cache || !req.op)
     {
-      DBG (1, "connect_dev: major version mismatch: got %d, expected %d\n",
-	   SANE_VERSION_MAJOR (version_code), V_MAJOR);
-      status = SANE_STATUS_IO_ERROR;
-      goto fail;
+      DBG (1, "load_option_values: not enough memory\n");
+      free (req.op);
+      return;
     }
-  if (SANE_VERSION_BUILD (version_code) != SANEI_NET_PROTOCOL_VERSION
-      && SANE_VERSION_BUILD (version_code) != 2)
+  s->num_values = s->opt.num_options;
+
+  req.handle = s->handle;
+  req.num_ops = 0;
+  for (option = 0; option < s->opt.num_options; ++option)
+    {
+      d = s->opt.desc[option];
+      if (!is_cacheable_option (d))
+	continue;
+      req.op[req.num_ops].handle = s->handle;
+      req.op[req.num_ops].option = option;
+      req.op[req.num_ops].action = SANE_ACTION_GET_VALUE;
+      req.op[req.num_ops].value_type = d->type;
+      req.op[req.num_ops].value_size = d->size;
+      if (d->size > max_size)
+	max_size = d->size;
+      ++req.num_ops;
+    }
+
+  /* the values sent along with GET_VALUE are ignored */
+  zero = calloc (1, max_size + 1);
+  if (req.num_ops == 0 || !zero)
+    {
+      free (zero);
+      free (req.op);
+      return;
+    }
+  for (i = 0; i < req.num_ops; ++i)
+    req.op[i].value = zero;
+
+  DBG (3, "load_option_values: reading %d option values\n", req.num_ops);
+  sanei_w_call (&s->hw->wire, SANE_NET_CONTROL_OPTIONS,
+		(WireCodecFunc) sanei_w_control_options_req, &req,
+		(WireCodecFunc) sanei_w_control_options_reply, &reply);
+  if (s->hw->wire.status)
     {
-      DBG (1, "connect_dev: network protocol version mismatch: "
-	   "got %d, expected %d\n",
-	   SANE_VERSION_BUILD (version_code), SANEI_NET_PROTOCOL_VERSION);
-      status = SANE_STATUS_IO_ERROR;
-      goto fail;
+      DBG (1, "load_option_values: failed to read option values (%s)\n",
+	   strerror (s->hw->wire.status));
+      free (zero);
+      free (req.op);
+      return;
     }
-  dev->wire.version = SANE_VERSION_BUILD (version_code);
-  DBG (4, "connect_dev: done\n");
-  return SANE_STATUS_GOOD;
 
-fail:
-  DBG (2, "connect_dev: closing connection to %s\n", dev->name);
-  close (dev->ctl);
-  dev->ctl = -1;
-  return status;
+  for (i = 0; i < req.num_ops && i < reply.num_ops; ++i)
+    {
+      option = req.op[i].option;
+      if (reply.op[i].status != SANE_STATUS_GOOD
+	  || reply.op[i].value_size != req.op[i].value_size
+	  || !reply.op[i].value)
+	{
+	  DBG (2, "load_option_values: option %d not cached (%s)\n", option,
+	       sane_strstatus (reply.op[i].status));
+	  continue;
+	}
+      s->value_cache[option] = malloc (reply.op[i].value_size);
+      if (s->value_cache[option])
+	memcpy (s->value_cache[option], reply.op[i].value,
+		reply.op[i].value_size);
+    }
+  sanei_w_free (&s->hw->wire,
+		(WireCodecFunc) sanei_w_control_options_reply, &reply);
+  free (zero);
+  free (req.op);
 }
 
-
 static SANE_Status
-fetch_options (Net_Scanner * s)
+fetch_all_option_descriptors (Net_Scanner * s)
 {
-  int option_number;
-  DBG (3, "fetch_options: %p\n", (void *) s);
-
   if (s->opt.num_options)
     {
       DBG (2, "fetch_options: %d option descriptors cached... freeing\n",
@@ -568,10 +933,101 @@ fetch_options (Net_Scanner * s)
 		(WireCodecFunc) sanei_w_option_descriptor_array, &s->opt);
   if (s->hw->wire.status)
     {
-      DBG (1, "fetch_options: failed to get option descriptors (%s)\n",
-	   strerror (s->hw->wire.status));
-      return SANE_STATUS_IO_ERROR;
+      DBG (1, "fetch_options: failed to get option descriptors (%s)\n",
+	   strerror (s->hw->wire.status));
+      return SANE_STATUS_IO_ERROR;
+    }
+  return SANE_STATUS_GOOD;
+}
+
+/* Only fetch the option descriptors that changed since the ones we
+   have.  The server sends all of them if it doesn't know our set.  */
+static SANE_Status
+fetch_changed_option_descriptors (Net_Scanner * s)
+{
+  SANE_Get_Option_Descriptors_Delta_Req req;
+  SANE_Option_Descriptors_Delta_Reply reply;
+  SANE_Option_Descriptor_Array old;
+  SANE_Option_Descriptor *desc;
+  SANE_Status status = SANE_STATUS_GOOD;
+  int i, full;
+
+  req.handle = s->handle;
+  req.generation = s->opt.num_options ? s->desc_generation : 0;
+  DBG (3, "fetch_options: get_option_descriptors_delta (generation %d)\n",
+       req.generation);
+  sanei_w_call (&s->hw->wire, SANE_NET_GET_OPTION_DESCRIPTORS_DELTA,
+		(WireCodecFunc) sanei_w_get_option_descriptors_delta_req, &req,
+		(WireCodecFunc) sanei_w_option_descriptors_delta_reply,
+		&reply);
+  if (s->hw->wire.status)
+    {
+      DBG (1, "fetch_options: failed to get option descriptors (%s)\n",
+	   strerror (s->hw->wire.status));
+      s->desc_generation = 0;
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  full = (reply.num_changed == reply.num_options
+	  && reply.changed.num_options == reply.num_changed);
+  for (i = 0; full && i < reply.num_changed; ++i)
+    full = (reply.index[i] == i);
+
+  if (full)
+    {
+      /* take the new array, the old one is freed with the reply */
+      old = s->opt;
+      s->opt = reply.changed;
+      reply.changed = old;
+    }
+  else if (reply.changed.num_options != reply.num_changed
+	   || reply.num_options != s->opt.num_options)
+    {
+      DBG (1, "fetch_options: inconsistent option descriptor update\n");
+      status = SANE_STATUS_IO_ERROR;
+    }
+  else
+    {
+      for (i = 0; i < reply.num_changed; ++i)
+	if (reply.index[i] < 0 || reply.index[i] >= s->opt.num_options)
+	  {
+	    DBG (1, "fetch_options: invalid option number %d\n",
+		 reply.index[i]);
+	    status = SANE_STATUS_IO_ERROR;
+	    break;
+	  }
+      for (i = 0; status == SANE_STATUS_GOOD && i < reply.num_changed; ++i)
+	{
+	  desc = s->opt.desc[reply.index[i]];
+	  s->opt.desc[reply.index[i]] = reply.changed.desc[i];
+	  reply.changed.desc[i] = desc;
+	}
     }
+  DBG (3, "fetch_options: %d of %d option descriptors changed\n",
+       reply.num_changed, reply.num_options);
+
+  s->desc_generation = (status == SANE_STATUS_GOOD) ? reply.generation : 0;
+  sanei_w_free (&s->hw->wire,
+		(WireCodecFunc) sanei_w_option_descriptors_delta_reply,
+		&reply);
+  return status;
+}
+
+static SANE_Status
+fetch_options (Net_Scanner * s)
+{
+  SANE_Status status;
+  int option_number;
+  DBG (3, "fetch_options: %p\n", (void *) s);
+
+  drop_option_values (s);
+
+  if (s->hw->option_batch)
+    status = fetch_changed_option_descriptors (s);
+  else
+    status = fetch_all_option_descriptors (s);
+  if (status != SANE_STATUS_GOOD)
+    return status;
 
   if (s->local_opt.num_options == 0)
     {
@@ -633,6 +1089,111 @@ do_cancel (Net_Scanner * s)
   return SANE_STATUS_CANCELLED;
 }
 
+#ifdef HAVE_LIBZ
+/* upper limit for the size of a data record to protect against bogus
+   record lengths */
+#define MAX_RECORD_SIZE (64 * 1024 * 1024)
+
+/* Reads the remaining part of a compressed record and decompresses it once
+   it has been read completely */
+static SANE_Status
+read_compressed_record (Net_Scanner * s)
+{
+  ssize_t nread;
+  size_t data_len;
+  uLongf len;
+
+  nread = read (s->data, s->compressed_buf + s->compressed_len,
+		s->compressed_remaining);
+  if (nread < 0 && errno == EAGAIN)
+    return SANE_STATUS_GOOD;
+  if (nread <= 0)
+    {
+      DBG (1, "read_compressed_record: read failed (%s)\n",
+	   nread < 0 ? strerror (errno) : "end of file");
+      do_cancel (s);
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  s->compressed_len += nread;
+  s->compressed_remaining -= nread;
+  if (s->compressed_remaining > 0)
+    return SANE_STATUS_GOOD;
+
+  data_len = (((u_long) s->compressed_buf[0] << 24)
+	      | ((u_long) s->compressed_buf[1] << 16)
+	      | ((u_long) s->compressed_buf[2] << 8)
+	      | ((u_long) s->compressed_buf[3] << 0));
+  if (data_len > MAX_RECORD_SIZE)
+    {
+      DBG (1, "read_compressed_record: invalid data length %lu\n",
+	   (u_long) data_len);
+      do_cancel (s);
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  if (s->decompressed_buf_size < data_len)
+    {
+      free (s->decompressed_buf);
+      s->decompressed_buf = malloc (data_len);
+      if (!s->decompressed_buf)
+	{
+	  DBG (1, "read_compressed_record: not enough memory\n");
+	  s->decompressed_buf_size = 0;
+	  do_cancel (s);
+	  return SANE_STATUS_NO_MEM;
+	}
+      s->decompressed_buf_size = data_len;
+    }
+
+  len = data_len;
+  if (uncompress (s->decompressed_buf, &len, s->compressed_buf + 4,
+		  s->compressed_len - 4) != Z_OK || len != data_len)
+    {
+      DBG (1, "read_compressed_record: corrupt compressed record\n");
+      do_cancel (s);
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  DBG (3, "read_compressed_record: %lu bytes decompressed to %lu bytes\n",
+       (u_long) s->compressed_len, (u_long) data_len);
+  s->decompressed_pos = 0;
+  s->decompressed_len = data_len;
+  return SANE_STATUS_GOOD;
+}
+
+/* Prepares reading a compressed record of the given length */
+static SANE_Status
+start_compressed_record (Net_Scanner * s, size_t record_len)
+{
+  if (record_len < 4 || record_len > MAX_RECORD_SIZE)
+    {
+      DBG (1, "start_compressed_record: invalid record length %lu\n",
+	   (u_long) record_len);
+      do_cancel (s);
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  if (s->compressed_buf_size < record_len)
+    {
+      free (s->compressed_buf);
+      s->compressed_buf = malloc (record_len);
+      if (!s->compressed_buf)
+	{
+	  DBG (1, "start_compressed_record: not enough memory\n");
+	  s->compressed_buf_size = 0;
+	  do_cancel (s);
+	  return SANE_STATUS_NO_MEM;
+	}
+      s->compressed_buf_size = record_len;
+    }
+
+  s->compressed_len = 0;
+  s->compressed_remaining = record_len;
+  return SANE_STATUS_GOOD;
+}
+#endif /* HAVE_LIBZ */
+
 static void
 do_authorization (Net_Device * dev, SANE_String resource)
 {
@@ -1026,6 +1587,42 @@ sane_init (SANE_Int * version_code, SANE_Auth_Callback authorize)
 	   * Check for net backend options.
 	   * Anything that isn't an option is a saned host.
 	   */
+	  if (strstr(device_name, "compression") != NULL)
+	    {
+	      optval = strchr(device_name, '=');
+
+	      if (!optval)
+		continue;
+
+	      optval = sanei_config_skip_whitespace (++optval);
+	      if ((optval != NULL) && (*optval != '\0'))
+		{
+		  use_compression = (strncmp (optval, "yes", 3) == 0);
+
+		  DBG (2, "sane_init: compression %s\n",
+		       use_compression ? "enabled" : "disabled");
+		}
+
+	      continue;
+	    }
+	  if (strstr(device_name, "device_list_ttl") != NULL)
+	    {
+	      optval = strchr(device_name, '=');
+
+	      if (!optval)
+		continue;
+
+	      optval = sanei_config_skip_whitespace (++optval);
+	      if ((optval != NULL) && (*optval != '\0'))
+		{
+		  device_list_ttl = atoi(optval);
+
+		  DBG (2, "sane_init: device list TTL set to %d seconds\n",
+		       device_list_ttl);
+		}
+
+	      continue;
+	    }
 	  if (strstr(device_name, "connect_timeout") != NULL)
 	    {
 	      /* Look for the = sign; if it's not there, error out */
@@ -1123,12 +1720,33 @@ sane_init (SANE_Int * version_code, SANE_Auth_Callback authorize)
   return SANE_STATUS_GOOD;
 }
 
+static void
+free_dev_list (Net_Device * dev)
+{
+  int i;
+
+  for (i = 0; i < dev->num_devices; ++i)
+    {
+      if (dev->devices[i]->vendor)
+	free ((void *) dev->devices[i]->vendor);
+      if (dev->devices[i]->model)
+	free ((void *) dev->devices[i]->model);
+      if (dev->devices[i]->type)
+	free ((void *) dev->devices[i]->type);
+      free (dev->devices[i]);
+    }
+  if (dev->devices)
+    free (dev->devices);
+  dev->devices = 0;
+  dev->num_devices = 0;
+  dev->devices_time = 0;
+}
+
 void
 sane_exit (void)
 {
   Net_Scanner *handle, *next_handle;
   Net_Device *dev, *next_device;
-  int i;
 
   DBG (1, "sane_exit: exiting\n");
 
@@ -1159,6 +1777,7 @@ sane_exit (void)
 	  sanei_w_exit (&dev->wire);
 	  close (dev->ctl);
 	}
+      free_dev_list (dev);
       if (dev->name)
 	free ((void *) dev->name);
 
@@ -1170,19 +1789,8 @@ sane_exit (void)
       free (dev);
     }
   if (devlist)
-    {
-      for (i = 0; devlist[i]; ++i)
-	{
-	  if (devlist[i]->vendor)
-	    free ((void *) devlist[i]->vendor);
-	  if (devlist[i]->model)
-	    free ((void *) devlist[i]->model);
-	  if (devlist[i]->type)
-	    free ((void *) devlist[i]->type);
-	  free ((void *) devlist[i]);
-	}
-      free (devlist);
-    }
+    free (devlist);
+  devlist = 0;
   DBG (3, "sane_exit: finished.\n");
 }
 
@@ -1192,175 +1800,226 @@ sane_exit (void)
    backend/device).  This is appropriate for the command-line
    interface of SANE, for example.
  */
-SANE_Status
-sane_get_devices (const SANE_Device *** device_list, SANE_Bool local_only)
+/* Ask the (connected) host DEV for its devices and store them with the
+   host.  A host that can't be asked ends up with an empty list.  */
+static SANE_Status
+fetch_dev_list (Net_Device * dev)
 {
-  static int devlist_size = 0, devlist_len = 0;
-  static const SANE_Device *empty_devlist[1] = { 0 };
   SANE_Get_Devices_Reply reply;
-  SANE_Status status;
-  Net_Device *dev;
   char *full_name;
   int i, num_devs;
   size_t len;
-#define ASSERT_SPACE(n)                                                    \
-  {                                                                        \
-    if (devlist_len + (n) > devlist_size)                                  \
-      {                                                                    \
-        devlist_size += (n) + 15;                                          \
-        if (devlist)                                                       \
-          devlist = realloc (devlist, devlist_size * sizeof (devlist[0])); \
-        else                                                               \
-          devlist = malloc (devlist_size * sizeof (devlist[0]));           \
-        if (!devlist)                                                      \
-          {                                                                \
-             DBG (1, "sane_get_devices: not enough memory\n");	           \
-             return SANE_STATUS_NO_MEM;                                    \
-          }                                                                \
-      }                                                                    \
-  }
 
-  DBG (3, "sane_get_devices: local_only = %d\n", local_only);
+  free_dev_list (dev);
+  dev->devices_time = time (NULL);
 
-  if (local_only)
+  if (dev->ctl < 0)
     {
-      *device_list = empty_devlist;
+      DBG (1, "sane_get_devices: ignoring failure to connect to %s\n",
+	   dev->name);
       return SANE_STATUS_GOOD;
     }
 
-  if (devlist)
+  sanei_w_call (&dev->wire, SANE_NET_GET_DEVICES,
+		(WireCodecFunc) sanei_w_void, 0,
+		(WireCodecFunc) sanei_w_get_devices_reply, &reply);
+  if (reply.status != SANE_STATUS_GOOD)
     {
-      DBG (2, "sane_get_devices: freeing devlist\n");
-      for (i = 0; devlist[i]; ++i)
-	{
-	  if (devlist[i]->vendor)
-	    free ((void *) devlist[i]->vendor);
-	  if (devlist[i]->model)
-	    free ((void *) devlist[i]->model);
-	  if (devlist[i]->type)
-	    free ((void *) devlist[i]->type);
-	  free ((void *) devlist[i]);
-	}
-      free (devlist);
-      devlist = 0;
+      DBG (1, "sane_get_devices: ignoring rpc-returned status %s\n",
+	   sane_strstatus (reply.status));
+      sanei_w_free (&dev->wire,
+		    (WireCodecFunc) sanei_w_get_devices_reply, &reply);
+      return SANE_STATUS_GOOD;
     }
-  devlist_len = 0;
-  devlist_size = 0;
 
-  for (dev = first_device; dev; dev = dev->next)
+  /* count the number of devices for this backend: */
+  for (num_devs = 0; reply.device_list[num_devs]; ++num_devs);
+
+  dev->devices = malloc ((num_devs + 1) * sizeof (dev->devices[0]));
+  if (!dev->devices)
     {
-      if (dev->ctl < 0)
+      DBG (1, "sane_get_devices: not enough free memory\n");
+      sanei_w_free (&dev->wire,
+		    (WireCodecFunc) sanei_w_get_devices_reply, &reply);
+      dev->devices_time = 0;
+      return SANE_STATUS_NO_MEM;
+    }
+
+  for (i = 0; i < num_devs; ++i)
+    {
+      SANE_Device *rdev;
+      char *mem;
+#ifdef ENABLE_IPV6
+      SANE_Bool IPv6 = SANE_FALSE;
+#endif /* ENABLE_IPV6 */
+
+      /* create a new device entry with a device name that is the
+	 sum of the backend name a colon and the backend's device
+	 name: */
+      len = strlen (dev->name) + 1 + strlen (reply.device_list[i]->name);
+
+#ifdef ENABLE_IPV6
+      if (strchr (dev->name, ':') != NULL)
 	{
-	  status = connect_dev (dev);
-	  if (status != SANE_STATUS_GOOD)
-	    {
-	      DBG (1, "sane_get_devices: ignoring failure to connect to %s\n",
-		   dev->name);
-	      continue;
-	    }
+	  len += 2;
+	  IPv6 = SANE_TRUE;
 	}
-      sanei_w_call (&dev->wire, SANE_NET_GET_DEVICES,
-		    (WireCodecFunc) sanei_w_void, 0,
-		    (WireCodecFunc) sanei_w_get_devices_reply, &reply);
-      if (reply.status != SANE_STATUS_GOOD)
+#endif /* ENABLE_IPV6 */
+
+      mem = malloc (sizeof (*dev) + len + 1);
+      if (!mem)
 	{
-	  DBG (1, "sane_get_devices: ignoring rpc-returned status %s\n",
-	       sane_strstatus (reply.status));
+	  DBG (1, "sane_get_devices: not enough free memory\n");
 	  sanei_w_free (&dev->wire,
-			(WireCodecFunc) sanei_w_get_devices_reply, &reply);
-	  continue;
+			(WireCodecFunc) sanei_w_get_devices_reply,
+			&reply);
+	  free_dev_list (dev);
+	  return SANE_STATUS_NO_MEM;
 	}
 
-      /* count the number of devices for this backend: */
-      for (num_devs = 0; reply.device_list[num_devs]; ++num_devs);
-
-      ASSERT_SPACE (num_devs);
+      memset (mem, 0, sizeof (*dev) + len);
+      full_name = mem + sizeof (*dev);
 
-      for (i = 0; i < num_devs; ++i)
-	{
-	  SANE_Device *rdev;
-	  char *mem;
 #ifdef ENABLE_IPV6
-	  SANE_Bool IPv6 = SANE_FALSE;
+      if (IPv6 == SANE_TRUE)
+	strcat (full_name, "[");
 #endif /* ENABLE_IPV6 */
 
-	  /* create a new device entry with a device name that is the
-	     sum of the backend name a colon and the backend's device
-	     name: */
-	  len = strlen (dev->name) + 1 + strlen (reply.device_list[i]->name);
+      strcat (full_name, dev->name);
 
 #ifdef ENABLE_IPV6
-	  if (strchr (dev->name, ':') != NULL)
-	    {
-	      len += 2;
-	      IPv6 = SANE_TRUE;
-	    }
+      if (IPv6 == SANE_TRUE)
+	strcat (full_name, "]");
 #endif /* ENABLE_IPV6 */
 
-	  mem = malloc (sizeof (*dev) + len + 1);
-	  if (!mem)
-	    {
-	      DBG (1, "sane_get_devices: not enough free memory\n");
-	      sanei_w_free (&dev->wire,
-			    (WireCodecFunc) sanei_w_get_devices_reply,
-			    &reply);
-	      return SANE_STATUS_NO_MEM;
-	    }
+      strcat (full_name, ":");
+      strcat (full_name, reply.device_list[i]->name);
+      DBG (3, "sane_get_devices: got %s\n", full_name);
 
-	  memset (mem, 0, sizeof (*dev) + len);
-	  full_name = mem + sizeof (*dev);
+      rdev = (SANE_Device *) mem;
+      rdev->name = full_name;
+      rdev->vendor = strdup (reply.device_list[i]->vendor);
+      rdev->model = strdup (reply.device_list[i]->model);
+      rdev->type = strdup (reply.device_list[i]->type);
 
-#ifdef ENABLE_IPV6
-	  if (IPv6 == SANE_TRUE)
-	    strcat (full_name, "[");
-#endif /* ENABLE_IPV6 */
+      if ((!rdev->vendor) || (!rdev->model) || (!rdev->type))
+	{
+	  DBG (1, "sane_get_devices: not enough free memory\n");
+	  if (rdev->vendor)
+	    free ((void *) rdev->vendor);
+	  if (rdev->model)
+	    free ((void *) rdev->model);
+	  if (rdev->type)
+	    free ((void *) rdev->type);
+	  free (rdev);
+	  sanei_w_free (&dev->wire,
+			(WireCodecFunc) sanei_w_get_devices_reply,
+			&reply);
+	  free_dev_list (dev);
+	  return SANE_STATUS_NO_MEM;
+	}
 
-	  strcat (full_name, dev->name);
+      dev->devices[dev->num_devices++] = rdev;
+    }
+  /* now free up the rpc return value: */
+  sanei_w_free (&dev->wire,
+		(WireCodecFunc) sanei_w_get_devices_reply, &reply);
+  return SANE_STATUS_GOOD;
+}
 
-#ifdef ENABLE_IPV6
-	  if (IPv6 == SANE_TRUE)
-	    strcat (full_name, "]");
-#endif /* ENABLE_IPV6 */
+SANE_Status
+sane_get_devices (const SANE_Device *** device_list, SANE_Bool local_only)
+{
+  static const SANE_Device *empty_devlist[1] = { 0 };
+  SANE_Status status;
+  Net_Device *dev, **devs, **stale;
+  int i, num_hosts, num_stale, devlist_len;
+  time_t now;
+
+  DBG (3, "sane_get_devices: local_only = %d\n", local_only);
 
-	  strcat (full_name, ":");
-	  strcat (full_name, reply.device_list[i]->name);
-	  DBG (3, "sane_get_devices: got %s\n", full_name);
+  if (local_only)
+    {
+      *device_list = empty_devlist;
+      return SANE_STATUS_GOOD;
+    }
 
-	  rdev = (SANE_Device *) mem;
-	  rdev->name = full_name;
-	  rdev->vendor = strdup (reply.device_list[i]->vendor);
-	  rdev->model = strdup (reply.device_list[i]->model);
-	  rdev->type = strdup (reply.device_list[i]->type);
+  if (devlist)
+    {
+      DBG (2, "sane_get_devices: freeing devlist\n");
+      free (devlist);
+      devlist = 0;
+    }
 
-	  if ((!rdev->vendor) || (!rdev->model) || (!rdev->type))
-	    {
-	      DBG (1, "sane_get_devices: not enough free memory\n");
-	      if (rdev->vendor)
-		free ((void *) rdev->vendor);
-	      if (rdev->model)
-		free ((void *) rdev->model);
-	      if (rdev->type)
-		free ((void *) rdev->type);
-	      free (rdev);
-	      sanei_w_free (&dev->wire,
-			    (WireCodecFunc) sanei_w_get_devices_reply,
-			    &reply);
-	      return SANE_STATUS_NO_MEM;
-	    }
+  /* Avahi may add hosts any time, work on the ones known right now.
+     Hosts are only removed by sane_exit().  */
+#if WITH_AVAHI
+  if (avahi_thread)
+    avahi_threaded_poll_lock (avahi_thread);
+#endif /* WITH_AVAHI */
+  for (num_hosts = 0, dev = first_device; dev; dev = dev->next)
+    ++num_hosts;
+  devs = malloc ((2 * num_hosts + 1) * sizeof (devs[0]));
+  if (devs)
+    for (i = 0, dev = first_device; i < num_hosts; dev = dev->next)
+      devs[i++] = dev;
+#if WITH_AVAHI
+  if (avahi_thread)
+    avahi_threaded_poll_unlock (avahi_thread);
+#endif /* WITH_AVAHI */
+  if (!devs)
+    {
+      DBG (1, "sane_get_devices: not enough memory\n");
+      return SANE_STATUS_NO_MEM;
+    }
+
+  /* refresh the hosts whose lists are too old, connecting to all of
+     them at once */
+  now = time (NULL);
+  stale = devs + num_hosts;
+  for (i = 0, num_stale = 0; i < num_hosts; ++i)
+    if (device_list_ttl <= 0 || devs[i]->devices_time == 0
+	|| now - devs[i]->devices_time >= device_list_ttl
+	|| now < devs[i]->devices_time)
+      stale[num_stale++] = devs[i];
+  DBG (2, "sane_get_devices: %d of %d hosts need to be asked\n",
+       num_stale, num_hosts);
 
-	  devlist[devlist_len++] = rdev;
+  connect_devs (stale, num_stale);
+  for (i = 0; i < num_stale; ++i)
+    {
+      status = fetch_dev_list (stale[i]);
+      if (status != SANE_STATUS_GOOD)
+	{
+	  free (devs);
+	  return status;
 	}
-      /* now free up the rpc return value: */
-      sanei_w_free (&dev->wire,
-		    (WireCodecFunc) sanei_w_get_devices_reply, &reply);
     }
 
+  devlist_len = 0;
+  for (i = 0; i < num_hosts; ++i)
+    devlist_len += devs[i]->num_devices;
+  devlist = malloc ((devlist_len + 1) * sizeof (devlist[0]));
+  if (!devlist)
+    {
+      DBG (1, "sane_get_devices: not enough memory\n");
+      free (devs);
+      return SANE_STATUS_NO_MEM;
+    }
+  devlist_len = 0;
+  for (i = 0; i < num_hosts; ++i)
+    {
+      memcpy (devlist + devlist_len, devs[i]->devices,
+	      devs[i]->num_devices * sizeof (devlist[0]));
+      devlist_len += devs[i]->num_devices;
+    }
+  free (devs);
+
   /* terminate device list with NULL entry: */
-  ASSERT_SPACE (1);
-  devlist[devlist_len++] = 0;
+  devlist[devlist_len] = 0;
 
   *device_list = devlist;
-  DBG (2, "sane_get_devices: finished (%d devices)\n", devlist_len - 1);
+  DBG (2, "sane_get_devices: finished (%d devices)\n", devlist_len);
   return SANE_STATUS_GOOD;
 }
 
@@ -1657,6 +2316,8 @@ sane_close (SANE_Handle handle)
   else
     first_handle = s->next;
 
+  drop_option_values (s);
+
   if (s->opt.num_options)
     {
       DBG (2, "sane_close: removing cached option descriptors\n");
@@ -1684,6 +2345,8 @@ sane_close (SANE_Handle handle)
       DBG (2, "sane_close: closing data pipe\n");
       close (s->data);
     }
+  free (s->compressed_buf);
+  free (s->decompressed_buf);
   free (s);
   DBG (2, "sane_close: done\n");
 }
@@ -1762,6 +2425,20 @@ sane_control_option (SANE_Handle handle, SANE_Int option,
       break;
     }
 
+  if (action == SANE_ACTION_GET_VALUE && s->hw->option_batch && value)
+    {
+      if (!s->values_loaded)
+	load_option_values (s);
+      if (option < s->num_values && s->value_cache[option])
+	{
+	  DBG (3, "sane_control_option: cached value\n");
+	  memcpy (value, s->value_cache[option], value_size);
+	  if (info)
+	    *info = 0;
+	  return SANE_STATUS_GOOD;
+	}
+    }
+
   /* Avoid leaking memory bits */
   if (value && (action != SANE_ACTION_SET_VALUE))
     memset (value, 0, value_size);
@@ -1819,6 +2496,22 @@ sane_control_option (SANE_Handle handle, SANE_Int option,
 	  if (reply.info & SANE_INFO_RELOAD_OPTIONS)
 	    s->options_valid = 0;
 	}
+      if (option < s->num_values && s->value_cache[option]
+	  && action != SANE_ACTION_GET_VALUE)
+	{
+	  /* keep the cache in sync with what the backend accepted */
+	  if (status == SANE_STATUS_GOOD && action == SANE_ACTION_SET_VALUE
+	      && value_size > 0 && (SANE_Word) value_size == reply.value_size)
+	    {
+	      memset (s->value_cache[option], 0, s->opt.desc[option]->size);
+	      memcpy (s->value_cache[option], value, value_size);
+	    }
+	  else
+	    {
+	      free (s->value_cache[option]);
+	      s->value_cache[option] = 0;
+	    }
+	}
       sanei_w_free (&s->hw->wire,
 		    (WireCodecFunc) sanei_w_control_option_reply, &reply);
       if (need_auth && !s->hw->auth_active)
@@ -1895,6 +2588,9 @@ sane_start (SANE_Handle handle)
   hang_over = -1;
   left_over = -1;
 
+  /* scanning may change option values, e.g. after calibration */
+  drop_option_values (s);
+
   if (s->data >= 0)
     {
       DBG (2, "sane_start: data pipe already exists\n");
@@ -2007,6 +2703,8 @@ sane_start (SANE_Handle handle)
   s->data = fd;
   s->reclen_buf_offset = 0;
   s->bytes_remaining = 0;
+  s->compressed_remaining = 0;
+  s->decompressed_pos = s->decompressed_len = 0;
   DBG (3, "sane_start: done (%s)\n", sane_strstatus (status));
   return status;
 }
@@ -2030,6 +2728,9 @@ sane_start (SANE_Handle handle)
   hang_over = -1;
   left_over = -1;
 
+  /* scanning may change option values, e.g. after calibration */
+  drop_option_values (s);
+
   if (s->data >= 0)
     {
       DBG (2, "sane_start: data pipe already exists\n");
@@ -2114,6 +2815,8 @@ sane_start (SANE_Handle handle)
   s->data = fd;
   s->reclen_buf_offset = 0;
   s->bytes_remaining = 0;
+  s->compressed_remaining = 0;
+  s->decompressed_pos = s->decompressed_len = 0;
   DBG (3, "sane_start: done (%s)\n", sane_strstatus (status));
   return status;
 }
@@ -2132,6 +2835,9 @@ sane_read (SANE_Handle handle, SANE_Byte * data, SANE_Int max_length,
   SANE_Byte swap_buf;
   SANE_Byte temp_hang_over;
   int is_even;
+#ifdef HAVE_LIBZ
+  SANE_Status status;
+#endif /* HAVE_LIBZ */
 
   DBG (3, "sane_read: handle=%p, data=%p, max_length=%d, length=%p\n",
        handle, data, max_length, (void *) length);
@@ -2168,7 +2874,8 @@ sane_read (SANE_Handle handle, SANE_Byte * data, SANE_Int max_length,
       return SANE_STATUS_CANCELLED;
     }
 
-  if (s->bytes_remaining == 0)
+  if (s->bytes_remaining == 0 && s->compressed_remaining == 0
+      && s->decompressed_pos >= s->decompressed_len)
     {
       /* boy, is this painful or what? */
 
@@ -2226,27 +2933,58 @@ sane_read (SANE_Handle handle, SANE_Byte * data, SANE_Int max_length,
 	  do_cancel (s);
 	  return (SANE_Status) ch;
 	}
+#ifdef HAVE_LIBZ
+      if (s->hw->compression
+	  && (s->bytes_remaining & SANEI_NET_RECORD_COMPRESSED))
+	{
+	  status = start_compressed_record (s, s->bytes_remaining
+					    & ~SANEI_NET_RECORD_COMPRESSED);
+	  s->bytes_remaining = 0;
+	  if (status != SANE_STATUS_GOOD)
+	    return status;
+	}
+#endif /* HAVE_LIBZ */
     }
 
-  if (max_length > (SANE_Int) s->bytes_remaining)
-    max_length = s->bytes_remaining;
-
-  nread = read (s->data, data, max_length);
+#ifdef HAVE_LIBZ
+  if (s->compressed_remaining > 0)
+    {
+      status = read_compressed_record (s);
+      if (status != SANE_STATUS_GOOD || s->compressed_remaining > 0)
+	return status;
+    }
+#endif /* HAVE_LIBZ */
 
-  if (nread < 0)
+  if (s->decompressed_pos < s->decompressed_len)
     {
-      DBG (2, "sane_read: error code %s\n", strerror (errno));
-      if (errno == EAGAIN)
-	return SANE_STATUS_GOOD;
-      else
+      nread = s->decompressed_len - s->decompressed_pos;
+      if (nread > max_length)
+	nread = max_length;
+      memcpy (data, s->decompressed_buf + s->decompressed_pos, nread);
+      s->decompressed_pos += nread;
+    }
+  else
+    {
+      if (max_length > (SANE_Int) s->bytes_remaining)
+	max_length = s->bytes_remaining;
+
+      nread = read (s->data, data, max_length);
+
+      if (nread < 0)
 	{
-	  DBG (1, "sane_read: cancelling scan\n");
-	  do_cancel (s);
-	  return SANE_STATUS_IO_ERROR;
+	  DBG (2, "sane_read: error code %s\n", strerror (errno));
+	  if (errno == EAGAIN)
+	    return SANE_STATUS_GOOD;
+	  else
+	    {
+	      DBG (1, "sane_read: cancelling scan\n");
+	      do_cancel (s);
+	      return SANE_STATUS_IO_ERROR;
+	    }
 	}
-    }
 
-  s->bytes_remaining -= nread;
+      s->bytes_remaining -= nread;
+    }
 
   *length = nread;
   /* Check whether we are scanning with a depth of 16 bits/pixel and whether
@@ -45,6 +45,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <time.h>
 
 #include "../include/sane/sanei_wire.h"
 #include "../include/sane/config.h"
@@ -62,6 +63,13 @@ typedef struct Net_Device
     int ctl;			/* socket descriptor (or -1) */
     Wire wire;
     int auth_active;
+    int compression;		/* data records may be compressed */
+    int option_batch;		/* server supports SANEI_NET_FEATURE_OPTION_BATCH */
+
+    /* the devices of this host, reused for device_list_ttl seconds: */
+    SANE_Device **devices;
+    int num_devices;
+    time_t devices_time;	/* 0 if the list must be fetched */
   }
 Net_Device;
 
@@ -72,6 +80,12 @@ typedef struct Net_Scanner
 
     int options_valid;			/* are the options current? */
     SANE_Option_Descriptor_Array opt, local_opt;
+    SANE_Word desc_generation;	/* generation of opt (if option_batch) */
+
+    /* option values read with one SANE_NET_CONTROL_OPTIONS call: */
+    int values_loaded;
+    SANE_Word num_values;
+    void **value_cache;		/* NULL for values that aren't cached */
 
     SANE_Word handle;		/* remote handle (it's a word, not a ptr!) */
 
@@ -80,6 +94,16 @@ typedef struct Net_Scanner
     u_char reclen_buf[4];
     size_t bytes_remaining;	/* how many bytes left in this record? */
 
+    /* compressed records are read completely and then decompressed: */
+    size_t compressed_remaining;	/* bytes left of a compressed record */
+    u_char *compressed_buf;
+    size_t compressed_buf_size;
+    size_t compressed_len;
+    u_char *decompressed_buf;
+    size_t decompressed_buf_size;
+    size_t decompressed_pos;
+    size_t decompressed_len;
+
     /* device (host) info: */
     Net_Device *hw;
   }
@@ -45,7 +45,7 @@
    This backend is for testing frontends.
 */
 
-#define BUILD 28
+#define BUILD 29
 
 #include "../include/sane/config.h"
 
@@ -58,6 +58,12 @@
 #include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
 
 #include "../include/_stdint.h"
 
@@ -76,6 +82,17 @@
 
 #define TEST_CONFIG_FILE "test.conf"
 
+/* The shared memory transport needs an anonymous shared mapping that
+   survives fork() and a memory barrier */
+#if defined(HAVE_MMAP) && defined(MAP_SHARED) && defined(__GNUC__) \
+  && (defined(MAP_ANONYMOUS) || defined(MAP_ANON))
+#define TEST_SHARED_MEMORY
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#define TEST_RING_SIZE (4 * 1024 * 1024)
+#endif
+
 static SANE_Bool inited = SANE_FALSE;
 static SANE_Device **sane_device_list = 0;
 static Test_Device *first_test_device = 0;
@@ -110,6 +127,30 @@ static SANE_Range read_delay_duration_range = {
   1000
 };
 
+static SANE_Range device_model_rate_range = {
+  0,
+  4 * 1024 * 1024,		/* 4 GB/s */
+  1
+};
+
+static SANE_Range device_model_burst_size_range = {
+  1024,
+  16 * 1024 * 1024,
+  1
+};
+
+static SANE_Range device_model_delay_range = {
+  0,
+  10 * 1000 * 1000,		/* 10 sec */
+  1000
+};
+
+static SANE_Range device_model_adf_pages_range = {
+  0,
+  10000,
+  1
+};
+
 static SANE_Range int_constraint_range = {
   4,
   192,
@@ -214,6 +255,13 @@ static SANE_Bool init_read_limit = SANE_FALSE;
 static SANE_Word init_read_limit_size = 1;
 static SANE_Bool init_read_delay = SANE_FALSE;
 static SANE_Word init_read_delay_duration = 1000;
+static SANE_Bool init_device_model = SANE_FALSE;
+static SANE_Word init_device_model_rate = 4096;
+static SANE_Word init_device_model_burst_size = 64 * 1024;
+static SANE_Word init_device_model_warmup = 0;
+static SANE_Word init_device_model_page_delay = 0;
+static SANE_Word init_device_model_adf_pages = 10;
+static SANE_Bool init_device_model_shared_memory = SANE_FALSE;
 static SANE_String init_read_status_code = "Default";
 static SANE_Bool init_fuzzy_parameters = SANE_FALSE;
 static SANE_Word init_ppl_loss = 0;
@@ -537,6 +585,134 @@ init_options (Test_Device * test_device)
   od->constraint.range = &read_delay_duration_range;
   test_device->val[opt_read_delay_duration].w = init_read_delay_duration;
 
+  /* opt_device_model */
+  od = &test_device->opt[opt_device_model];
+  od->name = "device-model";
+  od->title = SANE_I18N ("Device model");
+  od->desc = SANE_I18N ("Simulate the timing of a real scanner: deliver the "
+			"data at a fixed rate in bursts, wait for the lamp to "
+			"warm up and feed a given number of pages from the "
+			"document feeder. This is for load testing frontends "
+			"and saned.");
+  od->type = SANE_TYPE_BOOL;
+  od->unit = SANE_UNIT_NONE;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  od->constraint_type = SANE_CONSTRAINT_NONE;
+  od->constraint.range = 0;
+  test_device->val[opt_device_model].w = init_device_model;
+
+  /* opt_device_model_rate */
+  od = &test_device->opt[opt_device_model_rate];
+  od->name = "device-model-rate";
+  od->title = SANE_I18N ("Transfer rate");
+  od->desc = SANE_I18N ("Average amount of data in kilobytes per second the "
+			"device delivers. 0 delivers the data as fast as "
+			"possible.");
+  od->type = SANE_TYPE_INT;
+  od->unit = SANE_UNIT_NONE;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  if (!init_device_model)
+    od->cap |= SANE_CAP_INACTIVE;
+  od->constraint_type = SANE_CONSTRAINT_RANGE;
+  od->constraint.range = &device_model_rate_range;
+  test_device->val[opt_device_model_rate].w = init_device_model_rate;
+
+  /* opt_device_model_burst_size */
+  od = &test_device->opt[opt_device_model_burst_size];
+  od->name = "device-model-burst-size";
+  od->title = SANE_I18N ("Burst size");
+  od->desc = SANE_I18N ("Amount of data in bytes the device delivers at "
+			"once. After each burst the device pauses until the "
+			"average transfer rate is met again.");
+  od->type = SANE_TYPE_INT;
+  od->unit = SANE_UNIT_NONE;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  if (!init_device_model)
+    od->cap |= SANE_CAP_INACTIVE;
+  od->constraint_type = SANE_CONSTRAINT_RANGE;
+  od->constraint.range = &device_model_burst_size_range;
+  test_device->val[opt_device_model_burst_size].w =
+    init_device_model_burst_size;
+
+  /* opt_device_model_warmup */
+  od = &test_device->opt[opt_device_model_warmup];
+  od->name = "device-model-warmup";
+  od->title = SANE_I18N ("Warm-up time");
+  od->desc = SANE_I18N ("How long the device waits before delivering the "
+			"first page after the device was opened.");
+  od->type = SANE_TYPE_INT;
+  od->unit = SANE_UNIT_MICROSECOND;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  if (!init_device_model)
+    od->cap |= SANE_CAP_INACTIVE;
+  od->constraint_type = SANE_CONSTRAINT_RANGE;
+  od->constraint.range = &device_model_delay_range;
+  test_device->val[opt_device_model_warmup].w = init_device_model_warmup;
+
+  /* opt_device_model_page_delay */
+  od = &test_device->opt[opt_device_model_page_delay];
+  od->name = "device-model-page-delay";
+  od->title = SANE_I18N ("Page delay");
+  od->desc = SANE_I18N ("How long the device waits before delivering the "
+			"data of each page, e.g. for feeding the paper.");
+  od->type = SANE_TYPE_INT;
+  od->unit = SANE_UNIT_MICROSECOND;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  if (!init_device_model)
+    od->cap |= SANE_CAP_INACTIVE;
+  od->constraint_type = SANE_CONSTRAINT_RANGE;
+  od->constraint.range = &device_model_delay_range;
+  test_device->val[opt_device_model_page_delay].w =
+    init_device_model_page_delay;
+
+  /* opt_device_model_adf_pages */
+  od = &test_device->opt[opt_device_model_adf_pages];
+  od->name = "device-model-adf-pages";
+  od->title = SANE_I18N ("Pages in document feeder");
+  od->desc = SANE_I18N ("Number of pages scanned from the automatic document "
+			"feeder before it runs out of documents. 0 never "
+			"runs out of documents.");
+  od->type = SANE_TYPE_INT;
+  od->unit = SANE_UNIT_NONE;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  if (!init_device_model)
+    od->cap |= SANE_CAP_INACTIVE;
+  od->constraint_type = SANE_CONSTRAINT_RANGE;
+  od->constraint.range = &device_model_adf_pages_range;
+  test_device->val[opt_device_model_adf_pages].w =
+    init_device_model_adf_pages;
+
+  /* opt_device_model_shared_memory */
+  od = &test_device->opt[opt_device_model_shared_memory];
+  od->name = "device-model-shared-memory";
+  od->title = SANE_I18N ("Use shared memory");
+  od->desc = SANE_I18N ("Transfer the data from the reader process through "
+			"shared memory instead of the pipe. The pipe is only "
+			"used for signalling new data.");
+  od->type = SANE_TYPE_BOOL;
+  od->unit = SANE_UNIT_NONE;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+#ifdef TEST_SHARED_MEMORY
+  if (!init_device_model)
+    od->cap |= SANE_CAP_INACTIVE;
+#else
+  /* never active without support for the ring */
+  od->cap |= SANE_CAP_INACTIVE;
+  if (init_device_model_shared_memory)
+    DBG (1, "init_options: no shared memory support, using the pipe\n");
+#endif
+  od->constraint_type = SANE_CONSTRAINT_NONE;
+  od->constraint.range = 0;
+  test_device->val[opt_device_model_shared_memory].w =
+    init_device_model_shared_memory;
+
   /* opt_read_status_code */
   od = &test_device->opt[opt_read_status_code];
   od->name = "read-return-value";
@@ -1246,14 +1422,142 @@ read_option (SANE_String line, SANE_String option_string,
   return SANE_STATUS_GOOD;
 }
 
+#ifdef TEST_SHARED_MEMORY
+static SANE_Status
+ring_create (Test_Device * test_device)
+{
+  Test_Ring *ring;
+  void *map;
+
+  map = mmap (0, sizeof (Test_Ring) + TEST_RING_SIZE, PROT_READ | PROT_WRITE,
+	      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    {
+      DBG (1, "ring_create: mmap failed (%s)\n", strerror (errno));
+      return SANE_STATUS_NO_MEM;
+    }
+  ring = (Test_Ring *) map;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->size = TEST_RING_SIZE;
+  ring->data = (SANE_Byte *) map + sizeof (Test_Ring);
+  test_device->ring = ring;
+  DBG (2, "ring_create: %lu bytes at %p\n", (u_long) ring->size, map);
+  return SANE_STATUS_GOOD;
+}
+
+static void
+ring_destroy (Test_Device * test_device)
+{
+  DBG (2, "ring_destroy: ring=%p\n", (void *) test_device->ring);
+  munmap (test_device->ring,
+	  sizeof (Test_Ring) + test_device->ring->size);
+  test_device->ring = 0;
+}
+
+/* (child) Copy up to count bytes into the ring and wake up sane_read() */
+static ssize_t
+ring_write (Test_Ring * ring, SANE_Int fd, SANE_Byte * buffer, size_t count)
+{
+  size_t space, offset, part;
+
+  while ((space = ring->size - (ring->head - ring->tail)) == 0)
+    usleep (100);
+  __sync_synchronize ();
+
+  if (count > space)
+    count = space;
+  offset = ring->head % ring->size;
+  part = ring->size - offset;
+  if (part > count)
+    part = count;
+  memcpy (ring->data + offset, buffer, part);
+  memcpy (ring->data, buffer + part, count - part);
+  __sync_synchronize ();
+  ring->head += count;
+
+  if (write (fd, "", 1) < 0)
+    return -1;
+  return count;
+}
+
+/* Copy up to count bytes out of the ring. Waits on the pipe while the
+   ring is empty, so this blocks or fails with EAGAIN just like reading
+   the data from the pipe itself. */
+static ssize_t
+ring_read (Test_Device * test_device, SANE_Byte * data, size_t count)
+{
+  Test_Ring *ring = test_device->ring;
+  size_t avail, offset, part;
+  char wakeup[256];
+  ssize_t bytes_read;
+
+  while ((avail = ring->head - ring->tail) == 0)
+    {
+      bytes_read = read (test_device->pipe, wakeup, sizeof (wakeup));
+      if (bytes_read <= 0)
+	return bytes_read;
+    }
+  __sync_synchronize ();
+
+  if (count > avail)
+    count = avail;
+  offset = ring->tail % ring->size;
+  part = ring->size - offset;
+  if (part > count)
+    part = count;
+  memcpy (data, ring->data + offset, part);
+  memcpy (data + part, ring->data, count - part);
+  __sync_synchronize ();
+  ring->tail += count;
+
+  return count;
+}
+#endif /* TEST_SHARED_MEMORY */
+
+/* usleep () isn't required to support a second or more */
+static void
+model_sleep (SANE_Word usec)
+{
+  while (usec >= 500000)
+    {
+      usleep (500000);
+      usec -= 500000;
+    }
+  if (usec > 0)
+    usleep (usec);
+}
+
+/* (child) Wait until byte_count bytes since start match the transfer rate
+   of the device model */
+static void
+model_pace (Test_Device * test_device, struct timeval *start,
+	    SANE_Word byte_count)
+{
+  struct timeval now;
+  double due, elapsed;
+
+  if (test_device->val[opt_device_model_rate].w == 0)
+    return;
+
+  due = byte_count / (test_device->val[opt_device_model_rate].w * 1024.0);
+  gettimeofday (&now, 0);
+  elapsed = (now.tv_sec - start->tv_sec)
+    + (now.tv_usec - start->tv_usec) / 1000000.0;
+  if (due > elapsed)
+    model_sleep ((SANE_Word) ((due - elapsed) * 1000000.0));
+}
+
 static SANE_Status
 reader_process (Test_Device * test_device, SANE_Int fd)
 {
   SANE_Status status;
-  SANE_Word byte_count = 0, bytes_total;
+  SANE_Word byte_count = 0, bytes_total, burst_size = 0;
   SANE_Byte *buffer = 0;
   ssize_t bytes_written = 0;
-  size_t buffer_size = 0, write_count = 0;
+  size_t buffer_size = 0, write_count = 0, offset;
+  SANE_Bool model = test_device->val[opt_device_model].w;
+  struct timeval start;
 
   DBG (2, "(child) reader_process: test_device=%p, fd=%d\n",
        (void *) test_device, fd);
@@ -1266,18 +1570,43 @@ reader_process (Test_Device * test_device, SANE_Int fd)
   DBG (2, "(child) reader_process: buffer=%p, buffersize=%lu\n",
        buffer, (u_long) buffer_size);
 
+  if (model)
+    {
+      burst_size = test_device->val[opt_device_model_burst_size].w;
+      if (burst_size < 1)
+	burst_size = 1;
+      if (test_device->start_delay > 0)
+	{
+	  DBG (4, "(child) reader_process: waiting %d us before the first "
+	       "data\n", test_device->start_delay);
+	  model_sleep (test_device->start_delay);
+	}
+      gettimeofday (&start, 0);
+    }
+
   while (byte_count < bytes_total)
     {
+      /* the buffer holds either the whole picture or a repeating pattern */
+      offset = byte_count % buffer_size;
       if (write_count == 0)
 	{
-	  write_count = buffer_size;
+	  write_count = buffer_size - offset;
 	  if (byte_count + (SANE_Word) write_count > bytes_total)
 	    write_count = bytes_total - byte_count;
+	  if (model
+	      && byte_count % burst_size + (SANE_Word) write_count > burst_size)
+	    write_count = burst_size - byte_count % burst_size;
 
 	  if (test_device->val[opt_read_delay].w == SANE_TRUE)
 	    usleep (test_device->val[opt_read_delay_duration].w);
 	}
-      bytes_written = write (fd, buffer, write_count);
+#ifdef TEST_SHARED_MEMORY
+      if (test_device->ring)
+	bytes_written = ring_write (test_device->ring, fd, buffer + offset,
+				    write_count);
+      else
+#endif
+	bytes_written = write (fd, buffer + offset, write_count);
       if (bytes_written < 0)
 	{
 	  DBG (1, "(child) reader_process: write returned %s\n",
@@ -1288,6 +1617,10 @@ reader_process (Test_Device * test_device, SANE_Int fd)
       DBG (4, "(child) reader_process: wrote %ld bytes of %lu (%d total)\n",
 	   (long) bytes_written, (u_long) write_count, byte_count);
       write_count -= bytes_written;
+
+      if (model && write_count == 0
+	  && (byte_count % burst_size == 0 || byte_count == bytes_total))
+	model_pace (test_device, &start, byte_count);
     }
 
   free (buffer);
@@ -1377,6 +1710,10 @@ finish_pass (Test_Device * test_device)
 	}
       sanei_thread_invalidate (test_device->reader_pid);
     }
+#ifdef TEST_SHARED_MEMORY
+  if (test_device->ring)
+    ring_destroy (test_device);
+#endif
   /* this happens when running in thread context... */
   if (test_device->reader_fds >= 0)
     {
@@ -1557,6 +1894,28 @@ sane_init (SANE_Int * __sane_unused__ version_code, SANE_Auth_Callback __sane_un
 	  if (read_option (line, "read-delay-duration", param_int,
 			   &init_read_delay_duration) == SANE_STATUS_GOOD)
 	    continue;
+	  if (read_option (line, "device-model", param_bool,
+			   &init_device_model) == SANE_STATUS_GOOD)
+	    continue;
+	  if (read_option (line, "device-model-rate", param_int,
+			   &init_device_model_rate) == SANE_STATUS_GOOD)
+	    continue;
+	  if (read_option (line, "device-model-burst-size", param_int,
+			   &init_device_model_burst_size) == SANE_STATUS_GOOD)
+	    continue;
+	  if (read_option (line, "device-model-warmup", param_int,
+			   &init_device_model_warmup) == SANE_STATUS_GOOD)
+	    continue;
+	  if (read_option (line, "device-model-page-delay", param_int,
+			   &init_device_model_page_delay) == SANE_STATUS_GOOD)
+	    continue;
+	  if (read_option (line, "device-model-adf-pages", param_int,
+			   &init_device_model_adf_pages) == SANE_STATUS_GOOD)
+	    continue;
+	  if (read_option (line, "device-model-shared-memory", param_bool,
+			   &init_device_model_shared_memory)
+	      == SANE_STATUS_GOOD)
+	    continue;
 	  if (read_option (line, "read-status-code", param_string,
 			   &init_read_status_code) == SANE_STATUS_GOOD)
 	    continue;
@@ -1643,6 +2002,7 @@ sane_init (SANE_Int * __sane_unused__ version_code, SANE_Auth_Callback __sane_un
       test_device->cancelled = SANE_FALSE;
       sanei_thread_initialize (test_device->reader_pid);
       test_device->pipe = -1;
+      test_device->ring = 0;
       DBG (4, "sane_init: new device: `%s' is a %s %s %s\n",
 	   test_device->sane.name, test_device->sane.vendor,
 	   test_device->sane.model, test_device->sane.type);
@@ -1969,6 +2329,11 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	case opt_read_limit_size:	/* Int */
 	case opt_ppl_loss:
 	case opt_read_delay_duration:
+	case opt_device_model_rate:
+	case opt_device_model_burst_size:
+	case opt_device_model_warmup:
+	case opt_device_model_page_delay:
+	case opt_device_model_adf_pages:
 	case opt_int:
 	case opt_int_constraint_range:
 	  if (test_device->val[option].w == *(SANE_Int *) value)
@@ -1997,6 +2362,7 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	case opt_invert_endianess:	/* Bool */
 	case opt_non_blocking:
 	case opt_select_fd:
+	case opt_device_model_shared_memory:
 	case opt_bool_soft_select_soft_detect:
 	case opt_bool_soft_select_soft_detect_auto:
 	case opt_bool_soft_select_soft_detect_emulated:
@@ -2195,6 +2561,36 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	       test_device->opt[option].name,
 	       *(SANE_Bool *) value == SANE_TRUE ? "true" : "false");
 	  break;
+	case opt_device_model:
+	  {
+	    int option_number;
+
+	    if (test_device->val[option].w == *(SANE_Bool *) value)
+	      {
+		DBG (4, "sane_control_option: option %d (%s) not changed\n",
+		     option, test_device->opt[option].name);
+		break;
+	      }
+	    test_device->val[option].w = *(SANE_Bool *) value;
+	    myinfo |= SANE_INFO_RELOAD_OPTIONS;
+	    for (option_number = opt_device_model_rate;
+#ifdef TEST_SHARED_MEMORY
+		 option_number <= opt_device_model_shared_memory;
+#else
+		 option_number <= opt_device_model_adf_pages;
+#endif
+		 option_number++)
+	      {
+		if (test_device->val[option].w == SANE_TRUE)
+		  test_device->opt[option_number].cap &= ~SANE_CAP_INACTIVE;
+		else
+		  test_device->opt[option_number].cap |= SANE_CAP_INACTIVE;
+	      }
+	    DBG (4, "sane_control_option: set option %d (%s) to %s\n",
+		 option, test_device->opt[option].name,
+		 *(SANE_Bool *) value == SANE_TRUE ? "true" : "false");
+	  }
+	  break;
 	case opt_enable_test_options:
 	  {
 	    int option_number;
@@ -2258,6 +2654,8 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	case opt_invert_endianess:
 	case opt_read_limit:
 	case opt_read_delay:
+	case opt_device_model:
+	case opt_device_model_shared_memory:
 	case opt_fuzzy_parameters:
 	case opt_non_blocking:
 	case opt_select_fd:
@@ -2289,6 +2687,11 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	case opt_read_limit_size:
 	case opt_ppl_loss:
 	case opt_read_delay_duration:
+	case opt_device_model_rate:
+	case opt_device_model_burst_size:
+	case opt_device_model_warmup:
+	case opt_device_model_page_delay:
+	case opt_device_model_adf_pages:
 	case opt_int:
 	case opt_int_constraint_range:
 	case opt_int_constraint_word_list:
@@ -2485,6 +2888,7 @@ sane_start (SANE_Handle handle)
 {
   Test_Device *test_device = handle;
   int pipe_descriptor[2];
+  SANE_Int adf_pages = 10;
 
   DBG (2, "sane_start: handle=%p\n", handle);
   if (!inited)
@@ -2522,14 +2926,28 @@ sane_start (SANE_Handle handle)
       test_device->number_of_scans++;
       DBG (3, "sane_start: scanning page %d\n", test_device->number_of_scans);
 
+      if (test_device->val[opt_device_model].w == SANE_TRUE)
+	adf_pages = test_device->val[opt_device_model_adf_pages].w;
       if ((strcmp (test_device->val[opt_scan_source].s, "Automatic Document Feeder") == 0) &&
-	  (((test_device->number_of_scans) % 11) == 0))
+	  adf_pages > 0 &&
+	  (((test_device->number_of_scans) % (adf_pages + 1)) == 0))
 	{
 	  DBG (1, "sane_start: Document feeder is out of documents!\n");
 	  return SANE_STATUS_NO_DOCS;
 	}
     }
 
+  test_device->start_delay = 0;
+  if (test_device->val[opt_device_model].w == SANE_TRUE
+      && test_device->pass == 0)
+    {
+      test_device->start_delay =
+	test_device->val[opt_device_model_page_delay].w;
+      if (test_device->number_of_scans == 1)
+	test_device->start_delay +=
+	  test_device->val[opt_device_model_warmup].w;
+    }
+
   test_device->scanning = SANE_TRUE;
   test_device->cancelled = SANE_FALSE;
   test_device->eof = SANE_FALSE;
@@ -2565,6 +2983,20 @@ sane_start (SANE_Handle handle)
   /* create reader routine as new process or thread */
   test_device->pipe = pipe_descriptor[0];
   test_device->reader_fds = pipe_descriptor[1];
+
+#ifdef TEST_SHARED_MEMORY
+  if (test_device->val[opt_device_model].w == SANE_TRUE
+      && test_device->val[opt_device_model_shared_memory].w == SANE_TRUE)
+    {
+      SANE_Status status = ring_create (test_device);
+      if (status != SANE_STATUS_GOOD)
+	{
+	  finish_pass (test_device);
+	  return status;
+	}
+    }
+#endif
+
   test_device->reader_pid =
     sanei_thread_begin (reader_task, (void *) test_device);
 
@@ -2680,7 +3112,12 @@ sane_read (SANE_Handle handle, SANE_Byte * data,
     }
   read_count = max_scan_length;
 
-  bytes_read = read (test_device->pipe, data, read_count);
+#ifdef TEST_SHARED_MEMORY
+  if (test_device->ring)
+    bytes_read = ring_read (test_device, data, read_count);
+  else
+#endif
+    bytes_read = read (test_device->pipe, data, read_count);
   if (bytes_read == 0
       || (bytes_read + test_device->bytes_total >= bytes_total))
     {
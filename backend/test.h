@@ -57,6 +57,19 @@ typedef enum
 }
 parameter_type;
 
+/* Ring buffer shared with the reader process for the device model's
+   shared memory transport. head and tail count the bytes written and
+   read so far, the pipe only carries one wakeup byte per update of
+   head. */
+typedef struct
+{
+  volatile size_t head;
+  volatile size_t tail;
+  size_t size;
+  SANE_Byte *data;
+}
+Test_Ring;
+
 typedef enum
 {
   opt_num_opts = 0,
@@ -75,6 +88,13 @@ typedef enum
   opt_read_limit_size,
   opt_read_delay,
   opt_read_delay_duration,
+  opt_device_model,
+  opt_device_model_rate,
+  opt_device_model_burst_size,
+  opt_device_model_warmup,
+  opt_device_model_page_delay,
+  opt_device_model_adf_pages,
+  opt_device_model_shared_memory,
   opt_read_status_code,
   opt_ppl_loss,
   opt_fuzzy_parameters,
@@ -140,6 +160,8 @@ typedef struct Test_Device
   SANE_Bool cancelled;
   SANE_Bool eof;
   SANE_Int number_of_scans;
+  SANE_Int start_delay;
+  Test_Ring *ring;
 }
 Test_Device;
 
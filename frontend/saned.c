@@ -58,6 +58,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <limits.h>
+#include <stdint.h>
 #ifdef HAVE_LIBC_H
 # include <libc.h>		/* NeXTStep/OpenStep */
 #endif
@@ -66,6 +67,10 @@
 # include <sys/select.h>
 #endif
 
+#ifdef HAVE_LIBZ
+# include <zlib.h>
+#endif
+
 #include <netinet/in.h>
 
 #include <stdarg.h>
@@ -89,7 +94,8 @@
 #else
 /*
  * This replacement poll() using select() is only designed to cover
- * our needs in run_standalone(). It should probably be extended...
+ * our needs in run_standalone() and do_scan(). It should probably be
+ * extended...
  */
 struct pollfd
 {
@@ -100,6 +106,9 @@ struct pollfd
 
 #define POLLIN 0x0001
 #define POLLERR 0x0002
+#define POLLOUT 0x0004
+#define POLLHUP 0x0008
+#define POLLNVAL 0x0010
 
 int
 poll (struct pollfd *ufds, unsigned int nfds, int timeout);
@@ -110,6 +119,7 @@ poll (struct pollfd *ufds, unsigned int nfds, int timeout)
   struct pollfd *fdp;
 
   fd_set rfds;
+  fd_set wfds;
   fd_set efds;
   struct timeval tv;
   int maxfd = 0;
@@ -120,6 +130,7 @@ poll (struct pollfd *ufds, unsigned int nfds, int timeout)
   tv.tv_usec = (timeout - tv.tv_sec * 1000) * 1000;
 
   FD_ZERO (&rfds);
+  FD_ZERO (&wfds);
   FD_ZERO (&efds);
 
   for (i = 0, fdp = ufds; i < nfds; i++, fdp++)
@@ -129,6 +140,9 @@ poll (struct pollfd *ufds, unsigned int nfds, int timeout)
       if (fdp->events & POLLIN)
 	FD_SET (fdp->fd, &rfds);
 
+      if (fdp->events & POLLOUT)
+	FD_SET (fdp->fd, &wfds);
+
       FD_SET (fdp->fd, &efds);
 
       maxfd = (fdp->fd > maxfd) ? fdp->fd : maxfd;
@@ -136,7 +150,7 @@ poll (struct pollfd *ufds, unsigned int nfds, int timeout)
 
   maxfd++;
 
-  ret = select (maxfd, &rfds, NULL, &efds, &tv);
+  ret = select (maxfd, &rfds, &wfds, &efds, timeout < 0 ? NULL : &tv);
 
   if (ret < 0)
     return ret;
@@ -147,6 +161,10 @@ poll (struct pollfd *ufds, unsigned int nfds, int timeout)
 	if (FD_ISSET (fdp->fd, &rfds))
 	  fdp->revents |= POLLIN;
 
+      if (fdp->events & POLLOUT)
+	if (FD_ISSET (fdp->fd, &wfds))
+	  fdp->revents |= POLLOUT;
+
       if (FD_ISSET (fdp->fd, &efds))
 	fdp->revents |= POLLERR;
     }
@@ -155,6 +173,24 @@ poll (struct pollfd *ufds, unsigned int nfds, int timeout)
 }
 #endif /* HAVE_SYS_POLL_H && HAVE_POLL */
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+# define SANED_READ_THREAD
+# if defined(__GNUC__) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L)
+#  define SANED_CLIENT_THREADS
+# endif
+#endif
+
+/* State of the client connection.  There is one copy per thread when
+   clients are served by threads of a single process. */
+#if defined(SANED_CLIENT_THREADS) && defined(__GNUC__)
+# define CLIENT_LOCAL __thread
+#elif defined(SANED_CLIENT_THREADS)
+# define CLIENT_LOCAL _Thread_local
+#else
+# define CLIENT_LOCAL
+#endif
+
 #if WITH_AVAHI
 # include <avahi-client/client.h>
 # include <avahi-client/publish.h>
@@ -223,6 +259,7 @@ static AvahiEntryGroup *avahi_group = NULL;
 
 struct saned_child {
   pid_t pid;
+  int busy;			/* pool worker serving a connection */
   struct saned_child *next;
 };
 struct saned_child *children;
@@ -235,26 +272,75 @@ int numchildren;
 #define SANED_SERVICE_PORT   6566
 #define SANED_SERVICE_PORT_S "6566"
 
+/* size of the buffer holding image data records for the data connection */
+#define DATA_BUFFER_SIZE_MIN     8192
+#define DATA_BUFFER_SIZE_DEFAULT (256 * 1024)
+#define DATA_BUFFER_SIZE_MAX     (16 * 1024 * 1024)
+
+/* minimum free space to start a new data record: the record length, some
+   data and a status record */
+#define DATA_RECORD_MIN_SPACE    (4 + 4096 + 5)
+
+/* smaller data records are never compressed */
+#define DATA_RECORD_MIN_COMPRESS 256
+
+/* how long do_scan() waits before polling a backend without select fd
+   again after a read returned no data (without a reader thread) */
+#define DATA_IDLE_POLL_MS        10
+
 typedef struct
 {
   u_int inuse:1;		/* is this handle in use? */
   u_int scanning:1;		/* are we scanning? */
   u_int docancel:1;		/* cancel the current scan */
+  u_int doclose:1;		/* close the handle once the scan ended */
   SANE_Handle handle;		/* backends handle */
+  SANE_Word desc_generation;	/* option descriptor set sent last */
+  SANE_Word num_desc;
+  uint64_t *desc_hash;		/* fingerprints of the descriptors sent */
+  char *device;			/* device name, for statistics */
+  u_int scans;			/* scans done with this handle */
+  uint64_t scan_bytes;		/* image data of these scans */
+  uint64_t scan_start;		/* time of the last sane_start() */
 }
 Handle;
 
-static SANE_Net_Procedure_Number current_request;
+/* Statistics of a single scan.  Clients send them to the standalone saned
+   through a pipe, so the size must not exceed PIPE_BUF. */
+typedef struct
+{
+  uint64_t bytes_read;		/* image data from the backend */
+  uint64_t bytes_sent;		/* data records sent to the client */
+  uint64_t us_total;		/* from sane_start() to the end of the scan */
+  uint64_t us_first_byte;	/* from sane_start() to the first image data */
+  uint64_t us_backend;		/* waiting for and reading from the backend */
+  uint64_t us_client;		/* waiting for and writing to the client */
+  uint64_t queue_sum;		/* buffered bytes, summed over the samples */
+  uint32_t queue_samples;
+  uint32_t queue_max;		/* most bytes buffered for the client */
+  int32_t status;		/* how the scan ended */
+}
+Scan_Stats;
+
+static CLIENT_LOCAL SANE_Net_Procedure_Number current_request;
 static const char *prog_name;
-static int can_authorize;
-static Wire wire;
-static int num_handles;
+static CLIENT_LOCAL int can_authorize;
+static CLIENT_LOCAL Wire wire;
+static CLIENT_LOCAL int num_handles;
 static int debug;
 static int run_mode;
 static int run_foreground;
 static int run_once;
 static int data_connect_timeout = 4000;
-static Handle *handle;
+static size_t data_buffer_size = DATA_BUFFER_SIZE_DEFAULT;
+static int worker_pool_size;
+static int worker_refresh_interval = 60;
+static int worker_fd[2] = { -1, -1 };	/* busy workers to the parent */
+static int client_threads;	/* max. clients served by threads, 0: fork */
+static int stats_interval;	/* seconds between statistics, 0: none */
+static int stats_fd[2] = { -1, -1 };	/* scan statistics to the parent */
+static CLIENT_LOCAL int compress_data;	/* compress the data records */
+static CLIENT_LOCAL Handle *handle;
 static char *bind_addr;
 static union
 {
@@ -266,15 +352,15 @@ byte_order;
 /* The default-user name.  This is not used to imply any rights.  All
    it does is save a remote user some work by reducing the amount of
    text s/he has to type when authentication is requested.  */
-static const char *default_username = "saned-user";
-static char *remote_ip;
+static CLIENT_LOCAL const char *default_username = "saned-user";
+static CLIENT_LOCAL char *remote_ip;
 
 /* data port range */
 static in_port_t data_port_lo;
 static in_port_t data_port_hi;
 
 #ifdef SANED_USES_AF_INDEP
-static union {
+static CLIENT_LOCAL union {
   struct sockaddr_storage ss;
   struct sockaddr sa;
   struct sockaddr_in sin;
@@ -282,9 +368,9 @@ static union {
   struct sockaddr_in6 sin6;
 #endif
 } remote_address;
-static int remote_address_len;
+static CLIENT_LOCAL int remote_address_len;
 #else
-static struct in_addr remote_address;
+static CLIENT_LOCAL struct in_addr remote_address;
 #endif /* SANED_USES_AF_INDEP */
 
 #ifndef _PATH_HEQUIV
@@ -297,8 +383,106 @@ static const char *config_file_names[] = {
 
 static SANE_Bool log_to_syslog = SANE_TRUE;
 
+/* backend state; pool workers initialize the backends and fetch the device
+   list before a client connects */
+static SANE_Bool backend_initialized = SANE_FALSE;
+static SANE_Status backend_init_status;
+static SANE_Int backend_version_code;
+static const SANE_Device **cached_device_list;
+static time_t cached_device_list_time;
+
+#ifdef SANED_CLIENT_THREADS
+/* Serializes the calls into the backends of the client and reader threads.
+   Scans on several devices read their data concurrently, as sane_read()
+   and sane_cancel() are the only calls that may overlap.  All other calls,
+   e.g. the device list refresh, get exclusive access and wait until the
+   reads in progress returned. */
+static pthread_mutex_t backend_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t backend_cond = PTHREAD_COND_INITIALIZER;
+static int backend_busy;	/* a thread has exclusive access */
+static int backend_waiting;	/* threads waiting for exclusive access */
+static int backend_readers;	/* threads in sane_read() or sane_cancel() */
+static CLIENT_LOCAL int backend_locked;
+
+/* The client threads; they are joined before the backends are shut down */
+typedef struct client_thread_entry
+{
+  pthread_t thread;
+  int fd;			/* control connection, -1 once closed */
+  int done;			/* the thread is about to return */
+  struct client_thread_entry *next;
+}
+Client_Thread;
+
+static pthread_mutex_t client_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Client_Thread *client_list;
+static int num_clients;		/* client threads running */
+static sigset_t stop_signals;	/* SIGINT and SIGTERM, see stop_signal_pending() */
+
+static void
+backend_lock (void)
+{
+  if (!backend_locked)
+    {
+      pthread_mutex_lock (&backend_mutex);
+      ++backend_waiting;
+      while (backend_busy || backend_readers > 0)
+	pthread_cond_wait (&backend_cond, &backend_mutex);
+      --backend_waiting;
+      backend_busy = 1;
+      pthread_mutex_unlock (&backend_mutex);
+      backend_locked = 1;
+    }
+}
+
+static void
+backend_unlock (void)
+{
+  if (backend_locked)
+    {
+      backend_locked = 0;
+      pthread_mutex_lock (&backend_mutex);
+      backend_busy = 0;
+      pthread_cond_broadcast (&backend_cond);
+      pthread_mutex_unlock (&backend_mutex);
+    }
+}
+
+/* Shared access for sane_read() and sane_cancel().  A cancel doesn't wait
+   for the threads that queued for exclusive access, those may be waiting
+   for the read that is to be cancelled. */
+static void
+backend_read_lock (int cancel)
+{
+  pthread_mutex_lock (&backend_mutex);
+  while (backend_busy || (!cancel && backend_waiting > 0))
+    pthread_cond_wait (&backend_cond, &backend_mutex);
+  ++backend_readers;
+  pthread_mutex_unlock (&backend_mutex);
+}
+
+static void
+backend_read_unlock (void)
+{
+  pthread_mutex_lock (&backend_mutex);
+  if (--backend_readers == 0)
+    pthread_cond_broadcast (&backend_cond);
+  pthread_mutex_unlock (&backend_mutex);
+}
+
+static void stop_client_threads (void);
+#else
+# define backend_lock()
+# define backend_unlock()
+# define backend_read_lock(cancel)
+# define backend_read_unlock()
+#endif /* SANED_CLIENT_THREADS */
+
 /* forward declarations: */
 static int process_request (Wire * w);
+static int dispatch_request (Wire * w);
+static void bail_out (int error);
+void sig_int_term_handler (int signum);
 
 #define SANED_RUN_INETD  0
 #define SANED_RUN_ALONE  1
@@ -336,10 +520,47 @@ saned_debug_call (int level, const char *fmt, ...)
 }
 
 
+/* Statistics are logged whatever the debug level is */
+static void
+stats_log (const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start (ap, fmt);
+  if (log_to_syslog)
+    vsyslog (LOG_INFO, fmt, ap);
+  else
+    {
+      fprintf (stderr, "[saned] ");
+      vfprintf (stderr, fmt, ap);
+    }
+  va_end (ap);
+}
+
+/* Microseconds since the epoch, for measuring durations */
+static uint64_t
+stats_now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void
+stats_log_handle (int h)
+{
+  if (stats_interval > 0 && handle[h].scans > 0)
+    stats_log ("stats: handle device=%s scans=%u bytes=%llu\n",
+	       handle[h].device ? handle[h].device : "",
+	       handle[h].scans, (unsigned long long) handle[h].scan_bytes);
+}
+
 static void
 reset_watchdog (void)
 {
-  if (!debug)
+  /* the alarm would end all clients of a threaded saned */
+  if (!debug && !client_threads)
     alarm (3600);
 }
 
@@ -457,11 +678,34 @@ auth_callback (SANE_String_Const res,
   sanei_w_reply (&wire, (WireCodecFunc) sanei_w_word, &ack);
 }
 
+/* Closes the devices of the current client and frees its state */
+static void
+close_client (void)
+{
+  int i;
+
+  backend_lock ();
+  for (i = 0; i < num_handles; ++i)
+    if (handle[i].inuse)
+      {
+	stats_log_handle (i);
+	sane_close (handle[i].handle);
+	free (handle[i].desc_hash);
+	free (handle[i].device);
+      }
+  backend_unlock ();
+
+  sanei_w_exit (&wire);
+  if (handle)
+    free (handle);
+  handle = NULL;
+  num_handles = 0;
+}
+
 static void
 quit (int signum)
 {
   static int running = 0;
-  int i;
 
   if (signum)
     DBG (DBG_ERR, "quit: received signal %d\n", signum);
@@ -473,14 +717,12 @@ quit (int signum)
     }
   running = 1;
 
-  for (i = 0; i < num_handles; ++i)
-    if (handle[i].inuse)
-      sane_close (handle[i].handle);
-
+#ifdef SANED_CLIENT_THREADS
+  /* the backends must not be shut down under the scans of other clients */
+  stop_client_threads ();
+#endif /* SANED_CLIENT_THREADS */
+  close_client ();
   sane_exit ();
-  sanei_w_exit (&wire);
-  if (handle)
-    free (handle);
   DBG (DBG_WARN, "quit: exiting\n");
   if (log_to_syslog)
     closelog ();
@@ -491,7 +733,7 @@ static SANE_Word
 get_free_handle (void)
 {
 # define ALLOC_INCREMENT        16
-  static int h, last_handle_checked = -1;
+  static CLIENT_LOCAL int h, last_handle_checked = -1;
 
   if (num_handles > 0)
     {
@@ -532,7 +774,12 @@ close_handle (int h)
 {
   if (h >= 0 && handle[h].inuse)
     {
+      stats_log_handle (h);
       sane_close (handle[h].handle);
+      free (handle[h].desc_hash);
+      handle[h].desc_hash = NULL;
+      free (handle[h].device);
+      handle[h].device = NULL;
       handle[h].inuse = 0;
     }
 }
@@ -1150,7 +1397,7 @@ check_host (int fd)
   char *netmask;
   char hostname[MAXHOSTNAMELEN];
   char *r_hostname;
-  static struct in_addr config_line_address;
+  static CLIENT_LOCAL struct in_addr config_line_address;
 
   int len;
   FILE *fp;
@@ -1332,6 +1579,43 @@ check_host (int fd)
 
 #endif /* SANED_USES_AF_INDEP */
 
+static SANE_Status
+init_backend (SANE_Int * version_code)
+{
+  if (!backend_initialized)
+    {
+      backend_init_status = sane_init (&backend_version_code, auth_callback);
+      backend_initialized = SANE_TRUE;
+    }
+  *version_code = backend_version_code;
+  return backend_init_status;
+}
+
+/* Returns the device list.  Pool workers keep the list that they fetched
+   while idle for up to worker_refresh_interval seconds. */
+static SANE_Status
+get_device_list (const SANE_Device *** device_list)
+{
+  SANE_Status status;
+
+  if (cached_device_list
+      && time (NULL) - cached_device_list_time < worker_refresh_interval)
+    {
+      DBG (DBG_DBG, "get_device_list: using cached device list\n");
+      *device_list = cached_device_list;
+      return SANE_STATUS_GOOD;
+    }
+
+  cached_device_list = NULL;
+  status = sane_get_devices (device_list, SANE_TRUE);
+  if (status == SANE_STATUS_GOOD && (worker_pool_size > 0 || client_threads > 0))
+    {
+      cached_device_list = *device_list;
+      cached_device_list_time = time (NULL);
+    }
+  return status;
+}
+
 static int
 init (Wire * w)
 {
@@ -1377,6 +1661,14 @@ init (Wire * w)
   if (req.username)
     default_username = strdup (req.username);
 
+#ifdef HAVE_LIBZ
+  if (SANE_VERSION_BUILD (req.version_code) & SANEI_NET_FEATURE_COMPRESSION)
+    {
+      DBG (DBG_MSG, "init: client requested compression\n");
+      compress_data = 1;
+    }
+#endif /* HAVE_LIBZ */
+
   sanei_w_free (w, (WireCodecFunc) sanei_w_init_req, &req);
   if (w->status)
     {
@@ -1386,13 +1678,19 @@ init (Wire * w)
 
   reply.version_code = SANE_VERSION_CODE (V_MAJOR, V_MINOR,
 					  SANEI_NET_PROTOCOL_VERSION);
+  if (compress_data)
+    reply.version_code |= SANEI_NET_FEATURE_COMPRESSION;
+  if (SANE_VERSION_BUILD (req.version_code) & SANEI_NET_FEATURE_OPTION_BATCH)
+    reply.version_code |= SANEI_NET_FEATURE_OPTION_BATCH;
 
   DBG (DBG_WARN, "init: access granted to %s@%s\n",
        default_username, remote_ip);
 
   if (status == SANE_STATUS_GOOD)
     {
-      status = sane_init (&be_version_code, auth_callback);
+      backend_lock ();
+      status = init_backend (&be_version_code);
+      backend_unlock ();
       if (status != SANE_STATUS_GOOD)
 	DBG (DBG_ERR, "init: failed to initialize backend (%s)\n",
 	     sane_strstatus (status));
@@ -1537,6 +1835,7 @@ start_scan (Wire * w, int h, SANE_Start_Reply * reply)
 
   DBG (DBG_MSG, "start_scan: using port %d for data\n", reply->port);
 
+  handle[h].scan_start = stats_now ();
   reply->status = sane_start (be_handle);
   if (reply->status == SANE_STATUS_GOOD)
     {
@@ -1618,6 +1917,7 @@ start_scan (Wire * w, int h, SANE_Start_Reply * reply)
 
   DBG (DBG_MSG, "start_scan: using port %d for data\n", reply->port);
 
+  handle[h].scan_start = stats_now ();
   reply->status = sane_start (be_handle);
   if (reply->status == SANE_STATUS_GOOD)
     {
@@ -1647,14 +1947,316 @@ store_reclen (SANE_Byte * buf, size_t buf_size, int i, size_t reclen)
   return i;
 }
 
+#ifdef HAVE_LIBZ
+/* Replaces the data record at buf + record by a compressed record if that
+   makes it smaller.  Returns the size of the resulting record. */
+static size_t
+compress_record (SANE_Byte * buf, size_t buf_size, size_t record,
+		 size_t record_len, Bytef * zbuf, uLong zbuf_size)
+{
+  uLongf zlen = zbuf_size;
+
+  if (record_len < DATA_RECORD_MIN_COMPRESS
+      || compress2 (zbuf, &zlen, buf + record + 4, record_len,
+		    Z_BEST_SPEED) != Z_OK
+      || zlen + 4 >= record_len)
+    {
+      store_reclen (buf, buf_size, record, record_len);
+      return record_len + 4;
+    }
+
+  store_reclen (buf, buf_size, record, SANEI_NET_RECORD_COMPRESSED | (zlen + 4));
+  store_reclen (buf, buf_size, record + 4, record_len);
+  memcpy (buf + record + 8, zbuf, zlen);
+  DBG (DBG_INFO, "compress_record: compressed %lu bytes to %lu bytes\n",
+       (u_long) record_len, (u_long) zlen);
+  return zlen + 8;
+}
+#endif /* HAVE_LIBZ */
+
+/* Returns non-zero if the backend select fd signals that more data can be
+   read without blocking. */
+static int
+backend_data_ready (int be_fd)
+{
+  struct pollfd pfd;
+
+  if (be_fd < 0)
+    return 0;
+
+  pfd.fd = be_fd;
+  pfd.events = POLLIN;
+  return poll (&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+#ifdef SANED_READ_THREAD
+/* Backends without a select fd are read by a helper thread that calls
+   sane_read() in blocking mode and stores the data in a ring, so that
+   do_scan() can sleep in poll() until the thread wakes it through a
+   pipe.  The thread stops reading while the ring is full.  */
+typedef struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t space;		/* signalled when data was taken out */
+  pthread_cond_t idle;		/* signalled when sane_read() returned */
+  pthread_t thread;
+  SANE_Handle be_handle;
+  SANE_Byte *data;
+  size_t size, head, fill;
+  SANE_Status status;		/* result of the last sane_read() */
+  int stop;
+  int pause;			/* don't start another sane_read() */
+  int reading;			/* the thread is in sane_read() */
+  int wake[2];			/* pipe to wake up do_scan() */
+}
+Read_Ring;
+
+/* The reader of the scan in progress.  Only sane_cancel() may be called
+   while it is in sane_read(), so it is paused for other requests. */
+static CLIENT_LOCAL Read_Ring *scan_ring;
+
+static void *
+read_ring_thread (void *arg)
+{
+  Read_Ring *ring = arg;
+  SANE_Status status;
+  SANE_Int length;
+  size_t tail, nbytes;
+
+  pthread_mutex_lock (&ring->lock);
+  while (!ring->stop && ring->status == SANE_STATUS_GOOD)
+    {
+      if (ring->fill == ring->size || ring->pause)
+	{
+	  pthread_cond_wait (&ring->space, &ring->lock);
+	  continue;
+	}
+
+      tail = (ring->head + ring->fill) % ring->size;
+      nbytes = ring->size - ring->fill;
+      if (nbytes > ring->size - tail)
+	nbytes = ring->size - tail;
+      ring->reading = 1;
+      pthread_mutex_unlock (&ring->lock);
+
+      backend_read_lock (0);
+      status = sane_read (ring->be_handle, ring->data + tail, nbytes, &length);
+      backend_read_unlock ();
+
+      pthread_mutex_lock (&ring->lock);
+      ring->reading = 0;
+      pthread_cond_signal (&ring->idle);
+      if (status == SANE_STATUS_GOOD)
+	ring->fill += length;
+      else
+	ring->status = status;
+      if (write (ring->wake[1], "", 1) < 0 && errno != EAGAIN)
+	DBG (DBG_ERR, "read_ring_thread: can't wake up main thread (%s)\n",
+	     strerror (errno));
+    }
+  pthread_mutex_unlock (&ring->lock);
+  return NULL;
+}
+
+/* Starts the reader thread.  Returns NULL if that isn't possible. */
+static Read_Ring *
+read_ring_start (SANE_Handle be_handle, size_t size)
+{
+  Read_Ring *ring;
+
+  ring = calloc (1, sizeof (*ring));
+  if (!ring)
+    return NULL;
+  ring->data = malloc (size);
+  if (!ring->data || pipe (ring->wake) < 0)
+    {
+      free (ring->data);
+      free (ring);
+      return NULL;
+    }
+  fcntl (ring->wake[0], F_SETFL, O_NONBLOCK);
+  fcntl (ring->wake[1], F_SETFL, O_NONBLOCK);
+
+  ring->be_handle = be_handle;
+  ring->size = size;
+  ring->status = SANE_STATUS_GOOD;
+  pthread_mutex_init (&ring->lock, NULL);
+  pthread_cond_init (&ring->space, NULL);
+  pthread_cond_init (&ring->idle, NULL);
+
+  if (pthread_create (&ring->thread, NULL, read_ring_thread, ring) != 0)
+    {
+      DBG (DBG_ERR, "read_ring_start: can't start reader thread (%s)\n",
+	   strerror (errno));
+      pthread_mutex_destroy (&ring->lock);
+      pthread_cond_destroy (&ring->space);
+      pthread_cond_destroy (&ring->idle);
+      close (ring->wake[0]);
+      close (ring->wake[1]);
+      free (ring->data);
+      free (ring);
+      return NULL;
+    }
+  return ring;
+}
+
+/* Non-zero if read_ring_read() won't return an empty result. */
+static int
+read_ring_ready (Read_Ring * ring)
+{
+  int ready;
+
+  pthread_mutex_lock (&ring->lock);
+  ready = ring->fill > 0 || ring->status != SANE_STATUS_GOOD;
+  pthread_mutex_unlock (&ring->lock);
+  return ready;
+}
+
+/* Non-zero once the reader thread got an error or EOF. */
+static int
+read_ring_finished (Read_Ring * ring)
+{
+  int finished;
+
+  pthread_mutex_lock (&ring->lock);
+  finished = ring->status != SANE_STATUS_GOOD;
+  pthread_mutex_unlock (&ring->lock);
+  return finished;
+}
+
+/* Takes up to MAX_LENGTH bytes out of the ring, like a non-blocking
+   sane_read().  The reader's final status is returned once all data has
+   been taken. */
+static SANE_Status
+read_ring_read (Read_Ring * ring, SANE_Byte * buf, SANE_Int max_length,
+		SANE_Int * length)
+{
+  SANE_Status status = SANE_STATUS_GOOD;
+  size_t nbytes, chunk;
+  char junk[64];
+
+  while (read (ring->wake[0], junk, sizeof (junk)) > 0)
+    ;
+
+  pthread_mutex_lock (&ring->lock);
+  nbytes = ring->fill;
+  if (nbytes > (size_t) max_length)
+    nbytes = max_length;
+  if (nbytes > 0)
+    {
+      chunk = ring->size - ring->head;
+      if (chunk > nbytes)
+	chunk = nbytes;
+      memcpy (buf, ring->data + ring->head, chunk);
+      memcpy (buf + chunk, ring->data, nbytes - chunk);
+      ring->head = (ring->head + nbytes) % ring->size;
+      ring->fill -= nbytes;
+      pthread_cond_signal (&ring->space);
+    }
+  else
+    status = ring->status;
+  pthread_mutex_unlock (&ring->lock);
+
+  *length = nbytes;
+  return status;
+}
+
+/* Waits until the reader thread is out of sane_read() and keeps it from
+   calling it again until read_ring_resume(). */
+static void
+read_ring_pause (Read_Ring * ring)
+{
+  pthread_mutex_lock (&ring->lock);
+  ring->pause = 1;
+  while (ring->reading)
+    pthread_cond_wait (&ring->idle, &ring->lock);
+  pthread_mutex_unlock (&ring->lock);
+}
+
+static void
+read_ring_resume (Read_Ring * ring)
+{
+  pthread_mutex_lock (&ring->lock);
+  ring->pause = 0;
+  pthread_cond_signal (&ring->space);
+  pthread_mutex_unlock (&ring->lock);
+}
+
+/* Stops the reader thread; the caller must have made a blocked
+   sane_read() return by cancelling the scan, unless it already
+   failed.  */
+static void
+read_ring_stop (Read_Ring * ring)
+{
+  pthread_mutex_lock (&ring->lock);
+  ring->stop = 1;
+  pthread_cond_signal (&ring->space);
+  pthread_mutex_unlock (&ring->lock);
+  pthread_join (ring->thread, NULL);
+
+  pthread_mutex_destroy (&ring->lock);
+  pthread_cond_destroy (&ring->space);
+  pthread_cond_destroy (&ring->idle);
+  close (ring->wake[0]);
+  close (ring->wake[1]);
+  free (ring->data);
+  free (ring);
+}
+#endif /* SANED_READ_THREAD */
+
+/* Logs the statistics of a scan and passes them on to the standalone
+   saned, which logs the totals of all clients. */
+static void
+stats_report (int h, Scan_Stats * st)
+{
+  uint64_t kib_per_s = 0;
+
+  handle[h].scans++;
+  handle[h].scan_bytes += st->bytes_read;
+  if (stats_interval <= 0)
+    return;
+
+  if (st->us_total > 0)
+    kib_per_s = st->bytes_read * 1000000 / 1024 / st->us_total;
+  stats_log ("stats: scan device=%s status=%d bytes=%llu sent=%llu ms=%llu "
+	     "first_byte_ms=%llu backend_ms=%llu client_ms=%llu kib_per_s=%llu "
+	     "queue_avg=%llu queue_max=%u\n",
+	     handle[h].device ? handle[h].device : "", st->status,
+	     (unsigned long long) st->bytes_read,
+	     (unsigned long long) st->bytes_sent,
+	     (unsigned long long) st->us_total / 1000,
+	     (unsigned long long) st->us_first_byte / 1000,
+	     (unsigned long long) st->us_backend / 1000,
+	     (unsigned long long) st->us_client / 1000,
+	     (unsigned long long) kib_per_s,
+	     (unsigned long long) (st->queue_samples ?
+				   st->queue_sum / st->queue_samples : 0),
+	     st->queue_max);
+
+  if (stats_fd[1] >= 0 && write (stats_fd[1], st, sizeof (*st)) < 0)
+    DBG (DBG_WARN, "stats_report: can't pass on statistics (%s)\n",
+	 strerror (errno));
+}
+
 static void
 do_scan (Wire * w, int h, int data_fd)
 {
-  int num_fds, be_fd = -1, reader, writer, bytes_in_buf, status_dirty = 0;
+  int be_fd = -1, status_dirty = 0, idle = 0;
+  int nfds, data_idx, be_idx, poll_timeout, ret;
   SANE_Handle be_handle = handle[h].handle;
-  struct timeval tv, *timeout = 0;
-  fd_set rd_set, rd_mask, wr_set, wr_mask;
-  SANE_Byte buf[8192];
+  struct pollfd pfd[3];
+  Scan_Stats stats;
+  uint64_t t;
+  SANE_Byte small_buf[DATA_BUFFER_SIZE_MIN];
+  SANE_Byte *buf;
+  size_t buf_size, reader, writer, bytes_in_buf, record_len;
+#ifdef SANED_READ_THREAD
+  Read_Ring *ring = NULL, *outer_ring = scan_ring;
+#endif /* SANED_READ_THREAD */
+#ifdef HAVE_LIBZ
+  Bytef *zbuf = NULL;
+  uLong zbuf_size = 0;
+#endif /* HAVE_LIBZ */
   SANE_Status status;
   long int nwritten;
   SANE_Int length;
@@ -1662,142 +2264,281 @@ do_scan (Wire * w, int h, int data_fd)
 
   DBG (3, "do_scan: start\n");
 
-  FD_ZERO (&rd_mask);
-  FD_SET (w->io.fd, &rd_mask);
-  num_fds = w->io.fd + 1;
-
-  FD_ZERO (&wr_mask);
-  FD_SET (data_fd, &wr_mask);
-  if (data_fd >= num_fds)
-    num_fds = data_fd + 1;
+  /* The data is stored in a linear buffer: records are appended at reader
+     and sent to the client from writer.  Once all data has been sent both
+     indices are reset to the start of the buffer. */
+  buf_size = data_buffer_size;
+  buf = malloc (buf_size);
+  if (!buf)
+    {
+      DBG (DBG_WARN, "do_scan: could not allocate %lu bytes for data buffer,"
+	   " using %d bytes\n", (u_long) buf_size, DATA_BUFFER_SIZE_MIN);
+      buf = small_buf;
+      buf_size = sizeof (small_buf);
+    }
 
-  sane_set_io_mode (be_handle, SANE_TRUE);
-  if (sane_get_select_fd (be_handle, &be_fd) == SANE_STATUS_GOOD)
+#ifdef HAVE_LIBZ
+  if (compress_data)
     {
-      FD_SET (be_fd, &rd_mask);
-      if (be_fd >= num_fds)
-	num_fds = be_fd + 1;
+      zbuf_size = compressBound (buf_size);
+      zbuf = malloc (zbuf_size);
+      if (!zbuf)
+	DBG (DBG_WARN, "do_scan: could not allocate compression buffer,"
+	     " sending uncompressed data\n");
     }
-  else
+#endif /* HAVE_LIBZ */
+
+  backend_lock ();
+  sane_set_io_mode (be_handle, SANE_TRUE);
+  if (sane_get_select_fd (be_handle, &be_fd) != SANE_STATUS_GOOD)
     {
-      memset (&tv, 0, sizeof (tv));
-      timeout = &tv;
+      be_fd = -1;
+#ifdef SANED_READ_THREAD
+      sane_set_io_mode (be_handle, SANE_FALSE);
+      ring = read_ring_start (be_handle, buf_size);
+      if (ring)
+	{
+	  DBG (DBG_MSG, "do_scan: backend has no select fd, reading it on a"
+	       " separate thread\n");
+	  scan_ring = ring;
+	}
+      else
+	sane_set_io_mode (be_handle, SANE_TRUE);
+#endif /* SANED_READ_THREAD */
     }
+  backend_unlock ();
 
+  memset (&stats, 0, sizeof (stats));
   status = SANE_STATUS_GOOD;
   reader = writer = bytes_in_buf = 0;
   do
     {
-      rd_set = rd_mask;
-      wr_set = wr_mask;
-      if (select (num_fds, &rd_set, &wr_set, 0, timeout) < 0)
+      /* New records are only started when there is room for the record
+	 length, a useful amount of data and a trailing status record. */
+      int can_read = status == SANE_STATUS_GOOD && !status_dirty
+	&& buf_size - reader >= DATA_RECORD_MIN_SPACE;
+      int be_ready = 0;
+
+      nfds = 0;
+      pfd[nfds].fd = w->io.fd;
+      pfd[nfds++].events = POLLIN;
+
+      data_idx = -1;
+      if (bytes_in_buf > 0)
+	{
+	  pfd[nfds].fd = data_fd;
+	  pfd[nfds].events = POLLOUT;
+	  data_idx = nfds++;
+	}
+
+      /* wait for the backend only while there is room for its data */
+      be_idx = -1;
+      poll_timeout = -1;
+      if (can_read && be_fd >= 0)
+	{
+	  pfd[nfds].fd = be_fd;
+	  pfd[nfds].events = POLLIN;
+	  be_idx = nfds++;
+	}
+#ifdef SANED_READ_THREAD
+      else if (can_read && ring)
+	{
+	  if (read_ring_ready (ring))
+	    poll_timeout = 0;
+	  else
+	    {
+	      pfd[nfds].fd = ring->wake[0];
+	      pfd[nfds].events = POLLIN;
+	      be_idx = nfds++;
+	    }
+	}
+#endif /* SANED_READ_THREAD */
+      else if (can_read)
+	poll_timeout = idle ? DATA_IDLE_POLL_MS : 0;
+
+      t = stats_now ();
+      ret = poll (pfd, nfds, poll_timeout);
+      t = stats_now () - t;
+      if (!can_read && bytes_in_buf > 0)
+	stats.us_client += t;	/* buffer full, waiting for the client */
+      else if (can_read && bytes_in_buf == 0)
+	stats.us_backend += t;	/* nothing to send, waiting for data */
+
+      if (ret < 0)
 	{
+	  if (errno == EINTR)
+	    continue;
 	  if (be_fd >= 0 && errno == EBADF)
 	    {
 	      /* This normally happens when a backend closes a select
 		 filedescriptor when reaching the end of file.  So
 		 pass back this status to the client: */
-	      FD_CLR (be_fd, &rd_mask);
 	      be_fd = -1;
 	      /* only set status_dirty if EOF hasn't been already detected */
 	      if (status == SANE_STATUS_GOOD)
 		status_dirty = 1;
 	      status = SANE_STATUS_EOF;
 	      DBG (DBG_INFO, "do_scan: select_fd was closed --> EOF\n");
-	      continue;
+	      memset (pfd, 0, sizeof (pfd));
 	    }
 	  else
 	    {
 	      status = SANE_STATUS_IO_ERROR;
-	      DBG (DBG_ERR, "do_scan: select failed (%s)\n", strerror (errno));
+	      DBG (DBG_ERR, "do_scan: poll failed (%s)\n", strerror (errno));
 	      break;
 	    }
 	}
-
-      if (bytes_in_buf)
+      else
 	{
-	  if (FD_ISSET (data_fd, &wr_set))
+	  if (be_idx >= 0 && be_fd >= 0 && (pfd[be_idx].revents & POLLNVAL))
+	    {
+	      /* same as EBADF above */
+	      be_fd = -1;
+	      if (status == SANE_STATUS_GOOD)
+		status_dirty = 1;
+	      status = SANE_STATUS_EOF;
+	      can_read = 0;
+	      DBG (DBG_INFO, "do_scan: select_fd was closed --> EOF\n");
+	    }
+	  else if (can_read)
+	    be_ready = be_idx < 0 || pfd[be_idx].revents != 0;
+
+	  if (data_idx >= 0 && pfd[data_idx].revents != 0)
 	    {
-	      if (bytes_in_buf > 0)
+	      /* write as much of the buffered records as the socket takes */
+	      nbytes = bytes_in_buf;
+	      DBG (DBG_INFO,
+		   "do_scan: trying to write %lu bytes to client\n",
+		   (u_long) nbytes);
+	      t = stats_now ();
+	      nwritten = write (data_fd, buf + writer, nbytes);
+	      stats.us_client += stats_now () - t;
+	      DBG (DBG_INFO,
+		   "do_scan: wrote %ld bytes to client\n", nwritten);
+	      if (nwritten < 0)
 		{
-		  /* write more input data */
-		  nbytes = bytes_in_buf;
-		  if (writer + nbytes > sizeof (buf))
-		    nbytes = sizeof (buf) - writer;
-		  DBG (DBG_INFO,
-		       "do_scan: trying to write %d bytes to client\n",
-		       nbytes);
-		  nwritten = write (data_fd, buf + writer, nbytes);
-		  DBG (DBG_INFO,
-		       "do_scan: wrote %ld bytes to client\n", nwritten);
-		  if (nwritten < 0)
+		  if (errno == EAGAIN || errno == EINTR)
+		    nwritten = 0;
+		  else
 		    {
 		      DBG (DBG_ERR, "do_scan: write failed (%s)\n",
 			   strerror (errno));
 		      status = SANE_STATUS_CANCELLED;
-	              handle[h].docancel = 1;
+		      handle[h].docancel = 1;
 		      break;
 		    }
-		  bytes_in_buf -= nwritten;
-		  writer += nwritten;
-		  if (writer == sizeof (buf))
-		    writer = 0;
 		}
+	      stats.bytes_sent += nwritten;
+	      bytes_in_buf -= nwritten;
+	      writer += nwritten;
+	      if (bytes_in_buf == 0)
+		reader = writer = 0;
 	    }
-	}
-      else if (status == SANE_STATUS_GOOD
-	       && (timeout || FD_ISSET (be_fd, &rd_set)))
-	{
-	  int i;
 
-	  /* get more input data */
+	  if (be_ready)
+	    {
+	      size_t record = reader;
+
+	      /* get more input data; reserve 4 bytes to store the length of
+		 the data record and 5 bytes for a status record */
+	      reader += 4;
+	      record_len = 0;
+	      do
+		{
+		  nbytes = buf_size - reader - 5;
+		  DBG (DBG_INFO,
+		       "do_scan: trying to read %lu bytes from scanner\n",
+		       (u_long) nbytes);
+		  t = stats_now ();
+#ifdef SANED_READ_THREAD
+		  if (ring)
+		    status = read_ring_read (ring, buf + reader, nbytes,
+					     &length);
+		  else
+#endif /* SANED_READ_THREAD */
+		    {
+		      backend_read_lock (0);
+		      status = sane_read (be_handle, buf + reader, nbytes,
+					  &length);
+		      backend_read_unlock ();
+		    }
+		  DBG (DBG_INFO,
+		       "do_scan: read %d bytes from scanner\n", length);
 
-	  /* reserve 4 bytes to store the length of the data record: */
-	  i = reader;
-	  reader += 4;
-	  if (reader >= (int) sizeof (buf))
-	    reader -= sizeof(buf);
+		  t = stats_now () - t;
+		  stats.us_backend += t;
+		  if (status == SANE_STATUS_GOOD && length > 0)
+		    {
+		      if (stats.bytes_read == 0)
+			stats.us_first_byte = stats_now () - handle[h].scan_start;
+		      stats.bytes_read += length;
+		    }
 
-	  assert (bytes_in_buf == 0);
-	  nbytes = sizeof (buf) - 4;
-	  if (reader + nbytes > sizeof (buf))
-	    nbytes = sizeof (buf) - reader;
+		  reset_watchdog ();
 
-	  DBG (DBG_INFO,
-	       "do_scan: trying to read %d bytes from scanner\n", nbytes);
-	  status = sane_read (be_handle, buf + reader, nbytes, &length);
-	  DBG (DBG_INFO,
-	       "do_scan: read %d bytes from scanner\n", length);
+		  if (status != SANE_STATUS_GOOD)
+		    break;
 
-	  reset_watchdog ();
+		  reader += length;
+		  record_len += length;
+		}
+	      /* batch further reads into the same record as long as the
+		 backend signals that more data is immediately available */
+	      while (length > 0
+		     && buf_size - reader >= DATA_RECORD_MIN_SPACE
+#ifdef SANED_READ_THREAD
+		     && (ring ? read_ring_ready (ring)
+			 : backend_data_ready (be_fd)));
+#else
+		     && backend_data_ready (be_fd));
+#endif /* SANED_READ_THREAD */
 
-	  reader += length;
-	  if (reader >= (int) sizeof (buf))
-	    reader = 0;
-	  bytes_in_buf += length + 4;
+	      idle = record_len == 0;
+	      if (record_len > 0)
+		{
+#ifdef HAVE_LIBZ
+		  if (zbuf)
+		    {
+		      reader = record + compress_record (buf, buf_size, record,
+							 record_len, zbuf,
+							 zbuf_size);
+		      bytes_in_buf += reader - record;
+		    }
+		  else
+#endif /* HAVE_LIBZ */
+		    {
+		      store_reclen (buf, buf_size, record, record_len);
+		      bytes_in_buf += record_len + 4;
+		    }
+		}
+	      else
+		reader = record;	/* restore reader index */
 
-	  if (status != SANE_STATUS_GOOD)
-	    {
-	      reader = i;	/* restore reader index */
-	      status_dirty = 1;
-	      DBG (DBG_MSG,
-		   "do_scan: status = `%s'\n", sane_strstatus(status));
+	      if (status != SANE_STATUS_GOOD)
+		{
+		  status_dirty = 1;
+		  DBG (DBG_MSG,
+		       "do_scan: status = `%s'\n", sane_strstatus(status));
+		}
 	    }
-	  else
-	    store_reclen (buf, sizeof (buf), i, length);
 	}
 
-      if (status_dirty && sizeof (buf) - bytes_in_buf >= 5)
+      if (status_dirty && buf_size - reader >= 5)
 	{
 	  status_dirty = 0;
-	  reader = store_reclen (buf, sizeof (buf), reader, 0xffffffff);
-	  buf[reader] = status;
+	  reader = store_reclen (buf, buf_size, reader, 0xffffffff);
+	  buf[reader++] = status;
 	  bytes_in_buf += 5;
 	  DBG (DBG_MSG, "do_scan: statuscode `%s' was added to buffer\n",
 	       sane_strstatus(status));
 	}
 
-      if (FD_ISSET (w->io.fd, &rd_set))
+      stats.queue_sum += bytes_in_buf;
+      stats.queue_samples++;
+      if (bytes_in_buf > stats.queue_max)
+	stats.queue_max = bytes_in_buf;
+
+      if (pfd[0].revents != 0)
 	{
 	  DBG (DBG_MSG,
 	       "do_scan: processing RPC request on fd %d\n", w->io.fd);
@@ -1811,19 +2552,119 @@ do_scan (Wire * w, int h, int data_fd)
   while (status == SANE_STATUS_GOOD || bytes_in_buf > 0 || status_dirty);
   DBG (DBG_MSG, "do_scan: done, status=%s\n", sane_strstatus (status));
 
-  if(handle[h].docancel)
-    sane_cancel (handle[h].handle);
+  stats.us_total = stats_now () - handle[h].scan_start;
+  stats.status = status;
+  stats_report (h, &stats);
+
+  if (buf != small_buf)
+    free (buf);
+#ifdef HAVE_LIBZ
+  free (zbuf);
+#endif /* HAVE_LIBZ */
+
+#ifdef SANED_READ_THREAD
+  /* a reader that is still running has to be cancelled to return */
+  if (ring && !read_ring_finished (ring))
+    handle[h].docancel = 1;
+#endif /* SANED_READ_THREAD */
+
+  if(handle[h].docancel)
+    {
+      backend_read_lock (1);
+      sane_cancel (handle[h].handle);
+      backend_read_unlock ();
+    }
+
+#ifdef SANED_READ_THREAD
+  if (ring)
+    read_ring_stop (ring);
+  scan_ring = outer_ring;
+#endif /* SANED_READ_THREAD */
 
   handle[h].docancel = 0;
   handle[h].scanning = 0;
+
+  if (handle[h].doclose)
+    close_handle (h);
+}
+
+/* 64 bit FNV-1a, used to find the option descriptors that changed since
+   they were last sent to the client.  */
+#define FNV_OFFSET_BASIS	0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+static uint64_t
+hash_bytes (uint64_t h, const void *data, size_t len)
+{
+  const u_char *p = data;
+
+  while (len--)
+    {
+      h ^= *p++;
+      h *= FNV_PRIME;
+    }
+  return h;
+}
+
+static uint64_t
+hash_string (uint64_t h, SANE_String_Const str)
+{
+  if (!str)
+    return hash_bytes (h, "\377", 1);
+  return hash_bytes (h, str, strlen (str) + 1);
+}
+
+/* Fingerprint of everything sanei_w_option_descriptor() sends.  */
+static uint64_t
+hash_option_descriptor (const SANE_Option_Descriptor * d)
+{
+  uint64_t h = FNV_OFFSET_BASIS;
+  SANE_Word fields[5];
+  int i;
+
+  if (!d)
+    return 0;
+
+  h = hash_string (h, d->name);
+  h = hash_string (h, d->title);
+  h = hash_string (h, d->desc);
+  fields[0] = d->type;
+  fields[1] = d->unit;
+  fields[2] = d->size;
+  fields[3] = d->cap;
+  fields[4] = d->constraint_type;
+  h = hash_bytes (h, fields, sizeof (fields));
+
+  switch (d->constraint_type)
+    {
+    case SANE_CONSTRAINT_RANGE:
+      if (d->constraint.range)
+	h = hash_bytes (h, d->constraint.range, sizeof (SANE_Range));
+      break;
+
+    case SANE_CONSTRAINT_WORD_LIST:
+      if (d->constraint.word_list)
+	h = hash_bytes (h, d->constraint.word_list,
+			(d->constraint.word_list[0] + 1) * sizeof (SANE_Word));
+      break;
+
+    case SANE_CONSTRAINT_STRING_LIST:
+      for (i = 0; d->constraint.string_list
+	   && d->constraint.string_list[i]; ++i)
+	h = hash_string (h, d->constraint.string_list[i]);
+      break;
+
+    default:
+      break;
+    }
+  return h;
 }
 
 static int
 process_request (Wire * w)
 {
-  SANE_Handle be_handle;
-  SANE_Word h, word;
-  int i;
+  SANE_Word word;
+  int ret;
 
   DBG (DBG_DBG, "process_request: waiting for request\n");
   sanei_w_set_dir (w, WIRE_DECODE);
@@ -1840,6 +2681,41 @@ process_request (Wire * w)
 
   DBG (DBG_MSG, "process_request: got request %d\n", current_request);
 
+#ifdef SANED_READ_THREAD
+  if (scan_ring && current_request != SANE_NET_CANCEL)
+    read_ring_pause (scan_ring);
+#endif /* SANED_READ_THREAD */
+
+  if (current_request == SANE_NET_CANCEL)
+    {
+      /* may be called while a read of this client is in progress */
+      backend_read_lock (1);
+      ret = dispatch_request (w);
+      backend_read_unlock ();
+    }
+  else
+    {
+      backend_lock ();
+      ret = dispatch_request (w);
+      backend_unlock ();
+    }
+
+#ifdef SANED_READ_THREAD
+  if (scan_ring)
+    read_ring_resume (scan_ring);
+#endif /* SANED_READ_THREAD */
+  return ret;
+}
+
+/* Handles current_request.  Called with the backends locked, shared only
+   for SANE_NET_CANCEL. */
+static int
+dispatch_request (Wire * w)
+{
+  SANE_Handle be_handle;
+  SANE_Word h;
+  int i;
+
   switch (current_request)
     {
     case SANE_NET_GET_DEVICES:
@@ -1847,8 +2723,7 @@ process_request (Wire * w)
 	SANE_Get_Devices_Reply reply;
 
 	reply.status =
-	  sane_get_devices ((const SANE_Device ***) &reply.device_list,
-			    SANE_TRUE);
+	  get_device_list ((const SANE_Device ***) &reply.device_list);
 	sanei_w_reply (w, (WireCodecFunc) sanei_w_get_devices_reply, &reply);
       }
       break;
@@ -1887,7 +2762,7 @@ process_request (Wire * w)
 	  DBG(DBG_DBG, "process_request: (open) strlen(resource) == 0\n");
 	  free (resource);
 
-	  if ((i = sane_get_devices (&device_list, SANE_TRUE)) !=
+	  if ((i = get_device_list (&device_list)) !=
 	      SANE_STATUS_GOOD)
 	    {
 	      DBG(DBG_ERR, "process_request: (open) sane_get_devices failed\n");
@@ -1940,6 +2815,7 @@ process_request (Wire * w)
 	    else
 	      {
 		handle[h].handle = be_handle;
+		handle[h].device = strdup (name);
 		reply.handle = h;
 	      }
 	  }
@@ -1956,7 +2832,14 @@ process_request (Wire * w)
 	SANE_Word ack = 0;
 
 	h = decode_handle (w, "close");
-	close_handle (h);
+	if (h >= 0 && handle[h].scanning)
+	  {
+	    /* do_scan() still uses the handle, it closes it when done */
+	    handle[h].docancel = 1;
+	    handle[h].doclose = 1;
+	  }
+	else
+	  close_handle (h);
 	sanei_w_reply (w, (WireCodecFunc) sanei_w_word, &ack);
       }
       break;
@@ -2051,6 +2934,165 @@ process_request (Wire * w)
       }
       break;
 
+    case SANE_NET_GET_OPTION_DESCRIPTORS_DELTA:
+      {
+	SANE_Get_Option_Descriptors_Delta_Req req;
+	SANE_Option_Descriptors_Delta_Reply reply;
+	const SANE_Option_Descriptor *desc;
+	SANE_Word num_options = 0;
+	uint64_t *desc_hash, hash;
+	int full;
+
+	sanei_w_get_option_descriptors_delta_req (w, &req);
+	if (w->status || (unsigned) req.handle >= (unsigned) num_handles
+	    || !handle[req.handle].inuse)
+	  {
+	    DBG (DBG_ERR,
+		 "process_request: (get_option_descriptors_delta) "
+		 "error while decoding args h=%d (%s)\n",
+		 req.handle, strerror (w->status));
+	    return 1;
+	  }
+	h = req.handle;
+	be_handle = handle[h].handle;
+	sane_control_option (be_handle, 0, SANE_ACTION_GET_VALUE,
+			     &num_options, 0);
+	if (num_options < 0)
+	  num_options = 0;
+
+	desc_hash = malloc ((num_options + 1) * sizeof (desc_hash[0]));
+	reply.index = malloc ((num_options + 1) * sizeof (reply.index[0]));
+	reply.changed.desc =
+	  malloc ((num_options + 1) * sizeof (reply.changed.desc[0]));
+	if (!desc_hash || !reply.index || !reply.changed.desc)
+	  {
+	    DBG (DBG_ERR, "process_request: (get_option_descriptors_delta) "
+		 "not enough memory for %d options\n", num_options);
+	    free (desc_hash);
+	    free (reply.index);
+	    free (reply.changed.desc);
+	    return -1;
+	  }
+
+	/* send everything if the client is out of sync */
+	full = (req.generation == 0
+		|| req.generation != handle[h].desc_generation
+		|| num_options != handle[h].num_desc
+		|| !handle[h].desc_hash);
+
+	reply.num_changed = 0;
+	for (i = 0; i < num_options; ++i)
+	  {
+	    desc = sane_get_option_descriptor (be_handle, i);
+	    hash = hash_option_descriptor (desc);
+	    desc_hash[i] = hash;
+	    if (full || hash != handle[h].desc_hash[i])
+	      {
+		reply.index[reply.num_changed] = i;
+		reply.changed.desc[reply.num_changed] =
+		  (SANE_Option_Descriptor *) desc;
+		++reply.num_changed;
+	      }
+	  }
+	reply.changed.num_options = reply.num_changed;
+	reply.num_options = num_options;
+
+	if (full || reply.num_changed > 0)
+	  {
+	    if (++handle[h].desc_generation <= 0)
+	      handle[h].desc_generation = 1;
+	  }
+	reply.generation = handle[h].desc_generation;
+	free (handle[h].desc_hash);
+	handle[h].desc_hash = desc_hash;
+	handle[h].num_desc = num_options;
+
+	DBG (DBG_MSG, "process_request: (get_option_descriptors_delta) "
+	     "sending %d of %d descriptors, generation %d\n",
+	     reply.num_changed, num_options, reply.generation);
+
+	sanei_w_reply (w,
+		       (WireCodecFunc) sanei_w_option_descriptors_delta_reply,
+		       &reply);
+
+	free (reply.index);
+	free (reply.changed.desc);
+      }
+      break;
+
+    case SANE_NET_CONTROL_OPTIONS:
+      {
+	SANE_Control_Options_Req req;
+	SANE_Control_Options_Reply reply;
+	SANE_Control_Option_Req *op;
+	const SANE_Option_Descriptor *desc;
+
+	sanei_w_control_options_req (w, &req);
+	if (w->status || (unsigned) req.handle >= (unsigned) num_handles
+	    || !handle[req.handle].inuse)
+	  {
+	    DBG (DBG_ERR,
+		 "process_request: (control_options) "
+		 "error while decoding args h=%d (%s)\n",
+		 req.handle, strerror (w->status));
+	    return 1;
+	  }
+	be_handle = handle[req.handle].handle;
+
+	reply.num_ops = req.num_ops;
+	reply.op = calloc (req.num_ops + 1, sizeof (reply.op[0]));
+	if (!reply.op)
+	  {
+	    DBG (DBG_ERR, "process_request: (control_options) "
+		 "not enough memory for %d operations\n", req.num_ops);
+	    sanei_w_free (w, (WireCodecFunc) sanei_w_control_options_req,
+			  &req);
+	    return -1;
+	  }
+
+	for (i = 0; i < req.num_ops; ++i)
+	  {
+	    op = &req.op[i];
+	    reply.op[i].value_type = op->value_type;
+	    reply.op[i].value_size = op->value_size;
+	    reply.op[i].value = op->value;
+
+	    /* the backend accesses the whole option, make sure the client
+	       sent a value of the right type and enough of it (the codec
+	       ensures the value buffer holds value_size bytes) */
+	    desc = sane_get_option_descriptor (be_handle, op->option);
+	    if (!desc)
+	      {
+		reply.op[i].status = SANE_STATUS_INVAL;
+		continue;
+	      }
+	    if ((op->action == SANE_ACTION_GET_VALUE
+		 || op->action == SANE_ACTION_SET_VALUE)
+		&& desc->type != SANE_TYPE_BUTTON
+		&& desc->type != SANE_TYPE_GROUP
+		&& (op->value_type != (SANE_Word) desc->type || !op->value
+		    || (op->value_size < desc->size
+			&& !(op->action == SANE_ACTION_SET_VALUE
+			     && desc->type == SANE_TYPE_STRING))))
+	      {
+		DBG (DBG_WARN, "process_request: (control_options) "
+		     "rejecting invalid value for option %d\n", op->option);
+		reply.op[i].status = SANE_STATUS_INVAL;
+		continue;
+	      }
+
+	    reply.op[i].status = sane_control_option (be_handle, op->option,
+						      op->action, op->value,
+						      &reply.op[i].info);
+	  }
+
+	sanei_w_reply (w, (WireCodecFunc) sanei_w_control_options_reply,
+		       &reply);
+	free (reply.op);
+	sanei_w_free (w, (WireCodecFunc) sanei_w_control_options_req, &req);
+      }
+      break;
+
     case SANE_NET_GET_PARAMETERS:
       {
 	SANE_Get_Parameters_Reply reply;
@@ -2088,6 +3130,10 @@ process_request (Wire * w)
 
 	sanei_w_reply (w, (WireCodecFunc) sanei_w_start_reply, &reply);
 
+	/* other clients may use the backends while we wait for the data
+	   connection and scan */
+	backend_unlock ();
+
 #ifdef SANED_USES_AF_INDEP
 	if (reply.status == SANE_STATUS_GOOD)
 	  {
@@ -2228,14 +3274,16 @@ process_request (Wire * w)
 
 	    if (data_fd < 0)
 	      {
+		backend_read_lock (1);
 		sane_cancel (handle[h].handle);
+		backend_read_unlock ();
 		handle[h].scanning = 0;
 		handle[h].docancel = 0;
 		DBG (DBG_ERR, "process_request: accept failed! (%s)\n",
 		     strerror (errno));
 		return 1;
 	      }
-	    fcntl (data_fd, F_SETFL, 1);      /* set non-blocking */
+	    fcntl (data_fd, F_SETFL, fcntl (data_fd, F_GETFL, 0) | O_NONBLOCK);
 	    shutdown (data_fd, 0);
 	    do_scan (w, h, data_fd);
 	    close (data_fd);
@@ -2295,7 +3343,7 @@ wait_child (pid_t pid, int *status, int options)
     }
 #endif /* WITH_AVAHI */
 
-  for (c = children; (c != NULL) && (c->next != NULL); p = c, c = c->next)
+  for (c = children; c != NULL; p = c, c = c->next)
     {
       if (c->pid == ret)
 	{
@@ -2329,9 +3377,11 @@ add_child (pid_t pid)
     }
 
   c->pid = pid;
+  c->busy = 0;
   c->next = children;
 
   children = c;
+  numchildren++;
 
   return 0;
 }
@@ -2349,8 +3399,12 @@ handle_connection (int fd)
 
   wire.io.fd = fd;
 
-  signal (SIGALRM, quit);
-  signal (SIGPIPE, quit);
+  /* a client thread must not take the other clients down */
+  if (!client_threads)
+    {
+      signal (SIGALRM, quit);
+      signal (SIGPIPE, quit);
+    }
 
 #ifdef TCP_NODELAY
 # ifdef SOL_TCP
@@ -2401,7 +3455,8 @@ handle_client (int fd)
 	closelog();
 
       for (i = 3; i < fd; i++)
-	close(i);
+	if (i != stats_fd[1])
+	  close(i);
 
       if (log_to_syslog)
 	openlog ("saned", LOG_PID | LOG_CONS, LOG_DAEMON);
@@ -2423,11 +3478,453 @@ handle_client (int fd)
     }
 }
 
+/* Totals of the scans reported to the standalone saned since it last
+   logged them */
+static struct
+{
+  uint64_t scans, failed;
+  uint64_t bytes_read, bytes_sent;
+  uint64_t us_total, us_first_byte, us_backend, us_client;
+  uint32_t queue_max;
+}
+stats_sum;
+static time_t stats_last;
+
+/* Collects the statistics sent by the clients for up to TIMEOUT ms and
+   logs their totals every stats_interval seconds. */
+static void
+stats_poll (int timeout)
+{
+  Scan_Stats st[16];
+  struct pollfd pfd;
+  uint64_t kib_per_s = 0;
+  time_t now;
+  ssize_t n;
+  int i;
+
+  if (stats_fd[0] < 0)
+    return;
+
+  pfd.fd = stats_fd[0];
+  pfd.events = POLLIN;
+  if (poll (&pfd, 1, timeout) > 0)
+    while ((n = read (stats_fd[0], st, sizeof (st))) > 0)
+      for (i = 0; i < n / (ssize_t) sizeof (st[0]); ++i)
+	{
+	  stats_sum.scans++;
+	  if (st[i].status != SANE_STATUS_EOF)
+	    stats_sum.failed++;
+	  stats_sum.bytes_read += st[i].bytes_read;
+	  stats_sum.bytes_sent += st[i].bytes_sent;
+	  stats_sum.us_total += st[i].us_total;
+	  stats_sum.us_first_byte += st[i].us_first_byte;
+	  stats_sum.us_backend += st[i].us_backend;
+	  stats_sum.us_client += st[i].us_client;
+	  if (st[i].queue_max > stats_sum.queue_max)
+	    stats_sum.queue_max = st[i].queue_max;
+	}
+
+  now = time (NULL);
+  if (stats_last == 0)
+    stats_last = now;
+  if (now - stats_last < stats_interval)
+    return;
+
+  if (stats_sum.scans == 0)
+    {
+      stats_last = now;
+      return;
+    }
+
+  if (stats_sum.us_total > 0)
+    kib_per_s = stats_sum.bytes_read * 1000000 / 1024 / stats_sum.us_total;
+  stats_log ("stats: total seconds=%ld scans=%llu failed=%llu bytes=%llu "
+	     "sent=%llu kib_per_s=%llu first_byte_ms_avg=%llu backend_ms=%llu "
+	     "client_ms=%llu queue_max=%u\n", (long) (now - stats_last),
+	     (unsigned long long) stats_sum.scans,
+	     (unsigned long long) stats_sum.failed,
+	     (unsigned long long) stats_sum.bytes_read,
+	     (unsigned long long) stats_sum.bytes_sent,
+	     (unsigned long long) kib_per_s,
+	     (unsigned long long) (stats_sum.scans ?
+				   stats_sum.us_first_byte / 1000
+				   / stats_sum.scans : 0),
+	     (unsigned long long) stats_sum.us_backend / 1000,
+	     (unsigned long long) stats_sum.us_client / 1000,
+	     stats_sum.queue_max);
+  memset (&stats_sum, 0, sizeof (stats_sum));
+  stats_last = now;
+}
+
+#ifdef SANED_CLIENT_THREADS
+static void *
+client_thread (void *arg)
+{
+  Client_Thread *c = arg;
+
+  sanei_w_init (&wire, sanei_codec_bin_init);
+  wire.io.read = read;
+  wire.io.write = write;
+
+  handle_connection (c->fd);
+  close_client ();
+
+  pthread_mutex_lock (&client_mutex);
+  close (c->fd);
+  c->fd = -1;
+  c->done = 1;
+  --num_clients;
+  pthread_mutex_unlock (&client_mutex);
+
+  DBG (DBG_DBG, "client_thread: connection closed\n");
+  return NULL;
+}
+
+/* Joins the client threads that finished, or all of them if ALL is set. */
+static void
+join_client_threads (int all)
+{
+  Client_Thread *c, **prev, *joinable = NULL;
+
+  pthread_mutex_lock (&client_mutex);
+  prev = &client_list;
+  while ((c = *prev) != NULL)
+    {
+      if (all || c->done)
+	{
+	  *prev = c->next;
+	  c->next = joinable;
+	  joinable = c;
+	}
+      else
+	prev = &c->next;
+    }
+  pthread_mutex_unlock (&client_mutex);
+
+  while ((c = joinable) != NULL)
+    {
+      joinable = c->next;
+      pthread_join (c->thread, NULL);
+      free (c);
+    }
+}
+
+/* Ends the connections of all clients and waits for their threads.  Scans
+   in progress notice the closed control connection and are cancelled. */
+static void
+stop_client_threads (void)
+{
+  Client_Thread *c;
+
+  pthread_mutex_lock (&client_mutex);
+  if (client_list)
+    DBG (DBG_MSG, "stop_client_threads: disconnecting %d clients\n",
+	 num_clients);
+  for (c = client_list; c; c = c->next)
+    if (c->fd >= 0)
+      shutdown (c->fd, SHUT_RDWR);
+  pthread_mutex_unlock (&client_mutex);
+
+  join_client_threads (1);
+}
+
+/* SIGINT and SIGTERM are blocked in all threads, as backends may change
+   their handlers (e.g. in a reader thread).  The main thread picks them up
+   here and returns the signal number, or 0 if none is pending. */
+static int
+stop_signal_pending (void)
+{
+  sigset_t pending;
+  int signum;
+
+  if (sigpending (&pending) < 0
+      || (!sigismember (&pending, SIGINT) && !sigismember (&pending, SIGTERM)))
+    return 0;
+  if (sigwait (&stop_signals, &signum) != 0)
+    return 0;
+  return signum;
+}
+
+/* Serves the client on a new thread of this process, which shares the
+   initialized backends with the other clients. */
+static void
+handle_client_thread (int fd)
+{
+  Client_Thread *c;
+  int ret;
+
+  join_client_threads (0);
+
+  pthread_mutex_lock (&client_mutex);
+  if (num_clients >= client_threads)
+    {
+      pthread_mutex_unlock (&client_mutex);
+      DBG (DBG_WARN, "handle_client_thread: %d clients connected already, "
+	   "refusing connection\n", num_clients);
+      close (fd);
+      return;
+    }
+  pthread_mutex_unlock (&client_mutex);
+
+  c = calloc (1, sizeof (*c));
+  if (!c)
+    {
+      DBG (DBG_ERR, "handle_client_thread: not enough memory\n");
+      close (fd);
+      return;
+    }
+  c->fd = fd;
+
+  DBG (DBG_DBG, "handle_client_thread: spawning client thread\n");
+
+  pthread_mutex_lock (&client_mutex);
+  ret = pthread_create (&c->thread, NULL, client_thread, c);
+  if (ret == 0)
+    {
+      c->next = client_list;
+      client_list = c;
+      ++num_clients;
+    }
+  pthread_mutex_unlock (&client_mutex);
+
+  if (ret != 0)
+    {
+      DBG (DBG_ERR, "handle_client_thread: pthread_create() failed: %s\n",
+	   strerror (ret));
+      close (fd);
+      free (c);
+    }
+}
+#endif /* SANED_CLIENT_THREADS */
+
+/* Runs in a pre-forked worker: initializes the backends and then waits for
+   a connection on the shared listening sockets.  While idle, the device
+   list is refreshed every worker_refresh_interval seconds.  A worker serves
+   a single connection and exits afterwards. */
+static void
+run_worker (struct pollfd *fds, int nfds)
+{
+  const SANE_Device **device_list;
+  SANE_Int version_code;
+  struct pollfd *fdp;
+  pid_t parent = getppid ();
+  time_t last_refresh;
+  int fd = -1;
+  int i;
+  int ret;
+
+  /* idle workers may be terminated at any time */
+  signal (SIGINT, quit);
+  signal (SIGTERM, quit);
+
+  if (worker_fd[0] >= 0)
+    close (worker_fd[0]);
+
+  if (init_backend (&version_code) == SANE_STATUS_GOOD)
+    get_device_list (&device_list);
+  last_refresh = time (NULL);
+
+  DBG (DBG_MSG, "run_worker: ready, waiting for control connection\n");
+
+  while (fd < 0)
+    {
+      ret = poll (fds, nfds, 1000);
+      if (ret < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  DBG (DBG_ERR, "run_worker: poll failed: %s\n", strerror (errno));
+	  quit (0);
+	}
+
+      if (ret == 0)
+	{
+	  /* don't keep accepting connections if the daemon is gone */
+	  if (getppid () != parent)
+	    {
+	      DBG (DBG_WARN, "run_worker: parent process exited\n");
+	      quit (0);
+	    }
+
+	  if (backend_init_status == SANE_STATUS_GOOD
+	      && time (NULL) - last_refresh >= worker_refresh_interval)
+	    {
+	      DBG (DBG_DBG, "run_worker: refreshing device list\n");
+	      cached_device_list = NULL;
+	      get_device_list (&device_list);
+	      last_refresh = time (NULL);
+	    }
+	  continue;
+	}
+
+      for (i = 0, fdp = fds; i < nfds; i++, fdp++)
+	{
+	  if (fdp->revents & (POLLERR | POLLHUP | POLLNVAL))
+	    {
+	      DBG (DBG_ERR, "run_worker: invalid fd in set\n");
+	      quit (0);
+	    }
+	  if (! (fdp->revents & POLLIN))
+	    continue;
+
+	  /* the listening sockets are non-blocking, another worker may
+	     have accepted the connection already */
+	  fd = accept (fdp->fd, 0, 0);
+	  if (fd >= 0)
+	    break;
+	  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	    DBG (DBG_ERR, "run_worker: accept failed: %s\n", strerror (errno));
+	}
+    }
+
+  /* let the scan finish when saned is shut down */
+  signal (SIGINT, SIG_IGN);
+  signal (SIGTERM, SIG_IGN);
+
+  /* the parent starts another worker to take our place */
+  if (worker_fd[1] >= 0)
+    {
+      pid_t pid = getpid ();
+
+      if (write (worker_fd[1], &pid, sizeof (pid)) < 0)
+	DBG (DBG_ERR, "run_worker: can't notify parent: %s\n",
+	     strerror (errno));
+      close (worker_fd[1]);
+      worker_fd[1] = -1;
+    }
+
+  fcntl (fd, F_SETFL, fcntl (fd, F_GETFL, 0) & ~O_NONBLOCK);
+
+  for (i = 0, fdp = fds; i < nfds; i++, fdp++)
+    close (fdp->fd);
+  free (fds);
+
+  handle_connection (fd);
+  quit (0);
+}
+
+/* Returns the number of workers waiting for a connection */
+static int
+count_idle_workers (void)
+{
+  struct saned_child *c;
+  int n = 0;
+
+  for (c = children; c != NULL; c = c->next)
+    if (!c->busy)
+      n++;
+  return n;
+}
+
+/* Marks the workers that reported a connection as busy */
+static void
+read_busy_workers (void)
+{
+  struct saned_child *c;
+  pid_t pids[16];
+  ssize_t n;
+  int i;
+
+  while ((n = read (worker_fd[0], pids, sizeof (pids))) > 0)
+    for (i = 0; i < n / (ssize_t) sizeof (pids[0]); ++i)
+      for (c = children; c != NULL; c = c->next)
+	if (c->pid == pids[i])
+	  {
+	    DBG (DBG_DBG, "read_busy_workers: worker %ld accepted a "
+		 "connection\n", (long) c->pid);
+	    c->busy = 1;
+	    break;
+	  }
+}
+
+/* Keeps worker_pool_size idle workers waiting for connections.  Busy
+   workers don't count, they report to the parent when they accept a
+   connection and a new worker is started in their place. */
+static void
+run_worker_pool (struct pollfd *fds, int nfds)
+{
+  struct pollfd pfd[2];
+  struct pollfd *fdp;
+  pid_t pid;
+  int i;
+
+  DBG (DBG_MSG, "run_worker_pool: starting %d workers\n", worker_pool_size);
+
+  for (i = 0, fdp = fds; i < nfds; i++, fdp++)
+    fcntl (fdp->fd, F_SETFL, fcntl (fdp->fd, F_GETFL, 0) | O_NONBLOCK);
+
+  if (pipe (worker_fd) < 0)
+    {
+      DBG (DBG_ERR, "run_worker_pool: can't create worker pipe: %s\n",
+	   strerror (errno));
+      bail_out (1);
+    }
+  fcntl (worker_fd[0], F_SETFL, O_NONBLOCK);
+
+  /* idle workers have to be stopped when saned exits */
+  signal (SIGINT, sig_int_term_handler);
+  signal (SIGTERM, sig_int_term_handler);
+
+  pfd[0].fd = worker_fd[0];
+  pfd[0].events = POLLIN;
+  pfd[1].fd = stats_fd[0];	/* ignored by poll() if there are none */
+  pfd[1].events = POLLIN;
+
+  while (1)
+    {
+      while (count_idle_workers () < worker_pool_size)
+	{
+	  pid = fork ();
+	  if (pid == 0)
+	    {
+	      if (log_to_syslog)
+		{
+		  closelog ();
+		  openlog ("saned", LOG_PID | LOG_CONS, LOG_DAEMON);
+		}
+	      run_worker (fds, nfds);
+	      /* NOT REACHED */
+	    }
+	  else if (pid < 0)
+	    {
+	      DBG (DBG_ERR, "run_worker_pool: fork() failed: %s\n", strerror (errno));
+	      break;
+	    }
+
+	  if (add_child (pid) < 0)
+	    {
+	      kill (pid, SIGTERM);
+	      break;
+	    }
+	}
+
+      /* wake up regularly to reap the workers and to retry spawning
+	 the ones that could not be started */
+      if (poll (pfd, 2, 1000) < 0 && errno != EINTR)
+	{
+	  DBG (DBG_ERR, "run_worker_pool: poll failed: %s\n", strerror (errno));
+	  bail_out (1);
+	}
+
+      read_busy_workers ();
+      stats_poll (0);
+      while (wait_child (-1, NULL, WNOHANG) > 0)
+	;
+    }
+}
+
 static void
 bail_out (int error)
 {
+  struct saned_child *c;
+
   DBG (DBG_ERR, "%sbailing out, waiting for children...\n", (error) ? "FATAL ERROR; " : "");
 
+  /* idle pool workers wait for connections forever; busy ones ignore this */
+  if (worker_pool_size > 0)
+    for (c = children; c != NULL; c = c->next)
+      kill (c->pid, SIGTERM);
+
 #if WITH_AVAHI
   if (avahi_pid > 0)
     kill (avahi_pid, SIGTERM);
@@ -2820,6 +4317,114 @@ read_config (void)
                 DBG (DBG_INFO, "read_config: data connect timeout: %d\n", data_connect_timeout);
               }
             }
+            else if (strstr (config_line, "data_buffer_size") != NULL)
+            {
+              optval = sanei_config_skip_whitespace (++optval);
+              if ((optval != NULL) && (*optval != '\0'))
+              {
+                val = strtol (optval, &endval, 10);
+                if (optval == endval)
+                {
+                  DBG (DBG_ERR, "read_config: invalid value for data_buffer_size\n");
+                  continue;
+                }
+                else if ((val < DATA_BUFFER_SIZE_MIN) || (val > DATA_BUFFER_SIZE_MAX))
+                {
+                  DBG (DBG_ERR, "read_config: data_buffer_size must be between %d and %d\n",
+                       DATA_BUFFER_SIZE_MIN, DATA_BUFFER_SIZE_MAX);
+                  continue;
+                }
+                data_buffer_size = val;
+                DBG (DBG_INFO, "read_config: data buffer size: %lu\n",
+                     (u_long) data_buffer_size);
+              }
+            }
+            else if (strstr (config_line, "worker_pool_refresh") != NULL)
+            {
+              optval = sanei_config_skip_whitespace (++optval);
+              if ((optval != NULL) && (*optval != '\0'))
+              {
+                val = strtol (optval, &endval, 10);
+                if (optval == endval)
+                {
+                  DBG (DBG_ERR, "read_config: invalid value for worker_pool_refresh\n");
+                  continue;
+                }
+                else if ((val < 1) || (val > 86400))
+                {
+                  DBG (DBG_ERR, "read_config: worker_pool_refresh is invalid\n");
+                  continue;
+                }
+                worker_refresh_interval = val;
+                DBG (DBG_INFO, "read_config: worker pool refresh interval: %d\n",
+                     worker_refresh_interval);
+              }
+            }
+            else if (strstr (config_line, "stats_interval") != NULL)
+            {
+              optval = sanei_config_skip_whitespace (++optval);
+              if ((optval != NULL) && (*optval != '\0'))
+              {
+                val = strtol (optval, &endval, 10);
+                if (optval == endval)
+                {
+                  DBG (DBG_ERR, "read_config: invalid value for stats_interval\n");
+                  continue;
+                }
+                else if ((val < 0) || (val > 86400))
+                {
+                  DBG (DBG_ERR, "read_config: stats_interval must be between 0 and 86400\n");
+                  continue;
+                }
+                stats_interval = val;
+                DBG (DBG_INFO, "read_config: statistics interval: %d\n", stats_interval);
+              }
+            }
+            else if (strstr (config_line, "client_threads") != NULL)
+            {
+              optval = sanei_config_skip_whitespace (++optval);
+              if ((optval != NULL) && (*optval != '\0'))
+              {
+                val = strtol (optval, &endval, 10);
+                if (optval == endval)
+                {
+                  DBG (DBG_ERR, "read_config: invalid value for client_threads\n");
+                  continue;
+                }
+                else if ((val < 0) || (val > 1024))
+                {
+                  DBG (DBG_ERR, "read_config: client_threads must be between 0 and 1024\n");
+                  continue;
+                }
+#ifdef SANED_CLIENT_THREADS
+                client_threads = val;
+                DBG (DBG_INFO, "read_config: client threads: %d\n", client_threads);
+#else
+                DBG (DBG_ERR, "read_config: client_threads is not supported "
+                     "by this saned\n");
+#endif /* SANED_CLIENT_THREADS */
+              }
+            }
+            else if (strstr (config_line, "worker_pool") != NULL)
+            {
+              optval = sanei_config_skip_whitespace (++optval);
+              if ((optval != NULL) && (*optval != '\0'))
+              {
+                val = strtol (optval, &endval, 10);
+                if (optval == endval)
+                {
+                  DBG (DBG_ERR, "read_config: invalid value for worker_pool\n");
+                  continue;
+                }
+                else if ((val < 0) || (val > 64))
+                {
+                  DBG (DBG_ERR, "read_config: worker_pool must be between 0 and 64\n");
+                  continue;
+                }
+                worker_pool_size = val;
+                DBG (DBG_INFO, "read_config: worker pool size: %d\n", worker_pool_size);
+              }
+            }
         }
       fclose (fp);
       DBG (DBG_INFO, "read_config: done reading config\n");
@@ -3228,10 +4833,62 @@ run_standalone (char *user)
   /* NOT REACHED (Avahi process) */
 #endif /* WITH_AVAHI */
 
+  if (stats_interval > 0)
+    {
+      /* clients send the statistics of their scans through this pipe */
+      if (pipe (stats_fd) < 0)
+	{
+	  DBG (DBG_ERR, "run_standalone: can't create statistics pipe: %s\n",
+	       strerror (errno));
+	  stats_fd[0] = stats_fd[1] = -1;
+	}
+      else
+	{
+	  fcntl (stats_fd[0], F_SETFL, O_NONBLOCK);
+	  fcntl (stats_fd[1], F_SETFL, O_NONBLOCK);
+	}
+    }
+
+  if (client_threads > 0)
+    {
+      const SANE_Device **device_list;
+      SANE_Int version_code;
+
+      /* clients get the backends initialized already */
+      DBG (DBG_MSG, "run_standalone: serving up to %d clients on threads\n",
+	   client_threads);
+      signal (SIGPIPE, SIG_IGN);
+#ifdef SANED_CLIENT_THREADS
+      /* the clients are disconnected before the backends are shut down,
+	 the threads created from now on inherit the signal mask */
+      sigemptyset (&stop_signals);
+      sigaddset (&stop_signals, SIGINT);
+      sigaddset (&stop_signals, SIGTERM);
+      pthread_sigmask (SIG_BLOCK, &stop_signals, NULL);
+#endif /* SANED_CLIENT_THREADS */
+      if (init_backend (&version_code) == SANE_STATUS_GOOD)
+	get_device_list (&device_list);
+    }
+  else if (worker_pool_size > 0 && run_once == SANE_FALSE)
+    {
+      run_worker_pool (fds, nfds);
+      /* NOT REACHED */
+    }
+
   DBG (DBG_MSG, "run_standalone: waiting for control connection\n");
 
   while (1)
     {
+#ifdef SANED_CLIENT_THREADS
+      if (client_threads > 0 && (ret = stop_signal_pending ()) != 0)
+	{
+	  DBG (DBG_ERR, "run_standalone: received signal %d\n", ret);
+	  stop_client_threads ();
+	  sane_exit ();
+	  bail_out (0);
+	}
+#endif /* SANED_CLIENT_THREADS */
+
       ret = poll (fds, nfds, 500);
       if (ret < 0)
 	{
@@ -3249,6 +4906,8 @@ run_standalone (char *user)
       while (wait_child (-1, NULL, WNOHANG) > 0)
 	;
 
+      stats_poll (0);
+
       if (ret == 0)
 	continue;
 
@@ -3279,7 +4938,12 @@ run_standalone (char *user)
 	      continue;
 	    }
 
-	  handle_client (fd);
+#ifdef SANED_CLIENT_THREADS
+	  if (client_threads > 0)
+	    handle_client_thread (fd);
+	  else
+#endif /* SANED_CLIENT_THREADS */
+	    handle_client (fd);
 
 	  if (run_once == SANE_TRUE)
 	    break; /* We have handled the only connection we're going to handle */
@@ -3479,6 +5143,10 @@ main (int argc, char *argv[])
 
   read_config ();
 
+  /* only a standalone saned serving more than one client uses threads */
+  if (run_mode != SANED_RUN_ALONE || run_once == SANE_TRUE)
+    client_threads = 0;
+
   byte_order.w = 0;
   byte_order.ch = 1;
 
@@ -42,6 +42,14 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#define SCANIMAGE_MMAP
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#define SCANIMAGE_BATCH_THREADS
+#endif
 
 #ifdef HAVE_LIBPNG
 #include <png.h>
@@ -71,8 +79,9 @@ typedef struct
   uint8_t *data;
   int width;    /*WARNING: this is in bytes, get pixel width from param*/
   int height;
-  int x;
-  int y;
+  size_t size;	/* bytes allocated for data */
+  size_t fill;	/* bytes of data written so far */
+  FILE *file;	/* temporary file data is mapped from, if any */
 }
 Image;
 
@@ -84,6 +93,7 @@ Image;
 #define OPTION_BATCH_INCREMENT	1006
 #define OPTION_BATCH_PROMPT    1007
 #define OPTION_BATCH_PRINT     1008
+#define OPTION_BATCH_THREADS   1009
 
 #define BATCH_COUNT_UNLIMITED -1
 
@@ -106,6 +116,7 @@ static struct option basic_options[] = {
   {"batch-increment", required_argument, NULL, OPTION_BATCH_INCREMENT},
   {"batch-print", no_argument, NULL, OPTION_BATCH_PRINT},
   {"batch-prompt", no_argument, NULL, OPTION_BATCH_PROMPT},
+  {"batch-threads", required_argument, NULL, OPTION_BATCH_THREADS},
   {"format", required_argument, NULL, OPTION_FORMAT},
   {"accept-md5-only", no_argument, NULL, OPTION_MD5},
   {"icc-profile", required_argument, NULL, 'i'},
@@ -120,7 +131,11 @@ static struct option basic_options[] = {
 #define OUTPUT_JPEG     4
 
 #define BASE_OPTSTRING	"d:hi:Lf:o:B::nvVTAbp"
-#define STRIP_HEIGHT	256	/* # lines we increment image height */
+#define STRIP_HEIGHT	256	/* # lines we initially allocate for images
+				   of unknown height */
+/* buffered images larger than this are kept in a memory mapped
+   temporary file instead of on the heap */
+#define IMAGE_MMAP_THRESHOLD	(256 * 1024 * 1024)
 
 static struct option *all_options;
 static int option_number_len;
@@ -1274,45 +1289,229 @@ write_jpeg_header (SANE_Frame format, int width, int height, int dpi, FILE *ofp,
 }
 #endif
 
-static void *
-advance (Image * image)
+#ifdef SCANIMAGE_MMAP
+/* Maps size bytes of the temporary file backing image, creating the file
+   if needed.  */
+static uint8_t *
+image_map_file (Image * image, size_t size)
+{
+  void *data;
+
+  if (!image->file)
+    image->file = tmpfile ();
+  if (!image->file || ftruncate (fileno (image->file), size) < 0)
+    return NULL;
+
+  data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	       fileno (image->file), 0);
+  return data == MAP_FAILED ? NULL : data;
+}
+#endif
+
+/* Makes sure that at least size bytes of image data are allocated.  The
+   buffer grows geometrically, so that scans of unknown height don't
+   reallocate the whole image every few lines.  Very large images are
+   moved to a memory mapped temporary file.  */
+static uint8_t *
+image_reserve (Image * image, size_t size)
 {
-  if (++image->x >= image->width)
+  size_t new_size;
+  uint8_t *data;
+
+  if (size <= image->size)
+    return image->data;
+
+  new_size = image->size * 2;
+  if (new_size < size)
+    new_size = size;
+  if (image->width > 0)
+    new_size = (new_size + image->width - 1) / image->width * image->width;
+
+#ifdef SCANIMAGE_MMAP
+  if (new_size > IMAGE_MMAP_THRESHOLD)
     {
-      image->x = 0;
-      if (++image->y >= image->height || !image->data)
+      if (image->file)
 	{
-	  size_t old_size = 0, new_size;
+	  /* the data lives in the file, so just map more of it */
+	  munmap (image->data, image->size);
+	  image->data = image_map_file (image, new_size);
+	  if (!image->data)
+	    {
+	      fprintf (stderr, "%s: can't map image buffer (%lu bytes)\n",
+		       prog_name, (unsigned long) new_size);
+	      return NULL;
+	    }
+	  image->size = new_size;
+	  return image->data;
+	}
 
+      data = image_map_file (image, new_size);
+      if (data)
+	{
 	  if (image->data)
-	    old_size = image->height * image->width;
+	    memcpy (data, image->data, image->size);
+	  free (image->data);
+	  image->data = data;
+	  image->size = new_size;
+	  return data;
+	}
+      /* fall back to the heap */
+      if (image->file)
+	{
+	  fclose (image->file);
+	  image->file = NULL;
+	}
+    }
+#endif
 
-	  image->height += STRIP_HEIGHT;
-	  new_size = image->height * image->width;
+  data = realloc (image->data, new_size);
+  if (!data)
+    {
+      fprintf (stderr, "%s: can't allocate image buffer (%lu bytes)\n",
+	       prog_name, (unsigned long) new_size);
+      return NULL;
+    }
+  memset (data + image->size, 0, new_size - image->size);
+  image->data = data;
+  image->size = new_size;
+  return data;
+}
 
-	  if (image->data)
-	    image->data = realloc (image->data, new_size);
-	  else
-	    image->data = malloc (new_size);
-	  if (image->data)
-	    memset (image->data + old_size, 0, new_size - old_size);
+static void
+image_free (Image * image)
+{
+#ifdef SCANIMAGE_MMAP
+  if (image->file)
+    {
+      if (image->data)
+	munmap (image->data, image->size);
+      fclose (image->file);
+      image->file = NULL;
+      image->data = NULL;
+      return;
+    }
+#endif
+  free (image->data);
+  image->data = NULL;
+}
+
+/* Writes an image buffered by scan_it() in the selected output format.  */
+static SANE_Status
+write_image (Image * image, const SANE_Parameters * parm, FILE * ofp)
+{
+  size_t size = (size_t) image->height * image->width;
+#ifdef HAVE_LIBPNG
+  png_structp png_ptr;
+  png_infop info_ptr;
+  png_bytep pngbuf;
+#endif
+#ifdef HAVE_LIBJPEG
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  JSAMPLE *jpegbuf;
+#endif
+  int y;
+
+#if !defined(WORDS_BIGENDIAN)
+  /* multibyte pnm file may need byte swap to LE */
+  /* FIXME: other bit depths? */
+  if (output_format != OUTPUT_TIFF && parm->depth == 16)
+    {
+      size_t i;
+      for (i = 0; i + 1 < size; i += 2)
+	{
+	  unsigned char LSB;
+	  LSB = image->data[i];
+	  image->data[i] = image->data[i + 1];
+	  image->data[i + 1] = LSB;
+	}
+    }
+#endif
+
+  switch (output_format)
+    {
+    case OUTPUT_TIFF:
+      sanei_write_tiff_header (parm->format, parm->pixels_per_line,
+			       image->height, parm->depth, resolution_value,
+			       icc_profile, ofp);
+      fwrite (image->data, 1, size, ofp);
+      break;
+
+    case OUTPUT_PNM:
+      write_pnm_header (parm->format, parm->pixels_per_line,
+			image->height, parm->depth, ofp);
+      fwrite (image->data, 1, size, ofp);
+      break;
+
+#ifdef HAVE_LIBPNG
+    case OUTPUT_PNG:
+      write_png_header (parm->format, parm->pixels_per_line,
+			image->height, parm->depth, resolution_value,
+			icc_profile, ofp, &png_ptr, &info_ptr);
+      pngbuf = malloc (image->width);
+      for (y = 0; y < image->height; y++)
+	{
+	  memcpy (pngbuf, image->data + (size_t) y * image->width,
+		  image->width);
+	  if (parm->depth == 1)
+	    {
+	      int j;
+	      for (j = 0; j < image->width; j++)
+		pngbuf[j] = ~pngbuf[j];
+	    }
+	  png_write_row (png_ptr, pngbuf);
 	}
+      png_write_end (png_ptr, info_ptr);
+      png_destroy_write_struct (&png_ptr, &info_ptr);
+      free (pngbuf);
+      break;
+#endif
+
+#ifdef HAVE_LIBJPEG
+    case OUTPUT_JPEG:
+      write_jpeg_header (parm->format, parm->pixels_per_line,
+			 image->height, resolution_value, ofp, &cinfo, &jerr);
+      jpegbuf = malloc (parm->depth == 1 ? image->width * 8 : image->width);
+      for (y = 0; y < image->height; y++)
+	{
+	  JSAMPLE *row = image->data + (size_t) y * image->width;
+	  if (parm->depth == 1)
+	    {
+	      int col1, col8;
+	      for (col1 = 0; col1 < image->width; col1++)
+		for (col8 = 0; col8 < 8; col8++)
+		  jpegbuf[col1 * 8 + col8] =
+		    row[col1] & (1 << (8 - col8 - 1)) ? 0 : 0xff;
+	      row = jpegbuf;
+	    }
+	  jpeg_write_scanlines (&cinfo, &row, 1);
+	}
+      jpeg_finish_compress (&cinfo);
+      jpeg_destroy_compress (&cinfo);
+      free (jpegbuf);
+      break;
+#endif
     }
-  if (!image->data)
-    fprintf (stderr, "%s: can't allocate image buffer (%dx%d)\n",
-	     prog_name, image->width, image->height);
-  return image->data;
+
+  if (fflush (ofp) != 0 || ferror (ofp))
+    return SANE_STATUS_IO_ERROR;
+  return SANE_STATUS_GOOD;
 }
 
+/* Scans one image and writes it to ofp.  If out is given, the whole
+   image is buffered and returned in out and out_parm instead of being
+   written; the caller has to write it with write_image() and free it
+   with image_free().  */
 static SANE_Status
-scan_it (FILE *ofp)
+scan_it (FILE *ofp, Image * out, SANE_Parameters * out_parm)
 {
   int i, len, first_frame = 1, offset = 0, must_buffer = 0;
+  size_t frame_fill = 0;
   uint64_t hundred_percent = 0;
   SANE_Byte min = 0xff, max = 0;
   SANE_Parameters parm;
   SANE_Status status;
-  Image image = { 0, 0, 0, 0, 0 };
+  Image image = { 0, 0, 0, 0, 0, 0 };
   static const char *format_name[] = {
     "gray", "RGB", "red", "green", "blue"
   };
@@ -1321,14 +1520,17 @@ scan_it (FILE *ofp)
 #ifdef HAVE_LIBPNG
   int pngrow = 0;
   png_bytep pngbuf = NULL;
-  png_structp png_ptr;
-  png_infop info_ptr;
+  png_structp png_ptr = NULL;
+  png_infop info_ptr = NULL;
 #endif
 #ifdef HAVE_LIBJPEG
   int jpegrow = 0;
   JSAMPLE *jpegbuf = NULL;
   struct jpeg_compress_struct cinfo;
   struct jpeg_error_mgr jerr;
+
+  /* the cleanup may be reached before the header is written */
+  memset (&cinfo, 0, sizeof (cinfo));
 #endif
 
   do
@@ -1397,7 +1599,7 @@ scan_it (FILE *ofp)
 	    case SANE_FRAME_GRAY:
 	      assert ((parm.depth == 1) || (parm.depth == 8)
 		      || (parm.depth == 16));
-	      if (parm.lines < 0)
+	      if (parm.lines < 0 || out)
 		{
 		  must_buffer = 1;
 		  offset = 0;
@@ -1452,18 +1654,14 @@ scan_it (FILE *ofp)
 		 case, we need to buffer all data before we can write
 		 the image.  */
 	      image.width = parm.bytes_per_line;
-
-	      if (parm.lines >= 0)
-		/* See advance(); we allocate one extra line so we
-		   don't end up realloc'ing in when the image has been
-		   filled in.  */
-		image.height = parm.lines - STRIP_HEIGHT + 1;
-	      else
-		image.height = 0;
-
-	      image.x = image.width - 1;
-	      image.y = -1;
-	      if (!advance (&image))
+	      if (parm.format >= SANE_FRAME_RED
+		  && parm.format <= SANE_FRAME_BLUE)
+		/* separate frames are interleaved into one RGB image */
+		image.width *= 3;
+
+	      if (!image_reserve (&image, (size_t) image.width
+				  * (parm.lines >= 0 ? parm.lines
+				     : STRIP_HEIGHT)))
 		{
 		  status = SANE_STATUS_NO_MEM;
 		  goto cleanup;
@@ -1475,8 +1673,8 @@ scan_it (FILE *ofp)
 	  assert (parm.format >= SANE_FRAME_RED
 		  && parm.format <= SANE_FRAME_BLUE);
 	  offset = parm.format - SANE_FRAME_RED;
-	  image.x = image.y = 0;
 	}
+      frame_fill = 0;
       hundred_percent = ((uint64_t)parm.bytes_per_line) * parm.lines
 	* ((parm.format == SANE_FRAME_RGB || parm.format == SANE_FRAME_GRAY) ? 1:3);
 
@@ -1505,7 +1703,7 @@ scan_it (FILE *ofp)
 		{
 		  fprintf (stderr, "%s: sane_read: %s\n",
 			   prog_name, sane_strstatus (status));
-		  return status;
+		  goto cleanup;
 		}
 	      break;
 	    }
@@ -1517,42 +1715,32 @@ scan_it (FILE *ofp)
 		case SANE_FRAME_RED:
 		case SANE_FRAME_GREEN:
 		case SANE_FRAME_BLUE:
-		  for (i = 0; i < len; ++i)
-		    {
-		      image.data[offset + 3 * i] = buffer[i];
-		      if (!advance (&image))
-			{
-			  status = SANE_STATUS_NO_MEM;
-			  goto cleanup;
-			}
-		    }
-		  offset += 3 * len;
-		  break;
+		  {
+		    uint8_t *dst;
 
-		case SANE_FRAME_RGB:
-		  for (i = 0; i < len; ++i)
-		    {
-		      image.data[offset + i] = buffer[i];
-		      if (!advance (&image))
-			  {
-			    status = SANE_STATUS_NO_MEM;
-			    goto cleanup;
-			  }
-		    }
-		  offset += len;
+		    if (!image_reserve (&image, 3 * (frame_fill + len)))
+		      {
+			status = SANE_STATUS_NO_MEM;
+			goto cleanup;
+		      }
+		    dst = image.data + offset + 3 * frame_fill;
+		    for (i = 0; i < len; ++i)
+		      dst[3 * i] = buffer[i];
+		    frame_fill += len;
+		    if (image.fill < 3 * frame_fill)
+		      image.fill = 3 * frame_fill;
+		  }
 		  break;
 
+		case SANE_FRAME_RGB:
 		case SANE_FRAME_GRAY:
-		  for (i = 0; i < len; ++i)
+		  if (!image_reserve (&image, image.fill + len))
 		    {
-		      image.data[offset + i] = buffer[i];
-		      if (!advance (&image))
-			  {
-			    status = SANE_STATUS_NO_MEM;
-			    goto cleanup;
-			  }
+		      status = SANE_STATUS_NO_MEM;
+		      goto cleanup;
 		    }
-		  offset += len;
+		  memcpy (image.data + image.fill, buffer, len);
+		  image.fill += len;
 		  break;
 
                 default:
@@ -1681,79 +1869,46 @@ scan_it (FILE *ofp)
 
   if (must_buffer)
     {
-      image.height = image.y;
-
-      switch(output_format) {
-      case OUTPUT_TIFF:
-	sanei_write_tiff_header (parm.format, parm.pixels_per_line,
-				 image.height, parm.depth, resolution_value,
-				 icc_profile, ofp);
-      break;
-      case OUTPUT_PNM:
-	write_pnm_header (parm.format, parm.pixels_per_line,
-                          image.height, parm.depth, ofp);
-      break;
-#ifdef HAVE_LIBPNG
-      case OUTPUT_PNG:
-	write_png_header (parm.format, parm.pixels_per_line,
-			  image.height, parm.depth, resolution_value,
-			  icc_profile, ofp, &png_ptr, &info_ptr);
-      break;
-#endif
-#ifdef HAVE_LIBJPEG
-      case OUTPUT_JPEG:
-	write_jpeg_header (parm.format, parm.pixels_per_line,
-			   parm.lines, resolution_value,
-			   ofp, &cinfo, &jerr);
-      break;
-#endif
-      }
-
-#if !defined(WORDS_BIGENDIAN)
-      /* multibyte pnm file may need byte swap to LE */
-      /* FIXME: other bit depths? */
-      if (output_format != OUTPUT_TIFF && parm.depth == 16)
+      image.height = image.fill / image.width;
+      if (out)
 	{
-	  int i;
-	  for (i = 0; i < image.height * image.width; i += 2)
-	    {
-	      unsigned char LSB;
-	      LSB = image.data[i];
-	      image.data[i] = image.data[i + 1];
-	      image.data[i + 1] = LSB;
-	    }
+	  /* the caller writes the image */
+	  *out = image;
+	  *out_parm = parm;
+	  memset (&image, 0, sizeof (image));
 	}
-#endif
-
-	fwrite (image.data, 1, image.height * image.width, ofp);
+      else
+	status = write_image (&image, &parm, ofp);
     }
 #ifdef HAVE_LIBPNG
-    if(output_format == OUTPUT_PNG)
+    if(output_format == OUTPUT_PNG && !must_buffer)
 	png_write_end(png_ptr, info_ptr);
 #endif
 #ifdef HAVE_LIBJPEG
-    if(output_format == OUTPUT_JPEG)
+    if(output_format == OUTPUT_JPEG && !must_buffer)
 	jpeg_finish_compress(&cinfo);
 #endif
 
   /* flush the output buffer */
-  fflush( ofp );
+  if (ofp)
+    fflush( ofp );
 
 cleanup:
 #ifdef HAVE_LIBPNG
   if(output_format == OUTPUT_PNG) {
-    png_destroy_write_struct(&png_ptr, &info_ptr);
+    if (!must_buffer)
+      png_destroy_write_struct(&png_ptr, &info_ptr);
     free(pngbuf);
   }
 #endif
 #ifdef HAVE_LIBJPEG
   if(output_format == OUTPUT_JPEG) {
-    jpeg_destroy_compress(&cinfo);
+    if (!must_buffer)
+      jpeg_destroy_compress(&cinfo);
     free(jpegbuf);
   }
 #endif
-  if (image.data)
-    free (image.data);
+  image_free (&image);
 
 
   expected_bytes = ((uint64_t)parm.bytes_per_line) * parm.lines *
@@ -1773,6 +1928,226 @@ cleanup:
   return status;
 }
 
+#ifdef SCANIMAGE_BATCH_THREADS
+/* Pipelined batch mode: pages are scanned into memory on the main thread
+   and written by a pool of threads, so that the scanner does not have to
+   wait while a page is compressed.  */
+
+#define PAGE_QUEUED	0
+#define PAGE_WRITING	1
+#define PAGE_DONE	2
+
+typedef struct
+{
+  Image image;
+  SANE_Parameters parm;
+  char path[PATH_MAX];
+  char part_path[PATH_MAX];
+  int state;
+  SANE_Status status;
+}
+Page;
+
+static struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;		/* signalled on any change of the pages */
+  pthread_t *threads;
+  int num_threads;
+  Page *pages;			/* ring of pages in flight, oldest first */
+  int size;
+  int first;
+  int count;
+  int quit;
+  int print;			/* print file names like --batch-print */
+  SANE_Status status;		/* first error writing a page */
+}
+pipeline;
+
+static void
+write_page (Page * page)
+{
+  FILE *fp;
+
+  fp = fopen (page->part_path, "w");
+  if (!fp)
+    {
+      fprintf (stderr, "cannot open %s\n", page->part_path);
+      page->status = SANE_STATUS_ACCESS_DENIED;
+      return;
+    }
+  page->status = write_image (&page->image, &page->parm, fp);
+  if (0 != fclose (fp) || page->status != SANE_STATUS_GOOD)
+    {
+      fprintf (stderr, "cannot write image file %s\n", page->part_path);
+      unlink (page->part_path);
+      page->status = SANE_STATUS_ACCESS_DENIED;
+      return;
+    }
+  /* let the fully written file show up */
+  if (rename (page->part_path, page->path))
+    {
+      fprintf (stderr, "cannot rename %s to %s\n", page->part_path,
+	       page->path);
+      page->status = SANE_STATUS_ACCESS_DENIED;
+    }
+}
+
+static void *
+pipeline_thread (void *arg)
+{
+  (void) arg;
+
+  pthread_mutex_lock (&pipeline.lock);
+  for (;;)
+    {
+      Page *page = NULL;
+      int i;
+
+      for (i = 0; i < pipeline.count; i++)
+	{
+	  Page *p = &pipeline.pages[(pipeline.first + i) % pipeline.size];
+	  if (p->state == PAGE_QUEUED)
+	    {
+	      page = p;
+	      break;
+	    }
+	}
+      if (!page)
+	{
+	  if (pipeline.quit)
+	    break;
+	  pthread_cond_wait (&pipeline.cond, &pipeline.lock);
+	  continue;
+	}
+
+      page->state = PAGE_WRITING;
+      pthread_mutex_unlock (&pipeline.lock);
+      write_page (page);
+      pthread_mutex_lock (&pipeline.lock);
+      page->state = PAGE_DONE;
+      pthread_cond_broadcast (&pipeline.cond);
+    }
+  pthread_mutex_unlock (&pipeline.lock);
+  return NULL;
+}
+
+/* Removes the written pages at the start of the ring, in page order.
+   Must be called with the lock held.  */
+static void
+pipeline_retire (void)
+{
+  while (pipeline.count > 0
+	 && pipeline.pages[pipeline.first].state == PAGE_DONE)
+    {
+      Page *page = &pipeline.pages[pipeline.first];
+
+      if (page->status != SANE_STATUS_GOOD)
+	{
+	  if (pipeline.status == SANE_STATUS_GOOD)
+	    pipeline.status = page->status;
+	}
+      else if (pipeline.print)
+	{
+	  fprintf (stdout, "%s\n", page->path);
+	  fflush (stdout);
+	}
+      image_free (&page->image);
+      pipeline.first = (pipeline.first + 1) % pipeline.size;
+      pipeline.count--;
+    }
+}
+
+static int
+pipeline_start (int num_threads, int print)
+{
+  int i;
+
+  pthread_mutex_init (&pipeline.lock, NULL);
+  pthread_cond_init (&pipeline.cond, NULL);
+  /* one page waiting for each thread in addition to the ones being
+     written keeps the threads busy without holding too many pages */
+  pipeline.size = 2 * num_threads;
+  pipeline.pages = calloc (pipeline.size, sizeof (Page));
+  pipeline.threads = calloc (num_threads, sizeof (pthread_t));
+  pipeline.first = pipeline.count = pipeline.quit = 0;
+  pipeline.print = print;
+  pipeline.status = SANE_STATUS_GOOD;
+  pipeline.num_threads = 0;
+  if (!pipeline.pages || !pipeline.threads)
+    return 0;
+
+  for (i = 0; i < num_threads; i++)
+    {
+      if (pthread_create (&pipeline.threads[i], NULL, pipeline_thread,
+			  NULL) != 0)
+	break;
+      pipeline.num_threads++;
+    }
+  return pipeline.num_threads > 0;
+}
+
+/* Hands a scanned page over to the writer threads, waiting while the
+   maximum number of pages is in flight.  Returns the status of the pages
+   written so far.  */
+static SANE_Status
+pipeline_submit (Image * image, SANE_Parameters * parm, const char *path,
+		 const char *part_path)
+{
+  Page *page;
+  SANE_Status status;
+
+  pthread_mutex_lock (&pipeline.lock);
+  pipeline_retire ();
+  while (pipeline.count == pipeline.size)
+    {
+      pthread_cond_wait (&pipeline.cond, &pipeline.lock);
+      pipeline_retire ();
+    }
+
+  page = &pipeline.pages[(pipeline.first + pipeline.count) % pipeline.size];
+  page->image = *image;
+  page->parm = *parm;
+  strcpy (page->path, path);
+  strcpy (page->part_path, part_path);
+  page->state = PAGE_QUEUED;
+  page->status = SANE_STATUS_GOOD;
+  pipeline.count++;
+  memset (image, 0, sizeof (*image));
+
+  pthread_cond_broadcast (&pipeline.cond);
+  status = pipeline.status;
+  pthread_mutex_unlock (&pipeline.lock);
+  return status;
+}
+
+/* Waits until all pages are written and stops the threads.  */
+static SANE_Status
+pipeline_finish (void)
+{
+  int i;
+
+  pthread_mutex_lock (&pipeline.lock);
+  pipeline.quit = 1;
+  pthread_cond_broadcast (&pipeline.cond);
+  pipeline_retire ();
+  while (pipeline.count > 0)
+    {
+      pthread_cond_wait (&pipeline.cond, &pipeline.lock);
+      pipeline_retire ();
+    }
+  pthread_mutex_unlock (&pipeline.lock);
+
+  for (i = 0; i < pipeline.num_threads; i++)
+    pthread_join (pipeline.threads[i], NULL);
+  free (pipeline.threads);
+  free (pipeline.pages);
+  pthread_mutex_destroy (&pipeline.lock);
+  pthread_cond_destroy (&pipeline.cond);
+  return pipeline.status;
+}
+#endif /* SCANIMAGE_BATCH_THREADS */
+
 #define clean_buffer(buf,size)	memset ((buf), 0x23, size)
 
 static void
@@ -1800,7 +2175,7 @@ test_it (void)
   int i, len;
   SANE_Parameters parm;
   SANE_Status status;
-  Image image = { 0, 0, 0, 0, 0 };
+  Image image = { 0, 0, 0, 0, 0, 0 };
   static const char *format_name[] =
     { "gray", "RGB", "red", "green", "blue" };
 
@@ -2021,6 +2396,7 @@ main (int argc, char **argv)
   int batch_count = BATCH_COUNT_UNLIMITED;
   int batch_start_at = 1;
   int batch_increment = 1;
+  int batch_threads = 0;
   SANE_Status status;
   char *full_optstring;
   SANE_Int version_code;
@@ -2106,6 +2482,9 @@ main (int argc, char **argv)
 	  batch_count = atoi (optarg);
 	  batch = 1;
 	  break;
+	case OPTION_BATCH_THREADS:
+	  batch_threads = atoi (optarg);
+	  break;
 	case OPTION_FORMAT:
 	  if (strcmp (optarg, "tiff") == 0)
 	    output_format = OUTPUT_TIFF;
@@ -2298,7 +2677,9 @@ Parameters are separated by a blank from single-character options (e.g.\n\
     --batch-double         increment page number by two, same as\n\
                            --batch-increment=2\n\
     --batch-print          print image filenames to stdout\n\
-    --batch-prompt         ask for pressing a key before scanning a page\n");
+    --batch-prompt         ask for pressing a key before scanning a page\n\
+    --batch-threads=#      write pages on # threads while the next page\n\
+                           is scanned\n");
       printf ("\
     --accept-md5-only      only accept authorization requests using md5\n\
 -p, --progress             print progress messages\n\
@@ -2578,6 +2959,7 @@ List of available devices:", prog_name);
   if (test == 0)
     {
       int n = batch_start_at;
+      SANE_Status write_status = SANE_STATUS_GOOD;
 
       if (batch && NULL == format)
 	{
@@ -2635,6 +3017,24 @@ List of available devices:", prog_name);
 
       buffer = malloc (buffer_size);
 
+#ifdef SCANIMAGE_BATCH_THREADS
+      if (batch && batch_threads > 0
+	  && !pipeline_start (batch_threads, batch_print))
+	{
+	  fprintf (stderr, "%s: can't start writer threads, writing pages "
+		   "while scanning\n", prog_name);
+	  pipeline_finish ();
+	  batch_threads = 0;
+	}
+#else
+      if (batch && batch_threads > 0)
+	{
+	  fprintf (stderr, "%s: --batch-threads is not supported on this "
+		   "platform\n", prog_name);
+	  batch_threads = 0;
+	}
+#endif
+
       do
 	{
 	  char path[PATH_MAX];
@@ -2692,6 +3092,23 @@ List of available devices:", prog_name);
 	    }
 
 
+#ifdef SCANIMAGE_BATCH_THREADS
+	  if (batch && batch_threads > 0)
+	    {
+	      Image image;
+	      SANE_Parameters parm;
+
+	      memset (&image, 0, sizeof (image));
+	      status = scan_it (NULL, &image, &parm);
+	      fprintf (stderr, "Scanned page %d.", n);
+	      fprintf (stderr, " (scanner status = %d)\n", status);
+	      if (status == SANE_STATUS_GOOD || status == SANE_STATUS_EOF)
+		status = pipeline_submit (&image, &parm, path, part_path);
+	      n += batch_increment;
+	      continue;
+	    }
+#endif
+
 	  /* write to .part file while scanning is in progress */
 	  if (batch)
 	    {
@@ -2703,7 +3120,7 @@ List of available devices:", prog_name);
 		}
 	    }
 
-	  status = scan_it (ofp);
+	  status = scan_it (ofp, NULL, NULL);
 	  if (batch)
 	    {
 	      fprintf (stderr, "Scanned page %d.", n);
@@ -2777,6 +3194,11 @@ List of available devices:", prog_name);
 	      && (batch_count == BATCH_COUNT_UNLIMITED || --batch_count))
 	     && SANE_STATUS_GOOD == status);
 
+#ifdef SCANIMAGE_BATCH_THREADS
+      if (batch && batch_threads > 0)
+	write_status = pipeline_finish ();
+#endif
+
       if (batch)
 	{
 	  int num_pgs = (n - batch_start_at) / batch_increment;
@@ -2789,6 +3211,8 @@ List of available devices:", prog_name);
 	  && (batch_count == BATCH_COUNT_UNLIMITED)
 	  && n > batch_start_at)
 	status = SANE_STATUS_GOOD;
+      if (write_status != SANE_STATUS_GOOD)
+	status = write_status;
 
       sane_cancel (device);
     }
@@ -22,6 +22,19 @@
 
 #define SANEI_NET_PROTOCOL_VERSION	3
 
+/* Optional protocol features.  The client requests them by setting bits in
+   the build number of the SANE_NET_INIT version code, the server replies
+   with the bits of the features it has enabled.  The protocol version is
+   kept in the low byte of the build number.  */
+#define SANEI_NET_PROTOCOL_VERSION_MASK	0xff
+#define SANEI_NET_FEATURE_COMPRESSION	0x100
+#define SANEI_NET_FEATURE_OPTION_BATCH	0x200
+
+/* If compression is enabled, data records that have this bit set in their
+   length contain the 4 byte length of the uncompressed data followed by the
+   data compressed with zlib.  Other records are stored uncompressed.  */
+#define SANEI_NET_RECORD_COMPRESSED	0x80000000
+
 typedef enum
   {
     SANE_NET_LITTLE_ENDIAN = 0x1234,
@@ -41,7 +54,10 @@ typedef enum
     SANE_NET_START,
     SANE_NET_CANCEL,
     SANE_NET_AUTHORIZE,
-    SANE_NET_EXIT
+    SANE_NET_EXIT,
+    /* only if SANEI_NET_FEATURE_OPTION_BATCH is enabled: */
+    SANE_NET_GET_OPTION_DESCRIPTORS_DELTA,
+    SANE_NET_CONTROL_OPTIONS
   }
 SANE_Net_Procedure_Number;
 
@@ -103,6 +119,44 @@ typedef struct
   }
 SANE_Control_Option_Reply;
 
+/* The server numbers the descriptor sets it sends for a handle.  A client
+   that passes the generation it received last only gets the descriptors
+   that changed since then, all others get the complete set.  */
+typedef struct
+  {
+    SANE_Word handle;
+    SANE_Word generation;	/* 0 if the client has no descriptors */
+  }
+SANE_Get_Option_Descriptors_Delta_Req;
+
+typedef struct
+  {
+    SANE_Word generation;
+    SANE_Word num_options;	/* total number of options */
+    SANE_Word num_changed;
+    SANE_Word *index;		/* option numbers of the changed options */
+    SANE_Option_Descriptor_Array changed;
+  }
+SANE_Option_Descriptors_Delta_Reply;
+
+/* Several control_option calls in one request.  They are executed in
+   order and can't be authorized.  The handle of the individual
+   operations is ignored.  */
+typedef struct
+  {
+    SANE_Word handle;
+    SANE_Word num_ops;
+    SANE_Control_Option_Req *op;
+  }
+SANE_Control_Options_Req;
+
+typedef struct
+  {
+    SANE_Word num_ops;
+    SANE_Control_Option_Reply *op;
+  }
+SANE_Control_Options_Reply;
+
 typedef struct
   {
     SANE_Status status;
@@ -136,6 +190,14 @@ extern void sanei_w_option_descriptor_array (Wire *w,
 extern void sanei_w_control_option_req (Wire *w, SANE_Control_Option_Req *req);
 extern void sanei_w_control_option_reply (Wire *w,
 					  SANE_Control_Option_Reply *reply);
+extern void sanei_w_get_option_descriptors_delta_req
+  (Wire *w, SANE_Get_Option_Descriptors_Delta_Req *req);
+extern void sanei_w_option_descriptors_delta_reply
+  (Wire *w, SANE_Option_Descriptors_Delta_Reply *reply);
+extern void sanei_w_control_options_req (Wire *w,
+					 SANE_Control_Options_Req *req);
+extern void sanei_w_control_options_reply (Wire *w,
+					   SANE_Control_Options_Reply *reply);
 extern void sanei_w_get_parameters_reply (Wire *w,
 					  SANE_Get_Parameters_Reply *reply);
 extern void sanei_w_start_reply (Wire *w, SANE_Start_Reply *reply);
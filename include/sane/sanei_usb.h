@@ -195,7 +195,11 @@ struct sanei_usb_dev_descriptor
     prepend all output commands before that node before an output command is
     encountered.
 
-    @param path Path to the XML data file.
+    The data file may also be a binary capture (see sanei_usb_capture.h),
+    which is replayed from a memory mapping instead of being loaded as a
+    whole. The development mode is only supported for XML data files.
+
+    @param path Path to the XML or binary data file.
     @param development_mode Enables development mode.
  */
 extern SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
@@ -206,7 +210,11 @@ extern SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
  * Initializes sanei_usb for recording communication with the scanner. This
  * function must be called before sanei_usb_init().
  *
- * @param path Path to the XML data file.
+ * If path ends with ".bin", the communication is written incrementally to a
+ * binary capture (see sanei_usb_capture.h) instead of an XML file. Binary
+ * captures can be converted with tools/sane-usb-capture-convert.
+ *
+ * @param path Path to the XML or binary data file.
  * @param be_name The name of the backend to enable recording for.
  */
 extern SANE_Status sanei_usb_testing_enable_record(SANE_String_Const path,
@@ -224,6 +232,11 @@ extern SANE_String sanei_usb_testing_get_backend();
  */
 extern SANE_Bool sanei_usb_is_replay_mode_enabled();
 
+/** Returns SANE_TRUE if record testing mode is enabled, i.e. whether the communication with the
+ * scanner is being captured.
+ */
+extern SANE_Bool sanei_usb_is_record_mode_enabled();
+
 /** Records a debug message in the captured USB data if testing mode is enabled. If testing mode
  * is not enabled, this function does nothing.
  *
@@ -0,0 +1,228 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   SANE is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   SANE is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with sane; see the file COPYING.  If not, write to the Free
+   Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+*/
+
+/** @file sanei_usb_capture.h
+ * Binary format for USB captures recorded and replayed by sanei_usb.
+ *
+ * The XML captures written by sanei_usb_testing_enable_record() store the
+ * payload of every transfer as hex text and are kept in memory as a whole.
+ * The binary format stores the same information as a sequence of
+ * length-prefixed records, so that a capture can be written while the
+ * scanner is running and replayed straight from a memory mapping.
+ *
+ * A file starts with the 8 byte magic #SANEI_USB_CAPTURE_MAGIC followed by
+ * a 32 bit version. Each record consists of a header of
+ * #SANEI_USB_CAPTURE_HEADER_SIZE bytes and a payload of the size given in
+ * the header. All integers are stored in little endian byte order.
+ *
+ * The records describing the device (#SANEI_USB_CAPTURE_DEVICE,
+ * #SANEI_USB_CAPTURE_INTERFACE and #SANEI_USB_CAPTURE_ENDPOINT) come first,
+ * followed by the transactions in the order they happened.
+ *
+ * @sa sanei_usb.h
+ */
+
+#ifndef sanei_usb_capture_h
+#define sanei_usb_capture_h
+
+#include "../include/sane/config.h"
+#include "../include/sane/sane.h"
+
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+#include <stdlib.h> /* for size_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Magic bytes at the start of a binary capture file */
+#define SANEI_USB_CAPTURE_MAGIC "SANEUSB\032"
+/** Version of the binary capture format */
+#define SANEI_USB_CAPTURE_VERSION 1
+/** Size of the file header in bytes */
+#define SANEI_USB_CAPTURE_FILE_HEADER_SIZE 12
+/** Size of a record header in bytes */
+#define SANEI_USB_CAPTURE_HEADER_SIZE 28
+
+/** @name Record types */
+/* @{ */
+/** Backend name (payload), vendor (arg 0) and product (arg 1) ID */
+#define SANEI_USB_CAPTURE_DEVICE              1
+/** Interface number (arg 0) of configuration number (arg 1) */
+#define SANEI_USB_CAPTURE_INTERFACE           2
+/** Transfer type (arg 0) and address (arg 1) of an endpoint of the last
+    interface */
+#define SANEI_USB_CAPTURE_ENDPOINT            3
+/** Control transfer: bmRequestType (arg 0), bRequest (arg 1), wValue and
+    wIndex (arg 2, low and high 16 bits), wLength (arg 3) */
+#define SANEI_USB_CAPTURE_CONTROL             4
+/** Bulk transfer, arg 0 holds the wanted size of unknown reads */
+#define SANEI_USB_CAPTURE_BULK                5
+/** Interrupt transfer, arg 0 holds the wanted size of unknown reads */
+#define SANEI_USB_CAPTURE_INTERRUPT           6
+/** Device descriptor: descriptor type, device class, sub class and
+    protocol (arg 0, one byte each), bcdUSB (arg 1), bcdDevice (arg 2),
+    maximum packet size (arg 3) */
+#define SANEI_USB_CAPTURE_GET_DESCRIPTOR      7
+/** Debug message (payload) */
+#define SANEI_USB_CAPTURE_DEBUG               8
+/** Marks the end of the known commands for the development mode */
+#define SANEI_USB_CAPTURE_KNOWN_COMMANDS_END  9
+/* @} */
+
+/** @name Record flags */
+/* @{ */
+/** The transfer or endpoint direction is IN */
+#define SANEI_USB_CAPTURE_FLAG_IN          0x01
+/** The transfer failed with a timeout */
+#define SANEI_USB_CAPTURE_FLAG_TIMEOUT     0x02
+/** The data of the read is unknown (not recorded yet) */
+#define SANEI_USB_CAPTURE_FLAG_UNKNOWN     0x04
+/** Break into the debugger when this transaction is replayed */
+#define SANEI_USB_CAPTURE_FLAG_DEBUG_BREAK 0x08
+/* @} */
+
+/** A single record of a binary capture */
+typedef struct
+{
+  unsigned type;     /**< one of the record types */
+  unsigned flags;    /**< combination of the record flags */
+  unsigned endpoint; /**< endpoint number of transfers */
+  unsigned seq;      /**< sequence number, 0 if none */
+  uint32_t arg[4];   /**< type dependent arguments */
+  size_t size;       /**< size of the payload */
+  const SANE_Byte *data; /**< payload, valid until the next read */
+}
+sanei_usb_capture_record;
+
+/** Opaque type of binary capture files */
+typedef struct sanei_usb_capture sanei_usb_capture;
+
+/** Check whether a file is a binary capture.
+ *
+ * @param path path of the file
+ *
+ * @return SANE_TRUE if the file starts with the binary capture magic
+ */
+extern SANE_Bool sanei_usb_capture_is_binary (SANE_String_Const path);
+
+/** Create a binary capture file for writing.
+ *
+ * Records are buffered and appended to the file as they are written, so
+ * the capture never has to be held in memory.
+ *
+ * @param path path of the file
+ *
+ * @return the capture or NULL on error
+ */
+extern sanei_usb_capture *sanei_usb_capture_create (SANE_String_Const path);
+
+/** Open a binary capture file for reading.
+ *
+ * The file is mapped into memory where possible and the payloads of the
+ * records point directly into the mapping.
+ *
+ * @param path path of the file
+ *
+ * @return the capture or NULL if the file can't be read or isn't a binary
+ * capture
+ */
+extern sanei_usb_capture *sanei_usb_capture_open (SANE_String_Const path);
+
+/** Append a record to a capture created by sanei_usb_capture_create().
+ *
+ * @return SANE_STATUS_GOOD or SANE_STATUS_IO_ERROR
+ */
+extern SANE_Status sanei_usb_capture_write (sanei_usb_capture * capture,
+                                            const sanei_usb_capture_record *
+                                            record);
+
+/** Read the next record of a capture opened by sanei_usb_capture_open().
+ *
+ * @return SANE_STATUS_GOOD, SANE_STATUS_EOF at the end of the capture or
+ * SANE_STATUS_INVAL if the file is truncated
+ */
+extern SANE_Status sanei_usb_capture_read (sanei_usb_capture * capture,
+                                           sanei_usb_capture_record * record);
+
+/** Get the read position of a capture, to return to it later with
+ * sanei_usb_capture_seek().
+ */
+extern size_t sanei_usb_capture_tell (sanei_usb_capture * capture);
+
+/** Set the read position of a capture to a value returned by
+ * sanei_usb_capture_tell().
+ */
+extern void sanei_usb_capture_seek (sanei_usb_capture * capture,
+                                    size_t offset);
+
+/** Close a capture. Pending records of written captures are flushed.
+ *
+ * @return SANE_STATUS_GOOD or SANE_STATUS_IO_ERROR if writing failed
+ */
+extern SANE_Status sanei_usb_capture_close (sanei_usb_capture * capture);
+
+/** Convert an XML capture into a binary one.
+ *
+ * The XML file is parsed as a stream, so its size is not limited by the
+ * available memory.
+ *
+ * @return SANE_STATUS_GOOD, SANE_STATUS_UNSUPPORTED without libxml2 or
+ * another error status
+ */
+extern SANE_Status sanei_usb_capture_from_xml (SANE_String_Const xml_path,
+                                               SANE_String_Const path);
+
+/** Convert a binary capture into an XML one in the format written by the
+ * XML recorder.
+ *
+ * @return SANE_STATUS_GOOD, SANE_STATUS_UNSUPPORTED without libxml2 or
+ * another error status
+ */
+extern SANE_Status sanei_usb_capture_to_xml (SANE_String_Const path,
+                                             SANE_String_Const xml_path);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* sanei_usb_capture_h */
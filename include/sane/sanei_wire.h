@@ -58,6 +58,8 @@ WireDirection;
 struct Wire;
 
 typedef void (*WireCodecFunc) (struct Wire *w, void *val_ptr);
+typedef void (*WireArrayCodecFunc) (struct Wire *w, void *val_ptr,
+				    size_t count);
 typedef ssize_t (*WireReadFunc) (int fd, void * buf, size_t len);
 typedef ssize_t (*WireWriteFunc) (int fd, const void * buf, size_t len);
 
@@ -73,6 +75,10 @@ typedef struct Wire
 	WireCodecFunc w_char;
 	WireCodecFunc w_word;
 	WireCodecFunc w_string;
+	/* optional bulk variants used by sanei_w_array() for arrays of
+	   plain bytes/chars and words, may be NULL: */
+	WireArrayCodecFunc w_byte_array;
+	WireArrayCodecFunc w_word_array;
       }
     codec;
     struct
@@ -129,6 +129,94 @@ bin_w_word (Wire *w, void *v)
     }
 }
 
+/* Number of whole elements of ELEMENT_SIZE bytes that can be coded
+   without touching the wire: free space when encoding, buffered data
+   when decoding.  Refills/flushes the buffer if none are.  */
+static size_t
+bin_array_chunk (Wire *w, size_t count, size_t element_size)
+{
+  size_t avail;
+
+  avail = (w->buffer.end - w->buffer.curr) / element_size;
+  if (avail == 0)
+    {
+      avail = w->buffer.size / element_size;
+      if (avail > count)
+	avail = count;
+      sanei_w_space (w, avail * element_size);
+      if (w->status)
+	return 0;
+      avail = (w->buffer.end - w->buffer.curr) / element_size;
+    }
+  return avail < count ? avail : count;
+}
+
+static void
+bin_w_byte_array (Wire *w, void *v, size_t count)
+{
+  SANE_Byte *b = v;
+  size_t n;
+
+  if (w->direction == WIRE_FREE)
+    return;
+
+  while (count > 0)
+    {
+      n = bin_array_chunk (w, count, 1);
+      if (w->status)
+	return;
+
+      if (w->direction == WIRE_ENCODE)
+	memcpy (w->buffer.curr, b, n);
+      else
+	memcpy (b, w->buffer.curr, n);
+      w->buffer.curr += n;
+      b += n;
+      count -= n;
+    }
+}
+
+static void
+bin_w_word_array (Wire *w, void *v, size_t count)
+{
+  SANE_Word *word = v;
+  unsigned char *p;
+  size_t i, n;
+
+  if (w->direction == WIRE_FREE)
+    return;
+
+  while (count > 0)
+    {
+      n = bin_array_chunk (w, count, 4);
+      if (w->status)
+	return;
+
+      /* same bigendian byte-order as bin_w_word(), kept as simple
+	 loops over the whole chunk so the compiler can vectorize them */
+      p = (unsigned char *) w->buffer.curr;
+      if (w->direction == WIRE_ENCODE)
+	for (i = 0; i < n; ++i)
+	  {
+	    SANE_Word val = word[i];
+
+	    p[4 * i + 0] = (val >> 24) & 0xff;
+	    p[4 * i + 1] = (val >> 16) & 0xff;
+	    p[4 * i + 2] = (val >>  8) & 0xff;
+	    p[4 * i + 3] = (val >>  0) & 0xff;
+	  }
+      else
+	for (i = 0; i < n; ++i)
+	  word[i] = (SANE_Word) (  ((unsigned int) p[4 * i + 0] << 24)
+				 | ((unsigned int) p[4 * i + 1] << 16)
+				 | ((unsigned int) p[4 * i + 2] <<  8)
+				 | ((unsigned int) p[4 * i + 3] <<  0));
+      w->buffer.curr += 4 * n;
+      word += n;
+      count -= n;
+    }
+}
+
 void
 sanei_codec_bin_init (Wire *w)
 {
@@ -136,4 +224,6 @@ sanei_codec_bin_init (Wire *w)
   w->codec.w_char = bin_w_byte;
   w->codec.w_word = bin_w_word;
   w->codec.w_string = bin_w_string;
+  w->codec.w_byte_array = bin_w_byte_array;
+  w->codec.w_word_array = bin_w_word_array;
 }
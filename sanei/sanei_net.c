@@ -89,8 +89,11 @@ sanei_w_open_reply (Wire *w, SANE_Open_Reply *reply)
   sanei_w_string (w, &reply->resource_to_authorize);
 }
 
+/* If CHECK_SIZE is set, a decoded value must be exactly SIZE bytes
+   long, so the receiver can rely on value_size.  */
 static void
-w_option_value (Wire *w, SANE_Word type, SANE_Word size, void **value)
+w_option_value (Wire *w, SANE_Word type, SANE_Word size, void **value,
+		int check_size)
 {
   SANE_Word len, element_size;
   WireCodecFunc w_value;
@@ -123,6 +126,10 @@ w_option_value (Wire *w, SANE_Word type, SANE_Word size, void **value)
       return;
     }
   sanei_w_array (w, &len, value, w_value, element_size);
+
+  if (check_size && w->direction == WIRE_DECODE && w->status == 0
+      && element_size > 0 && len * element_size != size)
+    w->status = EINVAL;
 }
 
 void
@@ -133,10 +140,9 @@ sanei_w_option_descriptor_array (Wire *w, SANE_Option_Descriptor_Array *a)
 		 sizeof (a->desc[0]));
 }
 
-void
-sanei_w_control_option_req (Wire *w, SANE_Control_Option_Req *req)
+static void
+w_control_option (Wire *w, SANE_Control_Option_Req *req, int check_size)
 {
-  sanei_w_word (w, &req->handle);
   sanei_w_word (w, &req->option);
   sanei_w_word (w, &req->action);
 
@@ -146,10 +152,24 @@ sanei_w_control_option_req (Wire *w, SANE_Control_Option_Req *req)
     {
       sanei_w_word (w, &req->value_type);
       sanei_w_word (w, &req->value_size);
-      w_option_value (w, req->value_type, req->value_size, &req->value);
+      w_option_value (w, req->value_type, req->value_size, &req->value,
+		      check_size);
     }
 }
 
+static void
+w_control_option_op (Wire *w, SANE_Control_Option_Req *req)
+{
+  w_control_option (w, req, 1);
+}
+
+void
+sanei_w_control_option_req (Wire *w, SANE_Control_Option_Req *req)
+{
+  sanei_w_word (w, &req->handle);
+  w_control_option (w, req, 0);
+}
+
 void
 sanei_w_control_option_reply (Wire *w, SANE_Control_Option_Reply *reply)
 {
@@ -157,10 +177,46 @@ sanei_w_control_option_reply (Wire *w, SANE_Control_Option_Reply *reply)
   sanei_w_word (w, &reply->info);
   sanei_w_word (w, &reply->value_type);
   sanei_w_word (w, &reply->value_size);
-  w_option_value (w, reply->value_type, reply->value_size, &reply->value);
+  w_option_value (w, reply->value_type, reply->value_size, &reply->value,
+		  0);
   sanei_w_string (w, &reply->resource_to_authorize);
 }
 
+void
+sanei_w_get_option_descriptors_delta_req
+  (Wire *w, SANE_Get_Option_Descriptors_Delta_Req *req)
+{
+  sanei_w_word (w, &req->handle);
+  sanei_w_word (w, &req->generation);
+}
+
+void
+sanei_w_option_descriptors_delta_reply
+  (Wire *w, SANE_Option_Descriptors_Delta_Reply *reply)
+{
+  sanei_w_word (w, &reply->generation);
+  sanei_w_word (w, &reply->num_options);
+  sanei_w_array (w, &reply->num_changed, (void **) &reply->index,
+		 (WireCodecFunc) sanei_w_word, sizeof (reply->index[0]));
+  sanei_w_option_descriptor_array (w, &reply->changed);
+}
+
+void
+sanei_w_control_options_req (Wire *w, SANE_Control_Options_Req *req)
+{
+  sanei_w_word (w, &req->handle);
+  sanei_w_array (w, &req->num_ops, (void **) &req->op,
+		 (WireCodecFunc) w_control_option_op, sizeof (req->op[0]));
+}
+
+void
+sanei_w_control_options_reply (Wire *w, SANE_Control_Options_Reply *reply)
+{
+  sanei_w_array (w, &reply->num_ops, (void **) &reply->op,
+		 (WireCodecFunc) sanei_w_control_option_reply,
+		 sizeof (reply->op[0]));
+}
+
 void
 sanei_w_get_parameters_reply (Wire *w, SANE_Get_Parameters_Reply *reply)
 {
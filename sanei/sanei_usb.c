@@ -124,6 +124,7 @@ GetNextDescriptor( struct usb_descriptor_header *currHead, UCHAR *lastBytePtr)
 #include "../include/sane/sanei_debug.h"
 #include "../include/sane/sanei_usb.h"
 #include "../include/sane/sanei_config.h"
+#include "../include/sane/sanei_usb_capture.h"
 
 typedef enum
 {
@@ -208,6 +209,11 @@ static xmlNode* testing_append_commands_node = NULL;
 static SANE_String testing_xml_path = NULL;
 static xmlDoc* testing_xml_doc = NULL;
 static xmlNode* testing_xml_next_tx_node = NULL;
+
+// Binary capture that is used instead of the XML document, see
+// sanei_usb_capture.h. Recording writes it as the transactions happen,
+// replay streams it from a memory mapping.
+static sanei_usb_capture* testing_capture = NULL;
 #endif // WITH_USB_RECORD_REPLAY
 
 #if defined(HAVE_LIBUSB_LEGACY) || defined(HAVE_LIBUSB)
@@ -500,6 +506,20 @@ SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
 
   // TODO: we'll leak if noone ever inits sane_usb properly
   testing_xml_path = strdup(path);
+
+  if (sanei_usb_capture_is_binary(path))
+    {
+      if (development_mode)
+        {
+          DBG(1, "%s: development mode requires an XML capture\n", __func__);
+          return SANE_STATUS_UNSUPPORTED;
+        }
+      testing_capture = sanei_usb_capture_open(path);
+      if (!testing_capture)
+        return SANE_STATUS_ACCESS_DENIED;
+      return SANE_STATUS_GOOD;
+    }
+
   testing_xml_doc = xmlReadFile(testing_xml_path, NULL, 0);
   if (!testing_xml_doc)
     return SANE_STATUS_ACCESS_DENIED;
@@ -1023,8 +1043,387 @@ static int sanei_usb_check_data_equal(xmlNode* node,
   return 0;
 }
 
+static void sanei_usb_add_endpoint(device_list_type* device,
+                                   SANE_Int transfer_type,
+                                   SANE_Int ep_address,
+                                   SANE_Int ep_direction);
+
+// Binary captures. Development mode is not supported for them, so there are
+// no replace functions: replay stops at the first mismatching transaction.
+
+#define FAIL_TEST_CAPTURE(func, rec, ...)                                      \
+  do {                                                                         \
+    if ((rec)->seq > 0)                                                        \
+      DBG(1, "%s: FAIL: in transaction with seq %u:\n", func, (rec)->seq);     \
+    DBG(1, "%s: FAIL: ", func);                                                \
+    DBG(1, __VA_ARGS__);                                                       \
+    fail_test();                                                               \
+  } while (0)
+
+// Returns whether the path of a capture to record asks for the binary format
+static int sanei_capture_path_is_binary(const char* path)
+{
+  size_t len = strlen(path);
+  return len > 4 && strcmp(path + len - 4, ".bin") == 0;
+}
+
+static const char* sanei_capture_type_name(unsigned type)
+{
+  switch (type)
+    {
+      case SANEI_USB_CAPTURE_CONTROL: return "control_tx";
+      case SANEI_USB_CAPTURE_BULK: return "bulk_tx";
+      case SANEI_USB_CAPTURE_INTERRUPT: return "interrupt_tx";
+      case SANEI_USB_CAPTURE_GET_DESCRIPTOR: return "get_descriptor";
+      case SANEI_USB_CAPTURE_DEBUG: return "debug";
+      case SANEI_USB_CAPTURE_KNOWN_COMMANDS_END: return "known_commands_end";
+    }
+  return "unknown";
+}
+
+// Same as sanei_xml_is_transaction_ignored()
+static int sanei_capture_is_transaction_ignored(const sanei_usb_capture_record* rec)
+{
+  if (rec->type != SANEI_USB_CAPTURE_CONTROL || rec->endpoint != 0)
+    return 0;
+
+  int is_direction_in = (rec->flags & SANEI_USB_CAPTURE_FLAG_IN) != 0;
+
+  if (rec->arg[1] == USB_REQ_GET_DESCRIPTOR && is_direction_in)
+    return rec->arg[0] == 0x80;
+  if (rec->arg[1] == USB_REQ_SET_CONFIGURATION && !is_direction_in)
+    return 1;
+  return 0;
+}
+
+// Reads the next transaction of the capture into rec. Returns 0 at the end.
+static int sanei_capture_get_next_tx(sanei_usb_capture_record* rec)
+{
+  while (sanei_usb_capture_read(testing_capture, rec) == SANE_STATUS_GOOD)
+    {
+      if (rec->type < SANEI_USB_CAPTURE_CONTROL ||
+          sanei_capture_is_transaction_ignored(rec))
+        continue;
+
+      if (rec->seq > 0)
+        testing_last_known_seq = rec->seq;
+      if (rec->flags & SANEI_USB_CAPTURE_FLAG_DEBUG_BREAK)
+        sanei_xml_break();
+      return 1;
+    }
+  return 0;
+}
+
+// Returns the size of the next transaction if it transfers data of the given
+// type and direction on the given endpoint, -1 otherwise
+static int sanei_capture_next_packet_size(unsigned type, int direction_is_in,
+                                          unsigned endpoint)
+{
+  sanei_usb_capture_record rec;
+  size_t pos = sanei_usb_capture_tell(testing_capture);
+  int ret = -1;
+
+  while (sanei_usb_capture_read(testing_capture, &rec) == SANE_STATUS_GOOD)
+    {
+      if (rec.type < SANEI_USB_CAPTURE_CONTROL ||
+          sanei_capture_is_transaction_ignored(&rec))
+        continue;
+
+      if (rec.type == type && rec.endpoint == endpoint &&
+          ((rec.flags & SANEI_USB_CAPTURE_FLAG_IN) != 0) == direction_is_in &&
+          !(rec.flags & (SANEI_USB_CAPTURE_FLAG_UNKNOWN |
+                         SANEI_USB_CAPTURE_FLAG_TIMEOUT)))
+        ret = rec.size;
+      break;
+    }
+  sanei_usb_capture_seek(testing_capture, pos);
+  return ret;
+}
+
+// returns 1 if the transaction has the given type, direction and endpoint
+// number. Pass a negative endpoint to not check it.
+static int sanei_capture_check_tx(const sanei_usb_capture_record* rec,
+                                  unsigned type, int direction_is_in,
+                                  int endpoint, const char* parent_fun)
+{
+  if (rec->type != type)
+    {
+      FAIL_TEST_CAPTURE(parent_fun, rec, "unexpected transaction type %s\n",
+                        sanei_capture_type_name(rec->type));
+      return 0;
+    }
+  if (((rec->flags & SANEI_USB_CAPTURE_FLAG_IN) != 0) != direction_is_in)
+    {
+      FAIL_TEST_CAPTURE(parent_fun, rec,
+                        "unexpected direction attribute: %s, wanted %s\n",
+                        direction_is_in ? "OUT" : "IN",
+                        direction_is_in ? "IN" : "OUT");
+      return 0;
+    }
+  if (endpoint >= 0 && rec->endpoint != (unsigned) endpoint)
+    {
+      FAIL_TEST_CAPTURE(parent_fun, rec,
+                        "unexpected endpoint_number attribute: %u, wanted 0x%x\n",
+                        rec->endpoint, endpoint);
+      return 0;
+    }
+  return 1;
+}
+
+// returns 1 on success
+static int sanei_capture_check_value(const sanei_usb_capture_record* rec,
+                                     const char* name, unsigned value,
+                                     unsigned expected, const char* parent_fun)
+{
+  if (value == expected)
+    return 1;
+
+  FAIL_TEST_CAPTURE(parent_fun, rec,
+                    "unexpected %s attribute: 0x%x, wanted 0x%x\n",
+                    name, value, expected);
+  return 0;
+}
+
+// returns 1 on data equality
+static int sanei_capture_check_data_equal(const sanei_usb_capture_record* rec,
+                                          const char* data, size_t data_size,
+                                          const char* parent_fun)
+{
+  if ((data_size == rec->size) && (memcmp(data, rec->data, data_size) == 0))
+    return 1;
+
+  char* data_hex = sanei_binary_to_hex_data(data, data_size, NULL);
+  char* expected_hex = sanei_binary_to_hex_data((const char*) rec->data,
+                                                rec->size, NULL);
+
+  if (data_size == rec->size)
+    FAIL_TEST_CAPTURE(parent_fun, rec, "data differs (size %lu):\n", data_size);
+  else
+    FAIL_TEST_CAPTURE(parent_fun, rec,
+                      "data differs (got size %lu, expected %lu):\n",
+                      data_size, rec->size);
+
+  FAIL_TEST(parent_fun, "got: %s\n", data_hex);
+  FAIL_TEST(parent_fun, "expected: %s\n", expected_hex);
+  free(data_hex);
+  free(expected_hex);
+  return 0;
+}
+
+static SANE_Status sanei_capture_testing_init()
+{
+  sanei_usb_capture_record rec;
+  device_list_type device;
+  int have_device = 0;
+  unsigned vendor = 0, product = 0;
+  size_t pos = sanei_usb_capture_tell(testing_capture);
+  SANE_Status status;
+
+  while ((status = sanei_usb_capture_read(testing_capture, &rec)) ==
+         SANE_STATUS_GOOD)
+    {
+      if (rec.type == SANEI_USB_CAPTURE_DEVICE)
+        {
+          vendor = rec.arg[0];
+          product = rec.arg[1];
+        }
+      else if (rec.type == SANEI_USB_CAPTURE_INTERFACE)
+        {
+          if (have_device)
+            {
+              if (device_number >= MAX_DEVICES)
+                return SANE_STATUS_INVAL;
+              memcpy(&(devices[device_number]), &device, sizeof(device));
+              device_number++;
+            }
+          memset(&device, 0, sizeof(device));
+          device.devname = strdup(testing_xml_path);
+
+          // other code shouldn't depend on method because testing_mode is
+          // sanei_usb_testing_mode_replay
+          device.method = sanei_usb_method_libusb;
+          device.vendor = vendor;
+          device.product = product;
+          device.interface_nr = rec.arg[0];
+          have_device = 1;
+        }
+      else if (rec.type == SANEI_USB_CAPTURE_ENDPOINT)
+        {
+          if (!have_device)
+            {
+              DBG(1, "%s: endpoint outside of interface\n", __func__);
+              return SANE_STATUS_INVAL;
+            }
+          sanei_usb_add_endpoint(&device, rec.arg[0], rec.arg[1],
+                                 (rec.flags & SANEI_USB_CAPTURE_FLAG_IN) != 0);
+        }
+      else
+        break;
+      pos = sanei_usb_capture_tell(testing_capture);
+    }
+
+  if (!have_device || device_number >= MAX_DEVICES)
+    {
+      DBG(1, "%s: no interfaces within capture\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+  memcpy(&(devices[device_number]), &device, sizeof(device));
+  device_number++;
+
+  if (status != SANE_STATUS_GOOD)
+    {
+      DBG(1, "%s: no transactions within capture\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  // continue with the first transaction
+  sanei_usb_capture_seek(testing_capture, pos);
+  return SANE_STATUS_GOOD;
+}
+
+static void sanei_capture_append(sanei_usb_capture_record* rec)
+{
+  if (rec->type != SANEI_USB_CAPTURE_DEVICE &&
+      rec->type != SANEI_USB_CAPTURE_INTERFACE &&
+      rec->type != SANEI_USB_CAPTURE_ENDPOINT)
+    rec->seq = ++testing_last_known_seq;
+
+  if (sanei_usb_capture_write(testing_capture, rec) != SANE_STATUS_GOOD)
+    DBG(1, "%s: failed to write transaction %u\n", __func__, rec->seq);
+}
+
+static void sanei_capture_record_open(SANE_Int dn)
+{
+  sanei_usb_capture_record rec;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.type = SANEI_USB_CAPTURE_DEVICE;
+  rec.arg[0] = devices[dn].vendor;
+  rec.arg[1] = devices[dn].product;
+  rec.data = (const SANE_Byte*) testing_record_backend;
+  rec.size = strlen(testing_record_backend);
+  sanei_capture_append(&rec);
+
+  memset(&rec, 0, sizeof(rec));
+  rec.type = SANEI_USB_CAPTURE_INTERFACE;
+  rec.arg[0] = devices[dn].interface_nr;
+  rec.arg[1] = 1;
+  sanei_capture_append(&rec);
+
+  struct endpoint_desc {
+    SANE_Int transfer_type;
+    int direction_is_in;
+    SANE_Int ep_address;
+  };
+
+  struct endpoint_desc endpoints[8] =
+  {
+    { USB_ENDPOINT_TYPE_BULK, 1, devices[dn].bulk_in_ep },
+    { USB_ENDPOINT_TYPE_BULK, 0, devices[dn].bulk_out_ep },
+    { USB_ENDPOINT_TYPE_ISOCHRONOUS, 1, devices[dn].iso_in_ep },
+    { USB_ENDPOINT_TYPE_ISOCHRONOUS, 0, devices[dn].iso_out_ep },
+    { USB_ENDPOINT_TYPE_INTERRUPT, 1, devices[dn].int_in_ep },
+    { USB_ENDPOINT_TYPE_INTERRUPT, 0, devices[dn].int_out_ep },
+    { USB_ENDPOINT_TYPE_CONTROL, 1, devices[dn].control_in_ep },
+    { USB_ENDPOINT_TYPE_CONTROL, 0, devices[dn].control_out_ep }
+  };
+
+  for (int i = 0; i < 8; ++i)
+    {
+      if (endpoints[i].ep_address)
+        {
+          memset(&rec, 0, sizeof(rec));
+          rec.type = SANEI_USB_CAPTURE_ENDPOINT;
+          rec.flags = endpoints[i].direction_is_in ? SANEI_USB_CAPTURE_FLAG_IN : 0;
+          rec.arg[0] = endpoints[i].transfer_type;
+          rec.arg[1] = endpoints[i].ep_address;
+          sanei_capture_append(&rec);
+        }
+    }
+}
+
+// Records a bulk or interrupt transfer. A NULL buffer records a read of
+// unknown data of the given size, a negative read_size a timeout.
+static void sanei_capture_record_data(unsigned type, unsigned endpoint,
+                                      int direction_is_in,
+                                      const SANE_Byte* buffer,
+                                      size_t size, ssize_t read_size)
+{
+  sanei_usb_capture_record rec;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.type = type;
+  rec.endpoint = endpoint;
+  rec.flags = direction_is_in ? SANEI_USB_CAPTURE_FLAG_IN : 0;
+  if (buffer == NULL)
+    {
+      rec.flags |= SANEI_USB_CAPTURE_FLAG_UNKNOWN;
+      rec.arg[0] = size;
+    }
+  else if (read_size < 0)
+    rec.flags |= SANEI_USB_CAPTURE_FLAG_TIMEOUT;
+  else
+    {
+      rec.data = buffer;
+      rec.size = read_size;
+    }
+  sanei_capture_append(&rec);
+}
+
+static void sanei_capture_record_debug_msg(SANE_String_Const message)
+{
+  sanei_usb_capture_record rec;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.type = SANEI_USB_CAPTURE_DEBUG;
+  rec.data = (const SANE_Byte*) message;
+  rec.size = strlen(message);
+  sanei_capture_append(&rec);
+}
+
+static void sanei_capture_replay_debug_msg(SANE_String_Const message)
+{
+  sanei_usb_capture_record rec;
+
+  if (!sanei_capture_get_next_tx(&rec))
+    {
+      FAIL_TEST(__func__, "no more transactions\n");
+      return;
+    }
+
+  if (rec.type != SANEI_USB_CAPTURE_DEBUG)
+    {
+      FAIL_TEST_CAPTURE(__func__, &rec, "unexpected transaction type %s\n",
+                        sanei_capture_type_name(rec.type));
+      return;
+    }
+
+  if (rec.size != strlen(message) || memcmp(rec.data, message, rec.size) != 0)
+    {
+      FAIL_TEST_CAPTURE(__func__, &rec,
+                        "unexpected message attribute: %.*s, wanted %s\n",
+                        (int) rec.size, (const char*) rec.data, message);
+    }
+}
+
 SANE_String sanei_usb_testing_get_backend()
 {
+  if (testing_capture != NULL)
+    {
+      sanei_usb_capture_record rec;
+      size_t pos = sanei_usb_capture_tell(testing_capture);
+      char* ret = NULL;
+
+      sanei_usb_capture_seek(testing_capture, SANEI_USB_CAPTURE_FILE_HEADER_SIZE);
+      if (sanei_usb_capture_read(testing_capture, &rec) == SANE_STATUS_GOOD &&
+          rec.type == SANEI_USB_CAPTURE_DEVICE)
+        ret = strndup((const char*) rec.data, rec.size);
+      else
+        FAIL_TEST(__func__, "no device record at the start of the capture\n");
+      sanei_usb_capture_seek(testing_capture, pos);
+      return ret;
+    }
+
   if (testing_xml_doc == NULL)
     return NULL;
 
@@ -1055,8 +1454,22 @@ SANE_Bool sanei_usb_is_replay_mode_enabled()
   return SANE_FALSE;
 }
 
+SANE_Bool sanei_usb_is_record_mode_enabled()
+{
+  if (testing_mode == sanei_usb_testing_mode_record)
+    return SANE_TRUE;
+
+  return SANE_FALSE;
+}
+
 static void sanei_usb_record_debug_msg(xmlNode* node, SANE_String_Const message)
 {
+  if (testing_capture != NULL)
+    {
+      sanei_capture_record_debug_msg(message);
+      return;
+    }
+
   int node_was_null = node == NULL;
   if (node_was_null)
     node = testing_append_commands_node;
@@ -1084,6 +1497,12 @@ static void sanei_usb_record_replace_debug_msg(xmlNode* node, SANE_String_Const
 
 static void sanei_usb_replay_debug_msg(SANE_String_Const message)
 {
+  if (testing_capture != NULL)
+    {
+      sanei_capture_replay_debug_msg(message);
+      return;
+    }
+
   if (testing_known_commands_input_failed)
     return;
 
@@ -1128,17 +1547,19 @@ extern void sanei_usb_testing_record_message(SANE_String_Const message)
     }
 }
 
-static void sanei_usb_add_endpoint(device_list_type* device,
-                                   SANE_Int transfer_type,
-                                   SANE_Int ep_address,
-                                   SANE_Int ep_direction);
-
 static SANE_Status sanei_usb_testing_init()
 {
   DBG_INIT();
 
   if (testing_mode == sanei_usb_testing_mode_record)
     {
+      if (sanei_capture_path_is_binary(testing_xml_path))
+        {
+          testing_capture = sanei_usb_capture_create(testing_xml_path);
+          if (testing_capture == NULL)
+            return SANE_STATUS_ACCESS_DENIED;
+          return SANE_STATUS_GOOD;
+        }
       testing_xml_doc = xmlNewDoc((const xmlChar*)"1.0");
       return SANE_STATUS_GOOD;
     }
@@ -1146,6 +1567,9 @@ static SANE_Status sanei_usb_testing_init()
   if (device_number != 0)
     return SANE_STATUS_INVAL; // already opened
 
+  if (testing_capture != NULL)
+    return sanei_capture_testing_init();
+
   xmlNode* el_root = xmlDocGetRootElement(testing_xml_doc);
   if (xmlStrcmp(el_root->name, (const xmlChar*)"device_capture") != 0)
     {
@@ -1293,7 +1717,15 @@ static SANE_Status sanei_usb_testing_init()
 
 static void sanei_usb_testing_exit()
 {
-  if (testing_development_mode || testing_mode == sanei_usb_testing_mode_record)
+  if (testing_capture != NULL)
+    {
+      if (sanei_usb_capture_close(testing_capture) != SANE_STATUS_GOOD)
+        DBG(1, "%s: failed to write %s\n", __func__, testing_xml_path);
+      if (testing_mode == sanei_usb_testing_mode_record)
+        free(testing_record_backend);
+    }
+  else if (testing_development_mode ||
+           testing_mode == sanei_usb_testing_mode_record)
     {
       if (testing_mode == sanei_usb_testing_mode_record)
         {
@@ -1317,6 +1749,7 @@ static void sanei_usb_testing_exit()
   testing_xml_path = NULL;
   testing_xml_doc = NULL;
   testing_xml_next_tx_node = NULL;
+  testing_capture = NULL;
 }
 #else // WITH_USB_RECORD_REPLAY
 SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
@@ -1348,6 +1781,11 @@ SANE_Bool sanei_usb_is_replay_mode_enabled()
   return SANE_FALSE;
 }
 
+SANE_Bool sanei_usb_is_record_mode_enabled()
+{
+  return SANE_FALSE;
+}
+
 void sanei_usb_testing_record_message(SANE_String_Const message)
 {
   (void) message;
@@ -2326,6 +2764,13 @@ static void sanei_usb_record_open(SANE_Int dn)
   if (testing_already_opened)
     return;
 
+  if (testing_capture != NULL)
+    {
+      sanei_capture_record_open(dn);
+      testing_already_opened = 1;
+      return;
+    }
+
   xmlNode* e_root = xmlNewNode(NULL, (const xmlChar*) "device_capture");
   xmlDocSetRootElement(testing_xml_doc, e_root);
   xmlNewProp(e_root, (const xmlChar*)"backend", (const xmlChar*) testing_record_backend);
@@ -3203,6 +3648,14 @@ static void sanei_usb_record_read_bulk(xmlNode* node, SANE_Int dn,
                                        SANE_Byte* buffer,
                                        size_t size, ssize_t read_size)
 {
+  if (testing_capture != NULL)
+    {
+      sanei_capture_record_data(SANEI_USB_CAPTURE_BULK,
+                                devices[dn].bulk_in_ep & 0x0f, 1,
+                                buffer, size, read_size);
+      return;
+    }
+
   int node_was_null = node == NULL;
   if (node_was_null)
     node = testing_append_commands_node;
@@ -3249,9 +3702,59 @@ static void sanei_usb_record_replace_read_bulk(xmlNode* node, SANE_Int dn,
   xmlFreeNode(node);
 }
 
+static int sanei_capture_replay_read_bulk(SANE_Int dn, SANE_Byte* buffer,
+                                          size_t size)
+{
+  unsigned endpoint = devices[dn].bulk_in_ep & 0x0f;
+  size_t wanted_size = size;
+  size_t total_got_size = 0;
+  while (wanted_size > 0)
+    {
+      sanei_usb_capture_record rec;
+      if (!sanei_capture_get_next_tx(&rec))
+        {
+          FAIL_TEST(__func__, "no more transactions\n");
+          return -1;
+        }
+
+      if (!sanei_capture_check_tx(&rec, SANEI_USB_CAPTURE_BULK, 1, endpoint,
+                                  __func__))
+        return -1;
+
+      if (rec.flags & SANEI_USB_CAPTURE_FLAG_UNKNOWN)
+        {
+          FAIL_TEST_CAPTURE(__func__, &rec, "the read data is unknown\n");
+          return -1;
+        }
+
+      if (rec.size > wanted_size)
+        {
+          FAIL_TEST_CAPTURE(__func__, &rec,
+                            "got more data than wanted (%lu vs %lu)\n",
+                            rec.size, wanted_size);
+          return -1;
+        }
+
+      memcpy(buffer + total_got_size, rec.data, rec.size);
+      total_got_size += rec.size;
+      wanted_size -= rec.size;
+
+      int next_size = sanei_capture_next_packet_size(SANEI_USB_CAPTURE_BULK,
+                                                     1, endpoint);
+      if (next_size < 0)
+        return total_got_size;
+      if ((size_t) next_size > wanted_size)
+        return total_got_size;
+    }
+  return total_got_size;
+}
+
 static int sanei_usb_replay_read_bulk(SANE_Int dn, SANE_Byte* buffer,
                                       size_t size)
 {
+  if (testing_capture != NULL)
+    return sanei_capture_replay_read_bulk(dn, buffer, size);
+
   // libusb may potentially combine multiple IN packets into a single transfer.
   // We recontruct that by looking into the next packet. If it can be
   // included into the current transfer without
@@ -3508,6 +4011,14 @@ static int sanei_usb_record_write_bulk(xmlNode* node, SANE_Int dn,
                                        const SANE_Byte* buffer,
                                        size_t size, size_t write_size)
 {
+  if (testing_capture != NULL)
+    {
+      sanei_capture_record_data(SANEI_USB_CAPTURE_BULK,
+                                devices[dn].bulk_out_ep & 0x0f, 0,
+                                buffer, size, size);
+      return write_size;
+    }
+
   int node_was_null = node == NULL;
   if (node_was_null)
     node = testing_append_commands_node;
@@ -3560,9 +4071,61 @@ static int sanei_usb_replay_next_write_bulk_packet_size(SANE_Int dn)
   return got_size;
 }
 
+static int sanei_capture_replay_write_bulk(SANE_Int dn,
+                                           const SANE_Byte* buffer,
+                                           size_t size)
+{
+  unsigned endpoint = devices[dn].bulk_out_ep & 0x0f;
+  size_t wanted_size = size;
+  size_t total_wrote_size = 0;
+  while (wanted_size > 0)
+    {
+      sanei_usb_capture_record rec;
+      if (!sanei_capture_get_next_tx(&rec))
+        {
+          FAIL_TEST(__func__, "no more transactions\n");
+          return -1;
+        }
+
+      if (!sanei_capture_check_tx(&rec, SANEI_USB_CAPTURE_BULK, 0, endpoint,
+                                  __func__))
+        return -1;
+
+      if (rec.size > wanted_size)
+        {
+          FAIL_TEST_CAPTURE(__func__, &rec,
+                            "wrote more data than wanted (%lu vs %lu)\n",
+                            rec.size, wanted_size);
+          return -1;
+        }
+
+      if (!sanei_capture_check_data_equal(&rec,
+                                          ((const char*) buffer) +
+                                             total_wrote_size,
+                                          rec.size, __func__))
+        return -1;
+
+      if (rec.size < wanted_size &&
+          sanei_capture_next_packet_size(SANEI_USB_CAPTURE_BULK, 0,
+                                         endpoint) < 0)
+        {
+          FAIL_TEST_CAPTURE(__func__, &rec,
+                            "wrote less data than wanted (%lu vs %lu)\n",
+                            rec.size, wanted_size);
+          return -1;
+        }
+      total_wrote_size += rec.size;
+      wanted_size -= rec.size;
+    }
+  return total_wrote_size;
+}
+
 static int sanei_usb_replay_write_bulk(SANE_Int dn, const SANE_Byte* buffer,
                                        size_t size)
 {
+  if (testing_capture != NULL)
+    return sanei_capture_replay_write_bulk(dn, buffer, size);
+
   size_t wanted_size = size;
   size_t total_wrote_size = 0;
   while (wanted_size > 0)
@@ -3839,13 +4402,36 @@ sanei_usb_record_control_msg(xmlNode* node,
 {
   (void) dn;
 
+  int direction_is_in = (rtype & 0x80) == 0x80;
+
+  if (testing_capture != NULL)
+    {
+      sanei_usb_capture_record rec;
+      memset(&rec, 0, sizeof(rec));
+      rec.type = SANEI_USB_CAPTURE_CONTROL;
+      rec.endpoint = rtype & 0x1f;
+      rec.flags = direction_is_in ? SANEI_USB_CAPTURE_FLAG_IN : 0;
+      rec.arg[0] = rtype;
+      rec.arg[1] = req;
+      rec.arg[2] = (value & 0xffff) | ((uint32_t) (index & 0xffff) << 16);
+      rec.arg[3] = len;
+      if (direction_is_in && data == NULL)
+        rec.flags |= SANEI_USB_CAPTURE_FLAG_UNKNOWN;
+      else
+        {
+          rec.data = data;
+          rec.size = len;
+        }
+      sanei_capture_append(&rec);
+      return;
+    }
+
   int node_was_null = node == NULL;
   if (node_was_null)
     node = testing_append_commands_node;
 
   xmlNode* e_tx = xmlNewNode(NULL, (const xmlChar*)"control_tx");
 
-  int direction_is_in = (rtype & 0x80) == 0x80;
   sanei_xml_command_common_props(e_tx, rtype & 0x1f,
                                  direction_is_in ? "IN" : "OUT");
   sanei_xml_set_hex_attr(e_tx, "bmRequestType", rtype);
@@ -3898,6 +4484,52 @@ sanei_usb_record_replace_control_msg(xmlNode* node,
   return ret;
 }
 
+static SANE_Status
+sanei_capture_replay_control_msg(SANE_Int rtype, SANE_Int req,
+                                 SANE_Int value, SANE_Int index, SANE_Int len,
+                                 SANE_Byte* data)
+{
+  sanei_usb_capture_record rec;
+  int direction_is_in = (rtype & 0x80) == 0x80;
+
+  if (!sanei_capture_get_next_tx(&rec))
+    {
+      FAIL_TEST(__func__, "no more transactions\n");
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  if (!sanei_capture_check_tx(&rec, SANEI_USB_CAPTURE_CONTROL,
+                              direction_is_in, -1, __func__) ||
+      !sanei_capture_check_value(&rec, "bmRequestType", rec.arg[0], rtype,
+                                 __func__) ||
+      !sanei_capture_check_value(&rec, "bRequest", rec.arg[1], req,
+                                 __func__) ||
+      !sanei_capture_check_value(&rec, "wValue", rec.arg[2] & 0xffff, value,
+                                 __func__) ||
+      !sanei_capture_check_value(&rec, "wIndex", rec.arg[2] >> 16, index,
+                                 __func__) ||
+      !sanei_capture_check_value(&rec, "wLength", rec.arg[3], len, __func__))
+    return SANE_STATUS_IO_ERROR;
+
+  if (direction_is_in)
+    {
+      if ((rec.flags & SANEI_USB_CAPTURE_FLAG_UNKNOWN) ||
+          rec.size != (size_t) len)
+        {
+          FAIL_TEST_CAPTURE(__func__, &rec,
+                            "got different amount of data than wanted (%lu vs %lu)\n",
+                            rec.size, (size_t) len);
+          return SANE_STATUS_IO_ERROR;
+        }
+      memcpy(data, rec.data, rec.size);
+    }
+  else if (!sanei_capture_check_data_equal(&rec, (const char*) data, len,
+                                           __func__))
+    return SANE_STATUS_IO_ERROR;
+
+  return SANE_STATUS_GOOD;
+}
+
 static SANE_Status
 sanei_usb_replay_control_msg(SANE_Int dn, SANE_Int rtype, SANE_Int req,
                              SANE_Int value, SANE_Int index, SANE_Int len,
@@ -3905,6 +4537,10 @@ sanei_usb_replay_control_msg(SANE_Int dn, SANE_Int rtype, SANE_Int req,
 {
   (void) dn;
 
+  if (testing_capture != NULL)
+    return sanei_capture_replay_control_msg(rtype, req, value, index, len,
+                                            data);
+
   if (testing_known_commands_input_failed)
     return SANE_STATUS_IO_ERROR;
 
@@ -4145,6 +4781,14 @@ static void sanei_usb_record_read_int(xmlNode* node,
 {
   (void) size;
 
+  if (testing_capture != NULL)
+    {
+      sanei_capture_record_data(SANEI_USB_CAPTURE_INTERRUPT,
+                                devices[dn].int_in_ep & 0x0f, 1,
+                                buffer, read_size, read_size);
+      return;
+    }
+
   int node_was_null = node == NULL;
   if (node_was_null)
     node = testing_append_commands_node;
@@ -4192,9 +4836,42 @@ static void sanei_usb_record_replace_read_int(xmlNode* node,
   xmlFreeNode(node);
 }
 
+static int sanei_capture_replay_read_int(SANE_Int dn, SANE_Byte* buffer,
+                                         size_t size)
+{
+  sanei_usb_capture_record rec;
+
+  if (!sanei_capture_get_next_tx(&rec))
+    {
+      FAIL_TEST(__func__, "no more transactions\n");
+      return -1;
+    }
+
+  if (!sanei_capture_check_tx(&rec, SANEI_USB_CAPTURE_INTERRUPT, 1,
+                              devices[dn].int_in_ep & 0x0f, __func__))
+    return -1;
+
+  if (rec.flags & SANEI_USB_CAPTURE_FLAG_TIMEOUT)
+    return -1;
+
+  if ((rec.flags & SANEI_USB_CAPTURE_FLAG_UNKNOWN) || rec.size > size)
+    {
+      FAIL_TEST_CAPTURE(__func__, &rec,
+                        "got more data than wanted (%lu vs %lu)\n",
+                        rec.size, size);
+      return -1;
+    }
+
+  memcpy(buffer, rec.data, rec.size);
+  return rec.size;
+}
+
 static int sanei_usb_replay_read_int(SANE_Int dn, SANE_Byte* buffer,
                                      size_t size)
 {
+  if (testing_capture != NULL)
+    return sanei_capture_replay_read_int(dn, buffer, size);
+
   if (testing_known_commands_input_failed)
     return -1;
 
@@ -4433,11 +5110,39 @@ sanei_usb_read_int (SANE_Int dn, SANE_Byte * buffer, size_t * size)
 }
 
 #if WITH_USB_RECORD_REPLAY
+static SANE_Status sanei_capture_replay_set_configuration(SANE_Int configuration)
+{
+  sanei_usb_capture_record rec;
+
+  if (!sanei_capture_get_next_tx(&rec))
+    {
+      FAIL_TEST(__func__, "no more transactions\n");
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  if (!sanei_capture_check_tx(&rec, SANEI_USB_CAPTURE_CONTROL, 0, -1,
+                              __func__) ||
+      !sanei_capture_check_value(&rec, "bmRequestType", rec.arg[0], 0,
+                                 __func__) ||
+      !sanei_capture_check_value(&rec, "bRequest", rec.arg[1], 9, __func__) ||
+      !sanei_capture_check_value(&rec, "wValue", rec.arg[2] & 0xffff,
+                                 configuration, __func__) ||
+      !sanei_capture_check_value(&rec, "wIndex", rec.arg[2] >> 16, 0,
+                                 __func__) ||
+      !sanei_capture_check_value(&rec, "wLength", rec.arg[3], 0, __func__))
+    return SANE_STATUS_IO_ERROR;
+
+  return SANE_STATUS_GOOD;
+}
+
 static SANE_Status sanei_usb_replay_set_configuration(SANE_Int dn,
                                                       SANE_Int configuration)
 {
   (void) dn;
 
+  if (testing_capture != NULL)
+    return sanei_capture_replay_set_configuration(configuration);
+
   xmlNode* node = sanei_xml_get_next_tx_node();
   if (node == NULL)
     {
@@ -4785,12 +5490,44 @@ sanei_usb_set_altinterface (SANE_Int dn, SANE_Int alternate)
 
 #if WITH_USB_RECORD_REPLAY
 
+static SANE_Status
+sanei_capture_replay_get_descriptor(struct sanei_usb_dev_descriptor *desc)
+{
+  sanei_usb_capture_record rec;
+
+  if (!sanei_capture_get_next_tx(&rec))
+    {
+      FAIL_TEST(__func__, "no more transactions\n");
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  if (rec.type != SANEI_USB_CAPTURE_GET_DESCRIPTOR)
+    {
+      FAIL_TEST_CAPTURE(__func__, &rec, "unexpected transaction type %s\n",
+                        sanei_capture_type_name(rec.type));
+      return SANE_STATUS_IO_ERROR;
+    }
+
+  desc->desc_type = rec.arg[0] & 0xff;
+  desc->dev_class = (rec.arg[0] >> 8) & 0xff;
+  desc->dev_sub_class = (rec.arg[0] >> 16) & 0xff;
+  desc->dev_protocol = (rec.arg[0] >> 24) & 0xff;
+  desc->bcd_usb = rec.arg[1];
+  desc->bcd_dev = rec.arg[2];
+  desc->max_packet_size = rec.arg[3];
+
+  return SANE_STATUS_GOOD;
+}
+
 static SANE_Status
 sanei_usb_replay_get_descriptor(SANE_Int dn,
                                 struct sanei_usb_dev_descriptor *desc)
 {
   (void) dn;
 
+  if (testing_capture != NULL)
+    return sanei_capture_replay_get_descriptor(desc);
+
   if (testing_known_commands_input_failed)
     return SANE_STATUS_IO_ERROR;
 
@@ -4851,6 +5588,21 @@ sanei_usb_record_get_descriptor(SANE_Int dn,
 {
   (void) dn;
 
+  if (testing_capture != NULL)
+    {
+      sanei_usb_capture_record rec;
+      memset(&rec, 0, sizeof(rec));
+      rec.type = SANEI_USB_CAPTURE_GET_DESCRIPTOR;
+      rec.arg[0] = desc->desc_type | desc->dev_class << 8 |
+                   desc->dev_sub_class << 16 |
+                   (uint32_t) desc->dev_protocol << 24;
+      rec.arg[1] = desc->bcd_usb;
+      rec.arg[2] = desc->bcd_dev;
+      rec.arg[3] = desc->max_packet_size;
+      sanei_capture_append(&rec);
+      return;
+    }
+
   xmlNode* node = testing_append_commands_node;
 
   xmlNode* e_tx = xmlNewNode(NULL, (const xmlChar*)"get_descriptor");
@@ -0,0 +1,955 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+
+   This file implements the binary USB capture format used by the
+   record and replay mode of sanei_usb.  */
+
+#include "../include/sane/config.h"
+
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_LIBXML2
+#include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
+#endif
+
+#define BACKEND_NAME	sanei_usb_capture
+#include "../include/sane/sane.h"
+#include "../include/sane/sanei_debug.h"
+#include "../include/sane/sanei_usb.h"
+#include "../include/sane/sanei_usb_capture.h"
+
+/* size of the stdio buffer of captures that are being written */
+#define CAPTURE_WRITE_BUFFER_SIZE (256 * 1024)
+
+struct sanei_usb_capture
+{
+  FILE *file;                   /* set while writing */
+  SANE_Byte *buf;               /* contents of the file while reading */
+  size_t size;
+  size_t pos;
+  int mapped;
+};
+
+static void
+capture_put_u32 (SANE_Byte * p, uint32_t value)
+{
+  p[0] = value & 0xff;
+  p[1] = (value >> 8) & 0xff;
+  p[2] = (value >> 16) & 0xff;
+  p[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t
+capture_get_u32 (const SANE_Byte * p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+    ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+SANE_Bool
+sanei_usb_capture_is_binary (SANE_String_Const path)
+{
+  char magic[8];
+  FILE *f;
+  SANE_Bool ret = SANE_FALSE;
+
+  f = fopen (path, "rb");
+  if (f == NULL)
+    return SANE_FALSE;
+  if (fread (magic, 1, sizeof (magic), f) == sizeof (magic) &&
+      memcmp (magic, SANEI_USB_CAPTURE_MAGIC, sizeof (magic)) == 0)
+    ret = SANE_TRUE;
+  fclose (f);
+  return ret;
+}
+
+sanei_usb_capture *
+sanei_usb_capture_create (SANE_String_Const path)
+{
+  sanei_usb_capture *capture;
+  SANE_Byte header[SANEI_USB_CAPTURE_FILE_HEADER_SIZE];
+
+  DBG_INIT ();
+
+  capture = calloc (1, sizeof (*capture));
+  if (capture == NULL)
+    return NULL;
+
+  capture->file = fopen (path, "wb");
+  if (capture->file == NULL)
+    {
+      DBG (1, "%s: can't create %s: %s\n", __func__, path, strerror (errno));
+      free (capture);
+      return NULL;
+    }
+  setvbuf (capture->file, NULL, _IOFBF, CAPTURE_WRITE_BUFFER_SIZE);
+
+  memcpy (header, SANEI_USB_CAPTURE_MAGIC, 8);
+  capture_put_u32 (header + 8, SANEI_USB_CAPTURE_VERSION);
+  if (fwrite (header, sizeof (header), 1, capture->file) != 1)
+    {
+      DBG (1, "%s: can't write %s: %s\n", __func__, path, strerror (errno));
+      fclose (capture->file);
+      free (capture);
+      return NULL;
+    }
+  return capture;
+}
+
+sanei_usb_capture *
+sanei_usb_capture_open (SANE_String_Const path)
+{
+  sanei_usb_capture *capture;
+  struct stat st;
+  int fd;
+
+  DBG_INIT ();
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      DBG (1, "%s: can't open %s: %s\n", __func__, path, strerror (errno));
+      return NULL;
+    }
+  if (fstat (fd, &st) < 0 || st.st_size < SANEI_USB_CAPTURE_FILE_HEADER_SIZE)
+    {
+      DBG (1, "%s: %s is not a USB capture\n", __func__, path);
+      close (fd);
+      return NULL;
+    }
+
+  capture = calloc (1, sizeof (*capture));
+  if (capture == NULL)
+    {
+      close (fd);
+      return NULL;
+    }
+  capture->size = st.st_size;
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  capture->buf = mmap (NULL, capture->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (capture->buf != MAP_FAILED)
+    {
+      capture->mapped = 1;
+#ifdef MADV_SEQUENTIAL
+      madvise (capture->buf, capture->size, MADV_SEQUENTIAL);
+#endif
+    }
+  else
+    capture->buf = NULL;
+#endif
+
+  if (capture->buf == NULL)
+    {
+      /* read the whole file if it can't be mapped */
+      size_t done = 0;
+      ssize_t n;
+
+      capture->buf = malloc (capture->size);
+      while (capture->buf != NULL && done < capture->size)
+        {
+          n = read (fd, capture->buf + done, capture->size - done);
+          if (n <= 0)
+            {
+              free (capture->buf);
+              capture->buf = NULL;
+              break;
+            }
+          done += n;
+        }
+    }
+  close (fd);
+
+  if (capture->buf == NULL)
+    {
+      DBG (1, "%s: can't read %s\n", __func__, path);
+      free (capture);
+      return NULL;
+    }
+
+  if (memcmp (capture->buf, SANEI_USB_CAPTURE_MAGIC, 8) != 0 ||
+      capture_get_u32 (capture->buf + 8) != SANEI_USB_CAPTURE_VERSION)
+    {
+      DBG (1, "%s: %s is not a USB capture of version %d\n", __func__, path,
+           SANEI_USB_CAPTURE_VERSION);
+      sanei_usb_capture_close (capture);
+      return NULL;
+    }
+  capture->pos = SANEI_USB_CAPTURE_FILE_HEADER_SIZE;
+  return capture;
+}
+
+SANE_Status
+sanei_usb_capture_write (sanei_usb_capture * capture,
+                         const sanei_usb_capture_record * record)
+{
+  SANE_Byte header[SANEI_USB_CAPTURE_HEADER_SIZE];
+  int i;
+
+  header[0] = record->type;
+  header[1] = record->flags;
+  header[2] = record->endpoint;
+  header[3] = 0;
+  capture_put_u32 (header + 4, record->seq);
+  for (i = 0; i < 4; i++)
+    capture_put_u32 (header + 8 + 4 * i, record->arg[i]);
+  capture_put_u32 (header + 24, record->size);
+
+  if (fwrite (header, sizeof (header), 1, capture->file) != 1 ||
+      (record->size > 0 &&
+       fwrite (record->data, record->size, 1, capture->file) != 1))
+    {
+      DBG (1, "%s: write failed: %s\n", __func__, strerror (errno));
+      return SANE_STATUS_IO_ERROR;
+    }
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_usb_capture_read (sanei_usb_capture * capture,
+                        sanei_usb_capture_record * record)
+{
+  const SANE_Byte *p;
+  int i;
+
+  if (capture->pos == capture->size)
+    return SANE_STATUS_EOF;
+  if (capture->size - capture->pos < SANEI_USB_CAPTURE_HEADER_SIZE)
+    {
+      DBG (1, "%s: truncated record header at offset %lu\n", __func__,
+           (unsigned long) capture->pos);
+      return SANE_STATUS_INVAL;
+    }
+
+  p = capture->buf + capture->pos;
+  record->type = p[0];
+  record->flags = p[1];
+  record->endpoint = p[2];
+  record->seq = capture_get_u32 (p + 4);
+  for (i = 0; i < 4; i++)
+    record->arg[i] = capture_get_u32 (p + 8 + 4 * i);
+  record->size = capture_get_u32 (p + 24);
+
+  if (capture->size - capture->pos - SANEI_USB_CAPTURE_HEADER_SIZE <
+      record->size)
+    {
+      DBG (1, "%s: truncated record at offset %lu\n", __func__,
+           (unsigned long) capture->pos);
+      return SANE_STATUS_INVAL;
+    }
+
+  record->data = p + SANEI_USB_CAPTURE_HEADER_SIZE;
+  capture->pos += SANEI_USB_CAPTURE_HEADER_SIZE + record->size;
+  return SANE_STATUS_GOOD;
+}
+
+size_t
+sanei_usb_capture_tell (sanei_usb_capture * capture)
+{
+  return capture->pos;
+}
+
+void
+sanei_usb_capture_seek (sanei_usb_capture * capture, size_t offset)
+{
+  capture->pos = offset;
+}
+
+SANE_Status
+sanei_usb_capture_close (sanei_usb_capture * capture)
+{
+  SANE_Status status = SANE_STATUS_GOOD;
+
+  if (capture == NULL)
+    return SANE_STATUS_GOOD;
+
+  if (capture->file != NULL && fclose (capture->file) != 0)
+    {
+      DBG (1, "%s: write failed: %s\n", __func__, strerror (errno));
+      status = SANE_STATUS_IO_ERROR;
+    }
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  if (capture->mapped)
+    munmap (capture->buf, capture->size);
+  else
+#endif
+    free (capture->buf);
+  free (capture);
+  return status;
+}
+
+#ifdef HAVE_LIBXML2
+
+static int
+capture_xml_uint_attr (xmlTextReaderPtr reader, const char *name,
+                       uint32_t * value)
+{
+  xmlChar *attr = xmlTextReaderGetAttribute (reader, (const xmlChar *) name);
+  if (attr == NULL)
+    return 0;
+  *value = strtoul ((const char *) attr, NULL, 0);
+  xmlFree (attr);
+  return 1;
+}
+
+static int
+capture_xml_attr_is (xmlTextReaderPtr reader, const char *name,
+                     const char *expected)
+{
+  int ret;
+  xmlChar *attr = xmlTextReaderGetAttribute (reader, (const xmlChar *) name);
+  if (attr == NULL)
+    return 0;
+  ret = strcmp ((const char *) attr, expected) == 0;
+  xmlFree (attr);
+  return ret;
+}
+
+static int
+capture_hex_value (char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/* Parses the hex text of a transaction into data, which must hold at least
+   half the length of the text. Returns the number of bytes or -1 on
+   invalid characters. */
+static ssize_t
+capture_parse_hex (const char *text, SANE_Byte * data)
+{
+  ssize_t size = 0;
+  int nibbles = 0;
+  unsigned value = 0;
+
+  for (; *text != '\0'; text++)
+    {
+      int v = capture_hex_value (*text);
+      if (v < 0)
+        {
+          if (*text == ' ' || *text == '\t' || *text == '\n' || *text == '\r')
+            continue;
+          return -1;
+        }
+      value = (value << 4) | v;
+      if (++nibbles == 2)
+        {
+          data[size++] = value;
+          value = 0;
+          nibbles = 0;
+        }
+    }
+  return size;
+}
+
+static void
+capture_xml_common (xmlTextReaderPtr reader, sanei_usb_capture_record * rec)
+{
+  uint32_t value;
+
+  if (capture_xml_uint_attr (reader, "seq", &value))
+    rec->seq = value;
+  if (capture_xml_uint_attr (reader, "endpoint_number", &value))
+    rec->endpoint = value;
+  if (capture_xml_attr_is (reader, "direction", "IN"))
+    rec->flags |= SANEI_USB_CAPTURE_FLAG_IN;
+  if (capture_xml_attr_is (reader, "error", "timeout"))
+    rec->flags |= SANEI_USB_CAPTURE_FLAG_TIMEOUT;
+  if (xmlTextReaderMoveToAttribute (reader, (const xmlChar *) "debug_break")
+      == 1)
+    rec->flags |= SANEI_USB_CAPTURE_FLAG_DEBUG_BREAK;
+  xmlTextReaderMoveToElement (reader);
+}
+
+/* Reads the text of a transaction node into rec. The returned buffer holds
+   the data and must be freed by the caller. The size of reads of unknown
+   data is stored in unknown_size if it is not NULL. */
+static SANE_Byte *
+capture_xml_data (xmlTextReaderPtr reader, sanei_usb_capture_record * rec,
+                  uint32_t * unknown_size)
+{
+  xmlChar *text;
+  const char *p;
+  SANE_Byte *data;
+  ssize_t size;
+
+  text = xmlTextReaderReadString (reader);
+  if (text == NULL)
+    return NULL;
+
+  p = (const char *) text;
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+    p++;
+
+  if (*p == '(')
+    {
+      /* placeholder of a read that hasn't been recorded yet:
+         "(unknown read of ... size N)" */
+      const char *num = strrchr (p, ' ');
+      rec->flags |= SANEI_USB_CAPTURE_FLAG_UNKNOWN;
+      if (unknown_size != NULL)
+        *unknown_size = num ? strtoul (num + 1, NULL, 10) : 0;
+      xmlFree (text);
+      return NULL;
+    }
+
+  data = malloc (strlen (p) / 2 + 1);
+  if (data == NULL)
+    {
+      xmlFree (text);
+      return NULL;
+    }
+  size = capture_parse_hex (p, data);
+  xmlFree (text);
+  if (size < 0)
+    {
+      DBG (1, "%s: invalid data in transaction %u\n", __func__, rec->seq);
+      free (data);
+      return NULL;
+    }
+  rec->data = data;
+  rec->size = size;
+  return data;
+}
+
+static int
+capture_transfer_type (xmlTextReaderPtr reader)
+{
+  if (capture_xml_attr_is (reader, "transfer_type", "CONTROL"))
+    return USB_ENDPOINT_TYPE_CONTROL;
+  if (capture_xml_attr_is (reader, "transfer_type", "ISOCHRONOUS"))
+    return USB_ENDPOINT_TYPE_ISOCHRONOUS;
+  if (capture_xml_attr_is (reader, "transfer_type", "BULK"))
+    return USB_ENDPOINT_TYPE_BULK;
+  if (capture_xml_attr_is (reader, "transfer_type", "INTERRUPT"))
+    return USB_ENDPOINT_TYPE_INTERRUPT;
+  return -1;
+}
+
+SANE_Status
+sanei_usb_capture_from_xml (SANE_String_Const xml_path,
+                            SANE_String_Const path)
+{
+  xmlTextReaderPtr reader;
+  sanei_usb_capture *capture;
+  xmlChar *backend = NULL;
+  uint32_t configuration = 1;
+  SANE_Status status = SANE_STATUS_GOOD;
+  int ret = 0;
+
+  DBG_INIT ();
+
+  reader = xmlReaderForFile (xml_path, NULL, XML_PARSE_HUGE);
+  if (reader == NULL)
+    {
+      DBG (1, "%s: can't open %s\n", __func__, xml_path);
+      return SANE_STATUS_ACCESS_DENIED;
+    }
+
+  capture = sanei_usb_capture_create (path);
+  if (capture == NULL)
+    {
+      xmlFreeTextReader (reader);
+      return SANE_STATUS_ACCESS_DENIED;
+    }
+
+  while (status == SANE_STATUS_GOOD && (ret = xmlTextReaderRead (reader)) == 1)
+    {
+      sanei_usb_capture_record rec;
+      SANE_Byte *data = NULL;
+      const char *name;
+      uint32_t value;
+
+      if (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT)
+        continue;
+
+      name = (const char *) xmlTextReaderConstName (reader);
+      memset (&rec, 0, sizeof (rec));
+
+      if (strcmp (name, "device_capture") == 0)
+        {
+          backend = xmlTextReaderGetAttribute (reader,
+                                               (const xmlChar *) "backend");
+          continue;
+        }
+      else if (strcmp (name, "description") == 0)
+        {
+          rec.type = SANEI_USB_CAPTURE_DEVICE;
+          capture_xml_uint_attr (reader, "id_vendor", &rec.arg[0]);
+          capture_xml_uint_attr (reader, "id_product", &rec.arg[1]);
+          if (backend != NULL)
+            {
+              rec.data = backend;
+              rec.size = strlen ((const char *) backend);
+            }
+        }
+      else if (strcmp (name, "configuration") == 0)
+        {
+          capture_xml_uint_attr (reader, "number", &configuration);
+          continue;
+        }
+      else if (strcmp (name, "interface") == 0)
+        {
+          rec.type = SANEI_USB_CAPTURE_INTERFACE;
+          capture_xml_uint_attr (reader, "number", &rec.arg[0]);
+          rec.arg[1] = configuration;
+        }
+      else if (strcmp (name, "endpoint") == 0)
+        {
+          int transfer_type = capture_transfer_type (reader);
+          if (transfer_type < 0)
+            {
+              DBG (3, "%s: skipping endpoint of unknown type\n", __func__);
+              continue;
+            }
+          rec.type = SANEI_USB_CAPTURE_ENDPOINT;
+          rec.arg[0] = transfer_type;
+          capture_xml_uint_attr (reader, "address", &rec.arg[1]);
+          if (capture_xml_attr_is (reader, "direction", "IN"))
+            rec.flags |= SANEI_USB_CAPTURE_FLAG_IN;
+        }
+      else if (strcmp (name, "control_tx") == 0)
+        {
+          rec.type = SANEI_USB_CAPTURE_CONTROL;
+          capture_xml_common (reader, &rec);
+          capture_xml_uint_attr (reader, "bmRequestType", &rec.arg[0]);
+          capture_xml_uint_attr (reader, "bRequest", &rec.arg[1]);
+          if (capture_xml_uint_attr (reader, "wValue", &value))
+            rec.arg[2] = value & 0xffff;
+          if (capture_xml_uint_attr (reader, "wIndex", &value))
+            rec.arg[2] |= (value & 0xffff) << 16;
+          capture_xml_uint_attr (reader, "wLength", &rec.arg[3]);
+          data = capture_xml_data (reader, &rec, NULL);
+        }
+      else if (strcmp (name, "bulk_tx") == 0 ||
+               strcmp (name, "interrupt_tx") == 0)
+        {
+          rec.type = name[0] == 'b' ? SANEI_USB_CAPTURE_BULK
+                                    : SANEI_USB_CAPTURE_INTERRUPT;
+          capture_xml_common (reader, &rec);
+          data = capture_xml_data (reader, &rec, &rec.arg[0]);
+        }
+      else if (strcmp (name, "get_descriptor") == 0)
+        {
+          uint32_t desc_type = 0, dev_class = 0, sub_class = 0, protocol = 0;
+
+          rec.type = SANEI_USB_CAPTURE_GET_DESCRIPTOR;
+          capture_xml_common (reader, &rec);
+          capture_xml_uint_attr (reader, "descriptor_type", &desc_type);
+          capture_xml_uint_attr (reader, "device_class", &dev_class);
+          capture_xml_uint_attr (reader, "device_sub_class", &sub_class);
+          capture_xml_uint_attr (reader, "device_protocol", &protocol);
+          rec.arg[0] = (desc_type & 0xff) | (dev_class & 0xff) << 8 |
+                       (sub_class & 0xff) << 16 | (protocol & 0xff) << 24;
+          capture_xml_uint_attr (reader, "bcd_usb", &rec.arg[1]);
+          capture_xml_uint_attr (reader, "bcd_device", &rec.arg[2]);
+          capture_xml_uint_attr (reader, "max_packet_size", &rec.arg[3]);
+        }
+      else if (strcmp (name, "debug") == 0)
+        {
+          rec.type = SANEI_USB_CAPTURE_DEBUG;
+          capture_xml_common (reader, &rec);
+          data = xmlTextReaderGetAttribute (reader,
+                                            (const xmlChar *) "message");
+          if (data != NULL)
+            {
+              rec.data = data;
+              rec.size = strlen ((const char *) data);
+            }
+        }
+      else if (strcmp (name, "known_commands_end") == 0)
+        {
+          rec.type = SANEI_USB_CAPTURE_KNOWN_COMMANDS_END;
+        }
+      else
+        continue;
+
+      status = sanei_usb_capture_write (capture, &rec);
+      if (rec.type == SANEI_USB_CAPTURE_DEBUG)
+        xmlFree (data);
+      else
+        free (data);
+    }
+
+  if (status == SANE_STATUS_GOOD && ret != 0)
+    {
+      DBG (1, "%s: failed to parse %s\n", __func__, xml_path);
+      status = SANE_STATUS_INVAL;
+    }
+
+  xmlFree (backend);
+  xmlFreeTextReader (reader);
+  if (sanei_usb_capture_close (capture) != SANE_STATUS_GOOD &&
+      status == SANE_STATUS_GOOD)
+    status = SANE_STATUS_IO_ERROR;
+  return status;
+}
+
+static void
+capture_xml_write_hex_attr (xmlTextWriterPtr writer, const char *name,
+                            unsigned value)
+{
+  if (value > 0xffffff)
+    xmlTextWriterWriteFormatAttribute (writer, (const xmlChar *) name,
+                                       "0x%x", value);
+  else if (value > 0xffff)
+    xmlTextWriterWriteFormatAttribute (writer, (const xmlChar *) name,
+                                       "0x%06x", value);
+  else if (value > 0xff)
+    xmlTextWriterWriteFormatAttribute (writer, (const xmlChar *) name,
+                                       "0x%04x", value);
+  else
+    xmlTextWriterWriteFormatAttribute (writer, (const xmlChar *) name,
+                                       "0x%02x", value);
+}
+
+static void
+capture_xml_write_common (xmlTextWriterPtr writer,
+                          const sanei_usb_capture_record * rec,
+                          int with_endpoint)
+{
+  xmlTextWriterWriteAttribute (writer, (const xmlChar *) "time_usec",
+                               (const xmlChar *) "0");
+  if (rec->seq > 0)
+    xmlTextWriterWriteFormatAttribute (writer, (const xmlChar *) "seq",
+                                       "%u", rec->seq);
+  if (rec->flags & SANEI_USB_CAPTURE_FLAG_DEBUG_BREAK)
+    xmlTextWriterWriteAttribute (writer, (const xmlChar *) "debug_break",
+                                 (const xmlChar *) "");
+  if (with_endpoint)
+    {
+      xmlTextWriterWriteFormatAttribute (writer,
+                                         (const xmlChar *) "endpoint_number",
+                                         "%u", rec->endpoint);
+      xmlTextWriterWriteAttribute (writer, (const xmlChar *) "direction",
+                                   (const xmlChar *)
+                                   ((rec->flags & SANEI_USB_CAPTURE_FLAG_IN)
+                                    ? "IN" : "OUT"));
+    }
+}
+
+/* Writes the data of a transaction in the same layout as the XML recorder:
+   two hex digits per byte, 32 bytes per line. */
+static void
+capture_xml_write_data (xmlTextWriterPtr writer,
+                        const sanei_usb_capture_record * rec,
+                        const char *unknown_fmt, unsigned long unknown_size)
+{
+  char line[32 * 3 + 1];
+  size_t i, len = 0;
+
+  if (rec->flags & SANEI_USB_CAPTURE_FLAG_UNKNOWN)
+    {
+      xmlTextWriterWriteFormatString (writer, unknown_fmt, unknown_size);
+      return;
+    }
+
+  for (i = 0; i < rec->size; i++)
+    {
+      len += snprintf (line + len, sizeof (line) - len, "%02x",
+                       rec->data[i]);
+      if (i + 1 == rec->size)
+        break;
+      line[len++] = (i + 1) % 32 == 0 ? '\n' : ' ';
+      if (len + 3 > sizeof (line))
+        {
+          line[len] = '\0';
+          xmlTextWriterWriteString (writer, (const xmlChar *) line);
+          len = 0;
+        }
+    }
+  line[len] = '\0';
+  if (len > 0)
+    xmlTextWriterWriteString (writer, (const xmlChar *) line);
+}
+
+static const char *
+capture_transfer_type_name (unsigned type)
+{
+  switch (type)
+    {
+    case USB_ENDPOINT_TYPE_CONTROL:
+      return "CONTROL";
+    case USB_ENDPOINT_TYPE_ISOCHRONOUS:
+      return "ISOCHRONOUS";
+    case USB_ENDPOINT_TYPE_BULK:
+      return "BULK";
+    case USB_ENDPOINT_TYPE_INTERRUPT:
+      return "INTERRUPT";
+    }
+  return "UNKNOWN";
+}
+
+SANE_Status
+sanei_usb_capture_to_xml (SANE_String_Const path, SANE_String_Const xml_path)
+{
+  sanei_usb_capture *capture;
+  sanei_usb_capture_record rec;
+  xmlTextWriterPtr writer;
+  SANE_Status status;
+  /* number of open description elements: 0 none, 1 description,
+     2 configurations, 3 configuration, 4 interface; -1 transactions */
+  int depth = 0;
+  uint32_t configuration = 0;
+  char *text;
+
+  DBG_INIT ();
+
+  capture = sanei_usb_capture_open (path);
+  if (capture == NULL)
+    return SANE_STATUS_ACCESS_DENIED;
+
+  writer = xmlNewTextWriterFilename (xml_path, 0);
+  if (writer == NULL)
+    {
+      DBG (1, "%s: can't create %s\n", __func__, xml_path);
+      sanei_usb_capture_close (capture);
+      return SANE_STATUS_ACCESS_DENIED;
+    }
+  xmlTextWriterSetIndent (writer, 1);
+  xmlTextWriterSetIndentString (writer, (const xmlChar *) "  ");
+  xmlTextWriterStartDocument (writer, NULL, "UTF-8", NULL);
+  xmlTextWriterStartElement (writer, (const xmlChar *) "device_capture");
+
+  while ((status = sanei_usb_capture_read (capture, &rec)) == SANE_STATUS_GOOD)
+    {
+      switch (rec.type)
+        {
+        case SANEI_USB_CAPTURE_DEVICE:
+          text = strndup ((const char *) rec.data, rec.size);
+          xmlTextWriterWriteAttribute (writer, (const xmlChar *) "backend",
+                                       (const xmlChar *) text);
+          free (text);
+          xmlTextWriterStartElement (writer, (const xmlChar *) "description");
+          capture_xml_write_hex_attr (writer, "id_vendor", rec.arg[0]);
+          capture_xml_write_hex_attr (writer, "id_product", rec.arg[1]);
+          xmlTextWriterStartElement (writer,
+                                     (const xmlChar *) "configurations");
+          depth = 2;
+          continue;
+
+        case SANEI_USB_CAPTURE_INTERFACE:
+          if (depth == 4)
+            {
+              xmlTextWriterEndElement (writer);
+              depth = 3;
+            }
+          if (depth == 3 && configuration != rec.arg[1])
+            {
+              xmlTextWriterEndElement (writer);
+              depth = 2;
+            }
+          if (depth == 2)
+            {
+              configuration = rec.arg[1];
+              xmlTextWriterStartElement (writer,
+                                         (const xmlChar *) "configuration");
+              xmlTextWriterWriteFormatAttribute (writer,
+                                                 (const xmlChar *) "number",
+                                                 "%u", configuration);
+              depth = 3;
+            }
+          xmlTextWriterStartElement (writer, (const xmlChar *) "interface");
+          xmlTextWriterWriteFormatAttribute (writer,
+                                             (const xmlChar *) "number",
+                                             "%u", rec.arg[0]);
+          depth = 4;
+          continue;
+
+        case SANEI_USB_CAPTURE_ENDPOINT:
+          xmlTextWriterStartElement (writer, (const xmlChar *) "endpoint");
+          xmlTextWriterWriteAttribute (writer,
+                                       (const xmlChar *) "transfer_type",
+                                       (const xmlChar *)
+                                       capture_transfer_type_name (rec.arg[0]));
+          xmlTextWriterWriteFormatAttribute (writer,
+                                             (const xmlChar *) "number",
+                                             "%u", rec.arg[1] & 0x0f);
+          xmlTextWriterWriteAttribute (writer, (const xmlChar *) "direction",
+                                       (const xmlChar *)
+                                       ((rec.flags & SANEI_USB_CAPTURE_FLAG_IN)
+                                        ? "IN" : "OUT"));
+          capture_xml_write_hex_attr (writer, "address", rec.arg[1]);
+          xmlTextWriterEndElement (writer);
+          continue;
+        }
+
+      if (depth >= 0)
+        {
+          /* close the description and start the transactions */
+          for (; depth > 0; depth--)
+            xmlTextWriterEndElement (writer);
+          xmlTextWriterStartElement (writer, (const xmlChar *) "transactions");
+          depth = -1;
+        }
+
+      switch (rec.type)
+        {
+        case SANEI_USB_CAPTURE_CONTROL:
+          xmlTextWriterStartElement (writer, (const xmlChar *) "control_tx");
+          capture_xml_write_common (writer, &rec, 1);
+          capture_xml_write_hex_attr (writer, "bmRequestType", rec.arg[0]);
+          capture_xml_write_hex_attr (writer, "bRequest", rec.arg[1]);
+          capture_xml_write_hex_attr (writer, "wValue", rec.arg[2] & 0xffff);
+          capture_xml_write_hex_attr (writer, "wIndex", rec.arg[2] >> 16);
+          capture_xml_write_hex_attr (writer, "wLength", rec.arg[3]);
+          capture_xml_write_data (writer, &rec, "(unknown read of size %lu)",
+                                  rec.arg[3]);
+          xmlTextWriterEndElement (writer);
+          break;
+
+        case SANEI_USB_CAPTURE_BULK:
+        case SANEI_USB_CAPTURE_INTERRUPT:
+          xmlTextWriterStartElement (writer, (const xmlChar *)
+                                     (rec.type == SANEI_USB_CAPTURE_BULK
+                                      ? "bulk_tx" : "interrupt_tx"));
+          capture_xml_write_common (writer, &rec, 1);
+          if (rec.flags & SANEI_USB_CAPTURE_FLAG_TIMEOUT)
+            xmlTextWriterWriteAttribute (writer, (const xmlChar *) "error",
+                                         (const xmlChar *) "timeout");
+          else
+            capture_xml_write_data (writer, &rec,
+                                    rec.type == SANEI_USB_CAPTURE_BULK
+                                    ? "(unknown read of allowed size %lu)"
+                                    : "(unknown read of wanted size %lu)",
+                                    rec.arg[0]);
+          xmlTextWriterEndElement (writer);
+          break;
+
+        case SANEI_USB_CAPTURE_GET_DESCRIPTOR:
+          xmlTextWriterStartElement (writer,
+                                     (const xmlChar *) "get_descriptor");
+          capture_xml_write_common (writer, &rec, 0);
+          capture_xml_write_hex_attr (writer, "descriptor_type",
+                                      rec.arg[0] & 0xff);
+          capture_xml_write_hex_attr (writer, "bcd_usb", rec.arg[1]);
+          capture_xml_write_hex_attr (writer, "bcd_device", rec.arg[2]);
+          capture_xml_write_hex_attr (writer, "device_class",
+                                      (rec.arg[0] >> 8) & 0xff);
+          capture_xml_write_hex_attr (writer, "device_sub_class",
+                                      (rec.arg[0] >> 16) & 0xff);
+          capture_xml_write_hex_attr (writer, "device_protocol",
+                                      rec.arg[0] >> 24);
+          capture_xml_write_hex_attr (writer, "max_packet_size", rec.arg[3]);
+          xmlTextWriterEndElement (writer);
+          break;
+
+        case SANEI_USB_CAPTURE_DEBUG:
+          xmlTextWriterStartElement (writer, (const xmlChar *) "debug");
+          if (rec.seq > 0)
+            xmlTextWriterWriteFormatAttribute (writer,
+                                               (const xmlChar *) "seq",
+                                               "%u", rec.seq);
+          text = strndup ((const char *) rec.data, rec.size);
+          xmlTextWriterWriteAttribute (writer, (const xmlChar *) "message",
+                                       (const xmlChar *) text);
+          free (text);
+          xmlTextWriterEndElement (writer);
+          break;
+
+        case SANEI_USB_CAPTURE_KNOWN_COMMANDS_END:
+          xmlTextWriterStartElement (writer,
+                                     (const xmlChar *) "known_commands_end");
+          xmlTextWriterEndElement (writer);
+          break;
+
+        default:
+          DBG (3, "%s: skipping record of unknown type %u\n", __func__,
+               rec.type);
+          break;
+        }
+    }
+
+  if (depth >= 0)
+    {
+      for (; depth > 0; depth--)
+        xmlTextWriterEndElement (writer);
+      xmlTextWriterStartElement (writer, (const xmlChar *) "transactions");
+    }
+  xmlTextWriterEndDocument (writer);
+  xmlFreeTextWriter (writer);
+  sanei_usb_capture_close (capture);
+
+  return status == SANE_STATUS_EOF ? SANE_STATUS_GOOD : status;
+}
+
+#else /* HAVE_LIBXML2 */
+
+SANE_Status
+sanei_usb_capture_from_xml (SANE_String_Const xml_path,
+                            SANE_String_Const path)
+{
+  (void) xml_path;
+  (void) path;
+
+  DBG (1, "%s: libxml2 support is missing\n", __func__);
+  return SANE_STATUS_UNSUPPORTED;
+}
+
+SANE_Status
+sanei_usb_capture_to_xml (SANE_String_Const path, SANE_String_Const xml_path)
+{
+  (void) path;
+  (void) xml_path;
+
+  DBG (1, "%s: libxml2 support is missing\n", __func__);
+  return SANE_STATUS_UNSUPPORTED;
+}
+
+#endif /* HAVE_LIBXML2 */
@@ -155,10 +155,30 @@ sanei_w_void (Wire * w, void __sane_unused__ * v)
   DBG (3, "sanei_w_void: wire %d (void debug output)\n", w->io.fd);
 }
 
+/* Return the codec's bulk function for arrays whose elements are coded
+   by W_ELEMENT, or 0 if the elements must be coded one by one. */
+static WireArrayCodecFunc
+array_codec (Wire * w, WireCodecFunc w_element, size_t element_size)
+{
+  if (element_size == sizeof (SANE_Word)
+      && (w_element == w->codec.w_word
+	  || w_element == (WireCodecFunc) sanei_w_word))
+    return w->codec.w_word_array;
+
+  if (element_size == 1
+      && (w_element == w->codec.w_byte || w_element == w->codec.w_char
+	  || w_element == (WireCodecFunc) sanei_w_byte
+	  || w_element == (WireCodecFunc) sanei_w_char))
+    return w->codec.w_byte_array;
+
+  return 0;
+}
+
 void
 sanei_w_array (Wire * w, SANE_Word * len_ptr, void **v,
 	       WireCodecFunc w_element, size_t element_size)
 {
+  WireArrayCodecFunc w_array;
   SANE_Word len;
   char *val;
   int i;
@@ -166,14 +186,17 @@ sanei_w_array (Wire * w, SANE_Word * len_ptr, void **v,
   DBG (3, "sanei_w_array: wire %d, elements of size %lu\n", w->io.fd,
        (u_long) element_size);
 
+  w_array = array_codec (w, w_element, element_size);
+
   if (w->direction == WIRE_FREE)
     {
       if (*len_ptr && *v)
 	{
 	  DBG (4, "sanei_w_array: FREE: freeing array (%d elements)\n",
 	       *len_ptr);
+	  /* plain bytes and words own no memory */
 	  val = *v;
-	  for (i = 0; i < *len_ptr; ++i)
+	  for (i = 0; !w_array && i < *len_ptr; ++i)
 	    {
 	      (*w_element) (w, val);
 	      val += element_size;
@@ -234,6 +257,15 @@ sanei_w_array (Wire * w, SANE_Word * len_ptr, void **v,
 
   val = *v;
   DBG (4, "sanei_w_array: transferring array elements\n");
+  if (w_array && len > 0)
+    {
+      (*w_array) (w, val, len);
+      if (w->status)
+	DBG (1, "sanei_w_array: bad status: %d\n", w->status);
+      else
+	DBG (4, "sanei_w_array: done\n");
+      return;
+    }
   for (i = 0; i < len; ++i)
     {
       (*w_element) (w, val);
@@ -672,6 +704,8 @@ sanei_w_init (Wire * w, void (*codec_init_func) (Wire *))
 
   w->buffer.curr = w->buffer.start;
   w->buffer.end = w->buffer.start + w->buffer.size;
+  w->codec.w_byte_array = 0;
+  w->codec.w_word_array = 0;
   if (codec_init_func != 0)
     {
       DBG (4, "sanei_w_init: initializing codec\n");
@@ -0,0 +1,475 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+*/
+
+// Measures the host side performance of the genesys backend. Each configuration is scanned
+// through the regular SANE API in testing mode, so that register setup, calibration and the
+// image pipeline run exactly as for a real scanner, while the scanner itself is replaced by
+// TestScannerInterface returning synthetic sensor data.
+
+#define DEBUG_DECLARE_ONLY
+
+#include "../../../backend/genesys/device.h"
+#include "../../../backend/genesys/enums.h"
+#include "../../../backend/genesys/error.h"
+#include "../../../backend/genesys/low.h"
+#include "../../../backend/genesys/genesys.h"
+#include "../../../backend/genesys/test_settings.h"
+#include "../../../backend/genesys/utilities.h"
+#include "../../../include/sane/saneopts.h"
+#include "benchmark_allocations.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct BenchmarkConfig
+{
+    std::uint16_t vendor_id = 0;
+    std::uint16_t product_id = 0;
+    std::uint16_t bcd_device = 0;
+    std::string model_name;
+    genesys::ScanMethod method = genesys::ScanMethod::FLATBED;
+    genesys::ScanColorMode color_mode = genesys::ScanColorMode::COLOR_SINGLE_PASS;
+    unsigned depth = 0;
+    unsigned resolution = 0;
+
+    std::string name() const
+    {
+        std::stringstream out;
+        out << "benchmark_" << model_name
+            << '_' << method
+            << '_' << color_mode
+            << "_depth" << depth
+            << "_dpi" << resolution;
+        return out.str();
+    }
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    // time spent in sane_start(), i.e. register setup, calibration and pipeline construction
+    double setup_ms = 0;
+    // time spent in sane_read(), i.e. moving the data through the image pipeline
+    double read_ms = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t pixels = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t allocated_bytes = 0;
+
+    double mb_per_s() const
+    {
+        return read_ms > 0 ? bytes / (read_ms * 1000.0) : 0;
+    }
+
+    double ns_per_pixel() const
+    {
+        return pixels > 0 ? read_ms * 1e6 / pixels : 0;
+    }
+};
+
+// Returns a deterministic, noisy pattern resembling raw sensor data. The pattern is generated
+// once and then copied, so that producing the data does not dominate the measured time.
+void fill_synthetic_data(std::uint8_t* data, std::size_t size)
+{
+    static std::vector<std::uint8_t> pattern;
+    if (pattern.empty()) {
+        pattern.resize(65521); // prime, so that the pattern does not align with lines
+        std::uint32_t state = 0x12345678;
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            state = state * 1103515245 + 12345;
+            // a slow ramp with noise on top, so that calibration sees plausible values
+            pattern[i] = static_cast<std::uint8_t>(0x40 + (i % 128) + ((state >> 16) & 0x3f));
+        }
+    }
+
+    std::size_t offset = 0;
+    while (offset < size) {
+        auto copy_size = std::min(size - offset, pattern.size());
+        std::memcpy(data + offset, pattern.data(), copy_size);
+        offset += copy_size;
+    }
+}
+
+SANE_Int find_option(SANE_Handle handle, const std::string& name, SANE_Value_Type type)
+{
+    SANE_Int option_count = 0;
+    TIE(sane_control_option(handle, 0, SANE_ACTION_GET_VALUE, &option_count, nullptr));
+
+    for (SANE_Int i = 1; i < option_count; ++i) {
+        const auto* option = sane_get_option_descriptor(handle, i);
+        if (option != nullptr && option->name != nullptr && option->name == name) {
+            if (option->type != type) {
+                throw std::runtime_error("Option has incorrect type");
+            }
+            return i;
+        }
+    }
+    throw std::runtime_error("Could not find option " + name);
+}
+
+void set_option(SANE_Handle handle, const std::string& name, SANE_Value_Type type, void* value)
+{
+    TIE(sane_control_option(handle, find_option(handle, name, type), SANE_ACTION_SET_VALUE,
+                            value, nullptr));
+}
+
+// Scans only a strip of the given height, as the per pixel cost does not depend on it and full
+// height scans at the highest resolutions would take minutes each.
+BenchmarkResult run_single_benchmark_scan(const BenchmarkConfig& config, double height_mm)
+{
+    using clock = std::chrono::steady_clock;
+
+    genesys::enable_testing_mode(config.vendor_id, config.product_id, config.bcd_device,
+                                 genesys::TestCheckpointCallback{});
+    genesys::set_testing_bulk_read_callback(fill_synthetic_data);
+
+    BenchmarkResult result;
+    result.name = config.name();
+
+    SANE_Handle handle;
+
+    TIE(sane_init(nullptr, nullptr));
+    TIE(sane_open(genesys::get_testing_device_name().c_str(), &handle));
+
+    SANE_Bool force_calibration = SANE_TRUE;
+    set_option(handle, "force-calibration", SANE_TYPE_BUTTON, &force_calibration);
+    std::string source = genesys::scan_method_to_option_string(config.method);
+    set_option(handle, SANE_NAME_SCAN_SOURCE, SANE_TYPE_STRING, &source.front());
+    std::string mode = genesys::scan_color_mode_to_option_string(config.color_mode);
+    set_option(handle, SANE_NAME_SCAN_MODE, SANE_TYPE_STRING, &mode.front());
+    if (config.color_mode != genesys::ScanColorMode::LINEART) {
+        SANE_Int depth = config.depth;
+        set_option(handle, SANE_NAME_BIT_DEPTH, SANE_TYPE_INT, &depth);
+    }
+    SANE_Int resolution = config.resolution;
+    set_option(handle, SANE_NAME_SCAN_RESOLUTION, SANE_TYPE_INT, &resolution);
+    SANE_Fixed br_y = genesys::double_to_fixed(height_mm);
+    set_option(handle, SANE_NAME_SCAN_BR_Y, SANE_TYPE_FIXED, &br_y);
+
+    std::vector<std::uint8_t> buffer;
+    buffer.resize(1024 * 1024);
+
+    start_counting_allocations();
+
+    auto start_time = clock::now();
+    TIE(sane_start(handle));
+    auto read_time = clock::now();
+
+    SANE_Parameters params;
+    TIE(sane_get_parameters(handle, &params));
+
+    std::uint64_t total_data_size = std::uint64_t(params.bytes_per_line) * params.lines;
+
+    while (result.bytes < total_data_size) {
+        int ask_len = std::min<std::uint64_t>(buffer.size(), total_data_size - result.bytes);
+
+        int got_data = 0;
+        auto status = sane_read(handle, buffer.data(), ask_len, &got_data);
+        result.bytes += got_data;
+        if (status == SANE_STATUS_EOF) {
+            break;
+        }
+        TIE(status);
+    }
+    auto end_time = clock::now();
+
+    auto allocations = stop_counting_allocations();
+
+    result.setup_ms = std::chrono::duration<double, std::milli>(read_time - start_time).count();
+    result.read_ms = std::chrono::duration<double, std::milli>(end_time - read_time).count();
+    result.pixels = std::uint64_t(params.pixels_per_line) * params.lines;
+    result.allocations = allocations.count;
+    result.allocated_bytes = allocations.bytes;
+
+    sane_cancel(handle);
+    sane_close(handle);
+    sane_exit();
+
+    genesys::disable_testing_mode();
+    return result;
+}
+
+// Runs the scan several times and keeps the fastest timings, which are the least affected by
+// the rest of the system.
+BenchmarkResult run_benchmark(const BenchmarkConfig& config, unsigned repeat, double height_mm)
+{
+    auto best = run_single_benchmark_scan(config, height_mm);
+    for (unsigned i = 1; i < repeat; ++i) {
+        auto result = run_single_benchmark_scan(config, height_mm);
+        best.setup_ms = std::min(best.setup_ms, result.setup_ms);
+        best.read_ms = std::min(best.read_ms, result.read_ms);
+    }
+    return best;
+}
+
+std::vector<BenchmarkConfig> get_all_benchmark_configs()
+{
+    genesys::genesys_init_usb_device_tables();
+    genesys::genesys_init_sensor_tables();
+    genesys::verify_usb_device_tables();
+    genesys::verify_sensor_tables();
+
+    std::vector<BenchmarkConfig> configs;
+    std::unordered_set<std::string> model_names;
+
+    for (const auto& usb_dev : *genesys::s_usb_devices) {
+
+        const auto& model = usb_dev.model();
+
+        if (genesys::has_flag(model.flags, genesys::ModelFlag::UNTESTED)) {
+            continue;
+        }
+        if (model_names.find(model.name) != model_names.end()) {
+            continue;
+        }
+        model_names.insert(model.name);
+
+        for (auto scan_mode : { genesys::ScanColorMode::GRAY,
+                                genesys::ScanColorMode::COLOR_SINGLE_PASS }) {
+
+            auto depth_values = model.bpp_gray_values;
+            if (scan_mode == genesys::ScanColorMode::COLOR_SINGLE_PASS) {
+                depth_values = model.bpp_color_values;
+            }
+            for (unsigned depth : depth_values) {
+                for (auto method_resolutions : model.resolutions) {
+                    for (auto method : method_resolutions.methods) {
+                        for (unsigned resolution : method_resolutions.get_resolutions()) {
+                            BenchmarkConfig config;
+                            config.vendor_id = usb_dev.vendor_id();
+                            config.product_id = usb_dev.product_id();
+                            config.bcd_device = usb_dev.bcd_device();
+                            config.model_name = model.name;
+                            config.method = method;
+                            config.depth = depth;
+                            config.resolution = resolution;
+                            config.color_mode = scan_mode;
+                            configs.push_back(config);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return configs;
+}
+
+const char* const CSV_HEADER =
+        "name,setup_ms,read_ms,bytes,pixels,mb_per_s,ns_per_pixel,allocations,allocated_bytes";
+
+std::string format_csv(const BenchmarkResult& result)
+{
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), ",%.3f,%.3f,%llu,%llu,%.2f,%.3f,%llu,%llu",
+                  result.setup_ms, result.read_ms,
+                  static_cast<unsigned long long>(result.bytes),
+                  static_cast<unsigned long long>(result.pixels),
+                  result.mb_per_s(), result.ns_per_pixel(),
+                  static_cast<unsigned long long>(result.allocations),
+                  static_cast<unsigned long long>(result.allocated_bytes));
+    return result.name + buf;
+}
+
+std::map<std::string, BenchmarkResult> read_baseline(const std::string& path)
+{
+    std::ifstream in{path};
+    if (!in.is_open()) {
+        throw std::runtime_error("Could not open baseline file: " + path);
+    }
+
+    std::map<std::string, BenchmarkResult> results;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line == CSV_HEADER) {
+            continue;
+        }
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream line_in{line};
+
+        BenchmarkResult result;
+        double mb_per_s = 0;
+        double ns_per_pixel = 0;
+        line_in >> result.name >> result.setup_ms >> result.read_ms >> result.bytes
+                >> result.pixels >> mb_per_s >> ns_per_pixel >> result.allocations
+                >> result.allocated_bytes;
+        if (!line_in) {
+            throw std::runtime_error("Invalid line in baseline file: " + line);
+        }
+        results[result.name] = result;
+    }
+    return results;
+}
+
+// Returns a description of the regressions of result compared to baseline or an empty string
+// if there are none. Times below min_ms are too noisy to be compared.
+std::string check_regression(const BenchmarkResult& result, const BenchmarkResult& baseline,
+                             double threshold, double min_ms)
+{
+    std::stringstream out;
+    auto limit = 1 + threshold / 100;
+
+    if (result.setup_ms > min_ms && result.setup_ms > baseline.setup_ms * limit) {
+        out << "    setup_ms: " << baseline.setup_ms << " -> " << result.setup_ms << "\n";
+    }
+    if (result.read_ms > min_ms && result.ns_per_pixel() > baseline.ns_per_pixel() * limit) {
+        out << "    ns_per_pixel: " << baseline.ns_per_pixel() << " -> "
+            << result.ns_per_pixel() << "\n";
+    }
+    if (result.allocations > baseline.allocations * limit) {
+        out << "    allocations: " << baseline.allocations << " -> " << result.allocations << "\n";
+    }
+    return out.str();
+}
+
+void print_help()
+{
+    std::cerr << "Usage:\n"
+              << "genesys_benchmarks [--test={test_name}] [--model={model_name}]\n"
+              << "                   [--repeat={count}] [--height={mm}] [--output={csv_file}]\n"
+              << "                   [--baseline={csv_file} [--threshold={percent}]\n"
+              << "                    [--min-time={ms}]]\n"
+              << "genesys_benchmarks --help\n"
+              << "genesys_benchmarks --print_test_names\n"
+              << "\n"
+              << "Results are printed as CSV to the standard output or written to the given\n"
+              << "file. With --baseline, the results are compared to a previous run and the\n"
+              << "program fails if any scan became slower or allocates more by more than the\n"
+              << "threshold (10% by default). Times shorter than --min-time (5 ms by\n"
+              << "default) are not compared. Only the top --height millimeters (10 by\n"
+              << "default) of the scan area are scanned.\n";
+}
+
+int main(int argc, const char* argv[])
+{
+    std::string test_name_filter;
+    std::string model_name_filter;
+    std::string output_path;
+    std::string baseline_path;
+    unsigned repeat = 3;
+    double threshold = 10;
+    double min_ms = 5;
+    double height_mm = 10;
+    bool print_test_names = false;
+
+    for (int argi = 1; argi < argc; ++argi) {
+        std::string arg = argv[argi];
+        if (arg.rfind("--test=", 0) == 0) {
+            test_name_filter = arg.substr(7);
+        } else if (arg.rfind("--model=", 0) == 0) {
+            model_name_filter = arg.substr(8);
+        } else if (arg.rfind("--repeat=", 0) == 0) {
+            repeat = std::max(1, std::atoi(arg.c_str() + 9));
+        } else if (arg.rfind("--height=", 0) == 0) {
+            height_mm = std::atof(arg.c_str() + 9);
+        } else if (arg.rfind("--output=", 0) == 0) {
+            output_path = arg.substr(9);
+        } else if (arg.rfind("--baseline=", 0) == 0) {
+            baseline_path = arg.substr(11);
+        } else if (arg.rfind("--threshold=", 0) == 0) {
+            threshold = std::atof(arg.c_str() + 12);
+        } else if (arg.rfind("--min-time=", 0) == 0) {
+            min_ms = std::atof(arg.c_str() + 11);
+        } else if (arg == "-h" || arg == "--help") {
+            print_help();
+            return 0;
+        } else if (arg == "--print_test_names") {
+            print_test_names = true;
+        } else {
+            print_help();
+            return 1;
+        }
+    }
+
+    auto configs = get_all_benchmark_configs();
+
+    if (print_test_names) {
+        for (const auto& config : configs) {
+            std::cout << config.name() << "\n";
+        }
+        return 0;
+    }
+
+    std::map<std::string, BenchmarkResult> baseline;
+    if (!baseline_path.empty()) {
+        baseline = read_baseline(baseline_path);
+    }
+
+    std::ofstream output_file;
+    if (!output_path.empty()) {
+        output_file.open(output_path);
+        if (!output_file.is_open()) {
+            std::cerr << "Could not open output file: " << output_path << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = output_path.empty() ? std::cout : output_file;
+    out << CSV_HEADER << "\n";
+
+    bool success = true;
+    for (unsigned i = 0; i < configs.size(); ++i) {
+        const auto& config = configs[i];
+
+        if (!test_name_filter.empty() && config.name() != test_name_filter) {
+            continue;
+        }
+        if (!model_name_filter.empty() && config.model_name != model_name_filter) {
+            continue;
+        }
+
+        BenchmarkResult result;
+        try {
+            result = run_benchmark(config, repeat, height_mm);
+        } catch (const std::exception& exc) {
+            std::cerr << "(" << i << "/" << configs.size() << "): FAIL: " << config.name()
+                      << "\n" << "got exception: " << exc.what() << "\n";
+            stop_counting_allocations();
+            genesys::disable_testing_mode();
+            success = false;
+            continue;
+        }
+        out << format_csv(result) << "\n";
+
+        if (baseline.empty()) {
+            continue;
+        }
+        auto it = baseline.find(result.name);
+        if (it == baseline.end()) {
+            std::cerr << "(" << i << "/" << configs.size() << "): NEW: " << result.name << "\n";
+            continue;
+        }
+        auto regressions = check_regression(result, it->second, threshold, min_ms);
+        if (!regressions.empty()) {
+            std::cerr << "(" << i << "/" << configs.size() << "): REGRESSION: "
+                      << result.name << "\n" << regressions;
+            success = false;
+        }
+    }
+
+    return success ? 0 : 1;
+}
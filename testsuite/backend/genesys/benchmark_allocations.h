@@ -0,0 +1,37 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+*/
+
+#ifndef SANE_TESTSUITE_BACKEND_GENESYS_BENCHMARK_ALLOCATIONS_H
+#define SANE_TESTSUITE_BACKEND_GENESYS_BENCHMARK_ALLOCATIONS_H
+
+#include <cstdint>
+
+struct AllocationCounts
+{
+    std::uint64_t count = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Starts counting the allocations done through the global operator new. The operator is replaced
+// in a separate translation unit so that the compiler can't inline it into its callers.
+void start_counting_allocations();
+AllocationCounts stop_counting_allocations();
+
+#endif
@@ -30,6 +30,7 @@ void test_image();
 void test_image_pipeline();
 void test_motor();
 void test_row_buffer();
+void test_scanner_interface();
 void test_utilities();
 
 } // namespace genesys
@@ -25,8 +25,12 @@
 #include "tests.h"
 #include "minigtest.h"
 
+#include "../../../backend/genesys/genesys.h"
 #include "../../../backend/genesys/low.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 
 namespace genesys {
@@ -123,9 +127,191 @@ void test_calibration_roundtrip()
     ASSERT_TRUE(str.eof());
 }
 
+void test_calibration_binary_roundtrip()
+{
+    auto second_entry = create_fake_calibration_entry();
+    second_entry.params.xres = 600;
+    second_entry.white_average_data = { 1, 2, 3 };
+    second_entry.dark_average_data = {};
+    second_entry.last_use = 12;
+
+    Genesys_Device::Calibration calibration = { create_fake_calibration_entry(), second_entry };
+    calibration[0].last_use = 7;
+    Genesys_Device::Calibration deserialized;
+
+    std::stringstream str;
+    write_calibration(str, calibration);
+    ASSERT_TRUE(read_calibration(str, deserialized, "test"));
+    ASSERT_EQ(deserialized.size(), 2u);
+    ASSERT_EQ(deserialized[0].last_use, 7u);
+    ASSERT_EQ(deserialized[1].last_use, 12u);
+
+    // the shading data is loaded only on request
+    ASSERT_TRUE(deserialized[0].white_average_data.empty());
+    ASSERT_TRUE(deserialized[0].params == calibration[0].params);
+    ASSERT_TRUE(deserialized[1].params == calibration[1].params);
+
+    for (auto& entry : deserialized) {
+        entry.load_shading_data();
+    }
+    ASSERT_TRUE(calibration == deserialized);
+}
+
+void test_calibration_binary_invalid()
+{
+    Genesys_Device::Calibration calibration = { create_fake_calibration_entry() };
+    Genesys_Device::Calibration deserialized;
+
+    std::stringstream text_str;
+    serialize(static_cast<std::ostream&>(text_str), calibration);
+    ASSERT_FALSE(read_calibration(text_str, deserialized, "test"));
+
+    std::stringstream str;
+    write_calibration(str, calibration);
+    auto data = str.str();
+    data.resize(data.size() / 2);
+
+    std::stringstream truncated_str{data};
+    bool thrown = false;
+    try {
+        read_calibration(truncated_str, deserialized, "test");
+    } catch (const SaneException&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+    ASSERT_TRUE(deserialized.empty());
+}
+
+void test_mapped_file()
+{
+    const std::string path = "genesys_mapped_file_test.bin";
+    std::vector<std::uint8_t> contents = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    {
+        std::ofstream out{path, std::ios::binary};
+        out.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+    }
+
+    MappedFile file;
+    ASSERT_TRUE(file.open(path));
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+    ASSERT_TRUE(file.is_mapped());
+#endif
+    ASSERT_EQ(file.size(), contents.size());
+    ASSERT_TRUE(std::equal(contents.begin(), contents.end(), file.data()));
+
+    file.close();
+    ASSERT_FALSE(file.is_mapped());
+    ASSERT_EQ(file.size(), 0u);
+
+    file.assign(contents);
+    ASSERT_FALSE(file.is_mapped());
+    ASSERT_EQ(file.size(), contents.size());
+
+    std::remove(path.c_str());
+    ASSERT_FALSE(file.open(path));
+
+    {
+        std::ofstream out{path, std::ios::binary};
+    }
+    ASSERT_TRUE(file.open(path));
+    ASSERT_EQ(file.size(), 0u);
+    std::remove(path.c_str());
+}
+
+void test_calibration_binary_file()
+{
+    const std::string path = "genesys_calibration_test.cal";
+    auto second_entry = create_fake_calibration_entry();
+    second_entry.params.yres = 600;
+    second_entry.white_average_data = { 9, 10, 11 };
+
+    Genesys_Device::Calibration calibration = { create_fake_calibration_entry(), second_entry };
+    {
+        std::ofstream out{path, std::ios::binary};
+        write_calibration(out, calibration);
+    }
+
+    Genesys_Device::Calibration deserialized;
+    ASSERT_TRUE(sanei_genesys_read_calibration(deserialized, path));
+    std::remove(path.c_str());
+    ASSERT_EQ(deserialized.size(), 2u);
+
+    // the shading data of all entries is read from the same mapping of the file
+    ASSERT_TRUE(deserialized[0].shading_file != nullptr);
+    ASSERT_TRUE(deserialized[0].shading_file == deserialized[1].shading_file);
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+    ASSERT_TRUE(deserialized[0].shading_file->is_mapped());
+#endif
+
+    for (auto& entry : deserialized) {
+        entry.load_shading_data();
+    }
+    ASSERT_TRUE(calibration == deserialized);
+}
+
+void test_calibration_cache_key()
+{
+    auto entry = create_fake_calibration_entry();
+    CalibrationCacheKey key{entry.params};
+    CalibrationCacheKeyHash hash;
+
+    auto other_params = entry.params;
+    ASSERT_TRUE(key == CalibrationCacheKey{other_params});
+    ASSERT_EQ(hash(key), hash(CalibrationCacheKey{other_params}));
+
+    // parameters that don't affect calibration compatibility must not affect the key
+    other_params.lines += 100;
+    other_params.starty += 10;
+    ASSERT_TRUE(key == CalibrationCacheKey{other_params});
+    ASSERT_EQ(hash(key), hash(CalibrationCacheKey{other_params}));
+
+    other_params = entry.params;
+    other_params.xres += 300;
+    ASSERT_FALSE(key == CalibrationCacheKey{other_params});
+
+    other_params = entry.params;
+    other_params.scan_method = ScanMethod::TRANSPARENCY;
+    ASSERT_FALSE(key == CalibrationCacheKey{other_params});
+}
+
+void test_calibration_cache_expiration()
+{
+    Genesys_Model model;
+    model.is_sheetfed = false;
+
+    Genesys_Device dev;
+    dev.model = &model;
+    dev.settings.expiration_time = 60;
+    dev.settings.scan_method = ScanMethod::FLATBED;
+
+    auto entry = create_fake_calibration_entry();
+    entry.last_calibration = 0;
+
+    entry.params.scan_method = ScanMethod::FLATBED;
+    ASSERT_TRUE(is_calibration_cache_entry_expired(dev, entry));
+
+    // entries of other scan methods never expire, whatever scan method is currently selected
+    entry.params.scan_method = ScanMethod::TRANSPARENCY;
+    ASSERT_FALSE(is_calibration_cache_entry_expired(dev, entry));
+    dev.settings.scan_method = ScanMethod::TRANSPARENCY;
+    ASSERT_FALSE(is_calibration_cache_entry_expired(dev, entry));
+
+    entry.params.scan_method = ScanMethod::FLATBED;
+    ASSERT_TRUE(is_calibration_cache_entry_expired(dev, entry));
+
+    dev.settings.expiration_time = -1;
+    ASSERT_FALSE(is_calibration_cache_entry_expired(dev, entry));
+}
+
 void test_calibration_parsing()
 {
     test_calibration_roundtrip();
+    test_calibration_binary_roundtrip();
+    test_calibration_binary_invalid();
+    test_mapped_file();
+    test_calibration_binary_file();
+    test_calibration_cache_key();
+    test_calibration_cache_expiration();
 }
 
 } // namespace genesys
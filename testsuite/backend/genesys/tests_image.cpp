@@ -28,6 +28,7 @@
 
 #include "../../../backend/genesys/image.h"
 #include "../../../backend/genesys/image_pipeline.h"
+#include "../../../backend/genesys/image_simd.h"
 #include <vector>
 
 namespace genesys {
@@ -562,6 +563,157 @@ void test_convert_pixel_row_format()
     ASSERT_EQ(out_data, expected_data);
 }
 
+static std::vector<std::uint8_t> make_test_data(std::size_t size, unsigned seed)
+{
+    std::vector<std::uint8_t> data;
+    data.resize(size);
+    unsigned value = seed;
+    for (auto& d : data) {
+        value = value * 1103515245 + 12345;
+        d = static_cast<std::uint8_t>(value >> 16);
+    }
+    return data;
+}
+
+void test_pixel_kernels_scalar()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    const auto& kernels = *get_pixel_kernels(SimdLevel::SCALAR);
+
+    Data in_data = {
+        0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc,
+    };
+    Data out_data;
+    out_data.resize(in_data.size());
+
+    kernels.swap_rgb_8(in_data.data(), out_data.data(), 2);
+    ASSERT_EQ(out_data, Data({0x56, 0x34, 0x12, 0xbc, 0x9a, 0x78}));
+
+    kernels.swap_rgb_16(in_data.data(), out_data.data(), 1);
+    ASSERT_EQ(out_data, Data({0x9a, 0xbc, 0x56, 0x78, 0x12, 0x34}));
+
+    out_data = in_data;
+    kernels.swap_16bit_endian(out_data.data(), 3);
+    ASSERT_EQ(out_data, Data({0x34, 0x12, 0x78, 0x56, 0xbc, 0x9a}));
+
+    out_data = in_data;
+    kernels.invert_bytes(out_data.data(), 6);
+    ASSERT_EQ(out_data, Data({0xed, 0xcb, 0xa9, 0x87, 0x65, 0x43}));
+
+    kernels.merge_mono_lines_8(in_data.data(), in_data.data() + 2, in_data.data() + 4,
+                               out_data.data(), 2);
+    ASSERT_EQ(out_data, Data({0x12, 0x56, 0x9a, 0x34, 0x78, 0xbc}));
+
+    kernels.merge_mono_lines_16(in_data.data(), in_data.data() + 2, in_data.data() + 4,
+                                out_data.data(), 1);
+    ASSERT_EQ(out_data, Data({0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc}));
+}
+
+void test_pixel_kernels_match_scalar()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    const auto& scalar = *get_pixel_kernels(SimdLevel::SCALAR);
+
+    // the sizes cover the tails of all vector widths, the data is offset by one byte to check
+    // unaligned accesses
+    std::vector<std::size_t> counts = { 0, 1, 2, 5, 6, 7, 15, 16, 17, 31, 32, 33, 49, 100, 257 };
+
+    for (auto level : { SimdLevel::SSE2, SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::NEON }) {
+        const auto* kernels = get_pixel_kernels(level);
+        if (!kernels) {
+            continue;
+        }
+
+        for (auto count : counts) {
+            auto in_data = make_test_data(count * 6 + 1, count);
+            const auto* in_ptr = in_data.data() + 1;
+
+            Data expected;
+            Data actual;
+
+            expected.assign(count * 3, 0);
+            actual.assign(count * 3 + 1, 0);
+            scalar.swap_rgb_8(in_ptr, expected.data(), count);
+            kernels->swap_rgb_8(in_ptr, actual.data() + 1, count);
+            ASSERT_EQ(Data(actual.begin() + 1, actual.end()), expected);
+
+            actual.assign(in_ptr, in_ptr + count * 3);
+            kernels->swap_rgb_8(actual.data(), actual.data(), count);
+            ASSERT_EQ(actual, expected);
+
+            expected.assign(count * 6, 0);
+            actual.assign(count * 6 + 1, 0);
+            scalar.swap_rgb_16(in_ptr, expected.data(), count);
+            kernels->swap_rgb_16(in_ptr, actual.data() + 1, count);
+            ASSERT_EQ(Data(actual.begin() + 1, actual.end()), expected);
+
+            actual.assign(in_ptr, in_ptr + count * 6);
+            kernels->swap_rgb_16(actual.data(), actual.data(), count);
+            ASSERT_EQ(actual, expected);
+
+            expected.assign(in_data.begin(), in_data.end());
+            actual.assign(in_data.begin(), in_data.end());
+            scalar.swap_16bit_endian(expected.data() + 1, count * 3);
+            kernels->swap_16bit_endian(actual.data() + 1, count * 3);
+            ASSERT_EQ(actual, expected);
+
+            expected.assign(in_data.begin(), in_data.end());
+            actual.assign(in_data.begin(), in_data.end());
+            scalar.invert_bytes(expected.data() + 1, count * 6);
+            kernels->invert_bytes(actual.data() + 1, count * 6);
+            ASSERT_EQ(actual, expected);
+
+            expected.assign(count * 3, 0);
+            actual.assign(count * 3 + 1, 0);
+            scalar.merge_mono_lines_8(in_ptr, in_ptr + count, in_ptr + count * 2,
+                                      expected.data(), count);
+            kernels->merge_mono_lines_8(in_ptr, in_ptr + count, in_ptr + count * 2,
+                                        actual.data() + 1, count);
+            ASSERT_EQ(Data(actual.begin() + 1, actual.end()), expected);
+
+            expected.assign(count * 6, 0);
+            actual.assign(count * 6 + 1, 0);
+            scalar.merge_mono_lines_16(in_ptr, in_ptr + count * 2, in_ptr + count * 4,
+                                       expected.data(), count);
+            kernels->merge_mono_lines_16(in_ptr, in_ptr + count * 2, in_ptr + count * 4,
+                                         actual.data() + 1, count);
+            ASSERT_EQ(Data(actual.begin() + 1, actual.end()), expected);
+        }
+    }
+}
+
+void test_convert_pixel_row_format_swap_rgb()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    std::size_t count = 37;
+    auto in_data = make_test_data(count * 6, 1);
+
+    for (auto formats : { std::make_pair(PixelFormat::RGB888, PixelFormat::BGR888),
+                          std::make_pair(PixelFormat::BGR888, PixelFormat::RGB888),
+                          std::make_pair(PixelFormat::RGB161616, PixelFormat::BGR161616),
+                          std::make_pair(PixelFormat::BGR161616, PixelFormat::RGB161616) })
+    {
+        auto row_bytes = get_pixel_row_bytes(formats.first, count);
+
+        Data expected;
+        expected.resize(row_bytes);
+        for (std::size_t x = 0; x < count; ++x) {
+            set_pixel_to_row(expected.data(), x,
+                             get_pixel_from_row(in_data.data(), x, formats.first),
+                             formats.second);
+        }
+
+        Data out_data;
+        out_data.resize(row_bytes);
+        convert_pixel_row_format(in_data.data(), formats.first,
+                                 out_data.data(), formats.second, count);
+        ASSERT_EQ(out_data, expected);
+    }
+}
+
 void test_image()
 {
     test_get_pixel_from_row();
@@ -571,6 +723,9 @@ void test_image()
     test_get_raw_channel_from_row();
     test_set_raw_channel_to_row();
     test_convert_pixel_row_format();
+    test_convert_pixel_row_format_swap_rgb();
+    test_pixel_kernels_scalar();
+    test_pixel_kernels_match_scalar();
 }
 
 } // namespace genesys
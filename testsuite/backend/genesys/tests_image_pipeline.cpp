@@ -28,7 +28,11 @@
 
 #include "../../../backend/genesys/image_pipeline.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <numeric>
+#include <thread>
 
 namespace genesys {
 
@@ -169,6 +173,167 @@ void test_image_buffer_capped_remaining_bytes()
     ASSERT_EQ(requests, expected);
 }
 
+void test_image_buffer_read_ahead()
+{
+    std::vector<std::size_t> requests;
+    std::uint8_t next_value = 0;
+
+    auto on_read = [&](std::size_t x, std::uint8_t* data)
+    {
+        requests.push_back(x);
+        for (std::size_t i = 0; i < x; ++i) {
+            data[i] = next_value++;
+        }
+        return true;
+    };
+
+    ImageBuffer buffer{1000, on_read};
+    buffer.set_remaining_size(2500);
+    buffer.set_last_read_multiple(16);
+    buffer.enable_read_ahead(2);
+
+    std::vector<std::uint8_t> data;
+    data.resize(2500);
+
+    ASSERT_TRUE(buffer.get_data(600, data.data()));
+    ASSERT_TRUE(buffer.get_data(1900, data.data() + 600));
+    ASSERT_FALSE(buffer.get_data(100, data.data()));
+    buffer.stop_read_ahead();
+
+    std::vector<std::size_t> expected = {
+        1000, 1000, 512, 0
+    };
+    ASSERT_EQ(requests, expected);
+
+    std::vector<std::uint8_t> expected_data;
+    expected_data.resize(2500);
+    std::iota(expected_data.begin(), expected_data.end(), 0);
+    ASSERT_EQ(data, expected_data);
+}
+
+void test_image_buffer_read_ahead_stop()
+{
+    std::vector<std::size_t> requests;
+
+    auto on_read = [&](std::size_t x, std::uint8_t* data)
+    {
+        (void) data;
+        requests.push_back(x);
+        return true;
+    };
+
+    ImageBuffer buffer{1000, on_read};
+    buffer.set_remaining_size(10000);
+    buffer.enable_read_ahead(3);
+
+    std::vector<std::uint8_t> dummy;
+    dummy.resize(1000);
+
+    ASSERT_TRUE(buffer.get_data(1000, dummy.data()));
+    buffer.stop_read_ahead();
+    ASSERT_FALSE(buffer.is_reading_ahead());
+
+    // the producer is not called any more
+    auto requests_after_stop = requests.size();
+    ASSERT_TRUE(requests_after_stop <= 4);
+
+    // all data is still returned, the chunks that were not read ahead are read synchronously
+    for (unsigned i = 1; i < 10; ++i) {
+        ASSERT_TRUE(buffer.get_data(1000, dummy.data()));
+    }
+    ASSERT_EQ(requests.size(), 10u);
+    ASSERT_EQ(buffer.remaining_size(), 0u);
+}
+
+void test_image_buffer_read_ahead_error()
+{
+    unsigned request_count = 0;
+
+    auto on_read = [&](std::size_t x, std::uint8_t* data)
+    {
+        (void) x;
+        (void) data;
+        if (request_count++ == 1) {
+            throw SaneException(SANE_STATUS_IO_ERROR, "failed read");
+        }
+        return true;
+    };
+
+    ImageBuffer buffer{1000, on_read};
+    buffer.set_remaining_size(3000);
+    buffer.enable_read_ahead(2);
+
+    std::vector<std::uint8_t> dummy;
+    dummy.resize(1000);
+
+    ASSERT_TRUE(buffer.get_data(1000, dummy.data()));
+
+    SANE_Status status = SANE_STATUS_GOOD;
+    try {
+        buffer.get_data(1000, dummy.data());
+    } catch (const SaneException& e) {
+        status = e.status();
+    }
+    ASSERT_EQ(status, SANE_STATUS_IO_ERROR);
+}
+
+void test_image_buffer_read_ahead_ready_size()
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    unsigned allowed_requests = 0;
+
+    auto on_read = [&](std::size_t x, std::uint8_t* data)
+    {
+        (void) x;
+        (void) data;
+        std::unique_lock<std::mutex> lock{mutex};
+        cond.wait(lock, [&]() { return allowed_requests > 0; });
+        allowed_requests--;
+        return true;
+    };
+
+    std::atomic<unsigned> callback_count{0};
+
+    ImageBuffer buffer{1000, on_read};
+    buffer.set_remaining_size(2500);
+    buffer.enable_read_ahead(4);
+    buffer.set_read_ahead_callback([&]() { callback_count++; });
+    buffer.start_read_ahead();
+
+    ASSERT_EQ(buffer.ready_size(), 0u);
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        allowed_requests = 1;
+    }
+    cond.notify_all();
+
+    while (callback_count < 1) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(buffer.ready_size(), 1000u);
+
+    std::vector<std::uint8_t> dummy;
+    dummy.resize(2500);
+    ASSERT_TRUE(buffer.get_data(400, dummy.data()));
+    ASSERT_EQ(buffer.ready_size(), 600u);
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        allowed_requests = 2;
+    }
+    cond.notify_all();
+
+    // the thread finishes after reading the last chunk
+    while (callback_count < 4) {
+        std::this_thread::yield();
+    }
+    std::uint64_t size_unset = ImageBuffer::BUFFER_SIZE_UNSET;
+    ASSERT_EQ(buffer.ready_size(), size_unset);
+    ASSERT_TRUE(buffer.get_data(2100, dummy.data()));
+}
+
 void test_node_buffered_callable_source()
 {
     using Data = std::vector<std::uint8_t>;
@@ -565,6 +730,49 @@ void test_node_component_shift_lines()
     ASSERT_EQ(out_data, expected_data);
 }
 
+void test_node_get_next_rows_matches_rows()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    std::size_t width = 5;
+    std::size_t height = 21;
+
+    Data in_data;
+    in_data.resize(width * height * 2);
+    for (std::size_t i = 0; i < in_data.size(); ++i) {
+        in_data[i] = static_cast<std::uint8_t>(i * 7 + 3);
+    }
+
+    auto make_stack = [&](ImagePipelineStack& stack)
+    {
+        stack.push_first_node<ImagePipelineNodeArraySource>(width, height, PixelFormat::I16,
+                                                            Data(in_data));
+        stack.push_node<ImagePipelineNodeSwap16BitEndian>();
+        stack.push_node<ImagePipelineNodeMergeMonoLines>(ColorOrder::BGR);
+        stack.push_node<ImagePipelineNodeComponentShiftLines>(0, 1, 2);
+        stack.push_node<ImagePipelineNodeFormatConvert>(PixelFormat::RGB888);
+        stack.push_node<ImagePipelineNodeInvert>();
+    };
+
+    ImagePipelineStack row_stack;
+    make_stack(row_stack);
+    auto expected_data = row_stack.get_all_data();
+
+    ImagePipelineStack batch_stack;
+    make_stack(batch_stack);
+
+    auto row_bytes = batch_stack.get_output_row_bytes();
+    auto out_height = batch_stack.get_output_height();
+    ASSERT_EQ(out_height, 5u);
+
+    Data out_data;
+    out_data.resize(row_bytes * out_height);
+    ASSERT_TRUE(batch_stack.get_next_rows(3, out_data.data()));
+    ASSERT_TRUE(batch_stack.get_next_rows(out_height - 3, out_data.data() + 3 * row_bytes));
+
+    ASSERT_EQ(out_data, expected_data);
+}
+
 void test_node_pixel_shift_lines_2lines()
 {
     using Data = std::vector<std::uint8_t>;
@@ -923,6 +1131,61 @@ void test_node_calibrate_16bit()
     ASSERT_EQ(out_data, expected_data);
 }
 
+void test_node_calibrate_matches_exact()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    for (auto format : { PixelFormat::RGB888, PixelFormat::RGB161616 }) {
+        std::size_t width = 100;
+        std::size_t values = width * 3;
+        std::int64_t max_value = get_pixel_format_depth(format) == 16 ? 65535 : 255;
+
+        Data in_data;
+        in_data.resize(get_pixel_row_bytes(format, width));
+        std::vector<std::uint16_t> bottom;
+        std::vector<std::uint16_t> top;
+
+        unsigned seed = 1;
+        auto next_random = [&]()
+        {
+            seed = seed * 1103515245 + 12345;
+            return (seed >> 8) & 0xffff;
+        };
+
+        for (auto& d : in_data) {
+            d = static_cast<std::uint8_t>(next_random());
+        }
+        for (std::size_t i = 0; i < values; ++i) {
+            bottom.push_back(next_random() / 4);
+            top.push_back(bottom.back() + 1 + next_random() / 2);
+        }
+
+        Data data_copy = in_data;
+
+        ImagePipelineStack stack;
+        stack.push_first_node<ImagePipelineNodeArraySource>(width, 1, format,
+                                                            std::move(data_copy));
+        stack.push_node<ImagePipelineNodeCalibrate>(bottom, top, 0);
+
+        auto out_data = stack.get_all_data();
+
+        // the results may differ only when the exact result is very close to a rounding boundary
+        std::int64_t max_difference = 0;
+        for (std::size_t i = 0; i < values; ++i) {
+            std::int64_t value = get_raw_channel_from_row(in_data.data(), i / 3, i % 3, format);
+            std::int64_t numerator = value * 65535 - bottom[i] * max_value;
+            std::int64_t denominator = top[i] - bottom[i];
+            std::int64_t expected = 0;
+            if (numerator > 0) {
+                expected = std::min((2 * numerator + denominator) / (2 * denominator), max_value);
+            }
+            std::int64_t actual = get_raw_channel_from_row(out_data.data(), i / 3, i % 3, format);
+            max_difference = std::max(max_difference, std::abs(actual - expected));
+        }
+        ASSERT_TRUE(max_difference <= 1);
+    }
+}
+
 void test_image_pipeline()
 {
     test_image_buffer_exact_reads();
@@ -930,6 +1193,10 @@ void test_image_pipeline()
     test_image_buffer_larger_reads();
     test_image_buffer_uncapped_remaining_bytes();
     test_image_buffer_capped_remaining_bytes();
+    test_image_buffer_read_ahead();
+    test_image_buffer_read_ahead_stop();
+    test_image_buffer_read_ahead_error();
+    test_image_buffer_read_ahead_ready_size();
     test_node_buffered_callable_source();
     test_node_format_convert();
     test_node_desegment_1_line();
@@ -942,6 +1209,7 @@ void test_image_pipeline()
     test_node_merge_mono_lines();
     test_node_split_mono_lines();
     test_node_component_shift_lines();
+    test_node_get_next_rows_matches_rows();
     test_node_pixel_shift_columns_no_switch();
     test_node_pixel_shift_columns_group_switch_pixel_multiple();
     test_node_pixel_shift_columns_group_switch_pixel_not_multiple();
@@ -952,6 +1220,7 @@ void test_image_pipeline()
     test_node_pixel_shift_columns_compute_max_width();
     test_node_calibrate_8bit();
     test_node_calibrate_16bit();
+    test_node_calibrate_matches_exact();
 }
 
 } // namespace genesys
@@ -0,0 +1,97 @@
+/* sane - Scanner Access Now Easy.
+
+   Copyright (C) 2019 Povilas Kanapickas <povilas@radix.lt>
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "tests.h"
+#include "minigtest.h"
+
+#include "../../../backend/genesys/scanner_interface_usb.h"
+
+namespace genesys {
+
+void test_scanner_interface_volatile_registers()
+{
+    for (auto asic_type : { AsicType::GL845, AsicType::GL846, AsicType::GL847 }) {
+        ASSERT_TRUE(is_volatile_register(asic_type, 0x0e));
+        ASSERT_TRUE(is_volatile_register(asic_type, 0x3a));
+        ASSERT_TRUE(is_volatile_register(asic_type, 0x41));
+        ASSERT_TRUE(is_volatile_register(asic_type, 0x6c));
+        ASSERT_TRUE(is_volatile_register(asic_type, 0x6d));
+        ASSERT_FALSE(is_volatile_register(asic_type, 0x01));
+        ASSERT_FALSE(is_volatile_register(asic_type, 0x5e));
+        ASSERT_FALSE(is_volatile_register(asic_type, 0x6e));
+    }
+
+    ASSERT_TRUE(is_volatile_register(AsicType::GL124, 0x0e));
+    ASSERT_TRUE(is_volatile_register(AsicType::GL124, 0x32));
+    ASSERT_TRUE(is_volatile_register(AsicType::GL124, 0x5d));
+    ASSERT_TRUE(is_volatile_register(AsicType::GL124, 0x100));
+    ASSERT_FALSE(is_volatile_register(AsicType::GL124, 0x01));
+    ASSERT_FALSE(is_volatile_register(AsicType::GL124, 0x28));
+    ASSERT_FALSE(is_volatile_register(AsicType::GL124, 0x3a));
+    ASSERT_FALSE(is_volatile_register(AsicType::GL124, 0x41));
+    ASSERT_FALSE(is_volatile_register(AsicType::GL124, 0x114));
+
+    ASSERT_TRUE(is_volatile_register(AsicType::GL843, 0x01));
+}
+
+void test_scanner_interface_filter_unchanged_registers()
+{
+    RegisterCache<std::uint8_t> cache;
+    cache.update(0x01, 0x20);
+    cache.update(0x02, 0x30);
+    cache.update(0x0f, 0x01);
+    cache.update(0x6c, 0x40);
+
+    Genesys_Register_Set regs;
+    regs.init_reg(0x01, 0x20); // unchanged
+    regs.init_reg(0x02, 0x31); // changed
+    regs.init_reg(0x03, 0x10); // not cached
+    regs.init_reg(0x0f, 0x01); // command
+    regs.init_reg(0x6c, 0x40); // GPIO
+
+    auto gl847_regs = filter_unchanged_registers(AsicType::GL847, regs, cache);
+    ASSERT_EQ(gl847_regs.size(), 4u);
+    ASSERT_FALSE(gl847_regs.has_reg(0x01));
+    ASSERT_EQ(gl847_regs.get8(0x02), 0x31u);
+    ASSERT_EQ(gl847_regs.get8(0x03), 0x10u);
+    ASSERT_TRUE(gl847_regs.has_reg(0x0f));
+    ASSERT_TRUE(gl847_regs.has_reg(0x6c));
+
+    auto gl124_regs = filter_unchanged_registers(AsicType::GL124, regs, cache);
+    ASSERT_EQ(gl124_regs.size(), 3u);
+    ASSERT_FALSE(gl124_regs.has_reg(0x01));
+    ASSERT_TRUE(gl124_regs.has_reg(0x0f));
+    ASSERT_FALSE(gl124_regs.has_reg(0x6c));
+
+    auto gl843_regs = filter_unchanged_registers(AsicType::GL843, regs, cache);
+    ASSERT_EQ(gl843_regs.size(), regs.size());
+}
+
+void test_scanner_interface()
+{
+    test_scanner_interface_volatile_registers();
+    test_scanner_interface_filter_unchanged_registers();
+}
+
+} // namespace genesys
@@ -100,11 +100,42 @@ void test_utilities_compute_array_percentile_approx_multiple_lines()
     ASSERT_EQ(result, expected);
 }
 
+void test_utilities_compute_array_percentile_approx_large()
+{
+    // wide and tall enough to use multiple tiles, threads and the histogram based selection
+    std::size_t line_count = 200;
+    std::size_t elements_per_line = 6000;
+
+    std::vector<std::uint16_t> data;
+    data.reserve(line_count * elements_per_line);
+    std::uint32_t seed = 12345;
+    for (std::size_t i = 0; i < line_count * elements_per_line; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data.push_back(static_cast<std::uint16_t>(seed >> 16));
+    }
+
+    // the generic implementation is used for other types
+    std::vector<std::uint32_t> data32(data.begin(), data.end());
+
+    for (float percentile : { 0.0f, 0.3f, 0.5f, 1.0f }) {
+        std::vector<std::uint16_t> result(elements_per_line, 0);
+        std::vector<std::uint32_t> expected(elements_per_line, 0);
+
+        compute_array_percentile_approx(result.data(), data.data(),
+                                        line_count, elements_per_line, percentile);
+        compute_array_percentile_approx(expected.data(), data32.data(),
+                                        line_count, elements_per_line, percentile);
+
+        ASSERT_EQ(std::vector<std::uint32_t>(result.begin(), result.end()), expected);
+    }
+}
+
 void test_utilities()
 {
     test_utilities_compute_array_percentile_approx_empty();
     test_utilities_compute_array_percentile_approx_single_line();
     test_utilities_compute_array_percentile_approx_multiple_lines();
+    test_utilities_compute_array_percentile_approx_large();
 }
 
 } // namespace genesys
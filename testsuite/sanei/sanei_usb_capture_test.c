@@ -0,0 +1,360 @@
+#include "../../include/sane/config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "../../include/sane/sane.h"
+#include "../../include/sane/sanei.h"
+#include "../../include/sane/sanei_usb.h"
+#include "../../include/sane/sanei_usb_capture.h"
+
+#include "../../include/_stdint.h"
+
+#define CAPTURE_FILE "sanei_usb_capture_test.bin"
+#define CAPTURE_XML_FILE "sanei_usb_capture_test.xml"
+#define CAPTURE_COPY_FILE "sanei_usb_capture_test2.bin"
+
+static const SANE_Byte ctrl_out_data[] = { 0x01, 0x02, 0x03, 0x04 };
+static const SANE_Byte ctrl_in_data[] = { 0xaa, 0xbb };
+static const SANE_Byte bulk_out_data[] = { 0x10, 0x20, 0x30 };
+static SANE_Byte bulk_in_data[200];
+static const char debug_message[] = "test message with \"quotes\" & <tags>";
+
+static sanei_usb_capture_record records[11];
+static int num_records;
+
+static void
+add_record (unsigned type, unsigned flags, unsigned endpoint,
+            uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+            const void *data, size_t size)
+{
+  sanei_usb_capture_record *rec = &records[num_records++];
+
+  memset (rec, 0, sizeof (*rec));
+  rec->type = type;
+  rec->flags = flags;
+  rec->endpoint = endpoint;
+  if (type >= SANEI_USB_CAPTURE_CONTROL)
+    rec->seq = num_records;
+  rec->arg[0] = arg0;
+  rec->arg[1] = arg1;
+  rec->arg[2] = arg2;
+  rec->arg[3] = arg3;
+  rec->data = data;
+  rec->size = size;
+}
+
+static void
+setup_records (void)
+{
+  unsigned i;
+
+  for (i = 0; i < sizeof (bulk_in_data); i++)
+    bulk_in_data[i] = i * 7;
+
+  num_records = 0;
+  add_record (SANEI_USB_CAPTURE_DEVICE, 0, 0, 0x04a9, 0x1905, 0, 0,
+              "genesys", 7);
+  add_record (SANEI_USB_CAPTURE_INTERFACE, 0, 0, 0, 1, 0, 0, NULL, 0);
+  add_record (SANEI_USB_CAPTURE_ENDPOINT, SANEI_USB_CAPTURE_FLAG_IN, 0,
+              USB_ENDPOINT_TYPE_BULK, 0x81, 0, 0, NULL, 0);
+  add_record (SANEI_USB_CAPTURE_ENDPOINT, 0, 0,
+              USB_ENDPOINT_TYPE_BULK, 0x02, 0, 0, NULL, 0);
+  add_record (SANEI_USB_CAPTURE_CONTROL, 0, 0,
+              0x40, 0x0c, 0x0083 | (0x0010 << 16), sizeof (ctrl_out_data),
+              ctrl_out_data, sizeof (ctrl_out_data));
+  add_record (SANEI_USB_CAPTURE_CONTROL, SANEI_USB_CAPTURE_FLAG_IN, 0,
+              0xc0, 0x0c, 0x0084 | (0x0020 << 16), sizeof (ctrl_in_data),
+              ctrl_in_data, sizeof (ctrl_in_data));
+  add_record (SANEI_USB_CAPTURE_BULK, 0, 2, 0, 0, 0, 0,
+              bulk_out_data, sizeof (bulk_out_data));
+  add_record (SANEI_USB_CAPTURE_DEBUG, 0, 0, 0, 0, 0, 0,
+              debug_message, strlen (debug_message));
+  add_record (SANEI_USB_CAPTURE_BULK, SANEI_USB_CAPTURE_FLAG_IN, 1,
+              0, 0, 0, 0, bulk_in_data, 150);
+  add_record (SANEI_USB_CAPTURE_BULK, SANEI_USB_CAPTURE_FLAG_IN, 1,
+              0, 0, 0, 0, bulk_in_data + 150, 50);
+  add_record (SANEI_USB_CAPTURE_BULK,
+              SANEI_USB_CAPTURE_FLAG_IN | SANEI_USB_CAPTURE_FLAG_UNKNOWN, 1,
+              512, 0, 0, 0, NULL, 0);
+}
+
+/** check that two records are equal
+ * @return 1 on success, else 0
+ */
+static int
+records_equal (const sanei_usb_capture_record * a,
+               const sanei_usb_capture_record * b)
+{
+  int i;
+
+  if (a->type != b->type || a->flags != b->flags ||
+      a->endpoint != b->endpoint || a->seq != b->seq || a->size != b->size)
+    {
+      printf ("ERROR: record %u/%u differs from %u/%u\n", a->type, a->seq,
+              b->type, b->seq);
+      return 0;
+    }
+  for (i = 0; i < 4; i++)
+    if (a->arg[i] != b->arg[i])
+      {
+        printf ("ERROR: argument %d of record %u/%u differs: %u vs %u\n", i,
+                a->type, a->seq, a->arg[i], b->arg[i]);
+        return 0;
+      }
+  if (a->size > 0 && memcmp (a->data, b->data, a->size) != 0)
+    {
+      printf ("ERROR: data of record %u/%u differs\n", a->type, a->seq);
+      return 0;
+    }
+  return 1;
+}
+
+/** check that a capture file holds exactly the test records
+ * @return 1 on success, else 0
+ */
+static int
+check_capture (const char *path)
+{
+  sanei_usb_capture *capture;
+  sanei_usb_capture_record rec;
+  SANE_Status status;
+  int i = 0;
+
+  capture = sanei_usb_capture_open (path);
+  if (capture == NULL)
+    {
+      printf ("ERROR: can't open %s\n", path);
+      return 0;
+    }
+  while ((status = sanei_usb_capture_read (capture, &rec)) == SANE_STATUS_GOOD)
+    {
+      if (i >= num_records || !records_equal (&rec, &records[i]))
+        {
+          sanei_usb_capture_close (capture);
+          return 0;
+        }
+      i++;
+    }
+  sanei_usb_capture_close (capture);
+  if (status != SANE_STATUS_EOF || i != num_records)
+    {
+      printf ("ERROR: got %d records, expected %d\n", i, num_records);
+      return 0;
+    }
+  return 1;
+}
+
+static int
+test_write_read (void)
+{
+  sanei_usb_capture *capture;
+  int i;
+
+  printf ("%s starting ...\n", __func__);
+  capture = sanei_usb_capture_create (CAPTURE_FILE);
+  if (capture == NULL)
+    {
+      printf ("ERROR: can't create %s\n", CAPTURE_FILE);
+      return 0;
+    }
+  for (i = 0; i < num_records; i++)
+    if (sanei_usb_capture_write (capture, &records[i]) != SANE_STATUS_GOOD)
+      {
+        printf ("ERROR: failed to write record %d\n", i);
+        return 0;
+      }
+  if (sanei_usb_capture_close (capture) != SANE_STATUS_GOOD)
+    return 0;
+
+  if (!sanei_usb_capture_is_binary (CAPTURE_FILE))
+    {
+      printf ("ERROR: %s not detected as binary capture\n", CAPTURE_FILE);
+      return 0;
+    }
+  if (!check_capture (CAPTURE_FILE))
+    return 0;
+  printf ("%s success\n", __func__);
+  return 1;
+}
+
+static int
+test_xml_roundtrip (void)
+{
+  SANE_Status status;
+
+  printf ("%s starting ...\n", __func__);
+  status = sanei_usb_capture_to_xml (CAPTURE_FILE, CAPTURE_XML_FILE);
+  if (status == SANE_STATUS_UNSUPPORTED)
+    {
+      printf ("%s skipped, no libxml2 support\n", __func__);
+      return 1;
+    }
+  if (status != SANE_STATUS_GOOD)
+    {
+      printf ("ERROR: conversion to XML failed: %s\n",
+              sane_strstatus (status));
+      return 0;
+    }
+  if (sanei_usb_capture_is_binary (CAPTURE_XML_FILE))
+    {
+      printf ("ERROR: %s detected as binary capture\n", CAPTURE_XML_FILE);
+      return 0;
+    }
+
+  status = sanei_usb_capture_from_xml (CAPTURE_XML_FILE, CAPTURE_COPY_FILE);
+  if (status != SANE_STATUS_GOOD)
+    {
+      printf ("ERROR: conversion from XML failed: %s\n",
+              sane_strstatus (status));
+      return 0;
+    }
+  if (!check_capture (CAPTURE_COPY_FILE))
+    return 0;
+  printf ("%s success\n", __func__);
+  return 1;
+}
+
+static int
+test_truncated (void)
+{
+  sanei_usb_capture *capture;
+  sanei_usb_capture_record rec;
+  SANE_Status status;
+  FILE *f;
+  long size;
+  char *buf;
+  int i;
+
+  printf ("%s starting ...\n", __func__);
+
+  /* cut the last record in half */
+  f = fopen (CAPTURE_FILE, "rb");
+  fseek (f, 0, SEEK_END);
+  size = ftell (f);
+  rewind (f);
+  buf = malloc (size);
+  assert (fread (buf, size, 1, f) == 1);
+  fclose (f);
+  f = fopen (CAPTURE_COPY_FILE, "wb");
+  fwrite (buf, size - SANEI_USB_CAPTURE_HEADER_SIZE / 2, 1, f);
+  fclose (f);
+  free (buf);
+
+  capture = sanei_usb_capture_open (CAPTURE_COPY_FILE);
+  if (capture == NULL)
+    return 0;
+  for (i = 0; (status = sanei_usb_capture_read (capture, &rec))
+       == SANE_STATUS_GOOD; i++)
+    ;
+  sanei_usb_capture_close (capture);
+  if (status != SANE_STATUS_INVAL || i != num_records - 1)
+    {
+      printf ("ERROR: truncated capture not detected\n");
+      return 0;
+    }
+  printf ("%s success\n", __func__);
+  return 1;
+}
+
+static int
+test_replay (void)
+{
+  SANE_Int dn;
+  SANE_Byte buf[512];
+  size_t size;
+  SANE_String backend;
+
+  printf ("%s starting ...\n", __func__);
+  if (sanei_usb_testing_enable_replay (CAPTURE_FILE, 0) ==
+      SANE_STATUS_UNSUPPORTED)
+    {
+      printf ("%s skipped, no record-replay support\n", __func__);
+      return 1;
+    }
+
+  backend = sanei_usb_testing_get_backend ();
+  if (backend == NULL || strcmp (backend, "genesys") != 0)
+    {
+      printf ("ERROR: unexpected backend %s\n", backend);
+      return 0;
+    }
+  free (backend);
+
+  sanei_usb_init ();
+  if (sanei_usb_open (CAPTURE_FILE, &dn) != SANE_STATUS_GOOD)
+    {
+      printf ("ERROR: can't open replayed device\n");
+      return 0;
+    }
+
+  memcpy (buf, ctrl_out_data, sizeof (ctrl_out_data));
+  if (sanei_usb_control_msg (dn, 0x40, 0x0c, 0x83, 0x10,
+                             sizeof (ctrl_out_data), buf) != SANE_STATUS_GOOD)
+    {
+      printf ("ERROR: control write failed\n");
+      return 0;
+    }
+
+  memset (buf, 0, sizeof (buf));
+  if (sanei_usb_control_msg (dn, 0xc0, 0x0c, 0x84, 0x20,
+                             sizeof (ctrl_in_data), buf) != SANE_STATUS_GOOD ||
+      memcmp (buf, ctrl_in_data, sizeof (ctrl_in_data)) != 0)
+    {
+      printf ("ERROR: control read failed\n");
+      return 0;
+    }
+
+  size = sizeof (bulk_out_data);
+  if (sanei_usb_write_bulk (dn, bulk_out_data, &size) != SANE_STATUS_GOOD ||
+      size != sizeof (bulk_out_data))
+    {
+      printf ("ERROR: bulk write failed\n");
+      return 0;
+    }
+
+  sanei_usb_testing_record_message (debug_message);
+
+  /* the two recorded packets are combined into one read */
+  size = 300;
+  memset (buf, 0, sizeof (buf));
+  if (sanei_usb_read_bulk (dn, buf, &size) != SANE_STATUS_GOOD ||
+      size != sizeof (bulk_in_data) ||
+      memcmp (buf, bulk_in_data, sizeof (bulk_in_data)) != 0)
+    {
+      printf ("ERROR: bulk read failed\n");
+      return 0;
+    }
+
+  /* the data of the last read is unknown */
+  size = sizeof (buf);
+  if (sanei_usb_read_bulk (dn, buf, &size) != SANE_STATUS_IO_ERROR)
+    {
+      printf ("ERROR: read of unknown data succeeded\n");
+      return 0;
+    }
+
+  sanei_usb_close (dn);
+  sanei_usb_exit ();
+  printf ("%s success\n", __func__);
+  return 1;
+}
+
+int
+main (void)
+{
+  setup_records ();
+
+  assert (test_write_read ());
+  assert (test_xml_roundtrip ());
+  assert (test_truncated ());
+  assert (test_replay ());
+
+  remove (CAPTURE_FILE);
+  remove (CAPTURE_XML_FILE);
+  remove (CAPTURE_COPY_FILE);
+  printf ("All sanei_usb_capture tests passed\n");
+  return 0;
+}
@@ -23,6 +23,11 @@ static SANE_String_Const mode_list[] = {
   "Lineart", "Grayscale", "Color", 0
 };
 
+/* both arrays are larger than the 8192 byte wire buffer, so the bulk
+   codec functions have to split them into several chunks */
+#define ROUND_TRIP_WORDS 3000
+#define ROUND_TRIP_BYTES 10000
+
 static char *program_name;
 static char *default_codec = "bin";
 static char *default_outfile = "test_wire.out";
@@ -53,6 +58,99 @@ Valid CODECs are: `ascii' `bin'\n", program_name, default_codec, default_outfile
 }
 
 
+/* Encodes a word and a byte array crossing the wire buffer boundary at
+   an unaligned offset, decodes them again and compares the result.
+   Returns 0 on success. */
+static int
+test_array_round_trip (const char *codec)
+{
+  static SANE_Word words[ROUND_TRIP_WORDS];
+  static SANE_Byte bytes[ROUND_TRIP_BYTES];
+  SANE_Word word_len = ROUND_TRIP_WORDS, byte_len = ROUND_TRIP_BYTES;
+  SANE_Word *word_ptr = words, *decoded_words = 0;
+  SANE_Byte *byte_ptr = bytes, *decoded_bytes = 0;
+  SANE_Byte pad[3] = { 0x11, 0x22, 0x33 };
+  int i, saved_fd, failed = 0;
+  FILE *tmp;
+
+  for (i = 0; i < ROUND_TRIP_WORDS; ++i)
+    words[i] = (SANE_Word) (i * 2654435761U);
+  for (i = 0; i < ROUND_TRIP_BYTES; ++i)
+    bytes[i] = (SANE_Byte) (i * 7 + (i >> 8));
+
+  /* keep the option descriptors in the output file for --readonly */
+  tmp = tmpfile ();
+  if (!tmp)
+    {
+      perror ("tmpfile");
+      return 1;
+    }
+  saved_fd = w.io.fd;
+  w.io.fd = fileno (tmp);
+
+  sanei_w_set_dir (&w, WIRE_ENCODE);
+  w.status = 0;
+
+  /* misalign the arrays relative to the wire buffer */
+  for (i = 0; i < NELEMS (pad); ++i)
+    sanei_w_byte (&w, &pad[i]);
+  sanei_w_array (&w, &word_len, (void **) &word_ptr,
+		 (WireCodecFunc) sanei_w_word, sizeof (SANE_Word));
+  sanei_w_array (&w, &byte_len, (void **) &byte_ptr,
+		 (WireCodecFunc) sanei_w_byte, sizeof (SANE_Byte));
+
+  /* switching the direction flushes the encoded data */
+  sanei_w_set_dir (&w, WIRE_DECODE);
+  if (w.status != 0)
+    {
+      fprintf (stderr, "%s: %s array encode error %d: %s\n",
+	       program_name, codec, w.status, strerror (w.status));
+      failed = 1;
+      goto out;
+    }
+
+  lseek (w.io.fd, 0, SEEK_SET);
+  memset (pad, 0, sizeof (pad));
+  word_len = byte_len = 0;
+
+  for (i = 0; i < NELEMS (pad); ++i)
+    sanei_w_byte (&w, &pad[i]);
+  sanei_w_array (&w, &word_len, (void **) &decoded_words,
+		 (WireCodecFunc) sanei_w_word, sizeof (SANE_Word));
+  sanei_w_array (&w, &byte_len, (void **) &decoded_bytes,
+		 (WireCodecFunc) sanei_w_byte, sizeof (SANE_Byte));
+
+  if (w.status != 0)
+    {
+      fprintf (stderr, "%s: %s array decode error %d: %s\n",
+	       program_name, codec, w.status, strerror (w.status));
+      failed = 1;
+    }
+  else if (pad[0] != 0x11 || pad[1] != 0x22 || pad[2] != 0x33
+	   || word_len != ROUND_TRIP_WORDS || byte_len != ROUND_TRIP_BYTES
+	   || memcmp (decoded_words, words, sizeof (words)) != 0
+	   || memcmp (decoded_bytes, bytes, sizeof (bytes)) != 0)
+    {
+      fprintf (stderr, "%s: %s array round trip mismatch\n",
+	       program_name, codec);
+      failed = 1;
+    }
+  else
+    printf ("%s array round trip successful\n", codec);
+
+  sanei_w_set_dir (&w, WIRE_FREE);
+  w.status = 0;
+  sanei_w_array (&w, &word_len, (void **) &decoded_words,
+		 (WireCodecFunc) sanei_w_word, sizeof (SANE_Word));
+  sanei_w_array (&w, &byte_len, (void **) &decoded_bytes,
+		 (WireCodecFunc) sanei_w_byte, sizeof (SANE_Byte));
+
+out:
+  w.io.fd = saved_fd;
+  fclose (tmp);
+  return failed;
+}
+
 int
 main (int __sane_unused__ arg, char **argv)
 {
@@ -61,6 +159,7 @@ main (int __sane_unused__ arg, char **argv)
   char *codec = default_codec;
   char *outfile = default_outfile;
   int readonly = 0;
+  int failed = 0;
 
   program_name = argv[0];
   argv++;
@@ -230,7 +329,10 @@ main (int __sane_unused__ arg, char **argv)
     fprintf (stderr, "%s: free error %d: %s\n",
 	     program_name, w.status, strerror (w.status));
 
+  if (!readonly)
+    failed = test_array_round_trip (codec);
+
   close (w.io.fd);
 
-  return 0;
+  return failed;
 }
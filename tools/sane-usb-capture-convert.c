@@ -0,0 +1,60 @@
+/* sane - Scanner Access Now Easy.
+
+   sane-usb-capture-convert
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+   MA 02111-1307, USA.
+
+   Converts USB captures recorded by sanei_usb between the XML and the
+   binary format. The direction is chosen by the format of the input
+   file.  */
+
+#include "../include/sane/config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/sane/sane.h"
+#include "../include/sane/sanei.h"
+#include "../include/sane/sanei_usb_capture.h"
+
+int
+main (int argc, char **argv)
+{
+  SANE_Status status;
+
+  if (argc != 3)
+    {
+      fprintf (stderr, "Usage: %s INPUT OUTPUT\n\n"
+               "Converts a binary USB capture into XML or an XML capture "
+               "into binary,\ndepending on the format of INPUT.\n", argv[0]);
+      return 1;
+    }
+
+  if (sanei_usb_capture_is_binary (argv[1]))
+    status = sanei_usb_capture_to_xml (argv[1], argv[2]);
+  else
+    status = sanei_usb_capture_from_xml (argv[1], argv[2]);
+
+  if (status != SANE_STATUS_GOOD)
+    {
+      fprintf (stderr, "%s: converting %s failed: %s\n", argv[0], argv[1],
+               sane_strstatus (status));
+      return 1;
+    }
+  return 0;
+}